@@ -190,11 +190,22 @@
 #define EMMC_CRC16_ERROR      (EMMC_ERR_ID|0x17)    /*!< FMI Error - crc16 err \hideinitializer */
 #define EMMC_CRC_ERROR        (EMMC_ERR_ID|0x18)    /*!< FMI Error - crc err \hideinitializer */
 #define EMMC_CMD8_ERROR       (EMMC_ERR_ID|0x19)    /*!< FMI Error - CMD8 err \hideinitializer */
+#define EMMC_SWITCH_ERROR     (EMMC_ERR_ID|0x1A)    /*!< FMI Error - CMD6 switch err \hideinitializer */
+#define EMMC_PART_ERROR       (EMMC_ERR_ID|0x1B)    /*!< FMI Error - partition not present or not selected \hideinitializer */
+#define EMMC_STREAM_BUSY      (EMMC_ERR_ID|0x1C)    /*!< FMI Error - card owned by a stream session \hideinitializer */
 
 #define SD_FREQ         25000      /*!< Unit: kHz. Output 25MHz to SD  \hideinitializer */
 #define SDHC_FREQ       50000      /*!< Unit: kHz. Output 50MHz to SDH  \hideinitializer */
 #define MMC_FREQ        20000      /*!< Unit: kHz. Output 20MHz to MMC  \hideinitializer */
 #define EMMC_FREQ       26000      /*!< Unit: kHz. Output 26MHz to eMMC  \hideinitializer */
+#define EMMC_HS52_FREQ  52000      /*!< Unit: kHz. Output 52MHz to eMMC in HS52 timing  \hideinitializer */
+
+#define EMMC_PART_USER        0           /*!< eMMC partition - user data area \hideinitializer */
+#define EMMC_PART_BOOT1       1           /*!< eMMC partition - boot partition 1 \hideinitializer */
+#define EMMC_PART_BOOT2       2           /*!< eMMC partition - boot partition 2 \hideinitializer */
+#define EMMC_PART_RPMB        3           /*!< eMMC partition - replay protected memory block \hideinitializer */
+
+#define EMMC_RPMB_FRAME_SIZE  512         /*!< Size of an RPMB data frame in bytes \hideinitializer */
 
 /*@}*/ /* end of group N9H31_FMI_EXPORTED_CONSTANTS */
 
@@ -210,8 +221,25 @@ typedef struct eMMC_info_t {
     unsigned int    totalSectorN;   /*!< total sector number */
     unsigned int    diskSize;       /*!< disk size in Kbytes */
     int             sectorSize;     /*!< sector size in bytes */
+    unsigned int    busWidth;       /*!< data bus width in use, 1 or 4 */
+    unsigned int    busClock;       /*!< bus clock in use, unit: kHz */
+    unsigned char   extCsdRev;      /*!< EXT_CSD_REV, EXT_CSD[192] */
+    unsigned char   deviceType;     /*!< supported timings, DEVICE_TYPE EXT_CSD[196] */
+    unsigned char   partConfig;     /*!< PARTITION_CONFIG EXT_CSD[179]. Bit 2~0 is the partition accessed */
+    unsigned int    bootSectorN;    /*!< sector number of each boot partition, 0 if none */
+    unsigned int    rpmbSectorN;    /*!< sector number of the RPMB partition, 0 if none */
 } EMMC_INFO_T;
 
+/** \brief  Structure type of sequential read/write stream session.
+ */
+typedef struct eMMC_stream_t {
+    unsigned int    u32NextSec;     /*!< next sector address of the transfer */
+    unsigned int    u32Transferred; /*!< sectors transferred since the session was opened */
+    unsigned int    u32BlockCount;  /*!< CMD23 block count of a closed-ended write, 0 if open-ended */
+    int             bIsWrite;       /*!< TRUE for write session, FALSE for read session */
+    int             bIsSendCmd;     /*!< TRUE once CMD18/CMD25 has been sent */
+} EMMC_STREAM_T;
+
 /*@}*/ /* end of group N9H31_FMI_EXPORTED_TYPEDEF */
 
 /// @cond HIDDEN_SYMBOLS
@@ -299,6 +327,14 @@ void eMMC_Open(void);
 void eMMC_Probe(void);
 unsigned int eMMC_Read(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount);
 unsigned int eMMC_Write(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount);
+unsigned int eMMC_StreamOpen(EMMC_STREAM_T *pStream, unsigned int u32StartSec, unsigned int u32PreEraseCount, int bIsWrite);
+unsigned int eMMC_StreamXfer(EMMC_STREAM_T *pStream, unsigned char *pu8BufAddr, unsigned int u32SecCount);
+unsigned int eMMC_StreamClose(EMMC_STREAM_T *pStream);
+unsigned int eMMC_ReadExtCsd(unsigned char *pu8ExtCsd);
+unsigned int eMMC_SelectPartition(unsigned int u32Part);
+unsigned int eMMC_GetPartitionSize(unsigned int u32Part);
+unsigned int eMMC_RpmbWrite(unsigned char *pu8Frames, unsigned int u32Count, int bIsReliable);
+unsigned int eMMC_RpmbRead(unsigned char *pu8Frames, unsigned int u32Count);
 void FMI_SetReferenceClock(unsigned int u32Clock);
 void eMMC_Open_Disk(void);
 void eMMC_Close_Disk(void);
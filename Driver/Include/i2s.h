@@ -29,6 +29,7 @@ extern "C"
 
 #define I2S_ERR_BUSY    -1 /*!< Interface is busy  */
 #define I2S_ERR_IO      -2 /*!< IO contril error  */
+#define I2S_ERR_XRUN    -3 /*!< DMA ring underrun or overrun  */
 
 #define I2S_DISABLE     0  /*!< Enable I2S  */
 #define I2S_ENABLE      1  /*!< Disable I2S  */
@@ -100,9 +101,18 @@ extern "C"
 #define PCM_SLOT2_OUT       3  /*!< Slot-2 out position */
 
 #define I2S_SET_PCM_FS_PERIOD       17  /*!< Set PCM FS pulse period */
+#define I2S_SET_RING_SILENCE        18  /*!< Clear every played play ring period, not only on underrun */
 
 /*@}*/ /* end of group N9H31_I2S_EXPORTED_CONSTANTS */
 
+/** @addtogroup N9H31_I2S_EXPORTED_STRUCTS I2S Exported Structs
+  @{
+*/
+
+typedef void (I2S_PERIOD_CB_T)(uint32_t u32Dir);   /*!< DMA ring period call-back, I2S_PLAY or I2S_REC  */
+
+/*@}*/ /* end of group N9H31_I2S_EXPORTED_STRUCTS */
+
 /** @addtogroup N9H31_I2S_EXPORTED_FUNCTIONS I2S Exported Functions
   @{
 */
@@ -113,6 +123,16 @@ int32_t i2sIoctl(uint32_t cmd, uint32_t arg0, uint32_t arg1);
 void i2sSetSampleRate(uint32_t u32SourceClockRate, uint32_t u32SampleRate, uint32_t u32DataBit, uint32_t u32Channel);
 void i2sSetMCLKFrequency(uint32_t u32SourceClockRate, uint32_t u32SampleRate);
 void i2sSetPCMBCLKFrequency(uint32_t u32SourceClockRate, uint32_t u32Rate);
+int32_t i2sRingOpen(uint32_t u32Dir, void *pvBuf, uint32_t u32PeriodBytes, uint32_t u32Periods, I2S_PERIOD_CB_T *pfnCallback);
+void i2sRingClose(uint32_t u32Dir);
+int32_t i2sRingStart(uint32_t u32Dir);
+void i2sRingStop(uint32_t u32Dir);
+int32_t i2sRingAvail(uint32_t u32Dir);
+int32_t i2sRingBegin(uint32_t u32Dir, void **ppvData);
+int32_t i2sRingCommit(uint32_t u32Dir, uint32_t u32Bytes);
+int32_t i2sRingRecover(uint32_t u32Dir);
+uint32_t i2sRingHwPointer(uint32_t u32Dir);
+uint32_t i2sRingXrunCount(uint32_t u32Dir);
 
 /*@}*/ /* end of group N9H31_I2S_EXPORTED_FUNCTIONS */
 
@@ -236,6 +236,11 @@
 #define SD_CRC16_ERROR      (SD_ERR_ID|0x17)    /*!< SDH Error - crc16 err \hideinitializer */
 #define SD_CRC_ERROR        (SD_ERR_ID|0x18)    /*!< SDH Error - crc err \hideinitializer */
 #define SD_CMD8_ERROR       (SD_ERR_ID|0x19)    /*!< SDH Error - CMD8 err \hideinitializer */
+#define SD_REQ_BUSY         (SD_ERR_ID|0x20)    /*!< SDH Request - queued or in progress \hideinitializer */
+#define SD_REQ_QUEUE_FULL   (SD_ERR_ID|0x21)    /*!< SDH Error - request queue full \hideinitializer */
+#define SD_STREAM_BUSY      (SD_ERR_ID|0x22)    /*!< SDH Error - controller owned by a stream session or request \hideinitializer */
+
+#define SD_REQ_QUEUE_SIZE   8       /*!< Slots of the SD request ring, which holds up to SD_REQ_QUEUE_SIZE-1 queued requests \hideinitializer */
 
 #define SD_FREQ         25000   /*!< Unit: kHz. Output 25MHz to SD  \hideinitializer */
 #define SDHC_FREQ       50000   /*!< Unit: kHz. Output 50MHz to SDH \hideinitializer */
@@ -264,6 +269,33 @@ typedef struct SD_info_t
     int             sectorSize;     /*!< sector size in bytes */
 } SD_INFO_T;
 
+/** \brief  Structure type of asynchronous SD read/write request.
+ */
+typedef struct sd_req_t
+{
+    unsigned int    u32CardNum;     /*!< SD_PORT0 or SD_PORT1 */
+    unsigned char   *pu8BufAddr;    /*!< DMA buffer address */
+    unsigned int    u32StartSec;    /*!< start sector address */
+    unsigned int    u32SecCount;    /*!< number of sectors */
+    int             bIsWrite;       /*!< TRUE for write, FALSE for read */
+    void (*pfnCallback)(struct sd_req_t *pReq);   /*!< completion callback, called from \ref SD_ServiceQueue in task context. May be NULL. */
+    void            *pvContext;     /*!< user context for callback */
+    volatile unsigned int u32Status;    /*!< \ref SD_REQ_BUSY until completed, then 0 or error code */
+    unsigned int    u32Remain;      /*!< driver internal: sectors not yet started */
+} SD_REQ_T;
+
+/** \brief  Structure type of sequential read/write stream session.
+ */
+typedef struct sd_stream_t
+{
+    unsigned int    u32CardNum;     /*!< SD_PORT0 or SD_PORT1 */
+    unsigned int    u32NextSec;     /*!< next sector address of the transfer */
+    unsigned int    u32Transferred; /*!< sectors transferred since the session was opened */
+    unsigned int    u32BlockCount;  /*!< CMD23 block count of a closed-ended eMMC write, 0 if open-ended */
+    int             bIsWrite;       /*!< TRUE for write session, FALSE for read session */
+    int             bIsSendCmd;     /*!< TRUE once CMD18/CMD25 has been sent */
+} SD_STREAM_T;
+
 /*@}*/ /* end of group N9H31_SDH_EXPORTED_TYPEDEF */
 
 /// @cond HIDDEN_SYMBOLS
@@ -364,6 +396,13 @@ unsigned int SD_Read(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigne
 unsigned int SD_Write(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount);
 void SD_SetReferenceClock(unsigned int u32Clock);
 unsigned int SD_CardDetection(unsigned int u32CardNum);
+unsigned int SD_SubmitRequest(SD_REQ_T *pReq);
+unsigned int SD_WaitRequest(SD_REQ_T *pReq);
+void SD_BlockDoneHandler(void);
+void SD_ServiceQueue(void);
+unsigned int SD_StreamOpen(SD_STREAM_T *pStream, unsigned int u32CardNum, unsigned int u32StartSec, unsigned int u32PreEraseCount, int bIsWrite);
+unsigned int SD_StreamXfer(SD_STREAM_T *pStream, unsigned char *pu8BufAddr, unsigned int u32SecCount);
+unsigned int SD_StreamClose(SD_STREAM_T *pStream);
 void SD_Open_Disk(unsigned int cardSel);
 void SD_Close_Disk(unsigned int cardSel);
 
@@ -53,6 +53,8 @@ unsigned char peMMC_offset = 0;
 
 EMMC_INFO_T eMMC;
 
+static EMMC_STREAM_T * volatile _fmi_pStream = NULL;    // open stream session, it owns the card
+
 void eMMC_CheckRB()
 {
     while(1) {
@@ -389,6 +391,107 @@ int eMMC_SwitchToHighSpeed(EMMC_INFO_T *pSD)
 }
 
 
+// Read the 512 bytes EXT_CSD into _fmi_uceMMCBuffer. The card must be selected.
+int eMMC_GetExtCsd(EMMC_INFO_T *pSD)
+{
+    outpw(REG_FMI_DMASA, (unsigned int)_fmi_uceMMCBuffer);  // set DMA transfer starting address
+    outpw(REG_FMI_EMMCBLEN, 511);  // read 512 bytes for EXT_CSD
+    outpw(REG_FMI_EMMCCTL, (inpw(REG_FMI_EMMCCTL) & ~FMI_EMMCCTL_BLKCNT_Msk) | (0x01 << FMI_EMMCCTL_BLKCNT_Pos));
+
+    return eMMC_CmdAndRspDataIn(pSD, 8, 0x00);
+}
+
+void eMMC_ParseExtCsd(EMMC_INFO_T *pSD, unsigned char *ext)
+{
+    pSD->extCsdRev = ext[192];
+    pSD->deviceType = ext[196];
+    pSD->partConfig = ext[179];
+    pSD->bootSectorN = ext[226] * 256;  // BOOT_SIZE_MULT, unit 128KB
+    pSD->rpmbSectorN = ext[168] * 256;  // RPMB_SIZE_MULT, unit 128KB
+}
+
+// CMD6 SWITCH with Write Byte access to one EXT_CSD byte. The card must be selected.
+int eMMC_SwitchExtCsd(EMMC_INFO_T *pSD, unsigned int u32Index, unsigned int u32Value)
+{
+    int volatile status;
+    unsigned int resp;
+
+    if ((status = eMMC_CmdAndRsp(pSD, 6, (3 << 24) | (u32Index << 16) | (u32Value << 8), 0)) != 0)
+        return status;
+    eMMC_CheckRB();
+
+    // CMD13, check SWITCH_ERROR (bit 7) of the card status
+    if ((status = eMMC_CmdAndRsp(pSD, 13, pSD->RCA, 0)) != 0)
+        return status;
+    resp = (inpw(REG_FMI_EMMCRESP0) << 8) | (inpw(REG_FMI_EMMCRESP1) & 0xff);
+    if (resp & 0x80)
+        return EMMC_SWITCH_ERROR;
+    return 0;
+}
+
+/*
+ * Pick the widest bus and the fastest timing both the card and the FMI controller
+ * support. The controller has 1-bit and 4-bit data bus and SDR timing only, so
+ * 8-bit and DDR modes offered in DEVICE_TYPE are not used. Each step is checked
+ * by reading EXT_CSD back and undone if the read fails. The card must be selected.
+ */
+int eMMC_NegotiateBusMode(EMMC_INFO_T *pSD)
+{
+    unsigned char *ext = (unsigned char *)((unsigned int)_fmi_uceMMCBuffer | 0x80000000);
+    unsigned int clock;
+    int volatile status;
+
+    outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL) & ~FMI_EMMCCTL_DBW_Msk);
+    pSD->busWidth = 1;
+    pSD->busClock = MMC_FREQ;
+
+    if ((status = eMMC_GetExtCsd(pSD)) != 0)
+        return status;
+    eMMC_ParseExtCsd(pSD, ext);
+
+    //--- BUS_WIDTH EXT_CSD[183]: 1 is 4-bit SDR
+    if (eMMC_SwitchExtCsd(pSD, 183, 1) == 0) {
+        outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL)| FMI_EMMCCTL_DBW_Msk);
+        if (eMMC_GetExtCsd(pSD) == 0) {
+            pSD->busWidth = 4;
+        } else {
+            eMMC_SwitchExtCsd(pSD, 183, 0);
+            outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL) & ~FMI_EMMCCTL_DBW_Msk);
+        }
+    }
+
+    //--- HS_TIMING EXT_CSD[185]: DEVICE_TYPE bit 1 is HS52, bit 0 is HS26
+    if (pSD->deviceType & 0x2)
+        clock = EMMC_HS52_FREQ;
+    else if (pSD->deviceType & 0x1)
+        clock = EMMC_FREQ;
+    else
+        return 0;
+
+    if (clock > gFMIReferenceClock)
+        clock = gFMIReferenceClock;
+    if (clock <= MMC_FREQ)
+        return 0;
+
+    if (eMMC_SwitchExtCsd(pSD, 185, 1) != 0)
+        return 0;
+
+    eMMC_Set_clock(clock);
+    status = eMMC_GetExtCsd(pSD);
+    if ((status != 0) && (clock > EMMC_FREQ)) {
+        clock = EMMC_FREQ;      // fall back to HS26
+        eMMC_Set_clock(clock);
+        status = eMMC_GetExtCsd(pSD);
+    }
+    if (status == 0) {
+        pSD->busClock = clock;
+    } else {
+        eMMC_Set_clock(MMC_FREQ);
+        eMMC_SwitchExtCsd(pSD, 185, 0);
+    }
+    return 0;
+}
+
 int eMMC_SelectCardType(EMMC_INFO_T *pSD)
 {
     int volatile status=0;
@@ -448,15 +551,10 @@ int eMMC_SelectCardType(EMMC_INFO_T *pSD)
 
     } else if (pSD->CardType == EMMC_TYPE_EMMC) {
 
-        //--- sent CMD6 to MMC card to set bus width to 4 bits mode, skymedi only support 1-bit
-        // set CMD6 argument Access field to 3, Index to 183, Value to 1 (4-bit mode)
-//         arg = (3 << 24) | (183 << 16) | (1 << 8);
-//         if ((status = eMMC_CmdAndRsp(pSD, 6, arg, 0)) != 0)
-//             return status;
-//         eMMC_CheckRB();
-
-//         outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL)| FMI_EMMCCTL_DBW_Msk);
-        outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL) & ~FMI_EMMCCTL_DBW_Msk);
+        //--- 4-bit bus and high speed timing if the card takes them. A card that
+        // only works in 1-bit mode (e.g. skymedi) fails the read back and stays in 1-bit.
+        if ((status = eMMC_NegotiateBusMode(pSD)) != 0)
+            return status;
     }
 
     if ((status = eMMC_CmdAndRsp(pSD, 16, FMI_BLOCK_SIZE, 0)) != 0) // set block length
@@ -596,6 +694,8 @@ void eMMC_Probe(void)
 
     eMMC_Get_info(&eMMC);
 
+    eMMC.busWidth = ((eMMC.CardType == EMMC_TYPE_SD_HIGH) || (eMMC.CardType == EMMC_TYPE_SD_LOW)) ? 4 : 1;
+    eMMC.busClock = ((eMMC.CardType == EMMC_TYPE_MMC) || (eMMC.CardType == EMMC_TYPE_EMMC)) ? MMC_FREQ : SD_FREQ;
     if (eMMC_SelectCardType(&eMMC))
         return;
 
@@ -609,7 +709,11 @@ void eMMC_Probe(void)
  *  @param[in]     u32StartSec   The start read sector address.
  *  @param[in]     u32SecCount   The the read sector number of data
  *
- *  @return None
+ *  @return   - \ref EMMC_SELECT_ERROR  u32SecCount is zero.
+ *            - \ref EMMC_STREAM_BUSY  A stream session owns the card.
+ *            - \ref EMMC_CRC7_ERROR  CRC7 error happen.
+ *            - \ref EMMC_CRC16_ERROR  CRC16 error happen.
+ *            - \ref Successful  Read data from eMMC card success.
  */
 unsigned int eMMC_Read(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
 {
@@ -625,6 +729,10 @@ unsigned int eMMC_Read(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsi
     if (u32SecCount == 0)
         return EMMC_SELECT_ERROR;
 
+    // an open stream session owns the card until eMMC_StreamClose()
+    if (_fmi_pStream != NULL)
+        return EMMC_STREAM_BUSY;
+
     if ((status = eMMC_CmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
         return status;
     eMMC_CheckRB();
@@ -722,6 +830,7 @@ unsigned int eMMC_Read(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsi
  *  @param[in]    u32SecCount   The the write sector number of data.
  *
  *  @return   - \ref EMMC_SELECT_ERROR  u32SecCount is zero.
+ *            - \ref EMMC_STREAM_BUSY  A stream session owns the card.
  *            - \ref EMMC_NO_CARD  SD card be removed.
  *            - \ref EMMC_CRC_ERROR  CRC error happen.
  *            - \ref EMMC_CRC7_ERROR  CRC7 error happen.
@@ -740,6 +849,10 @@ unsigned int eMMC_Write(unsigned char *pu8BufAddr, unsigned int u32StartSec, uns
     if (u32SecCount == 0)
         return EMMC_SELECT_ERROR;
 
+    // an open stream session owns the card until eMMC_StreamClose()
+    if (_fmi_pStream != NULL)
+        return EMMC_STREAM_BUSY;
+
     if ((status = eMMC_CmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
         return status;
 
@@ -821,6 +934,366 @@ unsigned int eMMC_Write(unsigned char *pu8BufAddr, unsigned int u32StartSec, uns
 }
 
 
+/**
+ *  @brief  Open a sequential read or write stream session on eMMC.
+ *
+ *          The first \ref eMMC_StreamXfer call starts a single CMD18/CMD25 multi-block transfer which
+ *          is continued by all following buffers until \ref eMMC_StreamClose.
+ *
+ *  @param[out]  pStream           Stream session object.
+ *  @param[in]   u32StartSec       The start sector address.
+ *  @param[in]   u32PreEraseCount  Number of sectors to be written. For eMMC/MMC it is sent with CMD23 and the
+ *                                 write becomes closed-ended; for SD cards it is sent with ACMD23 as a pre-erase
+ *                                 hint. 0 to skip. Ignored for read. CMD23 only carries 16 bits, so a
+ *                                 count above 65535 leaves the write open-ended and it is stopped by CMD12.
+ *  @param[in]   bIsWrite          TRUE to open a write session, FALSE for a read session.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_NO_CARD : eMMC card be removed. \n
+ *            \ref EMMC_STREAM_BUSY : Another stream session is open. \n
+ *            Other eMMC error codes on command failure.
+ */
+unsigned int eMMC_StreamOpen(EMMC_STREAM_T *pStream, unsigned int u32StartSec, unsigned int u32PreEraseCount, int bIsWrite)
+{
+    int volatile status = 0;
+    int bIsEnabled;
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if (pSD->IsCardInsert == FALSE)
+        return EMMC_NO_CARD;
+
+    bIsEnabled = (sysGetInterruptEnableStatus() & (1 << FMI_IRQn)) ? TRUE : FALSE;
+    sysDisableInterrupt(FMI_IRQn);
+    if (_fmi_pStream != NULL) {
+        if (bIsEnabled)
+            sysEnableInterrupt(FMI_IRQn);
+        return EMMC_STREAM_BUSY;
+    }
+    _fmi_pStream = pStream;
+    if (bIsEnabled)
+        sysEnableInterrupt(FMI_IRQn);
+
+    memset(pStream, 0, sizeof(EMMC_STREAM_T));
+    pStream->u32NextSec = u32StartSec;
+    pStream->bIsWrite = bIsWrite;
+
+    if ((status = eMMC_CmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0) {
+        _fmi_pStream = NULL;
+        return status;
+    }
+    eMMC_CheckRB();
+
+    if (bIsWrite && (u32PreEraseCount != 0)) {
+        if ((pSD->CardType == EMMC_TYPE_SD_HIGH) || (pSD->CardType == EMMC_TYPE_SD_LOW)) {
+            // ACMD23: SET_WR_BLK_ERASE_COUNT
+            if ((status = eMMC_CmdAndRsp(pSD, 55, pSD->RCA, 0)) == 0)
+                status = eMMC_CmdAndRsp(pSD, 23, u32PreEraseCount & 0x7fffff, 0);
+        } else if (u32PreEraseCount <= 0xffff) {
+            // CMD23: SET_BLOCK_COUNT
+            if ((status = eMMC_CmdAndRsp(pSD, 23, u32PreEraseCount, 0)) == 0)
+                pStream->u32BlockCount = u32PreEraseCount;
+        }
+        if (status != 0) {
+            eMMC_Command(pSD, 7, 0);
+            _fmi_pStream = NULL;
+            return status;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  @brief  Transfer the next buffer of an eMMC stream session.
+ *
+ *  @param[in]      pStream       Stream session opened by \ref eMMC_StreamOpen.
+ *  @param[in,out]  pu8BufAddr    DMA buffer to read into or write from.
+ *  @param[in]      u32SecCount   Number of sectors in this buffer.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_SELECT_ERROR : u32SecCount is zero, goes past the CMD23 count of a closed-ended
+ *                                     write, or the session is not open. \n
+ *            \ref EMMC_NO_CARD : eMMC card be removed. \n
+ *            \ref EMMC_CRC_ERROR / \ref EMMC_CRC7_ERROR / \ref EMMC_CRC16_ERROR : CRC error happen.
+ */
+unsigned int eMMC_StreamXfer(EMMC_STREAM_T *pStream, unsigned char *pu8BufAddr, unsigned int u32SecCount)
+{
+    unsigned int volatile reg;
+    unsigned int blkcnt;
+
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if ((u32SecCount == 0) || (_fmi_pStream != pStream))
+        return EMMC_SELECT_ERROR;
+    if ((pStream->u32BlockCount != 0) && (u32SecCount > pStream->u32BlockCount - pStream->u32Transferred))
+        return EMMC_SELECT_ERROR;
+
+    outpw(REG_FMI_EMMCBLEN, FMI_BLOCK_SIZE - 1);
+    outpw(REG_FMI_DMASA, (unsigned int)pu8BufAddr);
+
+    if (!pStream->bIsSendCmd) {
+        if ((pSD->CardType == EMMC_TYPE_SD_HIGH) || (pSD->CardType == EMMC_TYPE_EMMC))
+            outpw(REG_FMI_EMMCCMD, pStream->u32NextSec);
+        else
+            outpw(REG_FMI_EMMCCMD, pStream->u32NextSec * FMI_BLOCK_SIZE);
+    }
+
+    while (u32SecCount > 0) {
+        blkcnt = (u32SecCount > 255) ? 255 : u32SecCount;
+        _fmi_eMMCDataReady = FALSE;
+
+        if (pStream->bIsWrite) {
+            reg = (inpw(REG_FMI_EMMCCTL) & 0xff00c080) | (blkcnt << 16);
+            if (!pStream->bIsSendCmd)
+                outpw(REG_FMI_EMMCCTL, reg|(25<<8)|(FMI_EMMCCTL_COEN_Msk | FMI_EMMCCTL_RIEN_Msk | FMI_EMMCCTL_DOEN_Msk));
+            else
+                outpw(REG_FMI_EMMCCTL, reg | FMI_EMMCCTL_DOEN_Msk);
+        } else {
+            reg = inpw(REG_FMI_EMMCCTL) & ~(FMI_EMMCCTL_CMDCODE_Msk | FMI_EMMCCTL_BLKCNT_Msk);
+            reg |= (blkcnt << 16);
+            if (!pStream->bIsSendCmd)
+                outpw(REG_FMI_EMMCCTL, reg|(18<<8)|(FMI_EMMCCTL_COEN_Msk | FMI_EMMCCTL_RIEN_Msk | FMI_EMMCCTL_DIEN_Msk));
+            else
+                outpw(REG_FMI_EMMCCTL, reg | FMI_EMMCCTL_DIEN_Msk);
+        }
+        pStream->bIsSendCmd = TRUE;
+
+        while(!_fmi_eMMCDataReady) {
+            if (pSD->IsCardInsert == FALSE)
+                return EMMC_NO_CARD;
+        }
+
+        if (pStream->bIsWrite) {
+            if ((inpw(REG_FMI_EMMCINTSTS) & FMI_EMMCINTSTS_CRCIF_Msk) != 0) {   // check CRC
+                outpw(REG_FMI_EMMCINTSTS, FMI_EMMCINTSTS_CRCIF_Msk);
+                return EMMC_CRC_ERROR;
+            }
+        } else {
+            if (!(inpw(REG_FMI_EMMCINTSTS) & FMI_EMMCINTSTS_CRC7_Msk))      // check CRC7
+                return EMMC_CRC7_ERROR;
+            if (!(inpw(REG_FMI_EMMCINTSTS) & FMI_EMMCINTSTS_CRC16_Msk))     // check CRC16
+                return EMMC_CRC16_ERROR;
+        }
+
+        pStream->u32NextSec += blkcnt;
+        pStream->u32Transferred += blkcnt;
+        u32SecCount -= blkcnt;
+    }
+    return 0;
+}
+
+/**
+ *  @brief  Close an eMMC stream session with STOP_TRANSMISSION and release the card.
+ *
+ *          No stop command is sent for a closed-ended write which has transferred its full CMD23 count.
+ *
+ *  @param[in]  pStream  Stream session opened by \ref eMMC_StreamOpen.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_SELECT_ERROR : The session is not open. \n
+ *            \ref EMMC_NO_CARD : eMMC card be removed, the session is released. \n
+ *            \ref EMMC_CRC7_ERROR : Stop command failed.
+ */
+unsigned int eMMC_StreamClose(EMMC_STREAM_T *pStream)
+{
+    unsigned int status = 0;
+
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if (_fmi_pStream != pStream)
+        return EMMC_SELECT_ERROR;
+
+    if (pSD->IsCardInsert == FALSE) {
+        pStream->bIsSendCmd = FALSE;
+        _fmi_pStream = NULL;
+        return EMMC_NO_CARD;
+    }
+
+    if (pStream->bIsWrite)
+        outpw(REG_FMI_EMMCINTSTS, FMI_EMMCINTSTS_CRCIF_Msk);
+
+    if (pStream->bIsSendCmd && !((pStream->u32BlockCount != 0) && (pStream->u32Transferred == pStream->u32BlockCount))) {
+        if (eMMC_CmdAndRsp(pSD, 12, 0, 0))     // stop command
+            status = EMMC_CRC7_ERROR;
+    }
+    eMMC_CheckRB();
+
+    eMMC_Command(pSD, 7, 0);
+    outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL)|FMI_EMMCCTL_CLK8OEN_Msk);
+    while(inpw(REG_FMI_EMMCCTL) & FMI_EMMCCTL_CLK8OEN_Msk);
+
+    pStream->bIsSendCmd = FALSE;
+    _fmi_pStream = NULL;
+    return status;
+}
+
+/**
+ *  @brief  Read the EXT_CSD register of the eMMC device.
+ *
+ *  @param[out]  pu8ExtCsd   512 bytes buffer to receive EXT_CSD.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_SELECT_ERROR : Not an eMMC device. \n
+ *            Other eMMC error codes on command failure.
+ */
+unsigned int eMMC_ReadExtCsd(unsigned char *pu8ExtCsd)
+{
+    int volatile status;
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if (pSD->CardType != EMMC_TYPE_EMMC)
+        return EMMC_SELECT_ERROR;
+
+    if ((status = eMMC_CmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
+        return status;
+    eMMC_CheckRB();
+
+    status = eMMC_GetExtCsd(pSD);
+    if (status == 0) {
+        memcpy(pu8ExtCsd, (unsigned char *)((unsigned int)_fmi_uceMMCBuffer | 0x80000000), 512);
+        eMMC_ParseExtCsd(pSD, pu8ExtCsd);
+    }
+
+    eMMC_Command(pSD, 7, 0);
+    outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL)|FMI_EMMCCTL_CLK8OEN_Msk);
+    while(inpw(REG_FMI_EMMCCTL) & FMI_EMMCCTL_CLK8OEN_Msk);
+
+    return status;
+}
+
+/**
+ *  @brief  Select the eMMC hardware partition accessed by \ref eMMC_Read, \ref eMMC_Write and the stream functions.
+ *
+ *  @param[in]  u32Part   \ref EMMC_PART_USER / \ref EMMC_PART_BOOT1 / \ref EMMC_PART_BOOT2 / \ref EMMC_PART_RPMB
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_SELECT_ERROR : Not an eMMC device. \n
+ *            \ref EMMC_PART_ERROR : The device has no such partition. \n
+ *            \ref EMMC_SWITCH_ERROR : The device rejected the switch.
+ *
+ *  @note  Sector addresses are relative to the selected partition. Close any file system
+ *         mounted on the user area before switching away from it. The boot enable and boot
+ *         acknowledge bits of PARTITION_CONFIG are kept.
+ */
+unsigned int eMMC_SelectPartition(unsigned int u32Part)
+{
+    int volatile status;
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if (pSD->CardType != EMMC_TYPE_EMMC)
+        return EMMC_SELECT_ERROR;
+
+    if (eMMC_GetPartitionSize(u32Part) == 0)
+        return EMMC_PART_ERROR;
+
+    if ((pSD->partConfig & 0x7) == u32Part)
+        return 0;
+
+    if ((status = eMMC_CmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
+        return status;
+    eMMC_CheckRB();
+
+    status = eMMC_SwitchExtCsd(pSD, 179, (pSD->partConfig & ~0x7) | u32Part);
+    if (status == 0)
+        pSD->partConfig = (pSD->partConfig & ~0x7) | u32Part;
+
+    eMMC_Command(pSD, 7, 0);
+    outpw(REG_FMI_EMMCCTL, inpw(REG_FMI_EMMCCTL)|FMI_EMMCCTL_CLK8OEN_Msk);
+    while(inpw(REG_FMI_EMMCCTL) & FMI_EMMCCTL_CLK8OEN_Msk);
+
+    return status;
+}
+
+/**
+ *  @brief  Get the size of an eMMC hardware partition.
+ *
+ *  @param[in]  u32Part   \ref EMMC_PART_USER / \ref EMMC_PART_BOOT1 / \ref EMMC_PART_BOOT2 / \ref EMMC_PART_RPMB
+ *
+ *  @return   Partition size in sectors, 0 if the partition is not present.
+ */
+unsigned int eMMC_GetPartitionSize(unsigned int u32Part)
+{
+    switch (u32Part) {
+    case EMMC_PART_USER:
+        return eMMC.totalSectorN;
+    case EMMC_PART_BOOT1:
+    case EMMC_PART_BOOT2:
+        return eMMC.bootSectorN;
+    case EMMC_PART_RPMB:
+        return eMMC.rpmbSectorN;
+    default:
+        return 0;
+    }
+}
+
+/// @cond HIDDEN_SYMBOLS
+
+// RPMB frames always go as one closed-ended transfer: CMD23 then CMD25/CMD18, no CMD12.
+static unsigned int eMMC_RpmbXfer(unsigned char *pu8Frames, unsigned int u32Count, unsigned int u32Cmd23Arg, int bIsWrite)
+{
+    EMMC_STREAM_T stream;
+    unsigned int status, status2;
+    EMMC_INFO_T *pSD;
+    pSD = &eMMC;
+
+    if ((pSD->CardType != EMMC_TYPE_EMMC) || ((pSD->partConfig & 0x7) != EMMC_PART_RPMB))
+        return EMMC_PART_ERROR;
+    if ((u32Count == 0) || (u32Count > 0xffff))
+        return EMMC_SELECT_ERROR;
+
+    if ((status = eMMC_StreamOpen(&stream, 0, 0, bIsWrite)) != 0)
+        return status;
+
+    if ((status = eMMC_CmdAndRsp(pSD, 23, u32Cmd23Arg, 0)) == 0) {
+        stream.u32BlockCount = u32Count;
+        status = eMMC_StreamXfer(&stream, pu8Frames, u32Count);
+    }
+
+    status2 = eMMC_StreamClose(&stream);
+    return (status != 0) ? status : status2;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Send RPMB request frames to the eMMC device.
+ *
+ *  @param[in]  pu8Frames   DMA buffer holding u32Count 512 bytes RPMB frames.
+ *  @param[in]  u32Count    Number of frames.
+ *  @param[in]  bIsReliable TRUE for authenticated data and key programming requests, which need a
+ *                          reliable write; FALSE for read, counter and result read requests.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_PART_ERROR : RPMB partition is not selected by \ref eMMC_SelectPartition. \n
+ *            Other eMMC error codes on command failure.
+ *
+ *  @note  Frames are built and authenticated (HMAC SHA-256) by the caller. The driver only moves them.
+ */
+unsigned int eMMC_RpmbWrite(unsigned char *pu8Frames, unsigned int u32Count, int bIsReliable)
+{
+    return eMMC_RpmbXfer(pu8Frames, u32Count, (bIsReliable ? 0x80000000 : 0) | u32Count, TRUE);
+}
+
+/**
+ *  @brief  Read RPMB response frames from the eMMC device.
+ *
+ *  @param[out]  pu8Frames  DMA buffer to receive u32Count 512 bytes RPMB frames.
+ *  @param[in]   u32Count   Number of frames, as asked for by the preceding request.
+ *
+ *  @return   0: Success. \n
+ *            \ref EMMC_PART_ERROR : RPMB partition is not selected by \ref eMMC_SelectPartition. \n
+ *            Other eMMC error codes on command failure.
+ */
+unsigned int eMMC_RpmbRead(unsigned char *pu8Frames, unsigned int u32Count)
+{
+    return eMMC_RpmbXfer(pu8Frames, u32Count, u32Count, FALSE);
+}
+
+
 /*@}*/ /* end of group N9H31_FMI_EXPORTED_FUNCTIONS */
 
 /*@}*/ /* end of group N9H31_FMI_Driver */
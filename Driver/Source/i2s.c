@@ -30,8 +30,23 @@
 
 typedef uint32_t (AU_CB_FUNC_T)(uint32_t);
 
+/* Period ring of one direction, positions are byte counts since i2sRingStart() */
+typedef struct
+{
+    uint8_t *pu8Buf;                    /* non-cacheable ring address */
+    uint32_t u32PeriodBytes;
+    uint32_t u32Periods;                /* 0 if the ring is not open */
+    volatile uint32_t u32HwPeriods;     /* periods completed by DMA */
+    volatile uint32_t u32ApplBytes;     /* bytes written (play) or read (record) by the application */
+    volatile uint32_t u32XrunCount;
+    volatile uint8_t u8Xrun;
+    I2S_PERIOD_CB_T *pfnCallback;
+} I2S_RING_T;
+
 static AU_CB_FUNC_T *g_fnPlayCallBack;
 static AU_CB_FUNC_T *g_fnRecCallBack;
+static I2S_RING_T g_sRing[2];
+static uint8_t g_u8RingSilence = I2S_DISABLE;
 static uint8_t i2sOpened = 0;
 
 /// @endcond /* HIDDEN_SYMBOLS */
@@ -108,6 +123,74 @@ static void Delay(int nCnt)
     for (loop=0; loop<nCnt*10; loop++);
 }
 
+/**
+  * @brief Byte offset of the DMA current address in a ring
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return Offset from the ring start
+  */
+static uint32_t i2sRingDmaOffset(uint32_t u32Dir)
+{
+    I2S_RING_T *ring = &g_sRing[u32Dir];
+    uint32_t u32Cur;
+
+    u32Cur = inpw((u32Dir == I2S_PLAY) ? REG_ACTL_PDESC : REG_ACTL_RDESC);
+    return ((u32Cur & ~0x80000000) - ((uint32_t)ring->pu8Buf & ~0x80000000)) % (ring->u32PeriodBytes * ring->u32Periods);
+}
+
+/**
+  * @brief Advance a ring on a DMA period interrupt
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return None
+  */
+static void i2sRingPeriod(uint32_t u32Dir)
+{
+    I2S_RING_T *ring = &g_sRing[u32Dir];
+    uint32_t u32Elapsed, u32Hw, u32Start, u32End;
+
+    /* The DMA address tells how many periods went by, so a late interrupt loses none */
+    u32Elapsed = (i2sRingDmaOffset(u32Dir) / ring->u32PeriodBytes + ring->u32Periods -
+                  ring->u32HwPeriods % ring->u32Periods) % ring->u32Periods;
+    if (u32Elapsed == 0)
+        u32Elapsed = 1;
+
+    /*
+     * With I2S_SET_RING_SILENCE, silence each period just played, so that it plays
+     * silence again if the application falls behind. This clears u32PeriodBytes of
+     * non-cacheable memory per period, 4.6 KB for 1152 stereo samples.
+     */
+    u32Hw = ring->u32HwPeriods;
+    while (u32Elapsed--) {
+        if ((u32Dir == I2S_PLAY) && g_u8RingSilence)
+            memset(ring->pu8Buf + (u32Hw % ring->u32Periods) * ring->u32PeriodBytes, 0, ring->u32PeriodBytes);
+        u32Hw++;
+    }
+    ring->u32HwPeriods = u32Hw;
+
+    /* Play: the period DMA starts now must be written. Record: it must have been read. */
+    if (u32Dir == I2S_PLAY) {
+        u32End = (u32Hw + 1) * ring->u32PeriodBytes;
+        if ((int32_t)(ring->u32ApplBytes - u32End) < 0) {
+            ring->u8Xrun = 1;
+            ring->u32XrunCount++;
+
+            /* Underrun: silence what is left unwritten of the period DMA plays now */
+            u32Start = u32Hw * ring->u32PeriodBytes;
+            if ((int32_t)(ring->u32ApplBytes - u32Start) > 0)
+                u32Start = ring->u32ApplBytes;
+            if (!g_u8RingSilence)
+                memset(ring->pu8Buf + u32Start % (ring->u32PeriodBytes * ring->u32Periods), 0, u32End - u32Start);
+        }
+    } else {
+        if ((int32_t)((u32Hw + 1 - ring->u32Periods) * ring->u32PeriodBytes - ring->u32ApplBytes) > 0) {
+            ring->u8Xrun = 1;
+            ring->u32XrunCount++;
+        }
+    }
+
+    if (ring->pfnCallback != NULL)
+        ring->pfnCallback(u32Dir);
+}
+
 /**
   * @brief Interrupt service routine for i2s
   * @param None
@@ -120,20 +203,16 @@ static void i2sISR(void)
     if (inpw(REG_ACTL_CON) & (1<<10)) {
         outpw(REG_ACTL_CON, inpw(REG_ACTL_CON) | (1<<10));//Clear TX INT
 
-        if (inpw(REG_ACTL_PSR) & (1<<4)) {
-            outpw(REG_ACTL_PSR, (1<<4));
-            sysprintf("\ndebug:DMA_COUNTER_IRQ occur");
-        }
-
-        if (inpw(REG_ACTL_PSR) & (1<<3)) {
-            outpw(REG_ACTL_PSR, (1<<3));
-            sysprintf("\ndebug:DMA_DATA_ZERO_IRQ occur");
-        }
+        /* DMA counter and data zero flags are not used by the driver */
+        outpw(REG_ACTL_PSR, inpw(REG_ACTL_PSR) & ((1<<4) | (1<<3)));
 
         if (inpw(REG_ACTL_PSR) & 0x1) {
             outpw(REG_ACTL_PSR, 0x1);
             u8SN = (inpw(REG_ACTL_PSR) >> 5) & 0x7;
-            g_fnPlayCallBack(u8SN);
+            if (g_sRing[I2S_PLAY].u32Periods)
+                i2sRingPeriod(I2S_PLAY);
+            else if (g_fnPlayCallBack != NULL)
+                g_fnPlayCallBack(u8SN);
         }
     }
 
@@ -143,7 +222,10 @@ static void i2sISR(void)
         if (inpw(REG_ACTL_RSR) & 0x1) {
             outpw(REG_ACTL_RSR, 0x1);
             u8SN = (inpw(REG_ACTL_RSR) >> 5) & 0x7;
-            g_fnRecCallBack(u8SN);
+            if (g_sRing[I2S_REC].u32Periods)
+                i2sRingPeriod(I2S_REC);
+            else if (g_fnRecCallBack != NULL)
+                g_fnRecCallBack(u8SN);
         }
     }
 }
@@ -234,6 +316,8 @@ void i2sInit(void)
   *                                     - \ref I2S_SET_I2S_FORMAT
   *                                     - \ref I2S_SET_I2S_CALLBACKFUN
   *                                     - \ref I2S_SET_PCMSLOT
+  *                                     - \ref I2S_SET_PCM_FS_PERIOD
+  *                                     - \ref I2S_SET_RING_SILENCE
   * @param[in] arg0 argument 0 for io control
   * @param[in] arg1 argument 1 for io control
   * @retval I2S_ERR_IO Command error.
@@ -389,6 +473,13 @@ int32_t i2sIoctl(uint32_t cmd, uint32_t arg0, uint32_t arg1)
             outpw(REG_ACTL_PCMCON, (inpw(REG_ACTL_PCMCON) & ~0x03FF0000 | (((arg0-1) & 0x3ff) << 16)));
             break;
 
+        // arg0: I2S_ENABLE or I2S_DISABLE (default). Enabled, the play ring interrupt clears each
+        // played period. Disabled, it only clears the unwritten part of a period on an underrun,
+        // and a late interrupt lets the first samples of that period replay old ones.
+        case I2S_SET_RING_SILENCE:
+            g_u8RingSilence = (arg0 == I2S_DISABLE) ? I2S_DISABLE : I2S_ENABLE;
+            break;
+
         default:
             return I2S_ERR_IO;
     }
@@ -449,6 +540,259 @@ void i2sSetPCMBCLKFrequency(uint32_t u32SourceClockRate, uint32_t u32Rate)
 }
 
 
+/**
+  * @brief Set up a DMA ring of periods for play or record
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @param[in] pvBuf ring buffer, 32-byte aligned, u32PeriodBytes * u32Periods bytes
+  * @param[in] u32PeriodBytes bytes per period, a multiple of 32
+  * @param[in] u32Periods number of periods, 2, 4 or 8
+  * @param[in] pfnCallback called from the I2S interrupt after each period, or NULL
+  * @retval I2S_ERR_IO Invalid argument.
+  * @retval 0 success.
+  * @details The DMA interrupt is raised once per period. While a ring is open it replaces
+  *          the call-back installed by \ref I2S_SET_I2S_CALLBACKFUN for that direction.
+  *          A play ring starts filled with silence. On an underrun the interrupt clears the
+  *          part of the period DMA starts that the application has not written, so the ring
+  *          plays silence instead of old samples. \ref I2S_SET_RING_SILENCE clears each played
+  *          period instead, a memset of u32PeriodBytes of non-cacheable memory per period,
+  *          for systems that take the I2S interrupt late.
+  */
+int32_t i2sRingOpen(uint32_t u32Dir, void *pvBuf, uint32_t u32PeriodBytes, uint32_t u32Periods, I2S_PERIOD_CB_T *pfnCallback)
+{
+    I2S_RING_T *ring;
+
+    if ((u32Dir > I2S_REC) || (pvBuf == NULL) || (u32PeriodBytes == 0) || (u32PeriodBytes & 0x1f) ||
+        ((u32Periods != 2) && (u32Periods != 4) && (u32Periods != 8)))
+        return I2S_ERR_IO;
+
+    i2sRingClose(u32Dir);
+
+    ring = &g_sRing[u32Dir];
+    ring->pu8Buf = (uint8_t *)((uint32_t)pvBuf | 0x80000000);
+    ring->u32PeriodBytes = u32PeriodBytes;
+    ring->pfnCallback = pfnCallback;
+    ring->u32XrunCount = 0;
+    ring->u32Periods = u32Periods;
+    i2sRingStop(u32Dir);
+
+    return 0;
+}
+
+/**
+  * @brief Stop a ring and return the direction to the call-back of \ref I2S_SET_I2S_CALLBACKFUN
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return None
+  */
+void i2sRingClose(uint32_t u32Dir)
+{
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return;
+
+    if (u32Dir == I2S_PLAY)
+        i2sStopPlay();
+    else
+        i2sStopRecord();
+    g_sRing[u32Dir].u32Periods = 0;
+}
+
+/**
+  * @brief Start DMA at the ring start
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @retval I2S_ERR_IO Ring is not open.
+  * @retval 0 success.
+  * @details Data written to a play ring before the start is played first.
+  */
+int32_t i2sRingStart(uint32_t u32Dir)
+{
+    I2S_RING_T *ring;
+    uint32_t u32IntSel;
+
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return I2S_ERR_IO;
+
+    ring = &g_sRing[u32Dir];
+    u32IntSel = (ring->u32Periods == 2) ? I2S_DMA_INT_HALF : (ring->u32Periods == 4) ? I2S_DMA_INT_QUARTER : I2S_DMA_INT_EIGHTH;
+
+    if (u32Dir == I2S_PLAY) {
+        i2sIoctl(I2S_SET_PLAY_DMA_INT_SEL, u32IntSel, 0);
+        outpw(REG_ACTL_PDESB, (uint32_t)ring->pu8Buf);
+        outpw(REG_ACTL_PDES_LENGTH, ring->u32PeriodBytes * ring->u32Periods);
+        i2sStartPlay();
+    } else {
+        i2sIoctl(I2S_SET_REC_DMA_INT_SEL, u32IntSel, 0);
+        outpw(REG_ACTL_RDESB, (uint32_t)ring->pu8Buf);
+        outpw(REG_ACTL_RDES_LENGTH, ring->u32PeriodBytes * ring->u32Periods);
+        i2sStartRecord();
+    }
+    return 0;
+}
+
+/**
+  * @brief Stop DMA and rewind the ring, data not played or read yet is dropped
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return None
+  */
+void i2sRingStop(uint32_t u32Dir)
+{
+    I2S_RING_T *ring;
+
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return;
+
+    ring = &g_sRing[u32Dir];
+    if (u32Dir == I2S_PLAY) {
+        i2sStopPlay();
+        memset(ring->pu8Buf, 0, ring->u32PeriodBytes * ring->u32Periods);
+    } else {
+        i2sStopRecord();
+    }
+    ring->u32HwPeriods = 0;
+    ring->u32ApplBytes = 0;
+    ring->u8Xrun = 0;
+}
+
+/**
+  * @brief Get the bytes the application can write (play) or read (record)
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @retval I2S_ERR_IO Ring is not open.
+  * @retval I2S_ERR_XRUN Underrun or overrun, see \ref i2sRingRecover.
+  * @retval >=0 bytes available.
+  * @details Play space ends at the period DMA is playing, record data ends at the
+  *          last period DMA completed.
+  */
+int32_t i2sRingAvail(uint32_t u32Dir)
+{
+    I2S_RING_T *ring;
+    uint32_t u32Hw;
+
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return I2S_ERR_IO;
+
+    ring = &g_sRing[u32Dir];
+    if (ring->u8Xrun)
+        return I2S_ERR_XRUN;
+
+    u32Hw = ring->u32HwPeriods * ring->u32PeriodBytes;
+    if (u32Dir == I2S_PLAY)
+        return ring->u32PeriodBytes * ring->u32Periods - (ring->u32ApplBytes - u32Hw);
+    else
+        return u32Hw - ring->u32ApplBytes;
+}
+
+/**
+  * @brief Get where the application writes (play) or reads (record) next
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @param[out] ppvData non-cacheable address in the ring
+  * @retval I2S_ERR_IO Ring is not open.
+  * @retval I2S_ERR_XRUN Underrun or overrun, see \ref i2sRingRecover.
+  * @retval >=0 contiguous bytes at *ppvData, up to the ring end.
+  * @details Pass the bytes actually written or read to \ref i2sRingCommit.
+  */
+int32_t i2sRingBegin(uint32_t u32Dir, void **ppvData)
+{
+    I2S_RING_T *ring;
+    int32_t i32Avail;
+    uint32_t u32Offset, u32Size;
+
+    i32Avail = i2sRingAvail(u32Dir);
+    if (i32Avail < 0)
+        return i32Avail;
+
+    ring = &g_sRing[u32Dir];
+    u32Size = ring->u32PeriodBytes * ring->u32Periods;
+    u32Offset = ring->u32ApplBytes % u32Size;
+    if ((uint32_t)i32Avail > u32Size - u32Offset)
+        i32Avail = u32Size - u32Offset;
+    *ppvData = ring->pu8Buf + u32Offset;
+
+    return i32Avail;
+}
+
+/**
+  * @brief Hand bytes written to a play ring to DMA, or release bytes read from a record ring
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @param[in] u32Bytes byte count, at most \ref i2sRingAvail
+  * @retval I2S_ERR_IO Ring is not open or u32Bytes is too large.
+  * @retval I2S_ERR_XRUN Underrun or overrun, see \ref i2sRingRecover.
+  * @retval 0 success.
+  */
+int32_t i2sRingCommit(uint32_t u32Dir, uint32_t u32Bytes)
+{
+    int32_t i32Avail;
+
+    i32Avail = i2sRingAvail(u32Dir);
+    if (i32Avail < 0)
+        return i32Avail;
+    if (u32Bytes > (uint32_t)i32Avail)
+        return I2S_ERR_IO;
+
+    g_sRing[u32Dir].u32ApplBytes += u32Bytes;
+    return 0;
+}
+
+/**
+  * @brief Continue after an underrun or overrun without stopping DMA
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @retval I2S_ERR_IO Ring is not open.
+  * @retval 0 success.
+  * @details Play resumes at the first period DMA has not started, record drops the
+  *          data not read yet.
+  */
+int32_t i2sRingRecover(uint32_t u32Dir)
+{
+    I2S_RING_T *ring;
+
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return I2S_ERR_IO;
+
+    /* An interrupt in between only reports the xrun once more */
+    ring = &g_sRing[u32Dir];
+    ring->u8Xrun = 0;
+    if (u32Dir == I2S_PLAY)
+        ring->u32ApplBytes = (i2sRingHwPointer(I2S_PLAY) / ring->u32PeriodBytes + 1) * ring->u32PeriodBytes;
+    else
+        ring->u32ApplBytes = ring->u32HwPeriods * ring->u32PeriodBytes;
+
+    return 0;
+}
+
+/**
+  * @brief Get the DMA position
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return Bytes played or recorded since \ref i2sRingStart, 0 if the ring is not open
+  */
+uint32_t i2sRingHwPointer(uint32_t u32Dir)
+{
+    I2S_RING_T *ring;
+    uint32_t u32Periods, u32Offset, u32Size, u32Hw;
+
+    if ((u32Dir > I2S_REC) || (g_sRing[u32Dir].u32Periods == 0))
+        return 0;
+
+    ring = &g_sRing[u32Dir];
+    do {
+        u32Periods = ring->u32HwPeriods;
+        u32Offset = i2sRingDmaOffset(u32Dir);
+    } while (u32Periods != ring->u32HwPeriods);
+
+    /* The DMA address can be a period ahead if the interrupt is pending */
+    u32Size = ring->u32PeriodBytes * ring->u32Periods;
+    u32Hw = u32Periods * ring->u32PeriodBytes;
+    return u32Hw + (u32Offset + u32Size - u32Hw % u32Size) % u32Size;
+}
+
+/**
+  * @brief Get the number of periods DMA started without valid data since \ref i2sRingOpen
+  * @param[in] u32Dir I2S_PLAY or I2S_REC
+  * @return Underrun (play) or overrun (record) count
+  */
+uint32_t i2sRingXrunCount(uint32_t u32Dir)
+{
+    if (u32Dir > I2S_REC)
+        return 0;
+    return g_sRing[u32Dir].u32XrunCount;
+}
+
 /*@}*/ /* end of group N9H31_I2S_EXPORTED_FUNCTIONS */
 
 /*@}*/ /* end of group N9H31_I2S_Driver */
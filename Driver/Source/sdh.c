@@ -858,147 +858,452 @@ int SD_Probe(unsigned int u32CardNum)
     return TRUE;
 }
 
-/**
- *  @brief  This function use to read data from SD card.
- *
- *  @param[in]     u32CardNum    Select card: SD0 or SD1. ( \ref SD_PORT0 / \ref SD_PORT1)
- *  @param[out]    pu8BufAddr    The buffer to receive the data from SD card.
- *  @param[in]     u32StartSec   The start read sector address.
- *  @param[in]     u32SecCount   The the read sector number of data
- *
- *  @return None
- */
-unsigned int SD_Read(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
+/// @cond HIDDEN_SYMBOLS
+
+static SD_REQ_T * volatile _sd_ReqQueue[SD_REQ_QUEUE_SIZE];
+static volatile unsigned int _sd_ReqHead = 0;
+static volatile unsigned int _sd_ReqTail = 0;
+static SD_REQ_T * volatile _sd_pActiveReq = NULL;    // request in its data phase
+static SD_REQ_T * volatile _sd_pDoneReq = NULL;      // data phase ended, waiting for SD_ServiceQueue()
+static volatile unsigned int _sd_DoneStatus = 0;
+static volatile int _sd_bStarting = FALSE;           // SD_ServiceQueue() is selecting the card for a request
+static SD_STREAM_T * volatile _sd_pStream = NULL;
+
+static SD_INFO_T *SD_GetInfo(unsigned int u32CardNum)
+{
+    if (u32CardNum == SD_PORT0)
+        return &SD0;
+    else
+        return &SD1;
+}
+
+// mask SDH interrupt while the request queue is updated, return previous enable state
+static int SD_LockQueue(void)
+{
+    int bIsEnabled = (sysGetInterruptEnableStatus() & (1 << SDH_IRQn)) ? TRUE : FALSE;
+
+    sysDisableInterrupt(SDH_IRQn);
+    return bIsEnabled;
+}
+
+static void SD_UnlockQueue(int bIsEnabled)
+{
+    if (bIsEnabled)
+        sysEnableInterrupt(SDH_IRQn);
+}
+
+// kick the next chunk (at most 255 blocks) of the active request
+static void SD_KickChunk(SD_REQ_T *pReq, int bIsFirst)
 {
-    char volatile bIsSendCmd = FALSE;
     unsigned int volatile reg;
-    int volatile i, loop, status;
-    unsigned int blksize = SD_BLOCK_SIZE;
+    unsigned int blkcnt;
 
-    SD_INFO_T *pSD;
+    blkcnt = (pReq->u32Remain > 255) ? 255 : pReq->u32Remain;
+    pReq->u32Remain -= blkcnt;
 
-    if (u32CardNum == SD_PORT0)
-        pSD = &SD0;
+    if (pReq->bIsWrite)
+    {
+        reg = (inpw(REG_SDH_CTL) & 0xff00c080) | (blkcnt << 16);
+
+        if (bIsFirst)
+            outpw(REG_SDH_CTL, reg | (25 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk));
+        else
+            outpw(REG_SDH_CTL, reg | SDH_CTL_DOEN_Msk);
+    }
     else
-        pSD = &SD1;
+    {
+        reg = inpw(REG_SDH_CTL) & ~(SDH_CTL_CMDCODE_Msk | SDH_CTL_BLKCNT_Msk);
+        reg |= (blkcnt << 16);
 
-    //--- check input parameters
-    if (u32SecCount == 0)
-        return SD_SELECT_ERROR;
+        if (bIsFirst)
+            outpw(REG_SDH_CTL, reg | (18 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk));
+        else
+            outpw(REG_SDH_CTL, reg | SDH_CTL_DIEN_Msk);
+    }
+}
+
+// wait until the card releases DAT0, give up if it is removed
+static unsigned int SD_WaitBusyEnd(SD_INFO_T *pSD)
+{
+    do
+    {
+        if (pSD->IsCardInsert == FALSE)
+            return SD_NO_SD_CARD;
+
+        outpw(REG_SDH_CTL, inpw(REG_SDH_CTL) | SDH_CTL_CLK8OEN_Msk);
+
+        while (inpw(REG_SDH_CTL) & SDH_CTL_CLK8OEN_Msk);
+    }
+    while (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_DAT0STS_Msk));
+
+    return 0;
+}
+
+// select the card of a request, blocking, task context only
+static unsigned int SD_SelectRequest(SD_REQ_T *pReq)
+{
+    SD_INFO_T *pSD = SD_GetInfo(pReq->u32CardNum);
+    int volatile status;
 
     if ((status = SD_SDCmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
         return status;
 
-    SD_CheckRB();
+    return SD_WaitBusyEnd(pSD);
+}
 
-    outpw(REG_SDH_BLEN, blksize - 1);       // the actual byte count is equal to (SDBLEN+1)
+// start the first chunk of a selected request, called with the SDH interrupt masked
+static void SD_StartRequest(SD_REQ_T *pReq)
+{
+    SD_INFO_T *pSD = SD_GetInfo(pReq->u32CardNum);
+
+    // According to SD Spec v2.0, the write CMD block size MUST be 512, and the start address MUST be 512*n.
+    outpw(REG_SDH_BLEN, SD_BLOCK_SIZE - 1);
 
     if ((pSD->CardType == SD_TYPE_SD_HIGH) || (pSD->CardType == SD_TYPE_EMMC))
-        outpw(REG_SDH_CMD, u32StartSec);
+        outpw(REG_SDH_CMD, pReq->u32StartSec);
     else
-        outpw(REG_SDH_CMD, u32StartSec * blksize);
+        outpw(REG_SDH_CMD, pReq->u32StartSec * SD_BLOCK_SIZE);
 
-    outpw(REG_SDH_DMASA, (unsigned int)pu8BufAddr);
+    outpw(REG_SDH_DMASA, (unsigned int)pReq->pu8BufAddr);
 
-    loop = u32SecCount / 255;
+    pReq->u32Remain = pReq->u32SecCount;
+    _sd_SDDataReady = FALSE;
+    _sd_pActiveReq = pReq;
+    SD_KickChunk(pReq, TRUE);
+}
 
-    for (i = 0; i < loop; i++)
-    {
-        _sd_SDDataReady = FALSE;
+// stop the transfer, release the card and report the request result, blocking, task context only
+static void SD_FinishRequest(SD_REQ_T *pReq, unsigned int status)
+{
+    SD_INFO_T *pSD = SD_GetInfo(pReq->u32CardNum);
 
-        reg = inpw(REG_SDH_CTL) & ~SDH_CTL_CMDCODE_Msk;
-        reg = reg | 0xff0000;   // set BLK_CNT to 255
+    if (pReq->bIsWrite)
+        outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
 
-        if (bIsSendCmd == FALSE)
+    if (status != SD_NO_SD_CARD)
+    {
+        if (SD_SDCmdAndRsp(pSD, 12, 0, 0))      // stop command
         {
-            outpw(REG_SDH_CTL, reg | (18 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk));
-            bIsSendCmd = TRUE;
+            if (status == 0)
+                status = SD_CRC7_ERROR;
         }
-        else
-            outpw(REG_SDH_CTL, reg | SDH_CTL_DIEN_Msk);
 
-        while (!_sd_SDDataReady)
-        {
-            //             if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_BLKDIF_Msk) && (!(inpw(REG_SDH_CTL) & SDH_CTL_DIEN_Msk))) {
-            //                 outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
-            //                 break;
-            //             }
-            if (pSD->IsCardInsert == FALSE)
-                return SD_NO_SD_CARD;
-        }
+        if (SD_WaitBusyEnd(pSD) != 0)
+            status = SD_NO_SD_CARD;
+    }
 
-        if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC7_Msk))      // check CRC7
-        {
-            //sysprintf("sdioSD_Read_in_blksize(): response error!\n");
-            return SD_CRC7_ERROR;
-        }
+    if (status != SD_NO_SD_CARD)
+    {
+        SD_SDCommand(pSD, 7, 0);
+        outpw(REG_SDH_CTL, inpw(REG_SDH_CTL) | SDH_CTL_CLK8OEN_Msk);
 
-        if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC16_Msk))     // check CRC16
-        {
-            //sysprintf("sdioSD_Read_in_blksize() :read data error!\n");
-            return SD_CRC16_ERROR;
-        }
+        while (inpw(REG_SDH_CTL) & SDH_CTL_CLK8OEN_Msk);
     }
 
-    loop = u32SecCount % 255;
+    pReq->u32Status = status;
 
-    if (loop != 0)
-    {
-        _sd_SDDataReady = FALSE;
+    if (pReq->pfnCallback != NULL)
+        pReq->pfnCallback(pReq);
+}
 
-        reg = inpw(REG_SDH_CTL) & (~SDH_CTL_CMDCODE_Msk);
-        reg = reg & (~SDH_CTL_BLKCNT_Msk);
-        reg |= (loop << 16);    // setup SDCR_BLKCNT
+// start queued requests until one is in flight or the queue is empty, task context only
+static void SD_ScheduleNext(void)
+{
+    SD_REQ_T *pReq;
+    unsigned int status;
+    int bIsEnabled;
+
+    while (1)
+    {
+        bIsEnabled = SD_LockQueue();
 
-        if (bIsSendCmd == FALSE)
+        if ((_sd_pActiveReq != NULL) || (_sd_pDoneReq != NULL) || _sd_bStarting ||
+            (_sd_pStream != NULL) || (_sd_ReqHead == _sd_ReqTail))
         {
-            outpw(REG_SDH_CTL, reg | (18 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk));
-            bIsSendCmd = TRUE;
+            SD_UnlockQueue(bIsEnabled);
+            return;
         }
+
+        pReq = _sd_ReqQueue[_sd_ReqHead];
+        _sd_ReqHead = (_sd_ReqHead + 1) % SD_REQ_QUEUE_SIZE;
+        _sd_bStarting = TRUE;
+        SD_UnlockQueue(bIsEnabled);
+
+        // CMD7 and the busy wait run with the SDH interrupt enabled, so card removal is seen
+        if (SD_GetInfo(pReq->u32CardNum)->IsCardInsert == FALSE)
+            status = SD_NO_SD_CARD;
         else
-            outpw(REG_SDH_CTL, reg | SDH_CTL_DIEN_Msk);
+            status = SD_SelectRequest(pReq);
 
-        while (!_sd_SDDataReady)
+        bIsEnabled = SD_LockQueue();
+        _sd_bStarting = FALSE;
+
+        if (status == 0)
+            SD_StartRequest(pReq);
+
+        SD_UnlockQueue(bIsEnabled);
+
+        if (status != 0)
         {
-            if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_BLKDIF_Msk) && (!(inpw(REG_SDH_CTL) & SDH_CTL_DIEN_Msk)))
-            {
-                outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
-                break;
-            }
+            pReq->u32Status = status;
 
-            if (pSD->IsCardInsert == FALSE)
-                return SD_NO_SD_CARD;
+            if (pReq->pfnCallback != NULL)
+                pReq->pfnCallback(pReq);
         }
+    }
+}
+
+// finish the request whose data phase ended, task context only
+static void SD_CompleteDone(void)
+{
+    SD_REQ_T *pReq;
+    unsigned int status;
+    int bIsEnabled;
+
+    bIsEnabled = SD_LockQueue();
+    pReq = _sd_pDoneReq;
+    status = _sd_DoneStatus;
+    _sd_pDoneReq = NULL;
+    SD_UnlockQueue(bIsEnabled);
+
+    if (pReq != NULL)
+        SD_FinishRequest(pReq, status);
+}
+
+// abort the active request and everything queued behind it, task context only
+static void SD_AbortAll(unsigned int status)
+{
+    SD_REQ_T *pReq;
+    int bIsEnabled;
 
-        if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC7_Msk))      // check CRC7
+    bIsEnabled = SD_LockQueue();
+    pReq = _sd_pActiveReq;
+    _sd_pActiveReq = NULL;
+
+    if (pReq == NULL)
+    {
+        pReq = _sd_pDoneReq;
+        _sd_pDoneReq = NULL;
+    }
+
+    SD_UnlockQueue(bIsEnabled);
+
+    if (pReq != NULL)
+        SD_FinishRequest(pReq, status);
+
+    while (1)
+    {
+        bIsEnabled = SD_LockQueue();
+
+        if (_sd_ReqHead == _sd_ReqTail)
         {
-            //sysprintf("sdioSD_Read_in_blksize(): response error!\n");
-            return SD_CRC7_ERROR;
+            SD_UnlockQueue(bIsEnabled);
+            break;
         }
 
-        if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC16_Msk))     // check CRC16
+        pReq = _sd_ReqQueue[_sd_ReqHead];
+        _sd_ReqHead = (_sd_ReqHead + 1) % SD_REQ_QUEUE_SIZE;
+        SD_UnlockQueue(bIsEnabled);
+
+        pReq->u32Status = status;
+
+        if (pReq->pfnCallback != NULL)
+            pReq->pfnCallback(pReq);
+    }
+}
+
+// advance the data phase for applications whose SDH interrupt handler only sets _sd_SDDataReady
+static void SD_PollQueue(void)
+{
+    int bIsEnabled;
+
+    if (_sd_SDDataReady && (_sd_pActiveReq != NULL))
+    {
+        _sd_SDDataReady = FALSE;
+        bIsEnabled = SD_LockQueue();
+        SD_BlockDoneHandler();
+        SD_UnlockQueue(bIsEnabled);
+    }
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Block transfer done handler of the request queue.
+ *
+ *          Call it from the application SDH interrupt handler when \ref SDH_INTSTS_BLKDIF_Msk is set,
+ *          after clearing that flag. It checks the CRC status of the finished chunk and kicks the next
+ *          chunk of the active request. It never waits on the card: once all blocks are transferred,
+ *          or on error, the request is left to \ref SD_ServiceQueue, which sends the stop command,
+ *          waits for the card busy end and deselects the card in task context.
+ *
+ *  @return None
+ */
+void SD_BlockDoneHandler(void)
+{
+    SD_REQ_T *pReq = _sd_pActiveReq;
+    unsigned int status = 0;
+
+    if (pReq == NULL)
+    {
+        // not a queued request, e.g. a stream session transfer
+        _sd_SDDataReady = TRUE;
+        return;
+    }
+
+    if (pReq->bIsWrite)
+    {
+        if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRCIF_Msk) != 0)     // check CRC
         {
-            //sysprintf("sdioSD_Read_in_blksize(): read data error!\n");
-            return SD_CRC16_ERROR;
+            outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
+            status = SD_CRC_ERROR;
         }
     }
+    else
+    {
+        if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC7_Msk))          // check CRC7
+            status = SD_CRC7_ERROR;
+        else if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC16_Msk))    // check CRC16
+            status = SD_CRC16_ERROR;
+    }
 
-    if (SD_SDCmdAndRsp(pSD, 12, 0, 0))      // stop command
+    if ((status == 0) && (pReq->u32Remain != 0))
     {
-        //sysprintf("stop command fail !!\n");
-        return SD_CRC7_ERROR;
+        SD_KickChunk(pReq, FALSE);
+        return;
     }
 
-    SD_CheckRB();
+    _sd_pActiveReq = NULL;
+    _sd_DoneStatus = status;
+    _sd_pDoneReq = pReq;
+}
 
-    SD_SDCommand(pSD, 7, 0);
-    outpw(REG_SDH_CTL, inpw(REG_SDH_CTL) | SDH_CTL_CLK8OEN_Msk);
+/**
+ *  @brief  Complete finished requests and start queued ones.
+ *
+ *          For a request whose data phase has ended, sends the stop command, waits for the card busy
+ *          end, deselects the card and calls the completion callback. Then selects the card for the
+ *          next queued request and starts its data phase. \ref SD_WaitRequest, \ref SD_Read and
+ *          \ref SD_Write call it. Applications that only use completion callbacks must call it from
+ *          their main loop or task. Must not be called from interrupt context or from a callback.
+ *
+ *  @return None
+ */
+void SD_ServiceQueue(void)
+{
+    SD_PollQueue();
+    SD_CompleteDone();
+    SD_ScheduleNext();
+}
 
-    while (inpw(REG_SDH_CTL) & SDH_CTL_CLK8OEN_Msk);
+/**
+ *  @brief  Queue an asynchronous read or write request.
+ *
+ *          The request is started at once if the controller is idle, otherwise it is started from
+ *          \ref SD_ServiceQueue when the requests ahead of it complete. Task context only. The
+ *          request structure and its buffer must stay valid until \b u32Status is no longer
+ *          \ref SD_REQ_BUSY.
+ *
+ *  @param[in]  pReq  Request. \b u32CardNum, \b pu8BufAddr, \b u32StartSec, \b u32SecCount, \b bIsWrite,
+ *                    \b pfnCallback and \b pvContext must be filled by caller. \b pfnCallback may be NULL.
+ *
+ *  @return   0: Request queued. \n
+ *            \ref SD_SELECT_ERROR : u32SecCount is zero. \n
+ *            \ref SD_REQ_QUEUE_FULL : No free slot in the request queue. \n
+ *            \ref SD_STREAM_BUSY : A stream session owns the controller.
+ */
+unsigned int SD_SubmitRequest(SD_REQ_T *pReq)
+{
+    unsigned int next;
+    int bIsEnabled;
+
+    if (pReq->u32SecCount == 0)
+        return SD_SELECT_ERROR;
+
+    if (_sd_pStream != NULL)
+        return SD_STREAM_BUSY;
+
+    bIsEnabled = SD_LockQueue();
+
+    next = (_sd_ReqTail + 1) % SD_REQ_QUEUE_SIZE;
+
+    if (next == _sd_ReqHead)
+    {
+        SD_UnlockQueue(bIsEnabled);
+        return SD_REQ_QUEUE_FULL;
+    }
 
+    pReq->u32Status = SD_REQ_BUSY;
+    _sd_ReqQueue[_sd_ReqTail] = pReq;
+    _sd_ReqTail = next;
+
+    SD_UnlockQueue(bIsEnabled);
+
+    SD_ScheduleNext();
     return 0;
 }
 
+/**
+ *  @brief  Wait for a queued request to complete.
+ *
+ *          The request queue is serviced with \ref SD_ServiceQueue while waiting. If the application
+ *          SDH interrupt handler only sets \ref _sd_SDDataReady instead of calling
+ *          \ref SD_BlockDoneHandler, the data phase is advanced from here too.
+ *          Must not be called from a completion callback.
+ *
+ *  @param[in]  pReq  Request queued by \ref SD_SubmitRequest.
+ *
+ *  @return   Request status: 0 on success, or an SD error code.
+ */
+unsigned int SD_WaitRequest(SD_REQ_T *pReq)
+{
+    while (pReq->u32Status == SD_REQ_BUSY)
+    {
+        SD_ServiceQueue();
+
+        if (SD_GetInfo(pReq->u32CardNum)->IsCardInsert == FALSE)
+            SD_AbortAll(SD_NO_SD_CARD);
+    }
+
+    return pReq->u32Status;
+}
+
+/**
+ *  @brief  This function use to read data from SD card.
+ *
+ *  @param[in]     u32CardNum    Select card: SD0 or SD1. ( \ref SD_PORT0 / \ref SD_PORT1)
+ *  @param[out]    pu8BufAddr    The buffer to receive the data from SD card.
+ *  @param[in]     u32StartSec   The start read sector address.
+ *  @param[in]     u32SecCount   The the read sector number of data
+ *
+ *  @return   0: Success. \n
+ *            \ref SD_SELECT_ERROR : u32SecCount is zero. \n
+ *            \ref SD_NO_SD_CARD : SD card be removed. \n
+ *            \ref SD_CRC7_ERROR : CRC7 error happen. \n
+ *            \ref SD_CRC16_ERROR : CRC16 error happen.
+ */
+unsigned int SD_Read(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
+{
+    SD_REQ_T req;
+    unsigned int status;
+
+    req.u32CardNum = u32CardNum;
+    req.pu8BufAddr = pu8BufAddr;
+    req.u32StartSec = u32StartSec;
+    req.u32SecCount = u32SecCount;
+    req.bIsWrite = FALSE;
+    req.pfnCallback = NULL;
+    req.pvContext = NULL;
+
+    while ((status = SD_SubmitRequest(&req)) == SD_REQ_QUEUE_FULL)
+        SD_ServiceQueue();
+
+    if (status != 0)
+        return status;
+
+    return SD_WaitRequest(&req);
+}
+
 
 /**
  *  @brief  This function use to write data to SD card.
@@ -1015,117 +1320,253 @@ unsigned int SD_Read(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigne
  */
 unsigned int SD_Write(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
 {
-    char volatile bIsSendCmd = FALSE;
-    unsigned int volatile reg;
-    int volatile i, loop, status;
-
-    SD_INFO_T *pSD;
+    SD_REQ_T req;
+    unsigned int status;
 
-    if (u32CardNum == SD_PORT0)
-        pSD = &SD0;
-    else
-        pSD = &SD1;
+    req.u32CardNum = u32CardNum;
+    req.pu8BufAddr = pu8BufAddr;
+    req.u32StartSec = u32StartSec;
+    req.u32SecCount = u32SecCount;
+    req.bIsWrite = TRUE;
+    req.pfnCallback = NULL;
+    req.pvContext = NULL;
 
-    //--- check input parameters
-    if (u32SecCount == 0)
-        return SD_SELECT_ERROR;
+    while ((status = SD_SubmitRequest(&req)) == SD_REQ_QUEUE_FULL)
+        SD_ServiceQueue();
 
-    if ((status = SD_SDCmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
+    if (status != 0)
         return status;
 
-    SD_CheckRB();
+    return SD_WaitRequest(&req);
+}
 
-    // According to SD Spec v2.0, the write CMD block size MUST be 512, and the start address MUST be 512*n.
-    outpw(REG_SDH_BLEN, SD_BLOCK_SIZE - 1);           // set the block size
 
-    if ((pSD->CardType == SD_TYPE_SD_HIGH) || (pSD->CardType == SD_TYPE_EMMC))
-        outpw(REG_SDH_CMD, u32StartSec);
-    else
-        outpw(REG_SDH_CMD, u32StartSec * SD_BLOCK_SIZE);  // set start address for SD CMD
+/**
+ *  @brief  Open a sequential read or write stream session.
+ *
+ *          The card is selected and a single open-ended CMD18/CMD25 transfer is started by the first
+ *          \ref SD_StreamXfer call. All following buffers continue the same multi-block transfer
+ *          until \ref SD_StreamClose sends STOP_TRANSMISSION. The request queue is held while a
+ *          session is open.
+ *
+ *  @param[out]  pStream           Stream session object.
+ *  @param[in]   u32CardNum        Select card: SD0 or SD1. ( \ref SD_PORT0 / \ref SD_PORT1)
+ *  @param[in]   u32StartSec       The start sector address.
+ *  @param[in]   u32PreEraseCount  Number of sectors expected to be written, sent with ACMD23 (SD) or
+ *                                 CMD23 (MMC/eMMC) before the write starts. 0 to skip. Ignored for read.
+ *                                 For MMC/eMMC the write is then closed-ended and \ref SD_StreamXfer
+ *                                 refuses to go past this count. CMD23 only carries 16 bits, so a count
+ *                                 above 65535 leaves the write open-ended and it is stopped by CMD12.
+ *  @param[in]   bIsWrite          TRUE to open a write session, FALSE for a read session.
+ *
+ *  @return   0: Success. \n
+ *            \ref SD_NO_SD_CARD : SD card be removed. \n
+ *            \ref SD_STREAM_BUSY : A request or another session owns the controller. \n
+ *            Other SD error codes on command failure.
+ */
+unsigned int SD_StreamOpen(SD_STREAM_T *pStream, unsigned int u32CardNum, unsigned int u32StartSec, unsigned int u32PreEraseCount, int bIsWrite)
+{
+    SD_INFO_T *pSD = SD_GetInfo(u32CardNum);
+    int volatile status;
+    int bIsEnabled;
 
-    outpw(REG_SDH_DMASA, (unsigned int)pu8BufAddr);
-    loop = u32SecCount / 255;   // the maximum block count is 0xFF=255 for register SDCR[BLK_CNT]
+    if (pSD->IsCardInsert == FALSE)
+        return SD_NO_SD_CARD;
 
-    for (i = 0; i < loop; i++)
+    bIsEnabled = SD_LockQueue();
+
+    if ((_sd_pActiveReq != NULL) || (_sd_pDoneReq != NULL) || _sd_bStarting || (_sd_pStream != NULL))
     {
-        _sd_SDDataReady = FALSE;
+        SD_UnlockQueue(bIsEnabled);
+        return SD_STREAM_BUSY;
+    }
 
-        reg = inpw(REG_SDH_CTL) & 0xff00c080;
-        reg = reg | 0xff0000;   // set BLK_CNT to 0xFF=255
+    _sd_pStream = pStream;
+    SD_UnlockQueue(bIsEnabled);
 
-        if (!bIsSendCmd)
-        {
-            outpw(REG_SDH_CTL, reg | (25 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk));
-            bIsSendCmd = TRUE;
-        }
-        else
-            outpw(REG_SDH_CTL, reg | SDH_CTL_DOEN_Msk);
+    memset(pStream, 0, sizeof(SD_STREAM_T));
+    pStream->u32CardNum = u32CardNum;
+    pStream->u32NextSec = u32StartSec;
+    pStream->bIsWrite = bIsWrite;
 
-        while (!_sd_SDDataReady)
+    if ((status = SD_SDCmdAndRsp(pSD, 7, pSD->RCA, 0)) != 0)
+        goto open_fail;
+
+    SD_CheckRB();
+
+    if (bIsWrite && (u32PreEraseCount != 0))
+    {
+        if ((pSD->CardType == SD_TYPE_SD_HIGH) || (pSD->CardType == SD_TYPE_SD_LOW))
         {
-            //             if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_BLKDIF_Msk) && (!(inpw(REG_SDH_CTL) & SDH_CTL_DOEN_Msk))) {
-            //                 outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
-            //                 break;
-            //             }
-            if (pSD->IsCardInsert == FALSE)
-                return SD_NO_SD_CARD;
-        }
+            // ACMD23: SET_WR_BLK_ERASE_COUNT, pre-erase hint for the following CMD25
+            if ((status = SD_SDCmdAndRsp(pSD, 55, pSD->RCA, 0)) != 0)
+                goto open_fail;
 
-        if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRCIF_Msk) != 0)     // check CRC
+            if ((status = SD_SDCmdAndRsp(pSD, 23, u32PreEraseCount & 0x7fffff, 0)) != 0)
+                goto open_fail;
+        }
+        else if (u32PreEraseCount <= 0xffff)
         {
-            outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
-            return SD_CRC_ERROR;
+            // CMD23: SET_BLOCK_COUNT, the write becomes a closed-ended transfer of this length
+            if ((status = SD_SDCmdAndRsp(pSD, 23, u32PreEraseCount, 0)) != 0)
+                goto open_fail;
+
+            pStream->u32BlockCount = u32PreEraseCount;
         }
     }
 
-    loop = u32SecCount % 255;
+    return 0;
+
+open_fail:
+    SD_SDCommand(pSD, 7, 0);
+    bIsEnabled = SD_LockQueue();
+    _sd_pStream = NULL;
+    SD_UnlockQueue(bIsEnabled);
+    SD_ScheduleNext();
+    return status;
+}
+
+/**
+ *  @brief  Transfer the next buffer of a stream session.
+ *
+ *  @param[in]      pStream       Stream session opened by \ref SD_StreamOpen.
+ *  @param[in,out]  pu8BufAddr    DMA buffer to read into or write from.
+ *  @param[in]      u32SecCount   Number of sectors in this buffer.
+ *
+ *  @return   0: Success. \n
+ *            \ref SD_SELECT_ERROR : u32SecCount is zero, goes past the CMD23 count of a closed-ended
+ *                                   write, or the session is not open. \n
+ *            \ref SD_NO_SD_CARD : SD card be removed. \n
+ *            \ref SD_CRC_ERROR / \ref SD_CRC7_ERROR / \ref SD_CRC16_ERROR : CRC error happen.
+ */
+unsigned int SD_StreamXfer(SD_STREAM_T *pStream, unsigned char *pu8BufAddr, unsigned int u32SecCount)
+{
+    SD_INFO_T *pSD = SD_GetInfo(pStream->u32CardNum);
+    unsigned int volatile reg;
+    unsigned int blkcnt;
+
+    if ((u32SecCount == 0) || (_sd_pStream != pStream))
+        return SD_SELECT_ERROR;
+
+    if ((pStream->u32BlockCount != 0) && (u32SecCount > pStream->u32BlockCount - pStream->u32Transferred))
+        return SD_SELECT_ERROR;
+
+    outpw(REG_SDH_BLEN, SD_BLOCK_SIZE - 1);
+    outpw(REG_SDH_DMASA, (unsigned int)pu8BufAddr);
 
-    if (loop != 0)
+    if (!pStream->bIsSendCmd)
     {
-        _sd_SDDataReady = FALSE;
+        if ((pSD->CardType == SD_TYPE_SD_HIGH) || (pSD->CardType == SD_TYPE_EMMC))
+            outpw(REG_SDH_CMD, pStream->u32NextSec);
+        else
+            outpw(REG_SDH_CMD, pStream->u32NextSec * SD_BLOCK_SIZE);
+    }
 
-        reg = (inpw(REG_SDH_CTL) & 0xff00c080) | (loop << 16);
+    while (u32SecCount > 0)
+    {
+        blkcnt = (u32SecCount > 255) ? 255 : u32SecCount;
+        _sd_SDDataReady = FALSE;
 
-        if (!bIsSendCmd)
+        if (pStream->bIsWrite)
         {
-            outpw(REG_SDH_CTL, reg | (25 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk));
-            bIsSendCmd = TRUE;
+            reg = (inpw(REG_SDH_CTL) & 0xff00c080) | (blkcnt << 16);
+
+            if (!pStream->bIsSendCmd)
+                outpw(REG_SDH_CTL, reg | (25 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk));
+            else
+                outpw(REG_SDH_CTL, reg | SDH_CTL_DOEN_Msk);
         }
         else
-            outpw(REG_SDH_CTL, reg | SDH_CTL_DOEN_Msk);
+        {
+            reg = inpw(REG_SDH_CTL) & ~(SDH_CTL_CMDCODE_Msk | SDH_CTL_BLKCNT_Msk);
+            reg |= (blkcnt << 16);
+
+            if (!pStream->bIsSendCmd)
+                outpw(REG_SDH_CTL, reg | (18 << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk));
+            else
+                outpw(REG_SDH_CTL, reg | SDH_CTL_DIEN_Msk);
+        }
+
+        pStream->bIsSendCmd = TRUE;
 
         while (!_sd_SDDataReady)
         {
-            //             if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_BLKDIF_Msk) && (!(inpw(REG_SDH_CTL) & SDH_CTL_DOEN_Msk))) {
-            //                 outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
-            //                 break;
-            //             }
             if (pSD->IsCardInsert == FALSE)
                 return SD_NO_SD_CARD;
         }
 
-        if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRCIF_Msk) != 0)     // check CRC
+        if (pStream->bIsWrite)
         {
-            outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
-            return SD_CRC_ERROR;
+            if ((inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRCIF_Msk) != 0)     // check CRC
+            {
+                outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
+                return SD_CRC_ERROR;
+            }
         }
+        else
+        {
+            if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC7_Msk))      // check CRC7
+                return SD_CRC7_ERROR;
+
+            if (!(inpw(REG_SDH_INTSTS) & SDH_INTSTS_CRC16_Msk))     // check CRC16
+                return SD_CRC16_ERROR;
+        }
+
+        pStream->u32NextSec += blkcnt;
+        pStream->u32Transferred += blkcnt;
+        u32SecCount -= blkcnt;
     }
 
-    outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
+    return 0;
+}
+
+/**
+ *  @brief  Close a stream session with STOP_TRANSMISSION and release the card.
+ *
+ *          For a closed-ended MMC/eMMC write (CMD23 count given to \ref SD_StreamOpen) which has
+ *          transferred exactly that many sectors, no stop command is needed and none is sent.
+ *
+ *  @param[in]  pStream  Stream session opened by \ref SD_StreamOpen.
+ *
+ *  @return   0: Success. \n
+ *            \ref SD_SELECT_ERROR : The session is not open. \n
+ *            \ref SD_CRC7_ERROR : Stop command failed.
+ */
+unsigned int SD_StreamClose(SD_STREAM_T *pStream)
+{
+    SD_INFO_T *pSD = SD_GetInfo(pStream->u32CardNum);
+    unsigned int status = 0;
+    int bIsEnabled;
+
+    if (_sd_pStream != pStream)
+        return SD_SELECT_ERROR;
+
+    if (pStream->bIsWrite)
+        outpw(REG_SDH_INTSTS, SDH_INTSTS_CRCIF_Msk);
 
-    if (SD_SDCmdAndRsp(pSD, 12, 0, 0))      // stop command
+    if ((pSD->IsCardInsert != FALSE) && pStream->bIsSendCmd &&
+            !((pStream->u32BlockCount != 0) && (pStream->u32Transferred == pStream->u32BlockCount)))
     {
-        return SD_CRC7_ERROR;
+        if (SD_SDCmdAndRsp(pSD, 12, 0, 0))      // stop command
+            status = SD_CRC7_ERROR;
     }
 
-    SD_CheckRB();
+    if (pSD->IsCardInsert != FALSE)
+    {
+        SD_CheckRB();
 
-    SD_SDCommand(pSD, 7, 0);
-    outpw(REG_SDH_CTL, inpw(REG_SDH_CTL) | SDH_CTL_CLK8OEN_Msk);
+        SD_SDCommand(pSD, 7, 0);
+        outpw(REG_SDH_CTL, inpw(REG_SDH_CTL) | SDH_CTL_CLK8OEN_Msk);
 
-    while (inpw(REG_SDH_CTL) & SDH_CTL_CLK8OEN_Msk);
+        while (inpw(REG_SDH_CTL) & SDH_CTL_CLK8OEN_Msk);
+    }
 
-    return 0;
+    bIsEnabled = SD_LockQueue();
+    _sd_pStream = NULL;
+    SD_UnlockQueue(bIsEnabled);
+    SD_ScheduleNext();
+
+    return status;
 }
 
 
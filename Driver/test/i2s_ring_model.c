@@ -0,0 +1,306 @@
+/*
+ * i2s_ring_model - host model of the I2S DMA ring API of i2s.c.
+ *
+ * Builds the driver against a model of the ACTL play and record DMA: the
+ * current address registers follow a DMA position, a period interrupt
+ * calls i2sISR(), and the play DMA checks every word it reads from the ring.
+ * The application side writes a running count to the play ring and checks
+ * that the record ring returns the count the record DMA wrote.
+ *
+ *   i2s_ring_model <mode> [late] [silence]
+ *
+ *   mode     0 the application keeps up, 1 it stalls now and then
+ *   late     words the DMA runs past a period end before the interrupt is
+ *            taken, periods passed meanwhile raise no interrupt of their own
+ *   silence  1 sets I2S_SET_RING_SILENCE, 0 (default) keeps the driver
+ *            default of clearing a period on an underrun only
+ *
+ * i2s_ring_model.sh builds the driver with the non-cacheable alias removed
+ * and runs the cases. The model does not show the cost of the period
+ * memset on the target, it only counts the bytes cleared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "N9H31.h"
+
+/* ACTL registers, PDESC and RDESC follow the model DMA, play [0] and record [1] */
+static uint32_t g_au32Reg[0x50 / 4];
+static uint32_t g_au32DmaPos[2];
+
+static uint32_t actl_in(uint32_t u32Addr)
+{
+    uint32_t u32Off = u32Addr - ACTL_BA;
+
+    /* system and clock registers read as 0 */
+    if (u32Off >= sizeof(g_au32Reg))
+        return 0;
+    if (u32Off == 0x1C)
+        return g_au32Reg[0x14 / 4] + g_au32DmaPos[0];
+    if (u32Off == 0x10)
+        return g_au32Reg[0x08 / 4] + g_au32DmaPos[1];
+    return g_au32Reg[u32Off / 4];
+}
+
+static void actl_out(uint32_t u32Addr, uint32_t u32Value)
+{
+    uint32_t u32Off = u32Addr - ACTL_BA;
+
+    if (u32Off >= sizeof(g_au32Reg))
+        return;
+    /* PSR, RSR and the CON interrupt flags are cleared by writing 1 */
+    if ((u32Off == 0x20) || (u32Off == 0x24)) {
+        g_au32Reg[u32Off / 4] &= ~u32Value;
+        return;
+    }
+    if (u32Off == 0x00) {
+        g_au32Reg[0] = (u32Value & ~0xC00) | (g_au32Reg[0] & 0xC00 & ~(u32Value & 0xC00));
+        return;
+    }
+    /* starting DMA restarts it at the ring base */
+    if (u32Off == 0x04) {
+        if ((u32Value & (1<<5)) && !(g_au32Reg[1] & (1<<5)))
+            g_au32DmaPos[0] = 0;
+        if ((u32Value & (1<<6)) && !(g_au32Reg[1] & (1<<6)))
+            g_au32DmaPos[1] = 0;
+    }
+    g_au32Reg[u32Off / 4] = u32Value;
+}
+
+#undef inpw
+#undef outpw
+#define inpw(port)          actl_in((uint32_t)(port))
+#define outpw(port,value)   actl_out((uint32_t)(port), (uint32_t)(value))
+
+/* count the bytes the period interrupt clears */
+static uint32_t g_u32Cleared;
+
+static void *ring_memset(void *pvDst, int c, size_t n)
+{
+    g_u32Cleared += n;
+    return memset(pvDst, c, n);
+}
+
+#define memset ring_memset
+
+#include "sys.h"
+#include "i2s.h"
+
+INT32 sysSetInterruptType(IRQn_Type eIntNo, UINT32 uIntSourceType) { return 0; }
+PVOID sysInstallISR(INT32 nIntTypeLevel, IRQn_Type eIntNo, PVOID pvNewISR) { return 0; }
+INT32 sysEnableInterrupt(IRQn_Type eIntNo) { return 0; }
+INT32 sysSetLocalInterrupt(INT32 nIntState) { return 0; }
+
+/* the driver, built by i2s_ring_model.sh with the non-cacheable alias removed */
+#include "i2s_host.c"
+
+#undef memset
+
+#define PLAY_PERIOD     64      /* words */
+#define PLAY_PERIODS    4
+#define REC_PERIOD      32
+#define REC_PERIODS     8
+#define LOOPS           200000
+
+static uint32_t g_au32Play[PLAY_PERIODS * PLAY_PERIOD];
+static uint32_t g_au32Rec[REC_PERIODS * REC_PERIOD];
+static uint8_t *g_apu8Ring[2] = { (uint8_t *)g_au32Play, (uint8_t *)g_au32Rec };
+
+static uint32_t g_u32Late;
+static uint32_t g_au32Pending[2], g_au32LateLeft[2];
+static uint32_t g_au32Callback[2];
+
+/* what the play DMA read */
+static uint32_t g_u32PlayWords, g_u32PlayZero, g_u32PlayLast, g_u32PlayStale, g_u32PlayGap;
+static uint32_t g_u32RecCount;
+
+static void ring_callback(uint32_t u32Dir)
+{
+    g_au32Callback[u32Dir]++;
+}
+
+/* move DMA of one direction by u32Words */
+static void dma_run(uint32_t u32Dir, uint32_t u32Words)
+{
+    uint32_t u32Len, u32Period, u32Word;
+
+    if (!(g_au32Reg[1] & ((u32Dir == I2S_PLAY) ? (1<<5) : (1<<6))))
+        return;
+    u32Len = g_au32Reg[((u32Dir == I2S_PLAY) ? 0x18 : 0x0C) / 4];
+    u32Period = u32Len >> ((g_au32Reg[0] >> ((u32Dir == I2S_PLAY) ? 12 : 14)) & 3);
+
+    while (u32Words--) {
+        uint32_t *pu32 = (uint32_t *)(g_apu8Ring[u32Dir] + g_au32DmaPos[u32Dir]);
+
+        if (u32Dir == I2S_REC) {
+            *pu32 = ++g_u32RecCount;
+        } else {
+            u32Word = *pu32;
+            g_u32PlayWords++;
+            if (u32Word == 0)
+                g_u32PlayZero++;
+            else if (u32Word <= g_u32PlayLast)
+                g_u32PlayStale++;
+            else {
+                if (u32Word != g_u32PlayLast + 1)
+                    g_u32PlayGap++;
+                g_u32PlayLast = u32Word;
+            }
+        }
+
+        g_au32DmaPos[u32Dir] += 4;
+        if ((g_au32DmaPos[u32Dir] % u32Period == 0) && !g_au32Pending[u32Dir]) {
+            g_au32Pending[u32Dir] = 1;
+            g_au32LateLeft[u32Dir] = g_u32Late;
+        }
+        if (g_au32DmaPos[u32Dir] == u32Len)
+            g_au32DmaPos[u32Dir] = 0;
+
+        if (g_au32Pending[u32Dir]) {
+            if (g_au32LateLeft[u32Dir]) {
+                g_au32LateLeft[u32Dir]--;
+                continue;
+            }
+            g_au32Pending[u32Dir] = 0;
+            g_au32Reg[0] |= (u32Dir == I2S_PLAY) ? (1<<10) : (1<<11);
+            g_au32Reg[((u32Dir == I2S_PLAY) ? 0x24 : 0x20) / 4] |= 1;
+            i2sISR();
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t u32Mode, u32Silence, u32Loop, u32Next = 0, u32Hw, u32LastHw = 0;
+    uint32_t u32RecLast = 0, u32RecErr = 0, u32PlayXrun = 0, u32RecXrun = 0, u32HwBack = 0;
+    uint32_t *pu32 = NULL, k, m;
+    int32_t i32Len;
+    int fail = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: i2s_ring_model <mode> [late] [silence]\n");
+        return 1;
+    }
+    u32Mode = atoi(argv[1]);
+    g_u32Late = (argc > 2) ? atoi(argv[2]) : 0;
+    u32Silence = (argc > 3) ? atoi(argv[3]) : 0;
+
+    if (u32Silence)
+        i2sIoctl(I2S_SET_RING_SILENCE, I2S_ENABLE, 0);
+
+    /* argument checks */
+    if (i2sRingOpen(I2S_PLAY, g_au32Play, 60, PLAY_PERIODS, ring_callback) != I2S_ERR_IO) {
+        printf("FAIL: unaligned period accepted\n");
+        fail = 1;
+    }
+    if ((i2sRingOpen(I2S_PLAY, g_au32Play, PLAY_PERIOD * 4, PLAY_PERIODS, ring_callback) != 0) ||
+        (i2sRingOpen(I2S_REC, g_au32Rec, REC_PERIOD * 4, REC_PERIODS, ring_callback) != 0)) {
+        printf("FAIL: ring open\n");
+        return 1;
+    }
+    /* only count the clearing of played periods, not the ring open */
+    g_u32Cleared = 0;
+
+    /* prefill all but one period */
+    while (i2sRingAvail(I2S_PLAY) > PLAY_PERIOD * 4) {
+        i32Len = i2sRingBegin(I2S_PLAY, (void **)&pu32);
+        if (i32Len > PLAY_PERIOD * 4)
+            i32Len = PLAY_PERIOD * 4;
+        for (k = 0; k < (uint32_t)i32Len / 4; k++)
+            pu32[k] = ++u32Next;
+        i2sRingCommit(I2S_PLAY, i32Len);
+    }
+    i2sRingStart(I2S_PLAY);
+    i2sRingStart(I2S_REC);
+
+    for (u32Loop = 0; u32Loop < LOOPS; u32Loop++) {
+        dma_run(I2S_PLAY, 1 + rand() % 7);
+        dma_run(I2S_REC, 1 + rand() % 7);
+
+        u32Hw = i2sRingHwPointer(I2S_PLAY);
+        if (u32Hw < u32LastHw)
+            u32HwBack++;
+        u32LastHw = u32Hw;
+
+        if ((u32Mode == 1) && (u32Loop % 5000 < 1500))
+            continue;
+
+        /* play: write a random part of the space */
+        i32Len = i2sRingBegin(I2S_PLAY, (void **)&pu32);
+        if (i32Len == I2S_ERR_XRUN) {
+            u32PlayXrun++;
+            i2sRingRecover(I2S_PLAY);
+        } else if (i32Len > 0) {
+            m = rand() % (i32Len / 4) + 1;
+            for (k = 0; k < m; k++)
+                pu32[k] = ++u32Next;
+            if (i2sRingCommit(I2S_PLAY, m * 4) != 0)
+                printf("FAIL: play commit\n");
+        }
+
+        /* record: read all, the count restarts after an overrun */
+        i32Len = i2sRingBegin(I2S_REC, (void **)&pu32);
+        if (i32Len == I2S_ERR_XRUN) {
+            u32RecXrun++;
+            i2sRingRecover(I2S_REC);
+            u32RecLast = 0;
+        } else if (i32Len > 0) {
+            for (k = 0; k < (uint32_t)i32Len / 4; k++) {
+                if (u32RecLast && (pu32[k] != u32RecLast + 1))
+                    u32RecErr++;
+                u32RecLast = pu32[k];
+            }
+            i2sRingCommit(I2S_REC, i32Len);
+        }
+    }
+
+    printf("mode %u late %u silence %u: play %u words, %u zero, %u stale, %u gaps, xrun %u/%u, "
+           "cleared %u bytes | rec %u errors, xrun %u/%u | callbacks %u %u\n",
+           u32Mode, g_u32Late, u32Silence, g_u32PlayWords, g_u32PlayZero, g_u32PlayStale,
+           g_u32PlayGap, u32PlayXrun, i2sRingXrunCount(I2S_PLAY), g_u32Cleared,
+           u32RecErr, u32RecXrun, i2sRingXrunCount(I2S_REC),
+           g_au32Callback[I2S_PLAY], g_au32Callback[I2S_REC]);
+
+    /* checks that hold in every case */
+    if (u32HwBack) {
+        printf("FAIL: play hardware pointer went back %u times\n", u32HwBack);
+        fail = 1;
+    }
+    if (u32RecErr) {
+        printf("FAIL: record data out of order\n");
+        fail = 1;
+    }
+    if (u32Silence && g_u32PlayStale) {
+        printf("FAIL: old samples played with silencing on\n");
+        fail = 1;
+    }
+    /* underrun silencing clears at most a period per underrun, and on time it plays no old sample */
+    if (!u32Silence && (g_u32Cleared > i2sRingXrunCount(I2S_PLAY) * PLAY_PERIOD * 4)) {
+        printf("FAIL: %u bytes cleared for %u underruns\n", g_u32Cleared, i2sRingXrunCount(I2S_PLAY));
+        fail = 1;
+    }
+    if (!u32Silence && (g_u32Late == 0) && g_u32PlayStale) {
+        printf("FAIL: old samples played with the interrupt on time\n");
+        fail = 1;
+    }
+
+    /* an application that keeps up sees every word in order */
+    if ((u32Mode == 0) && (g_u32PlayGap || u32PlayXrun || u32RecXrun)) {
+        printf("FAIL: xrun or gap while keeping up\n");
+        fail = 1;
+    }
+    if ((u32Mode == 1) && (!u32PlayXrun || !u32RecXrun)) {
+        printf("FAIL: stalls raised no xrun\n");
+        fail = 1;
+    }
+    /* a stall plays silence */
+    if ((u32Mode == 1) && (!g_u32PlayZero || !g_u32Cleared)) {
+        printf("FAIL: no silence played for the stalls\n");
+        fail = 1;
+    }
+
+    return fail;
+}
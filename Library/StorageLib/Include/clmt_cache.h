@@ -0,0 +1,87 @@
+/**************************************************************************//**
+ * @file     clmt_cache.h
+ * @brief    Cluster link map (fast seek) management for FatFs files
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __CLMT_CACHE_H__
+#define __CLMT_CACHE_H__
+
+#include "N9H31.h"
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if !FF_USE_FASTSEEK
+#error "clmt_cache requires FF_USE_FASTSEEK 1 in ffconf.h"
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_CLMT_CACHE_EXPORTED_CONSTANTS CLMT Cache Exported Constants
+  @{
+*/
+
+#ifndef CLMT_CACHE_MAPS
+#define CLMT_CACHE_MAPS         8       /*!< Number of link maps kept, open or pre-built \hideinitializer */
+#endif
+
+#ifndef CLMT_CACHE_INIT_ITEMS
+#define CLMT_CACHE_INIT_ITEMS   32      /*!< Initial size of a link map in DWORDs, grown when the file is more fragmented \hideinitializer */
+#endif
+
+/*@}*/ /* end of group N9H31_CLMT_CACHE_EXPORTED_CONSTANTS */
+
+/** @addtogroup N9H31_CLMT_CACHE_EXPORTED_TYPEDEF CLMT Cache Exported Type Defines
+  @{
+*/
+
+/** \brief  Link map cache statistics.
+ */
+typedef struct clmt_stat_t
+{
+    UINT32  u32Builds;      /*!< Link maps built by walking the FAT chain */
+    UINT32  u32Reuses;      /*!< Opens served by a map that was already built */
+    UINT32  u32Grows;       /*!< Times a map was enlarged for a fragmented file */
+    UINT32  u32Evictions;   /*!< Unused maps dropped to make room */
+    UINT32  u32MaxItems;    /*!< Largest map size in DWORDs */
+} CLMT_STAT_T;
+
+/*@}*/ /* end of group N9H31_CLMT_CACHE_EXPORTED_TYPEDEF */
+
+/** @addtogroup N9H31_CLMT_CACHE_EXPORTED_FUNCTIONS CLMT Cache Exported Functions
+  @{
+*/
+
+FRESULT clmt_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT clmt_close(FIL *fp);
+FRESULT clmt_attach(FIL *fp);
+void clmt_detach(FIL *fp);
+FRESULT clmt_prebuild(const TCHAR *path);
+void clmt_purge(void);
+void clmt_get_stat(CLMT_STAT_T *pStat);
+
+/*@}*/ /* end of group N9H31_CLMT_CACHE_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __CLMT_CACHE_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,113 @@
+/**************************************************************************//**
+ * @file     disk_cache.h
+ * @brief    Sector cache with read-ahead and write-back for the FatFs block layer
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __DISK_CACHE_H__
+#define __DISK_CACHE_H__
+
+#include "N9H31.h"
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_DISK_CACHE_EXPORTED_CONSTANTS Disk Cache Exported Constants
+  @{
+*/
+
+#define DISK_CACHE_SECTOR_SIZE      512             /*!< Sector size handled by the cache in bytes \hideinitializer */
+
+#ifndef DISK_CACHE_DRIVES
+#define DISK_CACHE_DRIVES           FF_VOLUMES      /*!< Number of physical drives that can be attached \hideinitializer */
+#endif
+
+#ifndef DISK_CACHE_LINES
+#define DISK_CACHE_LINES            16              /*!< Number of cache lines shared by all drives \hideinitializer */
+#endif
+
+#ifndef DISK_CACHE_LINE_SECTORS
+#define DISK_CACHE_LINE_SECTORS     8               /*!< Sectors per cache line, 1 ~ 32 \hideinitializer */
+#endif
+
+#ifndef DISK_CACHE_RA_SECTORS
+#define DISK_CACHE_RA_SECTORS       32              /*!< Size of the read-ahead window in sectors, 0 disables read-ahead \hideinitializer */
+#endif
+
+#ifndef DISK_CACHE_BYPASS_SECTORS
+#define DISK_CACHE_BYPASS_SECTORS   DISK_CACHE_LINE_SECTORS     /*!< Requests of this many sectors or more go straight to the media \hideinitializer */
+#endif
+
+#ifndef DISK_CACHE_WRITE_BACK
+#define DISK_CACHE_WRITE_BACK       1               /*!< 1: hold writes until eviction or CTRL_SYNC. 0: write-through \hideinitializer */
+#endif
+
+/*@}*/ /* end of group N9H31_DISK_CACHE_EXPORTED_CONSTANTS */
+
+/** @addtogroup N9H31_DISK_CACHE_EXPORTED_TYPEDEF Disk Cache Exported Type Defines
+  @{
+*/
+
+/** \brief  Media read function of a drive. Same contract as disk_read(). */
+typedef DRESULT (*DISK_CACHE_READ_FUNC)(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+
+/** \brief  Media write function of a drive. Same contract as disk_write(). */
+typedef DRESULT (*DISK_CACHE_WRITE_FUNC)(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+/** \brief  Per-drive cache statistics.
+ */
+typedef struct disk_cache_stat_t
+{
+    UINT32  u32ReadHits;        /*!< Sectors served from a cache line or the read-ahead window */
+    UINT32  u32ReadMisses;      /*!< Sectors that had to be fetched from the media */
+    UINT32  u32ReadAheadFills;  /*!< Read-ahead windows loaded on a sequential miss */
+    UINT32  u32ReadAheadHits;   /*!< Part of u32ReadHits served by the read-ahead window */
+    UINT32  u32WriteHits;       /*!< Sectors rewritten while still cached */
+    UINT32  u32WriteBacks;      /*!< Media write commands issued to write back dirty sectors */
+    UINT32  u32WriteBackSectors;/*!< Sectors written back */
+    UINT32  u32Evictions;       /*!< Cache lines of this drive evicted to make room */
+    UINT32  u32Bypass;          /*!< Requests passed straight to the media */
+} DISK_CACHE_STAT_T;
+
+/*@}*/ /* end of group N9H31_DISK_CACHE_EXPORTED_TYPEDEF */
+
+/** @addtogroup N9H31_DISK_CACHE_EXPORTED_FUNCTIONS Disk Cache Exported Functions
+  @{
+*/
+
+void disk_cache_attach(BYTE pdrv, DISK_CACHE_READ_FUNC pfnRead, DISK_CACHE_WRITE_FUNC pfnWrite);
+void disk_cache_invalidate(BYTE pdrv);
+void disk_cache_discard(BYTE pdrv, DWORD sector, UINT count);
+DRESULT disk_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+DRESULT disk_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+DRESULT disk_cache_sync(BYTE pdrv);
+void disk_cache_get_stat(BYTE pdrv, DISK_CACHE_STAT_T *pStat);
+void disk_cache_reset_stat(BYTE pdrv);
+
+/*@}*/ /* end of group N9H31_DISK_CACHE_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DISK_CACHE_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,80 @@
+/**************************************************************************//**
+ * @file     sd_diskio.h
+ * @brief    Zero-copy FatFs disk I/O layer for the SDH controller
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __SD_DISKIO_H__
+#define __SD_DISKIO_H__
+
+#include "N9H31.h"
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_SD_DISKIO_EXPORTED_CONSTANTS SD Disk I/O Exported Constants
+  @{
+*/
+
+#define SD_DISK_SECTOR_SIZE     512           /*!< Sector size of SD/eMMC media in bytes \hideinitializer */
+#define SD_DISK_NONCACHE_BIT    0x80000000    /*!< Address bit that selects the non-cacheable alias \hideinitializer */
+
+#ifndef SD_DISK_BOUNCE_SIZE
+#define SD_DISK_BOUNCE_SIZE     (8*1024)      /*!< Size of the non-cacheable bounce buffer, two halves of a multiple of 512 \hideinitializer */
+#endif
+
+/*@}*/ /* end of group N9H31_SD_DISKIO_EXPORTED_CONSTANTS */
+
+/** @addtogroup N9H31_SD_DISKIO_EXPORTED_TYPEDEF SD Disk I/O Exported Type Defines
+  @{
+*/
+
+/** \brief  Transfer statistics of the SD disk I/O layer.
+ */
+typedef struct sd_disk_stat_t
+{
+    UINT32  u32ReadSectors;     /*!< Sectors read through sd_disk_read() */
+    UINT32  u32WriteSectors;    /*!< Sectors written through sd_disk_write() */
+    UINT32  u32BytesDirect;     /*!< Bytes DMA'd straight to/from the caller's buffer */
+    UINT32  u32BytesCopied;     /*!< Bytes copied through the bounce buffer */
+    UINT32  u32BounceCount;     /*!< Number of SD commands issued on the bounce buffer */
+} SD_DISK_STAT_T;
+
+/*@}*/ /* end of group N9H31_SD_DISKIO_EXPORTED_TYPEDEF */
+
+/** @addtogroup N9H31_SD_DISKIO_EXPORTED_FUNCTIONS SD Disk I/O Exported Functions
+  @{
+*/
+
+DRESULT sd_disk_read(UINT32 u32CardNum, BYTE *buff, DWORD sector, UINT count);
+DRESULT sd_disk_write(UINT32 u32CardNum, const BYTE *buff, DWORD sector, UINT count);
+void sd_disk_get_stat(SD_DISK_STAT_T *pStat);
+void sd_disk_reset_stat(void);
+
+/*@}*/ /* end of group N9H31_SD_DISKIO_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SD_DISKIO_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,74 @@
+/**************************************************************************//**
+ * @file     sd_recorder.h
+ * @brief    Contiguous pre-allocated FatFs files written by raw SD sector streams
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __SD_RECORDER_H__
+#define __SD_RECORDER_H__
+
+#include "N9H31.h"
+#include "sdh.h"
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if !FF_USE_EXPAND
+#error "sd_recorder requires FF_USE_EXPAND 1 in ffconf.h"
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_SD_RECORDER_EXPORTED_TYPEDEF SD Recorder Exported Type Defines
+  @{
+*/
+
+/** \brief  Recording file object.
+ */
+typedef struct sd_rec_t
+{
+    FIL          fil;               /*!< FatFs file holding the extent */
+    SD_STREAM_T  stream;            /*!< SD write stream session */
+    UINT32       u32CardNum;        /*!< SD port the volume lives on */
+    DWORD        u32StartSec;       /*!< First sector of the extent on the card */
+    DWORD        u32SecCount;       /*!< Number of sectors reserved */
+    DWORD        u32WrittenSec;     /*!< Number of sectors written so far */
+    BOOL         bStreamOpen;       /*!< A stream session is holding the card */
+} SD_REC_T;
+
+/*@}*/ /* end of group N9H31_SD_RECORDER_EXPORTED_TYPEDEF */
+
+/** @addtogroup N9H31_SD_RECORDER_EXPORTED_FUNCTIONS SD Recorder Exported Functions
+  @{
+*/
+
+FRESULT sd_rec_open(SD_REC_T *pRec, UINT32 u32CardNum, const TCHAR *path, FSIZE_t u32MaxSize);
+FRESULT sd_rec_write(SD_REC_T *pRec, const BYTE *buff, UINT count);
+FRESULT sd_rec_flush(SD_REC_T *pRec);
+FRESULT sd_rec_close(SD_REC_T *pRec, FSIZE_t u32Size);
+
+/*@}*/ /* end of group N9H31_SD_RECORDER_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SD_RECORDER_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
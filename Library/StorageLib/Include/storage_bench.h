@@ -0,0 +1,99 @@
+/**************************************************************************//**
+ * @file     storage_bench.h
+ * @brief    Storage throughput and latency benchmark for FatFs diskio backends
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __STORAGE_BENCH_H__
+#define __STORAGE_BENCH_H__
+
+#include "N9H31.h"
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_STORAGE_BENCH_EXPORTED_CONSTANTS Storage Benchmark Exported Constants
+  @{
+*/
+
+#define SBENCH_SECTOR_SIZE      512     /*!< Sector size in bytes \hideinitializer */
+#define SBENCH_HIST_BINS        16      /*!< Number of latency histogram bins \hideinitializer */
+
+#define SBENCH_SEQ_WRITE        0       /*!< Sequential write test \hideinitializer */
+#define SBENCH_SEQ_READ         1       /*!< Sequential read test \hideinitializer */
+#define SBENCH_RAND_WRITE       2       /*!< Random write test \hideinitializer */
+#define SBENCH_RAND_READ        3       /*!< Random read test \hideinitializer */
+#define SBENCH_TESTS            4       /*!< Number of tests \hideinitializer */
+
+/*@}*/ /* end of group N9H31_STORAGE_BENCH_EXPORTED_CONSTANTS */
+
+/** @addtogroup N9H31_STORAGE_BENCH_EXPORTED_TYPEDEF Storage Benchmark Exported Type Defines
+  @{
+*/
+
+/** \brief  Benchmark setup.
+ */
+typedef struct sbench_cfg_t
+{
+    BYTE         u8Drv;             /*!< diskio physical drive of a raw block test */
+    const TCHAR  *pPath;            /*!< Test file of a file level test, NULL for a raw block test */
+    DWORD        u32StartSec;       /*!< First sector of the raw test area. Its contents are destroyed */
+    DWORD        u32AreaSec;        /*!< Size of the raw test area or of the test file in sectors */
+    UINT         u32ReqSec;         /*!< Sectors per request */
+    BYTE         *pu8Buff;          /*!< Buffer of u32ReqSec sectors, 32 bytes aligned */
+    INT32        i32TimerNo;        /*!< Timer read by sysGetTicks(), started by the caller */
+    UINT32       u32TicksPerSec;    /*!< Tick rate of i32TimerNo */
+    UINT32       u32Seed;           /*!< Seed of the random tests */
+} SBENCH_CFG_T;
+
+/** \brief  Result of one test.
+ */
+typedef struct sbench_result_t
+{
+    UINT32  u32Requests;            /*!< Requests completed */
+    UINT32  u32Sectors;             /*!< Sectors moved */
+    UINT32  u32Ticks;               /*!< Duration including the final sync or close */
+    UINT32  u32KBps;                /*!< Throughput in KB per second */
+    UINT32  u32Iops;                /*!< Requests per second */
+    UINT32  u32MinLat;              /*!< Shortest request in ticks */
+    UINT32  u32MaxLat;              /*!< Longest request in ticks */
+    UINT32  au32Hist[SBENCH_HIST_BINS]; /*!< Request latencies. Bin 0 counts 0 tick, bin n counts 2^(n-1) ~ 2^n-1 ticks, the last bin everything from 2^(n-1) up */
+} SBENCH_RESULT_T;
+
+/*@}*/ /* end of group N9H31_STORAGE_BENCH_EXPORTED_TYPEDEF */
+
+/** @addtogroup N9H31_STORAGE_BENCH_EXPORTED_FUNCTIONS Storage Benchmark Exported Functions
+  @{
+*/
+
+FRESULT sbench_run(const SBENCH_CFG_T *pCfg, INT32 i32Test, SBENCH_RESULT_T *pResult);
+void sbench_report(const SBENCH_CFG_T *pCfg, INT32 i32Test, const SBENCH_RESULT_T *pResult);
+FRESULT sbench_run_all(const SBENCH_CFG_T *pCfg);
+
+/*@}*/ /* end of group N9H31_STORAGE_BENCH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __STORAGE_BENCH_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
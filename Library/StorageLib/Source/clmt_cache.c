@@ -0,0 +1,327 @@
+/**************************************************************************//**
+ * @file     clmt_cache.c
+ * @brief    Cluster link map (fast seek) management for FatFs files
+ *
+ *           FatFs fast seek needs an application supplied cluster link map
+ *           table (CLMT) per file. This module allocates the table when a file
+ *           is opened, grows it when the file is more fragmented than the
+ *           initial size allows, and keeps built maps around so that a file
+ *           opened again, or pre-built ahead of playback, does not walk its
+ *           FAT chain a second time.
+ *
+ *           Maps are only attached to files opened for reading. FatFs does
+ *           not update the map when a write extends the cluster chain.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "clmt_cache.h"
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_CLMT_CACHE_EXPORTED_FUNCTIONS CLMT Cache Exported Functions
+  @{
+*/
+/// @cond HIDDEN_SYMBOLS
+
+typedef struct clmt_entry_t
+{
+    DWORD   *pu32Tbl;           /* NULL if the entry is free */
+    FATFS   *pFs;
+    WORD    u16FsId;            /* mount ID, changes when the volume is remounted */
+    DWORD   u32StartClust;
+    FSIZE_t u32Size;
+    UINT32  u32Refs;            /* open files using the map */
+    UINT32  u32LastUse;
+    BOOL    bPinned;            /* built by clmt_prebuild(), evicted only as a last resort */
+} CLMT_ENTRY_T;
+
+static CLMT_ENTRY_T  _clmt_entry[CLMT_CACHE_MAPS];
+static CLMT_STAT_T   _clmt_stat;
+static UINT32        _clmt_tick;
+
+static void clmt_free(CLMT_ENTRY_T *pEntry)
+{
+    free(pEntry->pu32Tbl);
+    pEntry->pu32Tbl = NULL;
+}
+
+static CLMT_ENTRY_T *clmt_find(FIL *fp)
+{
+    int  i;
+
+    for (i = 0; i < CLMT_CACHE_MAPS; i++)
+    {
+        if ((_clmt_entry[i].pu32Tbl != NULL) && (_clmt_entry[i].pFs == fp->obj.fs) &&
+            (_clmt_entry[i].u16FsId == fp->obj.id) && (_clmt_entry[i].u32StartClust == fp->obj.sclust) &&
+            (_clmt_entry[i].u32Size == fp->obj.objsize))
+            return &_clmt_entry[i];
+    }
+    return NULL;
+}
+
+/* Get a free entry. Unused maps are dropped oldest first, pre-built ones last. */
+static CLMT_ENTRY_T *clmt_alloc(void)
+{
+    CLMT_ENTRY_T  *pVictim = NULL, *pEntry;
+    int  i;
+
+    for (i = 0; i < CLMT_CACHE_MAPS; i++)
+    {
+        pEntry = &_clmt_entry[i];
+        if (pEntry->pu32Tbl == NULL)
+            return pEntry;
+        if (pEntry->u32Refs != 0)
+            continue;
+        if ((pVictim == NULL) || (pVictim->bPinned && !pEntry->bPinned) ||
+            ((pVictim->bPinned == pEntry->bPinned) && ((INT32)(pEntry->u32LastUse - pVictim->u32LastUse) < 0)))
+            pVictim = pEntry;
+    }
+
+    if (pVictim != NULL)
+    {
+        clmt_free(pVictim);
+        _clmt_stat.u32Evictions++;
+    }
+    return pVictim;
+}
+
+/* Build the link map of fp into pEntry, growing the table until it fits. */
+static FRESULT clmt_build(FIL *fp, CLMT_ENTRY_T *pEntry)
+{
+    DWORD    *tbl, *ntbl;
+    DWORD    items = CLMT_CACHE_INIT_ITEMS;
+    FRESULT  res;
+
+    tbl = (DWORD *)malloc(items * sizeof(DWORD));
+    if (tbl == NULL)
+        return FR_NOT_ENOUGH_CORE;
+
+    while (1)
+    {
+        tbl[0] = items;
+        fp->cltbl = tbl;
+        res = f_lseek(fp, CREATE_LINKMAP);
+        if (res != FR_NOT_ENOUGH_CORE)
+            break;
+
+        /* f_lseek() reports the required size in tbl[0]. */
+        items = tbl[0];
+        ntbl = (DWORD *)realloc(tbl, items * sizeof(DWORD));
+        if (ntbl == NULL)
+            break;
+        tbl = ntbl;
+        _clmt_stat.u32Grows++;
+    }
+
+    if (res != FR_OK)
+    {
+        fp->cltbl = NULL;
+        free(tbl);
+        return res;
+    }
+
+    pEntry->pu32Tbl = tbl;
+    pEntry->pFs = fp->obj.fs;
+    pEntry->u16FsId = fp->obj.id;
+    pEntry->u32StartClust = fp->obj.sclust;
+    pEntry->u32Size = fp->obj.objsize;
+    pEntry->u32Refs = 0;
+    pEntry->bPinned = FALSE;
+
+    _clmt_stat.u32Builds++;
+    if (items > _clmt_stat.u32MaxItems)
+        _clmt_stat.u32MaxItems = items;
+    return FR_OK;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Open a file and put it in fast seek mode.
+ *
+ *  @param[out]  fp    File object.
+ *  @param[in]   path  File name.
+ *  @param[in]   mode  Access mode as f_open(). Files opened with FA_WRITE get no link map.
+ *
+ *  @return  Result of f_open(). A file that cannot get a link map stays open in normal seek mode.
+ */
+FRESULT clmt_open(FIL *fp, const TCHAR *path, BYTE mode)
+{
+    FRESULT  res;
+
+    res = f_open(fp, path, mode);
+    if ((res != FR_OK) || (mode & FA_WRITE))
+        return res;
+
+    clmt_attach(fp);
+    return FR_OK;
+}
+
+/**
+ *  @brief  Release the link map of a file and close it.
+ *
+ *  @param[in]  fp  File object opened by \ref clmt_open.
+ *
+ *  @return  Result of f_close().
+ */
+FRESULT clmt_close(FIL *fp)
+{
+    clmt_detach(fp);
+    return f_close(fp);
+}
+
+/**
+ *  @brief  Put an open file in fast seek mode.
+ *
+ *  @param[in]  fp  File object opened for reading.
+ *
+ *  @return  FR_OK, FR_NOT_ENOUGH_CORE if no map could be allocated, or an f_lseek() error.
+ *
+ *  @note  A map already built for the same file is shared instead of walking the FAT chain again.
+ */
+FRESULT clmt_attach(FIL *fp)
+{
+    CLMT_ENTRY_T  *pEntry;
+    FRESULT  res;
+
+    if (fp->cltbl != NULL)
+        return FR_OK;
+
+    if (fp->obj.sclust == 0)
+        return FR_OK;       /* empty file, nothing to map */
+
+    pEntry = clmt_find(fp);
+    if (pEntry != NULL)
+    {
+        fp->cltbl = pEntry->pu32Tbl;
+        _clmt_stat.u32Reuses++;
+    }
+    else
+    {
+        pEntry = clmt_alloc();
+        if (pEntry == NULL)
+            return FR_NOT_ENOUGH_CORE;
+
+        res = clmt_build(fp, pEntry);
+        if (res != FR_OK)
+            return res;
+    }
+
+    pEntry->u32Refs++;
+    pEntry->u32LastUse = ++_clmt_tick;
+    return FR_OK;
+}
+
+/**
+ *  @brief  Take a file out of fast seek mode.
+ *
+ *  @param[in]  fp  File object.
+ *
+ *  @return None
+ *
+ *  @note  The map is kept for a later open of the same file until its entry is needed.
+ */
+void clmt_detach(FIL *fp)
+{
+    int  i;
+
+    if (fp->cltbl == NULL)
+        return;
+
+    for (i = 0; i < CLMT_CACHE_MAPS; i++)
+    {
+        if ((_clmt_entry[i].pu32Tbl == fp->cltbl) && (_clmt_entry[i].u32Refs > 0))
+        {
+            _clmt_entry[i].u32Refs--;
+            break;
+        }
+    }
+    fp->cltbl = NULL;
+}
+
+/**
+ *  @brief  Build the link map of a file ahead of time, e.g. for the next files of a playlist.
+ *
+ *  @param[in]  path  File name.
+ *
+ *  @return  FR_OK, or an f_open()/f_lseek() error.
+ *
+ *  @note  Pre-built maps are dropped after the other unused maps when entries run out.
+ */
+FRESULT clmt_prebuild(const TCHAR *path)
+{
+    CLMT_ENTRY_T  *pEntry;
+    FIL      fil;
+    FRESULT  res;
+    int      i;
+
+    res = f_open(&fil, path, FA_OPEN_EXISTING | FA_READ);
+    if (res != FR_OK)
+        return res;
+
+    res = clmt_attach(&fil);
+    if ((res == FR_OK) && (fil.cltbl != NULL))
+    {
+        for (i = 0, pEntry = _clmt_entry; i < CLMT_CACHE_MAPS; i++, pEntry++)
+        {
+            if (pEntry->pu32Tbl == fil.cltbl)
+                pEntry->bPinned = TRUE;
+        }
+    }
+
+    clmt_detach(&fil);
+    f_close(&fil);
+    return res;
+}
+
+/**
+ *  @brief  Drop all link maps that are not used by an open file.
+ *
+ *  @return None
+ *
+ *  @note  Call it after unmounting a volume, or after rewriting a file that has a pre-built map.
+ */
+void clmt_purge(void)
+{
+    int  i;
+
+    for (i = 0; i < CLMT_CACHE_MAPS; i++)
+    {
+        if ((_clmt_entry[i].pu32Tbl != NULL) && (_clmt_entry[i].u32Refs == 0))
+            clmt_free(&_clmt_entry[i]);
+    }
+}
+
+/**
+ *  @brief  Get link map cache statistics.
+ *
+ *  @param[out]  pStat  Statistics counters.
+ *
+ *  @return None
+ */
+void clmt_get_stat(CLMT_STAT_T *pStat)
+{
+    memcpy(pStat, &_clmt_stat, sizeof(CLMT_STAT_T));
+}
+
+/*@}*/ /* end of group N9H31_CLMT_CACHE_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,702 @@
+/**************************************************************************//**
+ * @file     disk_cache.c
+ * @brief    Sector cache with read-ahead and write-back for the FatFs block layer
+ *
+ *           The cache sits between disk_read()/disk_write() and the media
+ *           functions of each drive. Small requests, which are FAT, directory
+ *           and partial-sector accesses, are served from a pool of LRU lines
+ *           shared by all drives. A miss that continues the previous read of
+ *           the same drive loads a larger read-ahead window instead of a line.
+ *           Writes are held in the lines until the line is evicted or FatFs
+ *           issues CTRL_SYNC; dirty sectors that are contiguous on the media
+ *           are then written with one command. Large requests bypass the cache.
+ *
+ *           The line and read-ahead pools are cacheable, so hits are copied at
+ *           cached speed. Media transfers go through the non-cacheable alias of
+ *           the pool after the D-cache is cleaned (write) or invalidated (read)
+ *           for the sectors concerned, so the media functions DMA directly.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "disk_cache.h"
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_DISK_CACHE_EXPORTED_FUNCTIONS Disk Cache Exported Functions
+  @{
+*/
+/// @cond HIDDEN_SYMBOLS
+
+#if (DISK_CACHE_LINE_SECTORS < 1) || (DISK_CACHE_LINE_SECTORS > 32)
+#error "DISK_CACHE_LINE_SECTORS must be 1 ~ 32"
+#endif
+
+#define DISK_CACHE_LINE_SIZE    (DISK_CACHE_LINE_SECTORS * DISK_CACHE_SECTOR_SIZE)
+#define DISK_CACHE_LINE_MASK    ((DISK_CACHE_LINE_SECTORS == 32) ? 0xFFFFFFFF : ((1UL << DISK_CACHE_LINE_SECTORS) - 1))
+#define DISK_CACHE_FREE         0xFF
+#define DISK_CACHE_NONCACHE_BIT 0x80000000
+
+/* The read-ahead window doubles as the gather buffer for write-back across lines. */
+#define DISK_CACHE_GATHER       (DISK_CACHE_RA_SECTORS >= 2 * DISK_CACHE_LINE_SECTORS)
+
+typedef struct disk_cache_line_t
+{
+    DWORD   u32Sector;          /* first sector, multiple of DISK_CACHE_LINE_SECTORS */
+    UINT32  u32Valid;           /* one bit per sector */
+    UINT32  u32Dirty;           /* one bit per sector, always a subset of u32Valid */
+    UINT32  u32LastUse;
+    BYTE    u8Drv;              /* DISK_CACHE_FREE if unused */
+} DISK_CACHE_LINE_T;
+
+typedef struct disk_cache_drv_t
+{
+    DISK_CACHE_READ_FUNC    pfnRead;
+    DISK_CACHE_WRITE_FUNC   pfnWrite;
+    DWORD                   u32NextSec;     /* sector following the last read */
+    DISK_CACHE_STAT_T       stat;
+} DISK_CACHE_DRV_T;
+
+#ifdef __ICCARM__
+#pragma data_alignment = 32
+static BYTE  _dc_line_pool[DISK_CACHE_LINES * DISK_CACHE_LINE_SIZE];
+#else
+static BYTE  _dc_line_pool[DISK_CACHE_LINES * DISK_CACHE_LINE_SIZE] __attribute__((aligned(32)));
+#endif
+
+#if DISK_CACHE_RA_SECTORS > 0
+#ifdef __ICCARM__
+#pragma data_alignment = 32
+static BYTE  _dc_ra_pool[DISK_CACHE_RA_SECTORS * DISK_CACHE_SECTOR_SIZE];
+#else
+static BYTE  _dc_ra_pool[DISK_CACHE_RA_SECTORS * DISK_CACHE_SECTOR_SIZE] __attribute__((aligned(32)));
+#endif
+
+static BYTE   _dc_ra_drv = DISK_CACHE_FREE;
+static DWORD  _dc_ra_sector;
+static UINT   _dc_ra_count;
+#endif
+
+static DISK_CACHE_LINE_T  _dc_lines[DISK_CACHE_LINES];
+static DISK_CACHE_DRV_T   _dc_drv[DISK_CACHE_DRIVES];
+static UINT32             _dc_tick;
+static BOOL               _dc_init = FALSE;
+
+static void disk_cache_init(void)
+{
+    int  i;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+        _dc_lines[i].u8Drv = DISK_CACHE_FREE;
+    _dc_init = TRUE;
+}
+
+static BYTE *disk_cache_line_buff(int idx)
+{
+    return _dc_line_pool + idx * DISK_CACHE_LINE_SIZE;
+}
+
+#if DISK_CACHE_RA_SECTORS > 0
+static BYTE *disk_cache_ra_buff(void)
+{
+    return _dc_ra_pool;
+}
+#endif
+
+/*
+ * Media access to a pool buffer. Sectors are 32-byte aligned in the pools, so
+ * the maintenance never touches a D-cache line shared with other sectors.
+ */
+static DRESULT disk_cache_media_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    sysInvalidateDcache((UINT32)buff, count * DISK_CACHE_SECTOR_SIZE);
+    return _dc_drv[pdrv].pfnRead(pdrv, (BYTE *)((UINT32)buff | DISK_CACHE_NONCACHE_BIT), sector, count);
+}
+
+static DRESULT disk_cache_media_write(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    sysCleanDcache((UINT32)buff, count * DISK_CACHE_SECTOR_SIZE);
+    return _dc_drv[pdrv].pfnWrite(pdrv, (BYTE *)((UINT32)buff | DISK_CACHE_NONCACHE_BIT), sector, count);
+}
+
+#if DISK_CACHE_RA_SECTORS > 0
+
+static void disk_cache_ra_drop(BYTE pdrv, DWORD sector, UINT count)
+{
+    if ((_dc_ra_drv == pdrv) && (sector < _dc_ra_sector + _dc_ra_count) && (_dc_ra_sector < sector + count))
+        _dc_ra_drv = DISK_CACHE_FREE;
+}
+#endif
+
+static int disk_cache_find(BYTE pdrv, DWORD lineSec)
+{
+    int  i;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+    {
+        if ((_dc_lines[i].u8Drv == pdrv) && (_dc_lines[i].u32Sector == lineSec))
+            return i;
+    }
+    return -1;
+}
+
+/* Length of the run of set bits in mask starting at bit first. */
+static UINT disk_cache_run(UINT32 mask, UINT first)
+{
+    UINT  len = 0;
+
+    while ((first + len < DISK_CACHE_LINE_SECTORS) && (mask & (1UL << (first + len))))
+        len++;
+    return len;
+}
+
+static UINT disk_cache_first(UINT32 mask)
+{
+    UINT  i = 0;
+
+    while (!(mask & (1UL << i)))
+        i++;
+    return i;
+}
+
+static DRESULT disk_cache_write_run(int idx, UINT first, UINT len)
+{
+    DISK_CACHE_LINE_T  *pLine = &_dc_lines[idx];
+    DISK_CACHE_DRV_T   *pDrv = &_dc_drv[pLine->u8Drv];
+    UINT32  mask;
+
+    if (disk_cache_media_write(pLine->u8Drv, disk_cache_line_buff(idx) + first * DISK_CACHE_SECTOR_SIZE,
+                               pLine->u32Sector + first, len) != RES_OK)
+        return RES_ERROR;
+
+    mask = (len == 32) ? 0xFFFFFFFF : (((1UL << len) - 1) << first);
+    pLine->u32Dirty &= ~mask;
+    pDrv->stat.u32WriteBacks++;
+    pDrv->stat.u32WriteBackSectors += len;
+    return RES_OK;
+}
+
+static DRESULT disk_cache_flush_line(int idx)
+{
+    UINT  first;
+
+    while (_dc_lines[idx].u32Dirty)
+    {
+        first = disk_cache_first(_dc_lines[idx].u32Dirty);
+        if (disk_cache_write_run(idx, first, disk_cache_run(_dc_lines[idx].u32Dirty, first)) != RES_OK)
+            return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+#if DISK_CACHE_GATHER
+/*
+ * The first dirty run of line idx ends at the line boundary and the next line
+ * starts dirty. Copy the run through the following lines into the read-ahead
+ * window and write it with a single command.
+ */
+static DRESULT disk_cache_gather_write(int idx, UINT first)
+{
+    BYTE     pdrv = _dc_lines[idx].u8Drv;
+    BYTE     *ra = disk_cache_ra_buff();
+    DWORD    sector = _dc_lines[idx].u32Sector + first;
+    int      lineIdx[DISK_CACHE_LINES];
+    UINT32   lineMask[DISK_CACHE_LINES];
+    int      nLines = 0, i;
+    UINT     n = 0, len;
+
+    _dc_ra_drv = DISK_CACHE_FREE;
+
+    len = DISK_CACHE_LINE_SECTORS - first;
+    while (1)
+    {
+        memcpy(ra + n * DISK_CACHE_SECTOR_SIZE, disk_cache_line_buff(idx) + first * DISK_CACHE_SECTOR_SIZE,
+               len * DISK_CACHE_SECTOR_SIZE);
+        lineIdx[nLines] = idx;
+        lineMask[nLines] = ((len == 32) ? 0xFFFFFFFF : ((1UL << len) - 1)) << first;
+        nLines++;
+        n += len;
+
+        if (first + len < DISK_CACHE_LINE_SECTORS)
+            break;      /* run ends inside this line */
+
+        idx = disk_cache_find(pdrv, _dc_lines[idx].u32Sector + DISK_CACHE_LINE_SECTORS);
+        if ((idx < 0) || !(_dc_lines[idx].u32Dirty & 1) || (n >= DISK_CACHE_RA_SECTORS))
+            break;
+
+        first = 0;
+        len = disk_cache_run(_dc_lines[idx].u32Dirty, 0);
+        if (len > DISK_CACHE_RA_SECTORS - n)
+            len = DISK_CACHE_RA_SECTORS - n;
+    }
+
+    if (disk_cache_media_write(pdrv, ra, sector, n) != RES_OK)
+        return RES_ERROR;
+
+    for (i = 0; i < nLines; i++)
+        _dc_lines[lineIdx[i]].u32Dirty &= ~lineMask[i];
+
+    _dc_drv[pdrv].stat.u32WriteBacks++;
+    _dc_drv[pdrv].stat.u32WriteBackSectors += n;
+    return RES_OK;
+}
+#endif
+
+/* Write back dirty lines of a drive in ascending sector order. */
+static DRESULT disk_cache_flush_drive(BYTE pdrv)
+{
+    DISK_CACHE_LINE_T  *pLine;
+    int     i, idx;
+    UINT    first, len;
+    DRESULT res;
+
+    while (1)
+    {
+        idx = -1;
+        for (i = 0; i < DISK_CACHE_LINES; i++)
+        {
+            if ((_dc_lines[i].u8Drv == pdrv) && _dc_lines[i].u32Dirty &&
+                ((idx < 0) || (_dc_lines[i].u32Sector < _dc_lines[idx].u32Sector)))
+                idx = i;
+        }
+        if (idx < 0)
+            return RES_OK;
+
+        pLine = &_dc_lines[idx];
+        first = disk_cache_first(pLine->u32Dirty);
+        len = disk_cache_run(pLine->u32Dirty, first);
+
+#if DISK_CACHE_GATHER
+        i = disk_cache_find(pdrv, pLine->u32Sector + DISK_CACHE_LINE_SECTORS);
+        if ((first + len == DISK_CACHE_LINE_SECTORS) && (i >= 0) && (_dc_lines[i].u32Dirty & 1))
+            res = disk_cache_gather_write(idx, first);
+        else
+#endif
+            res = disk_cache_write_run(idx, first, len);
+
+        if (res != RES_OK)
+            return res;
+    }
+}
+
+/* Write back dirty lines overlapping a sector range before the media is accessed directly. */
+static DRESULT disk_cache_flush_range(BYTE pdrv, DWORD sector, UINT count)
+{
+    int  i;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+    {
+        if ((_dc_lines[i].u8Drv == pdrv) && _dc_lines[i].u32Dirty &&
+            (_dc_lines[i].u32Sector < sector + count) &&
+            (sector < _dc_lines[i].u32Sector + DISK_CACHE_LINE_SECTORS))
+        {
+            if (disk_cache_flush_line(i) != RES_OK)
+                return RES_ERROR;
+        }
+    }
+    return RES_OK;
+}
+
+/* Forget cached copies of a sector range that is about to be overwritten on the media. */
+static void disk_cache_drop_range(BYTE pdrv, DWORD sector, UINT count)
+{
+    DISK_CACHE_LINE_T  *pLine;
+    int     i;
+    UINT    s;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+    {
+        pLine = &_dc_lines[i];
+        if ((pLine->u8Drv != pdrv) || (pLine->u32Sector >= sector + count) ||
+            (sector >= pLine->u32Sector + DISK_CACHE_LINE_SECTORS))
+            continue;
+
+        for (s = 0; s < DISK_CACHE_LINE_SECTORS; s++)
+        {
+            if ((pLine->u32Sector + s >= sector) && (pLine->u32Sector + s < sector + count))
+            {
+                pLine->u32Valid &= ~(1UL << s);
+                pLine->u32Dirty &= ~(1UL << s);
+            }
+        }
+        if (pLine->u32Valid == 0)
+            pLine->u8Drv = DISK_CACHE_FREE;
+    }
+#if DISK_CACHE_RA_SECTORS > 0
+    disk_cache_ra_drop(pdrv, sector, count);
+#endif
+}
+
+/* Get a line for lineSec, evicting the least recently used one if needed. */
+static int disk_cache_alloc(BYTE pdrv, DWORD lineSec)
+{
+    int  i, idx = -1;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+    {
+        if (_dc_lines[i].u8Drv == DISK_CACHE_FREE)
+        {
+            idx = i;
+            break;
+        }
+        if ((idx < 0) || ((INT32)(_dc_lines[i].u32LastUse - _dc_lines[idx].u32LastUse) < 0))
+            idx = i;
+    }
+
+    if (_dc_lines[idx].u8Drv != DISK_CACHE_FREE)
+    {
+        if (disk_cache_flush_line(idx) != RES_OK)
+            return -1;
+        _dc_drv[_dc_lines[idx].u8Drv].stat.u32Evictions++;
+    }
+
+    _dc_lines[idx].u8Drv = pdrv;
+    _dc_lines[idx].u32Sector = lineSec;
+    _dc_lines[idx].u32Valid = 0;
+    _dc_lines[idx].u32Dirty = 0;
+    return idx;
+}
+
+/* Return the cached copy of a sector, or NULL on a miss. */
+static BYTE *disk_cache_lookup(BYTE pdrv, DWORD sector)
+{
+    DWORD   lineSec = sector - sector % DISK_CACHE_LINE_SECTORS;
+    UINT    s = sector - lineSec;
+    int     idx;
+
+    idx = disk_cache_find(pdrv, lineSec);
+    if ((idx >= 0) && (_dc_lines[idx].u32Valid & (1UL << s)))
+    {
+        _dc_lines[idx].u32LastUse = ++_dc_tick;
+        return disk_cache_line_buff(idx) + s * DISK_CACHE_SECTOR_SIZE;
+    }
+
+#if DISK_CACHE_RA_SECTORS > 0
+    if ((_dc_ra_drv == pdrv) && (sector >= _dc_ra_sector) && (sector < _dc_ra_sector + _dc_ra_count))
+    {
+        _dc_drv[pdrv].stat.u32ReadAheadHits++;
+        return disk_cache_ra_buff() + (sector - _dc_ra_sector) * DISK_CACHE_SECTOR_SIZE;
+    }
+#endif
+    return NULL;
+}
+
+/* Load the line holding sector from the media and return the sector's copy. */
+static BYTE *disk_cache_fill(BYTE pdrv, DWORD sector)
+{
+    DWORD   lineSec = sector - sector % DISK_CACHE_LINE_SECTORS;
+    UINT    s = sector - lineSec;
+    BYTE    *buff;
+    int     idx;
+
+    idx = disk_cache_find(pdrv, lineSec);
+    if (idx < 0)
+    {
+        idx = disk_cache_alloc(pdrv, lineSec);
+        if (idx < 0)
+            return NULL;
+    }
+    buff = disk_cache_line_buff(idx);
+
+    /*
+     * An empty line is loaded as a whole. A line that already holds written
+     * sectors only gets the missing one, and so does the last line of a
+     * medium whose size is not a multiple of the line.
+     */
+    if ((_dc_lines[idx].u32Valid != 0) ||
+        (disk_cache_media_read(pdrv, buff, lineSec, DISK_CACHE_LINE_SECTORS) != RES_OK))
+    {
+        if (disk_cache_media_read(pdrv, buff + s * DISK_CACHE_SECTOR_SIZE, sector, 1) != RES_OK)
+        {
+            if (_dc_lines[idx].u32Valid == 0)
+                _dc_lines[idx].u8Drv = DISK_CACHE_FREE;
+            return NULL;
+        }
+        _dc_lines[idx].u32Valid |= (1UL << s);
+    }
+    else
+    {
+        _dc_lines[idx].u32Valid = DISK_CACHE_LINE_MASK;
+    }
+
+    _dc_lines[idx].u32LastUse = ++_dc_tick;
+    return buff + s * DISK_CACHE_SECTOR_SIZE;
+}
+
+#if DISK_CACHE_RA_SECTORS > 0
+/* Load the read-ahead window starting at sector and return the sector's copy. */
+static BYTE *disk_cache_read_ahead(BYTE pdrv, DWORD sector)
+{
+    _dc_ra_drv = DISK_CACHE_FREE;
+
+    if (disk_cache_media_read(pdrv, disk_cache_ra_buff(), sector, DISK_CACHE_RA_SECTORS) != RES_OK)
+        return NULL;    /* may run past the end of the medium, caller falls back to a line fill */
+
+    _dc_ra_drv = pdrv;
+    _dc_ra_sector = sector;
+    _dc_ra_count = DISK_CACHE_RA_SECTORS;
+    _dc_drv[pdrv].stat.u32ReadAheadFills++;
+    return disk_cache_ra_buff();
+}
+#endif
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Attach the media functions of a drive to the cache.
+ *
+ *  @param[in]  pdrv      Physical drive number. Must be less than \ref DISK_CACHE_DRIVES.
+ *  @param[in]  pfnRead   Media read function.
+ *  @param[in]  pfnWrite  Media write function.
+ *
+ *  @return None
+ *
+ *  @note  Any data cached for the drive is discarded. Call it from disk_initialize().
+ */
+void disk_cache_attach(BYTE pdrv, DISK_CACHE_READ_FUNC pfnRead, DISK_CACHE_WRITE_FUNC pfnWrite)
+{
+    if (pdrv >= DISK_CACHE_DRIVES)
+        return;
+
+    if (!_dc_init)
+        disk_cache_init();
+
+    disk_cache_invalidate(pdrv);
+    _dc_drv[pdrv].pfnRead = pfnRead;
+    _dc_drv[pdrv].pfnWrite = pfnWrite;
+}
+
+/**
+ *  @brief  Discard all data cached for a drive without writing it back.
+ *
+ *  @param[in]  pdrv  Physical drive number.
+ *
+ *  @return None
+ *
+ *  @note  Use it when the medium has been removed or replaced.
+ */
+void disk_cache_invalidate(BYTE pdrv)
+{
+    int  i;
+
+    if ((pdrv >= DISK_CACHE_DRIVES) || !_dc_init)
+        return;
+
+    for (i = 0; i < DISK_CACHE_LINES; i++)
+    {
+        if (_dc_lines[i].u8Drv == pdrv)
+            _dc_lines[i].u8Drv = DISK_CACHE_FREE;
+    }
+#if DISK_CACHE_RA_SECTORS > 0
+    if (_dc_ra_drv == pdrv)
+        _dc_ra_drv = DISK_CACHE_FREE;
+#endif
+    _dc_drv[pdrv].u32NextSec = 0xFFFFFFFF;
+}
+
+/**
+ *  @brief  Discard cached copies of a sector range without writing them back.
+ *
+ *  @param[in]  pdrv    Physical drive number.
+ *  @param[in]  sector  Start sector in LBA.
+ *  @param[in]  count   Number of sectors.
+ *
+ *  @return None
+ *
+ *  @note  Use it on CTRL_TRIM, or before sectors are written to the media around the cache.
+ */
+void disk_cache_discard(BYTE pdrv, DWORD sector, UINT count)
+{
+    if ((pdrv >= DISK_CACHE_DRIVES) || !_dc_init)
+        return;
+
+    disk_cache_drop_range(pdrv, sector, count);
+}
+
+/**
+ *  @brief  Read sectors through the cache.
+ *
+ *  @param[in]   pdrv    Physical drive number.
+ *  @param[out]  buff    Data buffer to store read data.
+ *  @param[in]   sector  Start sector in LBA.
+ *  @param[in]   count   Number of sectors to read.
+ *
+ *  @return  RES_OK, RES_ERROR, or RES_PARERR if the drive is not attached.
+ */
+DRESULT disk_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    DISK_CACHE_DRV_T  *pDrv;
+    BYTE    *src;
+    BOOL    bSeq;
+
+    if ((pdrv >= DISK_CACHE_DRIVES) || (_dc_drv[pdrv].pfnRead == NULL))
+        return RES_PARERR;
+
+    pDrv = &_dc_drv[pdrv];
+    bSeq = (sector == pDrv->u32NextSec);
+    pDrv->u32NextSec = sector + count;
+
+    if (count >= DISK_CACHE_BYPASS_SECTORS)
+    {
+        /* The media must see data still held dirty in the cache. */
+        if (disk_cache_flush_range(pdrv, sector, count) != RES_OK)
+            return RES_ERROR;
+
+        pDrv->stat.u32Bypass++;
+        return pDrv->pfnRead(pdrv, buff, sector, count);
+    }
+
+    while (count > 0)
+    {
+        src = disk_cache_lookup(pdrv, sector);
+        if (src != NULL)
+        {
+            pDrv->stat.u32ReadHits++;
+        }
+        else
+        {
+            pDrv->stat.u32ReadMisses++;
+#if DISK_CACHE_RA_SECTORS > 0
+            if (bSeq)
+                src = disk_cache_read_ahead(pdrv, sector);
+            if (src == NULL)
+#endif
+                src = disk_cache_fill(pdrv, sector);
+            if (src == NULL)
+                return RES_ERROR;
+        }
+
+        memcpy(buff, src, DISK_CACHE_SECTOR_SIZE);
+        buff += DISK_CACHE_SECTOR_SIZE;
+        sector++;
+        count--;
+    }
+    return RES_OK;
+}
+
+/**
+ *  @brief  Write sectors through the cache.
+ *
+ *  @param[in]  pdrv    Physical drive number.
+ *  @param[in]  buff    Data to be written.
+ *  @param[in]  sector  Start sector in LBA.
+ *  @param[in]  count   Number of sectors to write.
+ *
+ *  @return  RES_OK, RES_ERROR, or RES_PARERR if the drive is not attached.
+ *
+ *  @note  With \ref DISK_CACHE_WRITE_BACK set, small writes reach the media only
+ *         when their line is evicted or \ref disk_cache_sync is called.
+ */
+DRESULT disk_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    DISK_CACHE_DRV_T  *pDrv;
+    DWORD   lineSec;
+    UINT    s;
+    int     idx;
+
+    if ((pdrv >= DISK_CACHE_DRIVES) || (_dc_drv[pdrv].pfnWrite == NULL))
+        return RES_PARERR;
+
+    pDrv = &_dc_drv[pdrv];
+
+    if (!DISK_CACHE_WRITE_BACK || (count >= DISK_CACHE_BYPASS_SECTORS))
+    {
+        disk_cache_drop_range(pdrv, sector, count);
+        pDrv->stat.u32Bypass++;
+        return pDrv->pfnWrite(pdrv, buff, sector, count);
+    }
+
+#if DISK_CACHE_RA_SECTORS > 0
+    disk_cache_ra_drop(pdrv, sector, count);
+#endif
+
+    while (count > 0)
+    {
+        lineSec = sector - sector % DISK_CACHE_LINE_SECTORS;
+        s = sector - lineSec;
+
+        idx = disk_cache_find(pdrv, lineSec);
+        if (idx < 0)
+        {
+            idx = disk_cache_alloc(pdrv, lineSec);
+            if (idx < 0)
+                return RES_ERROR;
+        }
+        else if (_dc_lines[idx].u32Valid & (1UL << s))
+        {
+            pDrv->stat.u32WriteHits++;
+        }
+
+        memcpy(disk_cache_line_buff(idx) + s * DISK_CACHE_SECTOR_SIZE, buff, DISK_CACHE_SECTOR_SIZE);
+        _dc_lines[idx].u32Valid |= (1UL << s);
+        _dc_lines[idx].u32Dirty |= (1UL << s);
+        _dc_lines[idx].u32LastUse = ++_dc_tick;
+
+        buff += DISK_CACHE_SECTOR_SIZE;
+        sector++;
+        count--;
+    }
+    return RES_OK;
+}
+
+/**
+ *  @brief  Write back all dirty sectors of a drive. Call it on CTRL_SYNC.
+ *
+ *  @param[in]  pdrv  Physical drive number.
+ *
+ *  @return  RES_OK, RES_ERROR, or RES_PARERR if the drive is not attached.
+ */
+DRESULT disk_cache_sync(BYTE pdrv)
+{
+    if ((pdrv >= DISK_CACHE_DRIVES) || (_dc_drv[pdrv].pfnWrite == NULL))
+        return RES_PARERR;
+
+    return disk_cache_flush_drive(pdrv);
+}
+
+/**
+ *  @brief  Get cache statistics of a drive.
+ *
+ *  @param[in]   pdrv   Physical drive number.
+ *  @param[out]  pStat  Statistics counters.
+ *
+ *  @return None
+ */
+void disk_cache_get_stat(BYTE pdrv, DISK_CACHE_STAT_T *pStat)
+{
+    if (pdrv < DISK_CACHE_DRIVES)
+        memcpy(pStat, &_dc_drv[pdrv].stat, sizeof(DISK_CACHE_STAT_T));
+}
+
+/**
+ *  @brief  Clear cache statistics of a drive.
+ *
+ *  @param[in]  pdrv  Physical drive number.
+ *
+ *  @return None
+ */
+void disk_cache_reset_stat(BYTE pdrv)
+{
+    if (pdrv < DISK_CACHE_DRIVES)
+        memset(&_dc_drv[pdrv].stat, 0, sizeof(DISK_CACHE_STAT_T));
+}
+
+/*@}*/ /* end of group N9H31_DISK_CACHE_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,289 @@
+/**************************************************************************//**
+ * @file     sd_diskio.c
+ * @brief    Zero-copy FatFs disk I/O layer for the SDH controller
+ *
+ *           SDH DMA is issued directly on the caller's buffer through its
+ *           non-cacheable alias after the D-cache has been cleaned or
+ *           invalidated for that range. The bounce buffer is only used for
+ *           buffers that are not word aligned, and for the first/last sector
+ *           of a read whose buffer is not cache line aligned, since those
+ *           sectors share a cache line with data that does not belong to
+ *           the caller. Bounced transfers are queued with SD_SubmitRequest()
+ *           on the two halves of the bounce buffer in turn, so copying one
+ *           chunk overlaps the DMA of the next.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "sdh.h"
+#include "sd_diskio.h"
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_SD_DISKIO_EXPORTED_FUNCTIONS SD Disk I/O Exported Functions
+  @{
+*/
+/// @cond HIDDEN_SYMBOLS
+
+#define SD_DISK_BOUNCE_SECTORS  (SD_DISK_BOUNCE_SIZE / SD_DISK_SECTOR_SIZE)
+#define SD_DISK_HALF_SECTORS    (SD_DISK_BOUNCE_SECTORS / 2)
+
+#ifdef __ICCARM__
+#pragma data_alignment = 32
+static BYTE  _sd_disk_bounce_pool[SD_DISK_BOUNCE_SIZE];     /* accessed through its non-cacheable alias only */
+#else
+static BYTE  _sd_disk_bounce_pool[SD_DISK_BOUNCE_SIZE] __attribute__((aligned(32)));     /* accessed through its non-cacheable alias only */
+#endif
+
+static SD_DISK_STAT_T  _sd_disk_stat;
+
+/* half 0 or 1 of the bounce buffer */
+static BYTE *sd_disk_bounce_buff(UINT half)
+{
+    return (BYTE *)(((UINT32)_sd_disk_bounce_pool + half * SD_DISK_HALF_SECTORS * SD_DISK_SECTOR_SIZE) | SD_DISK_NONCACHE_BIT);
+}
+
+/* queue a request, a request that cannot be queued completes at once with the error */
+static void sd_disk_submit(SD_REQ_T *pReq, UINT32 u32CardNum, BYTE *buff, DWORD sector, UINT count, int bIsWrite)
+{
+    unsigned int  status;
+
+    pReq->u32CardNum = u32CardNum;
+    pReq->pu8BufAddr = buff;
+    pReq->u32StartSec = sector;
+    pReq->u32SecCount = count;
+    pReq->bIsWrite = bIsWrite;
+    pReq->pfnCallback = NULL;
+    pReq->pvContext = NULL;
+
+    while ((status = SD_SubmitRequest(pReq)) == SD_REQ_QUEUE_FULL)
+        SD_ServiceQueue();
+
+    if (status != 0)
+        pReq->u32Status = status;
+}
+
+/*
+ * The two halves of the bounce buffer alternate, so the copy of one chunk
+ * overlaps the SDH DMA of the next.
+ */
+static DRESULT sd_disk_bounce_read(UINT32 u32CardNum, BYTE *buff, DWORD sector, UINT count)
+{
+    SD_REQ_T  req[2];
+    UINT      cnt[2], i = 0, j;
+    DRESULT   res = RES_OK;
+
+    cnt[0] = (count > SD_DISK_HALF_SECTORS) ? SD_DISK_HALF_SECTORS : count;
+    sd_disk_submit(&req[0], u32CardNum, sd_disk_bounce_buff(0), sector, cnt[0], FALSE);
+    sector += cnt[0];
+    count -= cnt[0];
+
+    while (cnt[i] > 0)
+    {
+        j = i ^ 1;
+        cnt[j] = (count > SD_DISK_HALF_SECTORS) ? SD_DISK_HALF_SECTORS : count;
+
+        if (cnt[j] > 0)
+        {
+            sd_disk_submit(&req[j], u32CardNum, sd_disk_bounce_buff(j), sector, cnt[j], FALSE);
+            sector += cnt[j];
+            count -= cnt[j];
+        }
+
+        if (SD_WaitRequest(&req[i]) != 0)
+        {
+            res = RES_ERROR;
+            count = 0;      /* only wait for the chunk already queued */
+        }
+
+        if (res == RES_OK)
+        {
+            memcpy(buff, sd_disk_bounce_buff(i), cnt[i] * SD_DISK_SECTOR_SIZE);
+
+            _sd_disk_stat.u32BytesCopied += cnt[i] * SD_DISK_SECTOR_SIZE;
+            _sd_disk_stat.u32BounceCount++;
+            buff += cnt[i] * SD_DISK_SECTOR_SIZE;
+        }
+        i = j;
+    }
+    return res;
+}
+
+static DRESULT sd_disk_bounce_write(UINT32 u32CardNum, const BYTE *buff, DWORD sector, UINT count)
+{
+    SD_REQ_T  req[2];
+    UINT      cnt, i = 0;
+    DRESULT   res = RES_OK;
+
+    req[0].u32Status = 0;
+    req[1].u32Status = 0;
+
+    while (count > 0)
+    {
+        cnt = (count > SD_DISK_HALF_SECTORS) ? SD_DISK_HALF_SECTORS : count;
+
+        /* the half written two chunks ago is free once that request is done */
+        if (SD_WaitRequest(&req[i]) != 0)
+        {
+            res = RES_ERROR;
+            break;
+        }
+
+        memcpy(sd_disk_bounce_buff(i), buff, cnt * SD_DISK_SECTOR_SIZE);
+        sd_disk_submit(&req[i], u32CardNum, sd_disk_bounce_buff(i), sector, cnt, TRUE);
+
+        _sd_disk_stat.u32BytesCopied += cnt * SD_DISK_SECTOR_SIZE;
+        _sd_disk_stat.u32BounceCount++;
+        buff += cnt * SD_DISK_SECTOR_SIZE;
+        sector += cnt;
+        count -= cnt;
+        i ^= 1;
+    }
+
+    if (SD_WaitRequest(&req[0]) != 0)
+        res = RES_ERROR;
+    if (SD_WaitRequest(&req[1]) != 0)
+        res = RES_ERROR;
+    return res;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Read sectors from SD card into a FatFs buffer without an intermediate copy.
+ *
+ *  @param[in]   u32CardNum  Select card: SD0 or SD1. ( \ref SD_PORT0 / \ref SD_PORT1)
+ *  @param[out]  buff        Data buffer to store read data. May be cacheable or non-cacheable.
+ *  @param[in]   sector      Start sector in LBA.
+ *  @param[in]   count       Number of sectors to read. Not limited by \ref SD_DISK_BOUNCE_SIZE.
+ *
+ *  @return  RES_OK or RES_ERROR.
+ */
+DRESULT sd_disk_read(UINT32 u32CardNum, BYTE *buff, DWORD sector, UINT count)
+{
+    UINT32  addr = (UINT32)buff;
+    UINT    edge;
+
+    outpw(REG_SDH_GCTL, SDH_GCTL_SDEN_Msk);
+
+    _sd_disk_stat.u32ReadSectors += count;
+
+    if (addr & SD_DISK_NONCACHE_BIT)
+    {
+        /* Caller already hands us a non-cacheable buffer. */
+        if (SD_Read(u32CardNum, buff, sector, count) != 0)
+            return RES_ERROR;
+
+        _sd_disk_stat.u32BytesDirect += count * SD_DISK_SECTOR_SIZE;
+        return RES_OK;
+    }
+
+    if (addr & 0x3)
+    {
+        /* SDH DMA cannot start from an unaligned address. */
+        return sd_disk_bounce_read(u32CardNum, buff, sector, count);
+    }
+
+    /*
+     * A sector size is a multiple of the cache line size, so the buffer end is
+     * misaligned exactly when its start is. In that case the first and the last
+     * sector go through the bounce buffer.
+     */
+    edge = (addr & (DEF_CACHE_LINE_SIZE - 1)) ? 1 : 0;
+
+    if (count <= 2 * edge)
+        return sd_disk_bounce_read(u32CardNum, buff, sector, count);
+
+    addr += edge * SD_DISK_SECTOR_SIZE;
+
+    sysInvalidateDcache(addr, (count - 2 * edge) * SD_DISK_SECTOR_SIZE);
+
+    if (SD_Read(u32CardNum, (BYTE *)(addr | SD_DISK_NONCACHE_BIT), sector + edge, count - 2 * edge) != 0)
+        return RES_ERROR;
+
+    _sd_disk_stat.u32BytesDirect += (count - 2 * edge) * SD_DISK_SECTOR_SIZE;
+
+    if (edge)
+    {
+        if (sd_disk_bounce_read(u32CardNum, buff, sector, 1) != RES_OK)
+            return RES_ERROR;
+
+        if (sd_disk_bounce_read(u32CardNum, buff + (count - 1) * SD_DISK_SECTOR_SIZE, sector + count - 1, 1) != RES_OK)
+            return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+/**
+ *  @brief  Write sectors to SD card from a FatFs buffer without an intermediate copy.
+ *
+ *  @param[in]  u32CardNum  Select card: SD0 or SD1. ( \ref SD_PORT0 / \ref SD_PORT1)
+ *  @param[in]  buff        Data to be written. May be cacheable or non-cacheable.
+ *  @param[in]  sector      Start sector in LBA.
+ *  @param[in]  count       Number of sectors to write. Not limited by \ref SD_DISK_BOUNCE_SIZE.
+ *
+ *  @return  RES_OK or RES_ERROR.
+ */
+DRESULT sd_disk_write(UINT32 u32CardNum, const BYTE *buff, DWORD sector, UINT count)
+{
+    UINT32  addr = (UINT32)buff;
+
+    outpw(REG_SDH_GCTL, SDH_GCTL_SDEN_Msk);
+
+    _sd_disk_stat.u32WriteSectors += count;
+
+    if (addr & 0x3)
+        return sd_disk_bounce_write(u32CardNum, buff, sector, count);
+
+    /* Cleaning never discards foreign data, so cache line alignment does not matter here. */
+    if (!(addr & SD_DISK_NONCACHE_BIT))
+        sysCleanDcache(addr, count * SD_DISK_SECTOR_SIZE);
+
+    if (SD_Write(u32CardNum, (BYTE *)(addr | SD_DISK_NONCACHE_BIT), sector, count) != 0)
+        return RES_ERROR;
+
+    _sd_disk_stat.u32BytesDirect += count * SD_DISK_SECTOR_SIZE;
+    return RES_OK;
+}
+
+/**
+ *  @brief  Get transfer statistics of the SD disk I/O layer.
+ *
+ *  @param[out]  pStat  Statistics counters.
+ *
+ *  @return None
+ */
+void sd_disk_get_stat(SD_DISK_STAT_T *pStat)
+{
+    memcpy(pStat, &_sd_disk_stat, sizeof(SD_DISK_STAT_T));
+}
+
+/**
+ *  @brief  Clear transfer statistics of the SD disk I/O layer.
+ *
+ *  @return None
+ */
+void sd_disk_reset_stat(void)
+{
+    memset(&_sd_disk_stat, 0, sizeof(SD_DISK_STAT_T));
+}
+
+/*@}*/ /* end of group N9H31_SD_DISKIO_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
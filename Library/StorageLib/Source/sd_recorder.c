@@ -0,0 +1,201 @@
+/**************************************************************************//**
+ * @file     sd_recorder.c
+ * @brief    Contiguous pre-allocated FatFs files written by raw SD sector streams
+ *
+ *           The file is allocated in one contiguous extent with f_expand() when
+ *           it is opened, so recorded data can be written to the card as raw
+ *           sector runs through an SD stream session. FatFs does not see these
+ *           writes: the FAT and the directory entry are only touched when the
+ *           file is opened and when it is closed, where the unused tail of the
+ *           extent is released and the file size is set.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "sdh.h"
+#include "sd_recorder.h"
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_SD_RECORDER_EXPORTED_FUNCTIONS SD Recorder Exported Functions
+  @{
+*/
+/// @cond HIDDEN_SYMBOLS
+
+#define SD_REC_SECTOR_SIZE      512
+#define SD_REC_NONCACHE_BIT     0x80000000
+
+static SD_INFO_T *sd_rec_info(UINT32 u32CardNum)
+{
+    return (u32CardNum == SD_PORT1) ? &SD1 : &SD0;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Create a recording file and reserve a contiguous extent for it.
+ *
+ *  @param[out]  pRec        Recording file object.
+ *  @param[in]   u32CardNum  SD port of the volume holding path. ( \ref SD_PORT0 / \ref SD_PORT1)
+ *  @param[in]   path        File name. An existing file is overwritten.
+ *  @param[in]   u32MaxSize  Largest size the recording may reach, in bytes.
+ *
+ *  @return  FR_OK, FR_DENIED if no contiguous free area is large enough, or another FatFs error.
+ *
+ *  @note  The extent is u32SecCount sectors from u32StartSec of pRec. Cached copies of it are
+ *         dropped with CTRL_TRIM, since the data is written around disk_write().
+ */
+FRESULT sd_rec_open(SD_REC_T *pRec, UINT32 u32CardNum, const TCHAR *path, FSIZE_t u32MaxSize)
+{
+    FATFS    *fs;
+    DWORD    range[2];
+    FRESULT  res;
+
+    memset(pRec, 0, sizeof(SD_REC_T));
+    pRec->u32CardNum = u32CardNum;
+
+    res = f_open(&pRec->fil, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK)
+        return res;
+
+    res = f_expand(&pRec->fil, u32MaxSize, 1);
+    if (res == FR_OK)
+        res = f_sync(&pRec->fil);   /* commit the allocation before any data goes out */
+
+    if (res != FR_OK)
+    {
+        f_close(&pRec->fil);
+        f_unlink(path);
+        return res;
+    }
+
+    fs = pRec->fil.obj.fs;
+    pRec->u32StartSec = fs->database + (pRec->fil.obj.sclust - 2) * fs->csize;
+    pRec->u32SecCount = (DWORD)((u32MaxSize + SD_REC_SECTOR_SIZE - 1) / SD_REC_SECTOR_SIZE);
+
+    range[0] = pRec->u32StartSec;
+    range[1] = pRec->u32StartSec + pRec->u32SecCount - 1;
+    disk_ioctl(fs->pdrv, CTRL_TRIM, range);
+
+    return FR_OK;
+}
+
+/**
+ *  @brief  Append sectors to a recording file.
+ *
+ *  @param[in]  pRec   Recording file object opened by \ref sd_rec_open.
+ *  @param[in]  buff   Data to be written. Word aligned, cacheable or non-cacheable.
+ *  @param[in]  count  Number of sectors to write.
+ *
+ *  @return  FR_OK, FR_INVALID_PARAMETER for an unaligned buffer, FR_DENIED if the extent is full,
+ *           or FR_DISK_ERR.
+ *
+ *  @note  The first call opens an SD stream session that keeps the card until \ref sd_rec_flush
+ *         or \ref sd_rec_close. Other accesses to the same card must wait until then.
+ */
+FRESULT sd_rec_write(SD_REC_T *pRec, const BYTE *buff, UINT count)
+{
+    SD_INFO_T  *pSD = sd_rec_info(pRec->u32CardNum);
+    UINT32  addr = (UINT32)buff;
+    UINT32  preErase = 0;
+
+    if (addr & 0x3)
+        return FR_INVALID_PARAMETER;
+
+    if (count > pRec->u32SecCount - pRec->u32WrittenSec)
+        return FR_DENIED;
+
+    outpw(REG_SDH_GCTL, SDH_GCTL_SDEN_Msk);
+
+    if (!pRec->bStreamOpen)
+    {
+        /*
+         * Tell an SD card how much is left so it can pre-erase. MMC takes the same
+         * count as a closed-ended transfer length, which a recording cannot promise.
+         */
+        if ((pSD->CardType == SD_TYPE_SD_HIGH) || (pSD->CardType == SD_TYPE_SD_LOW))
+            preErase = pRec->u32SecCount - pRec->u32WrittenSec;
+
+        if (SD_StreamOpen(&pRec->stream, pRec->u32CardNum, pRec->u32StartSec + pRec->u32WrittenSec, preErase, TRUE) != 0)
+            return FR_DISK_ERR;
+        pRec->bStreamOpen = TRUE;
+    }
+
+    if (!(addr & SD_REC_NONCACHE_BIT))
+        sysCleanDcache(addr, count * SD_REC_SECTOR_SIZE);
+
+    if (SD_StreamXfer(&pRec->stream, (unsigned char *)(addr | SD_REC_NONCACHE_BIT), count) != 0)
+        return FR_DISK_ERR;
+
+    pRec->u32WrittenSec += count;
+    return FR_OK;
+}
+
+/**
+ *  @brief  End the current stream session so that the card can be used by others.
+ *
+ *  @param[in]  pRec  Recording file object.
+ *
+ *  @return  FR_OK or FR_DISK_ERR.
+ *
+ *  @note  The next \ref sd_rec_write continues where the recording stopped.
+ */
+FRESULT sd_rec_flush(SD_REC_T *pRec)
+{
+    if (!pRec->bStreamOpen)
+        return FR_OK;
+
+    pRec->bStreamOpen = FALSE;
+    if (SD_StreamClose(&pRec->stream) != 0)
+        return FR_DISK_ERR;
+    return FR_OK;
+}
+
+/**
+ *  @brief  Finish a recording: release the unused tail of the extent and set the file size.
+ *
+ *  @param[in]  pRec     Recording file object.
+ *  @param[in]  u32Size  Final file size in bytes. Clipped to the sectors actually written.
+ *
+ *  @return  FR_OK or a FatFs error.
+ */
+FRESULT sd_rec_close(SD_REC_T *pRec, FSIZE_t u32Size)
+{
+    FRESULT  res, res2;
+
+    res = sd_rec_flush(pRec);
+
+    if (u32Size > (FSIZE_t)pRec->u32WrittenSec * SD_REC_SECTOR_SIZE)
+        u32Size = (FSIZE_t)pRec->u32WrittenSec * SD_REC_SECTOR_SIZE;
+
+    res2 = f_lseek(&pRec->fil, u32Size);
+    if (res2 == FR_OK)
+        res2 = f_truncate(&pRec->fil);
+    if (res == FR_OK)
+        res = res2;
+
+    res2 = f_close(&pRec->fil);
+    if (res == FR_OK)
+        res = res2;
+    return res;
+}
+
+/*@}*/ /* end of group N9H31_SD_RECORDER_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,228 @@
+/**************************************************************************//**
+ * @file     storage_bench.c
+ * @brief    Storage throughput and latency benchmark for FatFs diskio backends
+ *
+ *           A test moves the test area once, either in order or as the same
+ *           number of requests at random request-aligned positions. Raw block
+ *           tests call disk_read()/disk_write() of the drive, so they measure
+ *           whatever backend and cache the diskio layer of the application
+ *           is built with. File level tests go through f_read()/f_write() on
+ *           a test file. Writes are finished with CTRL_SYNC or f_close()
+ *           inside the measured time.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "storage_bench.h"
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_StorageLib Storage Library
+  @{
+*/
+
+/** @addtogroup N9H31_STORAGE_BENCH_EXPORTED_FUNCTIONS Storage Benchmark Exported Functions
+  @{
+*/
+/// @cond HIDDEN_SYMBOLS
+
+static const char *_sbench_name[SBENCH_TESTS] = { "seq write", "seq read", "rand write", "rand read" };
+
+static UINT32 sbench_rand(UINT32 *pu32Seed)
+{
+    *pu32Seed = *pu32Seed * 1103515245 + 12345;
+    return *pu32Seed >> 8;
+}
+
+static void sbench_account(SBENCH_RESULT_T *pResult, UINT32 u32Lat, UINT u32Sec)
+{
+    int  bin = 0;
+
+    while ((u32Lat >> bin) && (bin < SBENCH_HIST_BINS - 1))
+        bin++;
+    pResult->au32Hist[bin]++;
+
+    if ((pResult->u32Requests == 0) || (u32Lat < pResult->u32MinLat))
+        pResult->u32MinLat = u32Lat;
+    if (u32Lat > pResult->u32MaxLat)
+        pResult->u32MaxLat = u32Lat;
+
+    pResult->u32Requests++;
+    pResult->u32Sectors += u32Sec;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ *  @brief  Run one benchmark test.
+ *
+ *  @param[in]   pCfg     Benchmark setup.
+ *  @param[in]   i32Test  \ref SBENCH_SEQ_WRITE / \ref SBENCH_SEQ_READ / \ref SBENCH_RAND_WRITE / \ref SBENCH_RAND_READ
+ *  @param[out]  pResult  Test result, valid for the requests done before an error.
+ *
+ *  @return  FR_OK, FR_INVALID_PARAMETER, FR_DISK_ERR for a raw block error, or a FatFs error.
+ *
+ *  @note  A file level read test needs the test file written by a write test first.
+ */
+FRESULT sbench_run(const SBENCH_CFG_T *pCfg, INT32 i32Test, SBENCH_RESULT_T *pResult)
+{
+    FIL      fil;
+    FRESULT  res = FR_OK;
+    UINT32   u32Seed = pCfg->u32Seed;
+    UINT32   u32Start, u32Begin, u32Lat;
+    DWORD    u32Slots, u32Pos, i;
+    UINT     u32Bytes, u32Done;
+    BOOL     bIsWrite = ((i32Test == SBENCH_SEQ_WRITE) || (i32Test == SBENCH_RAND_WRITE));
+    BOOL     bIsRand = ((i32Test == SBENCH_RAND_WRITE) || (i32Test == SBENCH_RAND_READ));
+    BYTE     mode;
+
+    memset(pResult, 0, sizeof(SBENCH_RESULT_T));
+
+    if ((i32Test < 0) || (i32Test >= SBENCH_TESTS) || (pCfg->u32ReqSec == 0) ||
+        (pCfg->u32AreaSec < pCfg->u32ReqSec) || (pCfg->u32TicksPerSec == 0))
+        return FR_INVALID_PARAMETER;
+
+    u32Slots = pCfg->u32AreaSec / pCfg->u32ReqSec;
+    u32Bytes = pCfg->u32ReqSec * SBENCH_SECTOR_SIZE;
+
+    if (pCfg->pPath != NULL)
+    {
+        if (i32Test == SBENCH_SEQ_WRITE)
+            mode = FA_CREATE_ALWAYS | FA_WRITE;
+        else if (bIsWrite)
+            mode = FA_OPEN_ALWAYS | FA_WRITE;
+        else
+            mode = FA_OPEN_EXISTING | FA_READ;
+
+        res = f_open(&fil, pCfg->pPath, mode);
+        if (res != FR_OK)
+            return res;
+    }
+
+    u32Begin = sysGetTicks(pCfg->i32TimerNo);
+
+    for (i = 0; i < u32Slots; i++)
+    {
+        u32Pos = (bIsRand ? (sbench_rand(&u32Seed) % u32Slots) : i) * pCfg->u32ReqSec;
+        u32Start = sysGetTicks(pCfg->i32TimerNo);
+
+        if (pCfg->pPath == NULL)
+        {
+            if (bIsWrite)
+                res = (disk_write(pCfg->u8Drv, pCfg->pu8Buff, pCfg->u32StartSec + u32Pos, pCfg->u32ReqSec) == RES_OK) ? FR_OK : FR_DISK_ERR;
+            else
+                res = (disk_read(pCfg->u8Drv, pCfg->pu8Buff, pCfg->u32StartSec + u32Pos, pCfg->u32ReqSec) == RES_OK) ? FR_OK : FR_DISK_ERR;
+        }
+        else
+        {
+            if (bIsRand)
+                res = f_lseek(&fil, (FSIZE_t)u32Pos * SBENCH_SECTOR_SIZE);
+            if (res == FR_OK)
+            {
+                if (bIsWrite)
+                    res = f_write(&fil, pCfg->pu8Buff, u32Bytes, &u32Done);
+                else
+                    res = f_read(&fil, pCfg->pu8Buff, u32Bytes, &u32Done);
+                if ((res == FR_OK) && (u32Done != u32Bytes))
+                    res = bIsWrite ? FR_DENIED : FR_INVALID_OBJECT;    /* volume full / file too short */
+            }
+        }
+        if (res != FR_OK)
+            break;
+
+        u32Lat = sysGetTicks(pCfg->i32TimerNo) - u32Start;
+        sbench_account(pResult, u32Lat, pCfg->u32ReqSec);
+    }
+
+    if (pCfg->pPath != NULL)
+    {
+        if ((f_close(&fil) != FR_OK) && (res == FR_OK))
+            res = FR_DISK_ERR;
+    }
+    else if (bIsWrite && (res == FR_OK))
+    {
+        if (disk_ioctl(pCfg->u8Drv, CTRL_SYNC, NULL) != RES_OK)
+            res = FR_DISK_ERR;
+    }
+
+    pResult->u32Ticks = sysGetTicks(pCfg->i32TimerNo) - u32Begin;
+    if (pResult->u32Ticks != 0)
+    {
+        pResult->u32KBps = (UINT32)(((UINT64)pResult->u32Sectors * SBENCH_SECTOR_SIZE / 1024) * pCfg->u32TicksPerSec / pResult->u32Ticks);
+        pResult->u32Iops = (UINT32)((UINT64)pResult->u32Requests * pCfg->u32TicksPerSec / pResult->u32Ticks);
+    }
+    return res;
+}
+
+/**
+ *  @brief  Print the result of a test on the debug console.
+ *
+ *  @param[in]  pCfg     Benchmark setup the test was run with.
+ *  @param[in]  i32Test  Test that was run.
+ *  @param[in]  pResult  Test result.
+ *
+ *  @return None
+ */
+void sbench_report(const SBENCH_CFG_T *pCfg, INT32 i32Test, const SBENCH_RESULT_T *pResult)
+{
+    UINT32  u32TickUs = 1000000 / pCfg->u32TicksPerSec;
+    int     i;
+
+    sysprintf("%-10s %4d sec/req: %6d KB/s, %6d IOPS, latency %d ~ %d us (%d requests)\n",
+              _sbench_name[i32Test], pCfg->u32ReqSec, pResult->u32KBps, pResult->u32Iops,
+              pResult->u32MinLat * u32TickUs, pResult->u32MaxLat * u32TickUs, pResult->u32Requests);
+
+    for (i = 0; i < SBENCH_HIST_BINS; i++)
+    {
+        if (pResult->au32Hist[i] == 0)
+            continue;
+        if (i == 0)
+            sysprintf("    < %8d us : %d\n", u32TickUs, pResult->au32Hist[i]);
+        else if (i == SBENCH_HIST_BINS - 1)     /* catch-all bin */
+            sysprintf("   >= %8d us : %d\n", (1 << (i - 1)) * u32TickUs, pResult->au32Hist[i]);
+        else
+            sysprintf("    < %8d us : %d\n", (1 << i) * u32TickUs, pResult->au32Hist[i]);
+    }
+}
+
+/**
+ *  @brief  Run and report all tests: sequential write, sequential read, random write, random read.
+ *
+ *  @param[in]  pCfg  Benchmark setup.
+ *
+ *  @return  FR_OK, or the error of the first failed test.
+ */
+FRESULT sbench_run_all(const SBENCH_CFG_T *pCfg)
+{
+    SBENCH_RESULT_T  result;
+    FRESULT  res;
+    INT32    i;
+
+    for (i = 0; i < SBENCH_TESTS; i++)
+    {
+        res = sbench_run(pCfg, i, &result);
+        sbench_report(pCfg, i, &result);
+        if (res != FR_OK)
+        {
+            sysprintf("%s failed, rc=%d\n", _sbench_name[i], res);
+            return res;
+        }
+    }
+    return FR_OK;
+}
+
+/*@}*/ /* end of group N9H31_STORAGE_BENCH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_StorageLib */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
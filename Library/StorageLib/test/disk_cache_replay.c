@@ -0,0 +1,421 @@
+/*
+ * disk_cache_replay - host trace replay of the FatFs sector cache.
+ *
+ * Records the disk_read()/disk_write()/CTRL_SYNC trace that FatFs issues
+ * for a few workloads on a RAM disk, or reads traces from files, and
+ * replays each one against the RAM disk directly and through disk_cache.c.
+ * Reported are the media commands and sectors of both runs and the cache
+ * hit rate. Every replay is checked against a shadow copy of the disk:
+ * each read must return what was last written, and after the final sync
+ * the media must equal the shadow.
+ *
+ *   disk_cache_replay.sh [trace ...]
+ *
+ * A trace file has one command per line: "R <sector> <count>",
+ * "W <sector> <count>" or "S" for CTRL_SYNC.
+ *
+ * The last case swaps the card under the cache: dirty and clean sectors of
+ * the old card must not be served or written back once the removal path
+ * has called disk_cache_invalidate().
+ */
+
+#include "host.h"
+#include "ramdisk.h"
+
+/* the cache under test */
+#define memcpy  host_memcpy
+#define memset  host_memset
+#include "../Source/disk_cache.c"
+#undef memcpy
+#undef memset
+
+#define DISK_SECTORS    (32 * 1024)     /* 16 MB */
+#define MAX_OPS         (256 * 1024)
+#define MAX_XFER        256             /* sectors */
+
+typedef struct trace_op_t
+{
+    char    cOp;            /* 'R', 'W' or 'S' */
+    DWORD   u32Sector;
+    UINT    u32Count;
+} TRACE_OP_T;
+
+static TRACE_OP_T  trace[MAX_OPS];
+static UINT        trace_len;
+
+static BYTE  shadow[DISK_SECTORS * 512];   /* disk image the replays start from */
+static BYTE  after[DISK_SECTORS * 512];    /* disk image FatFs left, restored after the replays */
+static BYTE  xfer[MAX_XFER * 512] __attribute__((aligned(32)));
+
+/* trace recording under FatFs */
+
+static void record(char cOp, DWORD sector, UINT count)
+{
+    if (trace_len < MAX_OPS)
+    {
+        trace[trace_len].cOp = cOp;
+        trace[trace_len].u32Sector = sector;
+        trace[trace_len].u32Count = count;
+        trace_len++;
+    }
+}
+
+static DRESULT rec_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    record('R', sector, count);
+    return ram_disk_read(pdrv, buff, sector, count);
+}
+
+static DRESULT rec_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    record('W', sector, count);
+    return ram_disk_write(pdrv, buff, sector, count);
+}
+
+static DRESULT rec_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if (cmd == CTRL_SYNC)
+        record('S', 0, 0);
+    return RES_PARERR;
+}
+
+/* workloads */
+
+static BYTE  data[64 * 1024];
+
+/* many small files written in 512-byte pieces: FAT and directory traffic */
+static int wl_small_files(void)
+{
+    FIL   fil;
+    UINT  i, j, bw;
+    char  name[16];
+
+    f_mkdir("0:/small");
+    for (i = 0; i < 40; i++)
+    {
+        sprintf(name, "0:/small/f%02u", i);
+        if (f_open(&fil, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+            return -1;
+        for (j = 0; j < 8; j++)
+            f_write(&fil, data + j * 512, 512, &bw);
+        f_close(&fil);
+    }
+    return 0;
+}
+
+/* data logger: short records, each followed by f_sync() */
+static int wl_log_append(void)
+{
+    FIL   fil;
+    UINT  i, bw;
+
+    if (f_open(&fil, "0:/log.txt", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return -1;
+    for (i = 0; i < 1000; i++)
+    {
+        f_write(&fil, data + (i % 64) * 100, 100, &bw);
+        f_sync(&fil);
+    }
+    f_close(&fil);
+    return 0;
+}
+
+/* sequential read of a 2 MB file in 1 KB pieces */
+static int wl_seq_read(void)
+{
+    FIL   fil;
+    UINT  br;
+    static BYTE  buf[1024];
+
+    if (f_open(&fil, "0:/big.bin", FA_READ) != FR_OK)
+        return -1;
+    while ((f_read(&fil, buf, sizeof(buf), &br) == FR_OK) && (br == sizeof(buf)))
+        ;
+    f_close(&fil);
+    return 0;
+}
+
+/* 2000 reads of 64 bytes at random offsets of the same file */
+static int wl_random_read(void)
+{
+    FIL   fil;
+    UINT  i, br;
+    BYTE  buf[64];
+
+    if (f_open(&fil, "0:/big.bin", FA_READ) != FR_OK)
+        return -1;
+    srand(1);
+    for (i = 0; i < 2000; i++)
+    {
+        f_lseek(&fil, (FSIZE_t)(rand() % (2 * 1024 * 1024 - 64)));
+        f_read(&fil, buf, sizeof(buf), &br);
+    }
+    f_close(&fil);
+    return 0;
+}
+
+static int make_big_file(void)
+{
+    FIL   fil;
+    UINT  i, bw;
+
+    if (f_open(&fil, "0:/big.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return -1;
+    for (i = 0; i < 32; i++)
+        f_write(&fil, data, sizeof(data), &bw);
+    f_close(&fil);
+    return 0;
+}
+
+/* replay */
+
+static void pattern(BYTE *buff, DWORD sector, UINT count, UINT op)
+{
+    UINT  i;
+
+    for (i = 0; i < count * 512; i += 4)
+        *(UINT32 *)(buff + i) = (sector + i / 512) * 0x9E3779B1u + op + i;
+}
+
+typedef struct replay_stat_t
+{
+    UINT32  u32Cmds;
+    UINT32  u32Sectors;
+    UINT32  u32Usec;
+    UINT32  u32Bad;
+} REPLAY_STAT_T;
+
+static void replay(int bCached, REPLAY_STAT_T *pStat)
+{
+    UINT  i, n;
+    DRESULT res;
+    BYTE  *image;
+
+    /* every run starts from the same disk image */
+    memcpy(ram_disk_data(0), shadow, sizeof(shadow));
+    memset(&ram_disk_stat, 0, sizeof(ram_disk_stat));
+    memset(pStat, 0, sizeof(*pStat));
+    if (bCached)
+    {
+        disk_cache_attach(0, ram_disk_read, ram_disk_write);
+        disk_cache_reset_stat(0);
+    }
+
+    /* the shadow copy follows the writes of this run */
+    image = malloc(sizeof(shadow));
+    memcpy(image, shadow, sizeof(shadow));
+
+    pStat->u32Usec = host_usec();
+    for (i = 0; i < trace_len; i++)
+    {
+        n = trace[i].u32Count;
+        if (n > MAX_XFER)
+            n = MAX_XFER;
+        switch (trace[i].cOp)
+        {
+        case 'R':
+            res = bCached ? disk_cache_read(0, xfer, trace[i].u32Sector, n)
+                          : ram_disk_read(0, xfer, trace[i].u32Sector, n);
+            if ((res != RES_OK) || memcmp(xfer, image + trace[i].u32Sector * 512, n * 512))
+                pStat->u32Bad++;
+            break;
+        case 'W':
+            pattern(xfer, trace[i].u32Sector, n, i);
+            memcpy(image + trace[i].u32Sector * 512, xfer, n * 512);
+            res = bCached ? disk_cache_write(0, xfer, trace[i].u32Sector, n)
+                          : ram_disk_write(0, xfer, trace[i].u32Sector, n);
+            if (res != RES_OK)
+                pStat->u32Bad++;
+            break;
+        case 'S':
+            if (bCached && (disk_cache_sync(0) != RES_OK))
+                pStat->u32Bad++;
+            break;
+        }
+    }
+    if (bCached && (disk_cache_sync(0) != RES_OK))
+        pStat->u32Bad++;
+    pStat->u32Usec = host_usec() - pStat->u32Usec;
+
+    if (memcmp(ram_disk_data(0), image, sizeof(shadow)))
+        pStat->u32Bad++;
+    free(image);
+
+    pStat->u32Cmds = ram_disk_stat.u32ReadCmds + ram_disk_stat.u32WriteCmds;
+    pStat->u32Sectors = ram_disk_stat.u32ReadSectors + ram_disk_stat.u32WriteSectors;
+}
+
+static int run_trace(const char *name)
+{
+    REPLAY_STAT_T      direct, cached;
+    DISK_CACHE_STAT_T  stat;
+    UINT32  hits;
+
+    replay(0, &direct);
+    replay(1, &cached);
+    disk_cache_get_stat(0, &stat);
+    hits = stat.u32ReadHits + stat.u32ReadMisses;
+
+    printf("%-12s %6u   %6u %7u %6u   %6u %7u %6u   %5.1f%%\n", name, trace_len,
+           direct.u32Cmds, direct.u32Sectors, direct.u32Usec,
+           cached.u32Cmds, cached.u32Sectors, cached.u32Usec,
+           hits ? 100.0 * stat.u32ReadHits / hits : 0.0);
+
+    if (direct.u32Bad || cached.u32Bad)
+    {
+        printf("FAIL: %s: %u direct and %u cached replay errors\n", name, direct.u32Bad, cached.u32Bad);
+        return 1;
+    }
+    return 0;
+}
+
+static int record_workload(const char *name, int (*pfnWorkload)(void))
+{
+    /* the image before the workload is the starting point of the replays */
+    memcpy(shadow, ram_disk_data(0), sizeof(shadow));
+    trace_len = 0;
+    host_disk_attach(0, rec_read, rec_write, rec_ioctl);
+    if (pfnWorkload() != 0)
+    {
+        printf("FAIL: workload %s\n", name);
+        return 1;
+    }
+    host_disk_attach(0, ram_disk_read, ram_disk_write, NULL);
+    memcpy(after, ram_disk_data(0), sizeof(after));
+    return 0;
+}
+
+static int load_trace(const char *path)
+{
+    FILE  *fp = fopen(path, "r");
+    char  line[64], op;
+    unsigned long  sector, count;
+
+    if (fp == NULL)
+    {
+        printf("FAIL: cannot open %s\n", path);
+        return 1;
+    }
+    trace_len = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        count = 0;
+        if ((sscanf(line, " %c %lu %lu", &op, &sector, &count) >= 1) &&
+            ((op == 'S') || ((count > 0) && (sector + count <= DISK_SECTORS))))
+            record(op, sector, count);
+    }
+    fclose(fp);
+    memcpy(shadow, ram_disk_data(0), sizeof(shadow));
+    return 0;
+}
+
+/* card swap under the cache */
+
+static int card_swap(void)
+{
+    UINT32  writes;
+    int     bad = 0, stale;
+
+    memset(ram_disk_data(0), 0x11, 1024 * 512);
+    disk_cache_attach(0, ram_disk_read, ram_disk_write);
+
+    /* old card: sectors 100~101 dirty, 200 clean in the cache */
+    memset(xfer, 0xAA, 2 * 512);
+    disk_cache_write(0, xfer, 100, 2);
+    disk_cache_read(0, xfer, 200, 1);
+
+    /* new card */
+    memset(ram_disk_data(0), 0x22, 1024 * 512);
+
+    /* what the cache would serve if the removal path did nothing */
+    disk_cache_read(0, xfer, 100, 1);
+    stale = (xfer[0] != 0x22);
+
+    /* SD_Close_Disk() on removal, disk_initialize() on the next mount */
+    disk_cache_invalidate(0);
+    disk_cache_attach(0, ram_disk_read, ram_disk_write);
+    memset(&ram_disk_stat, 0, sizeof(ram_disk_stat));
+
+    disk_cache_read(0, xfer, 100, 1);
+    disk_cache_read(0, xfer + 512, 200, 1);
+    if ((xfer[0] != 0x22) || (xfer[512] != 0x22))
+    {
+        printf("FAIL: sectors of the old card served after the swap\n");
+        bad++;
+    }
+    writes = ram_disk_stat.u32WriteCmds;
+    disk_cache_sync(0);
+    if ((ram_disk_stat.u32WriteCmds != writes) || (ram_disk_data(100)[0] != 0x22))
+    {
+        printf("FAIL: dirty sectors of the old card written to the new one\n");
+        bad++;
+    }
+    printf("\ncard swap: %s without invalidate, none after disk_cache_invalidate()\n",
+           stale ? "stale sectors served" : "no stale sectors");
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    static FATFS  fs;
+    int  i, bad = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    for (i = 0; i < (int)sizeof(data); i++)
+        data[i] = (BYTE)(i * 31 + (i >> 8));
+
+    ram_disk_init(DISK_SECTORS);
+    host_disk_attach(0, ram_disk_read, ram_disk_write, NULL);
+    if ((host_disk_mkfs("0:", 4096) != FR_OK) || (f_mount(&fs, "0:", 1) != FR_OK) || (make_big_file() != 0))
+    {
+        printf("FAIL: cannot make the test volume\n");
+        return 1;
+    }
+
+    printf("disk_cache: %d lines of %d sectors, read-ahead %d, bypass at %d, write-%s\n\n",
+           DISK_CACHE_LINES, DISK_CACHE_LINE_SECTORS, DISK_CACHE_RA_SECTORS,
+           DISK_CACHE_BYPASS_SECTORS, DISK_CACHE_WRITE_BACK ? "back" : "through");
+    printf("%-12s %6s   %-21s   %-21s   %s\n", "", "", "direct", "cached", "read");
+    printf("%-12s %6s   %6s %7s %6s   %6s %7s %6s   %s\n", "trace", "ops",
+           "cmds", "sectors", "us", "cmds", "sectors", "us", "hits");
+
+    if (argc > 1)
+    {
+        for (i = 1; i < argc; i++)
+        {
+            if (load_trace(argv[i]) == 0)
+                bad += run_trace(argv[i]);
+            else
+                bad++;
+        }
+    }
+    else
+    {
+        static const struct
+        {
+            const char  *name;
+            int  (*pfn)(void);
+        } wl[] =
+        {
+            { "small_files", wl_small_files },
+            { "log_append",  wl_log_append },
+            { "seq_read",    wl_seq_read },
+            { "random_read", wl_random_read },
+        };
+
+        for (i = 0; i < (int)(sizeof(wl) / sizeof(wl[0])); i++)
+        {
+            if (record_workload(wl[i].name, wl[i].pfn) == 0)
+            {
+                bad += run_trace(wl[i].name);
+                memcpy(ram_disk_data(0), after, sizeof(after));
+            }
+            else
+                bad++;
+        }
+    }
+
+    f_mount(NULL, "0:", 0);
+    bad += card_swap();
+    return bad ? 1 : 0;
+}
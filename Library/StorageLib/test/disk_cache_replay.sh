@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Build disk_cache.c against the RAM disk and FatFs, and replay disk I/O
+# traces with and without the cache: media commands, sectors and read hit
+# rate, with every read and the final media contents checked. Without
+# arguments the traces of a few FatFs workloads are recorded first. Ends
+# with a card swap under the cache.
+#
+#   test/disk_cache_replay.sh [trace ...]
+#
+# Pool buffers are handed to the media through the non-cacheable alias,
+# address | 0x80000000, as 32-bit values, so the harness is linked without
+# PIE. FatFs types are forced to 32 bits by test/host_types.h. Set CFLAGS
+# to try other cache settings, for example CFLAGS="-O2 -DDISK_CACHE_LINES=64".
+#
+
+TRACES=""
+for f in "$@"; do
+    TRACES="$TRACES $(cd "$(dirname "$f")" && pwd)/$(basename "$f")"
+done
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/disk_cache_replay.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -IInclude -Itest"
+
+# the library keeps addresses in UINT32
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host_types.h $INC -o "$OUT/replay" \
+    test/disk_cache_replay.c test/host.c test/ramdisk.c \
+    $ROOT/ThirdParty/FatFs/source/ff.c || exit 1
+
+"$OUT/replay" $TRACES
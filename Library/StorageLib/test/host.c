@@ -0,0 +1,63 @@
+/*
+ * host.c - target stand-ins shared by the StorageLib host harnesses.
+ */
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "host.h"
+#include "ff.h"
+
+HOST_CACHE_STAT_T  host_cache_stat;
+
+static UINT32  host_regs[0x10000];
+
+UINT32 host_reg_read(UINT32 u32Addr)
+{
+    return host_regs[(u32Addr >> 2) & 0xFFFF];
+}
+
+void host_reg_write(UINT32 u32Addr, UINT32 u32Value)
+{
+    host_regs[(u32Addr >> 2) & 0xFFFF] = u32Value;
+}
+
+UINT32 host_usec(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UINT32)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/* every timer runs at HOST_TICKS_PER_SEC */
+UINT32 sysGetTicks(INT32 nTimeNo)
+{
+    return host_usec();
+}
+
+void sysprintf(PINT8 pcStr, ...)
+{
+    va_list  ap;
+
+    va_start(ap, pcStr);
+    vprintf(pcStr, ap);
+    va_end(ap);
+}
+
+void sysCleanDcache(UINT32 buffer, UINT32 size)
+{
+    host_cache_stat.u32CleanBytes += size;
+    host_cache_stat.u32CleanCalls++;
+}
+
+void sysInvalidateDcache(UINT32 buffer, UINT32 size)
+{
+    host_cache_stat.u32InvalBytes += size;
+    host_cache_stat.u32InvalCalls++;
+}
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2018 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
@@ -0,0 +1,63 @@
+/*
+ * host.h - target stand-ins shared by the StorageLib host harnesses.
+ *
+ * Include it before the library source under test. Register accesses go to
+ * a scratch array, the D-cache maintenance calls only count bytes, and
+ * sysGetTicks() returns microseconds. Buffers handed to the media models
+ * carry the 0x80000000 non-cacheable alias like on the target, so the
+ * harnesses are linked without PIE and keep DMA buffers in static storage.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+
+#undef inpw
+#undef outpw
+#define inpw(port)          host_reg_read((UINT32)(port))
+#define outpw(port,value)   host_reg_write((UINT32)(port), (UINT32)(value))
+
+#define HOST_NONCACHE_BIT   0x80000000
+#define HOST_TICKS_PER_SEC  1000000
+
+/* CPU address of a buffer passed through its non-cacheable alias, stack and heap are above 4 GB */
+#define HOST_PTR(p)         ((BYTE *)(((uintptr_t)(p) >> 32) ? (uintptr_t)(p) : ((uintptr_t)(p) & ~(uintptr_t)HOST_NONCACHE_BIT)))
+
+typedef struct host_cache_stat_t
+{
+    UINT32  u32CleanBytes;      /* bytes passed to sysCleanDcache() */
+    UINT32  u32InvalBytes;      /* bytes passed to sysInvalidateDcache() */
+    UINT32  u32CleanCalls;
+    UINT32  u32InvalCalls;
+} HOST_CACHE_STAT_T;
+
+extern HOST_CACHE_STAT_T  host_cache_stat;
+
+UINT32 host_reg_read(UINT32 u32Addr);
+void host_reg_write(UINT32 u32Addr, UINT32 u32Value);
+UINT32 host_usec(void);
+
+/*
+ * Library code copies through the alias as well. A harness maps memcpy() and
+ * memset() of the source it includes onto these with #define.
+ */
+static inline void *host_memcpy(void *dst, const void *src, size_t n)
+{
+    memcpy(HOST_PTR(dst), HOST_PTR(src), n);
+    return dst;
+}
+
+static inline void *host_memset(void *dst, int c, size_t n)
+{
+    memset(HOST_PTR(dst), c, n);
+    return dst;
+}
+
+#endif
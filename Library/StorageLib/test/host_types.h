@@ -0,0 +1,24 @@
+/*
+ * host_types.h - FatFs integer types for the StorageLib host harnesses.
+ *
+ * integer.h takes DWORD and LONG from long, which is 64 bits on a 64-bit
+ * host. The harness scripts force-include this file (gcc -include) so that
+ * FatFs, the library and the harness all see the 32-bit types of the target.
+ */
+
+#ifndef HOST_TYPES_H
+#define HOST_TYPES_H
+
+#define FF_INTEGER
+
+typedef int                 INT;
+typedef unsigned int        UINT;
+typedef unsigned char       BYTE;
+typedef short               SHORT;
+typedef unsigned short      WORD;
+typedef unsigned short      WCHAR;
+typedef int                 LONG;
+typedef unsigned int        DWORD;
+typedef unsigned long long  QWORD;
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * lseek_bench - host benchmark of f_lseek() latency against file size.
+ *
+ * Files of 256 KB to 16 MB are written on a RAM disk interleaved cluster by
+ * cluster with a filler file, so every cluster of their chain is a fragment
+ * of its own. Each file is then read at 500 random offsets after f_lseek(),
+ * once opened with f_open() and once with clmt_open(), which puts it in
+ * fast seek mode through a cluster link map. Reported per seek are the
+ * host time and the sectors read from the media, which on the target is
+ * what the time is made of.
+ *
+ *   lseek_bench.sh
+ *
+ * Every read is checked against the file contents. Fast seek must not read
+ * more than the data sector itself, whatever the size of the file.
+ */
+
+#include "host.h"
+#include "ramdisk.h"
+#include "clmt_cache.h"
+
+#define CLUSTER_SIZE    4096
+#define SEEKS           500
+
+static BYTE  chunk[CLUSTER_SIZE];
+
+static int make_fragmented(const char *path, const char *filler, DWORD u32Size)
+{
+    FIL    fil, fill;
+    DWORD  pos, i;
+    UINT   bw;
+
+    if ((f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) ||
+        (f_open(&fill, filler, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK))
+        return -1;
+
+    for (pos = 0; pos < u32Size; pos += CLUSTER_SIZE)
+    {
+        for (i = 0; i < CLUSTER_SIZE; i += 4)
+            *(UINT32 *)(chunk + i) = pos + i;
+        if ((f_write(&fil, chunk, CLUSTER_SIZE, &bw) != FR_OK) || (bw != CLUSTER_SIZE))
+            return -1;
+        if ((f_write(&fill, chunk, CLUSTER_SIZE, &bw) != FR_OK) || (bw != CLUSTER_SIZE))
+            return -1;
+    }
+    f_close(&fil);
+    f_close(&fill);
+    return 0;
+}
+
+typedef struct seek_stat_t
+{
+    UINT32  u32Usec;        /* per seek and read, in 1/100 us */
+    UINT32  u32Sectors;     /* per seek and read, in 1/100 sector */
+    UINT32  u32OpenUsec;
+    UINT32  u32Bad;
+} SEEK_STAT_T;
+
+static void seek_run(const char *path, DWORD u32Size, int bFast, SEEK_STAT_T *pStat)
+{
+    FIL     fil;
+    UINT32  t0, sectors, value;
+    UINT    i, br;
+    FSIZE_t ofs;
+
+    memset(pStat, 0, sizeof(*pStat));
+
+    t0 = host_usec();
+    if ((bFast ? clmt_open(&fil, path, FA_READ) : f_open(&fil, path, FA_READ)) != FR_OK)
+    {
+        pStat->u32Bad++;
+        return;
+    }
+    pStat->u32OpenUsec = host_usec() - t0;
+    if (bFast && (fil.cltbl == NULL))
+        pStat->u32Bad++;
+
+    srand(u32Size);
+    sectors = ram_disk_stat.u32ReadSectors;
+    t0 = host_usec();
+    for (i = 0; i < SEEKS; i++)
+    {
+        ofs = ((FSIZE_t)rand() * 4) % u32Size;
+        if ((f_lseek(&fil, ofs) != FR_OK) ||
+            (f_read(&fil, &value, sizeof(value), &br) != FR_OK) || (br != sizeof(value)) || (value != ofs))
+            pStat->u32Bad++;
+    }
+    pStat->u32Usec = (host_usec() - t0) * 100 / SEEKS;
+    pStat->u32Sectors = (ram_disk_stat.u32ReadSectors - sectors) * 100 / SEEKS;
+
+    if (bFast)
+        clmt_close(&fil);
+    else
+        f_close(&fil);
+}
+
+int main(void)
+{
+    static const DWORD  sizes[] = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+    static FATFS  fs;
+    SEEK_STAT_T   plain, fast;
+    CLMT_STAT_T   cstat;
+    char    path[16], filler[16];
+    UINT    i;
+    int     bad = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    ram_disk_init(RAM_DISK_MAX_SECTORS);
+    host_disk_attach(0, ram_disk_read, ram_disk_write, NULL);
+    if ((host_disk_mkfs("0:", CLUSTER_SIZE) != FR_OK) || (f_mount(&fs, "0:", 1) != FR_OK))
+    {
+        printf("FAIL: cannot make the test volume\n");
+        return 1;
+    }
+
+    printf("f_lseek() and a 4-byte f_read() at %d random offsets, %d byte clusters, one fragment per cluster\n\n",
+           SEEKS, CLUSTER_SIZE);
+    printf("%-8s %9s   %-22s   %-32s\n", "", "", "f_open()", "clmt_open()");
+    printf("%-8s %9s   %9s %12s   %9s %12s %9s\n", "size KB", "fragments",
+           "us/seek", "sectors/seek", "us/seek", "sectors/seek", "map us");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        sprintf(path, "0:/f%u.bin", i);
+        sprintf(filler, "0:/fill%u.bin", i);
+        if (make_fragmented(path, filler, sizes[i]) != 0)
+        {
+            printf("FAIL: cannot write %s\n", path);
+            return 1;
+        }
+
+        seek_run(path, sizes[i], 0, &plain);
+        seek_run(path, sizes[i], 1, &fast);
+
+        printf("%-8u %9u   %5u.%02u %9u.%02u   %5u.%02u %9u.%02u %9u\n",
+               sizes[i] / 1024, sizes[i] / CLUSTER_SIZE,
+               plain.u32Usec / 100, plain.u32Usec % 100, plain.u32Sectors / 100, plain.u32Sectors % 100,
+               fast.u32Usec / 100, fast.u32Usec % 100, fast.u32Sectors / 100, fast.u32Sectors % 100,
+               fast.u32OpenUsec);
+
+        if (plain.u32Bad || fast.u32Bad)
+        {
+            printf("FAIL: %s: %u f_open() and %u clmt_open() errors\n", path, plain.u32Bad, fast.u32Bad);
+            bad++;
+        }
+        /* one data sector per read at most */
+        if (fast.u32Sectors > 100)
+        {
+            printf("FAIL: %s: fast seek reads %u.%02u sectors per seek\n", path,
+                   fast.u32Sectors / 100, fast.u32Sectors % 100);
+            bad++;
+        }
+    }
+
+    clmt_get_stat(&cstat);
+    printf("\nlink maps: %u built, largest %u DWORDs\n", cstat.u32Builds, cstat.u32MaxItems);
+
+    f_mount(NULL, "0:", 0);
+    return bad ? 1 : 0;
+}
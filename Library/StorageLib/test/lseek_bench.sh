@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Build clmt_cache.c and FatFs against the RAM disk and run lseek_bench:
+# f_lseek() latency and media sectors per seek against file size, in
+# normal and fast seek mode, on files with one fragment per cluster.
+#
+#   test/lseek_bench.sh
+#
+# FatFs types are forced to 32 bits by test/host_types.h.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/lseek_bench.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -IInclude -Itest"
+
+# the library keeps addresses in UINT32
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host_types.h $INC -o "$OUT/bench" \
+    test/lseek_bench.c test/host.c test/ramdisk.c Source/clmt_cache.c \
+    $ROOT/ThirdParty/FatFs/source/ff.c || exit 1
+
+"$OUT/bench"
@@ -0,0 +1,145 @@
+/*
+ * ramdisk.c - RAM disk medium and FatFs glue for the StorageLib host harnesses.
+ */
+
+#include "ramdisk.h"
+
+#define RAM_DISK_SECTOR_SIZE    512
+
+RAM_DISK_STAT_T  ram_disk_stat;
+void (*ram_disk_trace)(int bIsWrite, DWORD sector, UINT count);
+
+static BYTE   ram_disk_pool[RAM_DISK_MAX_SECTORS * RAM_DISK_SECTOR_SIZE];
+static DWORD  ram_disk_size;
+
+void ram_disk_init(DWORD u32Sectors)
+{
+    if (u32Sectors > RAM_DISK_MAX_SECTORS)
+        u32Sectors = RAM_DISK_MAX_SECTORS;
+    ram_disk_size = u32Sectors;
+    memset(ram_disk_pool, 0, (size_t)u32Sectors * RAM_DISK_SECTOR_SIZE);
+    memset(&ram_disk_stat, 0, sizeof(ram_disk_stat));
+}
+
+DWORD ram_disk_sectors(void)
+{
+    return ram_disk_size;
+}
+
+BYTE *ram_disk_data(DWORD sector)
+{
+    return ram_disk_pool + (size_t)sector * RAM_DISK_SECTOR_SIZE;
+}
+
+DRESULT ram_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    if (ram_disk_trace != NULL)
+        ram_disk_trace(0, sector, count);
+    if ((count == 0) || (sector >= ram_disk_size) || (count > ram_disk_size - sector))
+        return RES_ERROR;
+
+    memcpy(HOST_PTR(buff), ram_disk_data(sector), (size_t)count * RAM_DISK_SECTOR_SIZE);
+    ram_disk_stat.u32ReadCmds++;
+    ram_disk_stat.u32ReadSectors += count;
+    return RES_OK;
+}
+
+DRESULT ram_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (ram_disk_trace != NULL)
+        ram_disk_trace(1, sector, count);
+    if ((count == 0) || (sector >= ram_disk_size) || (count > ram_disk_size - sector))
+        return RES_ERROR;
+
+    memcpy(ram_disk_data(sector), HOST_PTR(buff), (size_t)count * RAM_DISK_SECTOR_SIZE);
+    ram_disk_stat.u32WriteCmds++;
+    ram_disk_stat.u32WriteSectors += count;
+    return RES_OK;
+}
+
+/* FatFs disk_*() on the media functions attached per drive */
+
+typedef struct host_disk_t
+{
+    HOST_DISK_READ_FUNC   pfnRead;
+    HOST_DISK_WRITE_FUNC  pfnWrite;
+    HOST_DISK_IOCTL_FUNC  pfnIoctl;
+} HOST_DISK_T;
+
+static HOST_DISK_T  host_disk[FF_VOLUMES];
+
+PARTITION VolToPart[FF_VOLUMES] = {
+    {0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}
+};
+
+void host_disk_attach(BYTE pdrv, HOST_DISK_READ_FUNC pfnRead, HOST_DISK_WRITE_FUNC pfnWrite,
+                      HOST_DISK_IOCTL_FUNC pfnIoctl)
+{
+    host_disk[pdrv].pfnRead = pfnRead;
+    host_disk[pdrv].pfnWrite = pfnWrite;
+    host_disk[pdrv].pfnIoctl = pfnIoctl;
+}
+
+/* FAT volume without a partition table, u32ClusterBytes 0 lets FatFs choose */
+FRESULT host_disk_mkfs(const TCHAR *path, DWORD u32ClusterBytes)
+{
+    static BYTE  work[FF_MAX_SS];
+
+    return f_mkfs(path, FM_FAT | FM_FAT32 | FM_SFD, u32ClusterBytes, work, sizeof(work));
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return (host_disk[pdrv].pfnRead != NULL) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (host_disk[pdrv].pfnRead != NULL) ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    if (host_disk[pdrv].pfnRead == NULL)
+        return RES_NOTRDY;
+    return host_disk[pdrv].pfnRead(pdrv, buff, sector, count);
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (host_disk[pdrv].pfnWrite == NULL)
+        return RES_NOTRDY;
+    return host_disk[pdrv].pfnWrite(pdrv, buff, sector, count);
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if (host_disk[pdrv].pfnRead == NULL)
+        return RES_NOTRDY;
+
+    /* the harness handles what it needs first, RES_PARERR falls through */
+    if (host_disk[pdrv].pfnIoctl != NULL)
+    {
+        DRESULT  res = host_disk[pdrv].pfnIoctl(pdrv, cmd, buff);
+
+        if (res != RES_PARERR)
+            return res;
+    }
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+    case CTRL_TRIM:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = ram_disk_size;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = RAM_DISK_SECTOR_SIZE;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = 1;
+        return RES_OK;
+    }
+    return RES_PARERR;
+}
@@ -0,0 +1,49 @@
+/*
+ * ramdisk.h - RAM disk medium for the StorageLib host harnesses.
+ *
+ * One medium of up to RAM_DISK_MAX_SECTORS sectors in static storage, read
+ * and written through functions with the disk_read()/disk_write() contract.
+ * Buffers may carry the non-cacheable alias. Commands and sectors are
+ * counted, and every command can be passed to a trace hook.
+ */
+
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include "host.h"
+#include "ff.h"
+#include "diskio.h"
+
+#ifndef RAM_DISK_MAX_SECTORS
+#define RAM_DISK_MAX_SECTORS    (128 * 1024)    /* 64 MB */
+#endif
+
+typedef struct ram_disk_stat_t
+{
+    UINT32  u32ReadCmds;
+    UINT32  u32ReadSectors;
+    UINT32  u32WriteCmds;
+    UINT32  u32WriteSectors;
+} RAM_DISK_STAT_T;
+
+extern RAM_DISK_STAT_T  ram_disk_stat;
+
+/* called for every command before it is carried out */
+extern void (*ram_disk_trace)(int bIsWrite, DWORD sector, UINT count);
+
+void ram_disk_init(DWORD u32Sectors);
+DWORD ram_disk_sectors(void);
+BYTE *ram_disk_data(DWORD sector);
+DRESULT ram_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+DRESULT ram_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+/* FatFs disk_*() glue: the media functions attached to each drive */
+typedef DRESULT (*HOST_DISK_READ_FUNC)(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+typedef DRESULT (*HOST_DISK_WRITE_FUNC)(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+typedef DRESULT (*HOST_DISK_IOCTL_FUNC)(BYTE pdrv, BYTE cmd, void *buff);
+
+void host_disk_attach(BYTE pdrv, HOST_DISK_READ_FUNC pfnRead, HOST_DISK_WRITE_FUNC pfnWrite,
+                      HOST_DISK_IOCTL_FUNC pfnIoctl);
+FRESULT host_disk_mkfs(const TCHAR *path, DWORD u32ClusterBytes);
+
+#endif
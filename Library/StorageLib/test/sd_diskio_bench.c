@@ -0,0 +1,387 @@
+/*
+ * sd_diskio_bench - host benchmark of the zero-copy SD disk I/O layer.
+ *
+ * Builds sd_diskio.c against a model of SD_Read()/SD_Write() that DMAs
+ * between a RAM disk and the buffer it is given, and counts the bytes the
+ * layer copies through its bounce buffer for every byte read or written.
+ * The same requests are run through the diskio code the SD samples had
+ * before, which copied every cacheable request through a 32 KB
+ * non-cacheable pool and failed anything larger.
+ *
+ *   sd_diskio_bench.sh
+ *
+ * Part 1 calls the layer directly with buffers that are cache line
+ * aligned, word aligned only, and byte aligned. Part 2 reads a file with
+ * f_read() in chunks of 512 bytes to 64 KB from a FAT volume on the RAM
+ * disk. Every transfer is checked against the RAM disk contents, and the
+ * model fails any DMA to a cacheable address or from an unaligned one.
+ * Bounced transfers must keep two requests queued, so the copy of one
+ * chunk overlaps the DMA of the next.
+ */
+
+#include "host.h"
+#include "sdh.h"
+#include "ramdisk.h"
+
+/*
+ * SDH model: requests are queued like the driver's ring and their DMA is
+ * carried out by SD_ServiceQueue(), one request per call, so a buffer read
+ * before its request is waited for, or refilled while its write is still
+ * queued, shows up as wrong data.
+ */
+
+SD_INFO_T  SD0, SD1;
+
+static SD_REQ_T  *sd_queue[SD_REQ_QUEUE_SIZE];
+static UINT      sd_head, sd_tail;
+static UINT32    sd_cmds;           /* requests carried out */
+static UINT32    sd_max_queued;     /* most requests queued at once */
+static UINT32    sd_dma_errors;     /* DMA on a cacheable or unaligned address */
+
+static unsigned int sd_dma(SD_REQ_T *pReq)
+{
+    sd_cmds++;
+    if (!((UINT32)pReq->pu8BufAddr & HOST_NONCACHE_BIT) || ((UINT32)pReq->pu8BufAddr & 0x3))
+    {
+        sd_dma_errors++;
+        return SD_SELECT_ERROR;
+    }
+    if (pReq->bIsWrite)
+        return (ram_disk_write(0, pReq->pu8BufAddr, pReq->u32StartSec, pReq->u32SecCount) == RES_OK) ? 0 : SD_SELECT_ERROR;
+    return (ram_disk_read(0, pReq->pu8BufAddr, pReq->u32StartSec, pReq->u32SecCount) == RES_OK) ? 0 : SD_SELECT_ERROR;
+}
+
+void SD_ServiceQueue(void)
+{
+    SD_REQ_T  *pReq;
+
+    if (sd_head == sd_tail)
+        return;
+    pReq = sd_queue[sd_head];
+    sd_head = (sd_head + 1) % SD_REQ_QUEUE_SIZE;
+    pReq->u32Status = sd_dma(pReq);
+}
+
+unsigned int SD_SubmitRequest(SD_REQ_T *pReq)
+{
+    UINT  next = (sd_tail + 1) % SD_REQ_QUEUE_SIZE;
+
+    if (pReq->u32SecCount == 0)
+        return SD_SELECT_ERROR;
+    if (next == sd_head)
+        return SD_REQ_QUEUE_FULL;
+    pReq->u32Status = SD_REQ_BUSY;
+    sd_queue[sd_tail] = pReq;
+    sd_tail = next;
+    if ((sd_tail + SD_REQ_QUEUE_SIZE - sd_head) % SD_REQ_QUEUE_SIZE > sd_max_queued)
+        sd_max_queued = (sd_tail + SD_REQ_QUEUE_SIZE - sd_head) % SD_REQ_QUEUE_SIZE;
+    return 0;
+}
+
+unsigned int SD_WaitRequest(SD_REQ_T *pReq)
+{
+    while (pReq->u32Status == SD_REQ_BUSY)
+        SD_ServiceQueue();
+    return pReq->u32Status;
+}
+
+static unsigned int sd_sync(unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount, int bIsWrite)
+{
+    SD_REQ_T      req;
+    unsigned int  status;
+
+    req.u32CardNum = SD_PORT0;
+    req.pu8BufAddr = pu8BufAddr;
+    req.u32StartSec = u32StartSec;
+    req.u32SecCount = u32SecCount;
+    req.bIsWrite = bIsWrite;
+    req.pfnCallback = NULL;
+    req.pvContext = NULL;
+    while ((status = SD_SubmitRequest(&req)) == SD_REQ_QUEUE_FULL)
+        SD_ServiceQueue();
+    if (status != 0)
+        return status;
+    return SD_WaitRequest(&req);
+}
+
+unsigned int SD_Read(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
+{
+    return sd_sync(pu8BufAddr, u32StartSec, u32SecCount, FALSE);
+}
+
+unsigned int SD_Write(unsigned int u32CardNum, unsigned char *pu8BufAddr, unsigned int u32StartSec, unsigned int u32SecCount)
+{
+    return sd_sync(pu8BufAddr, u32StartSec, u32SecCount, TRUE);
+}
+
+/* the layer under test, copying through the bounce buffer alias */
+#define memcpy  host_memcpy
+#define memset  host_memset
+#include "../Source/sd_diskio.c"
+#undef memcpy
+#undef memset
+
+/* disk_read()/disk_write() of the SD samples before sd_diskio.c */
+
+#define LEGACY_BUFFER_SIZE  (32 * 1024)
+
+static BYTE    legacy_pool[LEGACY_BUFFER_SIZE] __attribute__((aligned(32)));
+static UINT32  legacy_copied;
+
+static DRESULT legacy_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    BYTE  *win;
+
+    if (!((UINT32)buff & 0x80000000))
+    {
+        if (count * 512 > LEGACY_BUFFER_SIZE)
+            return RES_ERROR;
+        win = (BYTE *)((UINT32)legacy_pool | 0x80000000);
+        if (SD_Read(SD_PORT0, win, sector, count) != 0)
+            return RES_ERROR;
+        memcpy(buff, HOST_PTR(win), count * 512);
+        legacy_copied += count * 512;
+        return RES_OK;
+    }
+    return (SD_Read(SD_PORT0, buff, sector, count) != 0) ? RES_ERROR : RES_OK;
+}
+
+static DRESULT legacy_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    BYTE  *win;
+
+    if (!((UINT32)buff & 0x80000000))
+    {
+        if (count * 512 > LEGACY_BUFFER_SIZE)
+            return RES_ERROR;
+        win = (BYTE *)((UINT32)legacy_pool | 0x80000000);
+        memcpy(HOST_PTR(win), buff, count * 512);
+        legacy_copied += count * 512;
+        return (SD_Write(SD_PORT0, win, sector, count) != 0) ? RES_ERROR : RES_OK;
+    }
+    return (SD_Write(SD_PORT0, (BYTE *)buff, sector, count) != 0) ? RES_ERROR : RES_OK;
+}
+
+static DRESULT zc_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    return sd_disk_read(SD_PORT0, buff, sector, count);
+}
+
+static DRESULT zc_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    return sd_disk_write(SD_PORT0, buff, sector, count);
+}
+
+/* bytes copied by the layer in use */
+static int     use_legacy;
+
+static UINT32 copied(void)
+{
+    SD_DISK_STAT_T  stat;
+
+    if (use_legacy)
+        return legacy_copied;
+    sd_disk_get_stat(&stat);
+    return stat.u32BytesCopied;
+}
+
+static void reset(void)
+{
+    legacy_copied = 0;
+    sd_disk_reset_stat();
+    sd_cmds = 0;
+}
+
+/* part 1: direct calls */
+
+#define MAX_REQ_SECTORS     256
+
+static BYTE  user_pool[MAX_REQ_SECTORS * 512 + 64] __attribute__((aligned(32)));
+
+static void fill_disk(DWORD u32Sectors)
+{
+    DWORD  i;
+
+    ram_disk_init(u32Sectors);
+    for (i = 0; i < u32Sectors * 512; i++)
+        ram_disk_data(0)[i] = (BYTE)(i * 7 + (i >> 9) * 13);
+}
+
+static int direct(void)
+{
+    static const UINT    counts[] = { 1, 2, 8, 64, 256 };
+    static const UINT    offsets[] = { 0, 4, 1 };
+    static const char   *names[] = { "32-byte aligned", "word aligned", "byte aligned" };
+    BYTE    *buff;
+    DRESULT res;
+    UINT    c, o, n, bad = 0;
+    DWORD   sector;
+
+    printf("direct sd_disk_read() / sd_disk_write(), bytes copied per byte moved:\n");
+    printf("%-16s %7s   %-20s %-20s\n", "buffer", "sectors", "read legacy / new", "write legacy / new");
+
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++)
+    {
+        buff = user_pool + offsets[o];
+        for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+        {
+            double  r[2], w[2];
+            int     ok[2][2];
+
+            n = counts[c];
+            sector = 1000 + n;
+            for (use_legacy = 1; use_legacy >= 0; use_legacy--)
+            {
+                reset();
+                memset(buff, 0, n * 512);
+                res = use_legacy ? legacy_read(0, buff, sector, n) : zc_read(0, buff, sector, n);
+                ok[use_legacy][0] = (res == RES_OK);
+                if (res == RES_OK && memcmp(buff, ram_disk_data(sector), n * 512) != 0)
+                {
+                    printf("FAIL: %s read of %u sectors returned wrong data\n", use_legacy ? "legacy" : "sd_disk", n);
+                    bad++;
+                }
+                r[use_legacy] = (double)copied() / (n * 512);
+
+                reset();
+                res = use_legacy ? legacy_write(0, buff, sector + 2000, n) : zc_write(0, buff, sector + 2000, n);
+                ok[use_legacy][1] = (res == RES_OK);
+                if (res == RES_OK && memcmp(buff, ram_disk_data(sector + 2000), n * 512) != 0)
+                {
+                    printf("FAIL: %s write of %u sectors stored wrong data\n", use_legacy ? "legacy" : "sd_disk", n);
+                    bad++;
+                }
+                w[use_legacy] = (double)copied() / (n * 512);
+            }
+
+            if (!ok[0][0] || !ok[0][1])
+            {
+                printf("FAIL: sd_disk failed %u sectors at %s\n", n, names[o]);
+                bad++;
+            }
+            printf("%-16s %7u   ", names[o], n);
+            if (ok[1][0])
+                printf("%4.2f / %4.2f          ", r[1], r[0]);
+            else
+                printf("fail / %4.2f          ", r[0]);
+            if (ok[1][1])
+                printf("%4.2f / %4.2f\n", w[1], w[0]);
+            else
+                printf("fail / %4.2f\n", w[0]);
+        }
+    }
+    return bad;
+}
+
+/* part 2: f_read() of a file */
+
+#define FILE_SIZE   (4 * 1024 * 1024)
+
+static BYTE  chunk_pool[64 * 1024 + 64] __attribute__((aligned(32)));
+
+static int file_read(void)
+{
+    static const UINT  chunks[] = { 512, 4096, 32768, 65536 };
+    static FATFS  fs;
+    FIL      fil;
+    FRESULT  res;
+    UINT     c, done, bad = 0, i;
+    UINT32   t0, pos, usec[2], ratio_cmds[2];
+    double   ratio[2];
+    FRESULT  rc[2];
+
+    ram_disk_init(32 * 1024);
+    host_disk_attach(0, zc_read, zc_write, NULL);
+    if ((host_disk_mkfs("0:", 65536) != FR_OK) || (f_mount(&fs, "0:", 1) != FR_OK))
+    {
+        printf("FAIL: cannot make the test volume\n");
+        return 1;
+    }
+
+    /* test file, written in 64 KB chunks */
+    if (f_open(&fil, "0:/test.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return 1;
+    for (pos = 0; pos < FILE_SIZE; pos += 65536)
+    {
+        for (i = 0; i < 65536; i += 4)
+            *(UINT32 *)(chunk_pool + i) = pos + i;
+        if ((f_write(&fil, chunk_pool, 65536, &done) != FR_OK) || (done != 65536))
+            return 1;
+    }
+    f_close(&fil);
+
+    printf("\nf_read() of a %d KB file, bytes copied per byte read, SD commands:\n", FILE_SIZE / 1024);
+    printf("%-8s %-26s %-26s\n", "chunk", "legacy", "sd_disk");
+
+    for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+    {
+        for (use_legacy = 1; use_legacy >= 0; use_legacy--)
+        {
+            host_disk_attach(0, use_legacy ? legacy_read : zc_read, use_legacy ? legacy_write : zc_write, NULL);
+            reset();
+            t0 = host_usec();
+            rc[use_legacy] = f_open(&fil, "0:/test.bin", FA_READ);
+            for (pos = 0; (rc[use_legacy] == FR_OK) && (pos < FILE_SIZE); pos += chunks[c])
+            {
+                res = f_read(&fil, chunk_pool, chunks[c], &done);
+                if ((res != FR_OK) || (done != chunks[c]))
+                {
+                    rc[use_legacy] = (res != FR_OK) ? res : FR_INT_ERR;
+                    break;
+                }
+                for (i = 0; i < chunks[c]; i += 4)
+                {
+                    if (*(UINT32 *)(chunk_pool + i) != pos + i)
+                    {
+                        printf("FAIL: wrong data at %u with %u byte chunks\n", pos + i, chunks[c]);
+                        bad++;
+                        break;
+                    }
+                }
+            }
+            f_close(&fil);
+            usec[use_legacy] = host_usec() - t0;
+            ratio[use_legacy] = (double)copied() / FILE_SIZE;
+            ratio_cmds[use_legacy] = sd_cmds;
+        }
+
+        if (rc[0] != FR_OK)
+        {
+            printf("FAIL: sd_disk f_read() error %d with %u byte chunks\n", rc[0], chunks[c]);
+            bad++;
+        }
+        printf("%-8u ", chunks[c]);
+        if (rc[1] == FR_OK)
+            printf("%4.2f, %5u cmds, %5u us  ", ratio[1], ratio_cmds[1], usec[1]);
+        else
+            printf("f_read() error %-2d          ", rc[1]);
+        printf("%4.2f, %5u cmds, %5u us\n", ratio[0], ratio_cmds[0], usec[0]);
+    }
+
+    f_mount(NULL, "0:", 0);
+    return bad;
+}
+
+int main(void)
+{
+    int  bad;
+
+    fill_disk(8192);
+    setvbuf(stdout, NULL, _IONBF, 0);
+    bad = direct();
+    bad += file_read();
+
+    printf("at most %u SD requests queued at once, bounced chunks overlap when 2\n", sd_max_queued);
+    if (sd_max_queued < 2)
+    {
+        printf("FAIL: bounced transfers are not queued ahead of the copy\n");
+        bad++;
+    }
+    if (sd_dma_errors)
+    {
+        printf("FAIL: %u DMA transfers on a cacheable or unaligned address\n", sd_dma_errors);
+        bad++;
+    }
+    printf("\nhost times only compare the two layers, memcpy stands in for SDH DMA\n");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Build sd_diskio.c against the SD_Read()/SD_Write() model and RAM disk of
+# sd_diskio_bench.c and run it: bytes copied per byte read or written by
+# the zero-copy layer and by the bounce-everything diskio the SD samples
+# had before, for direct calls and for f_read() through FatFs.
+#
+#   test/sd_diskio_bench.sh
+#
+# Buffers carry the non-cacheable alias, address | 0x80000000, and are
+# handed around as 32-bit values, so the harness is linked without PIE.
+# FatFs types are forced to 32 bits by test/host_types.h.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/sd_diskio_bench.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -IInclude -Itest"
+
+# the library keeps addresses in UINT32
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host_types.h $INC -o "$OUT/bench" \
+    test/sd_diskio_bench.c test/host.c test/ramdisk.c \
+    $ROOT/ThirdParty/FatFs/source/ff.c || exit 1
+
+"$OUT/bench"
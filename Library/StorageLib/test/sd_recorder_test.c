@@ -0,0 +1,244 @@
+/*
+ * sd_recorder_test - host check that recording streams touch no FAT sector.
+ *
+ * Builds sd_recorder.c and FatFs against a RAM disk and a model of the SD
+ * stream API that writes the raw sector runs to the same disk. A 6 MB
+ * recording goes into an 8 MB extent in 4 KB pieces, with sd_rec_flush()
+ * every 1 MB as an application sharing the card would do. Between
+ * sd_rec_open() and sd_rec_close() FatFs must issue no disk_write() at all,
+ * and every sector outside the extent must be unchanged, the FAT and the
+ * directory in particular. After sd_rec_close() the file must read back
+ * with the recorded data and the size given, and the unused tail of the
+ * extent must be free again.
+ *
+ * The same data is then written with f_write() and f_sync() every 1 MB,
+ * to show the FAT and directory writes the recorder avoids.
+ *
+ *   sd_recorder_test.sh
+ */
+
+#include "host.h"
+#include "sdh.h"
+#include "ramdisk.h"
+
+#define DISK_SECTORS    (64 * 1024)     /* 32 MB */
+#define EXTENT_SIZE     (8 * 1024 * 1024)
+#define REC_SIZE        (6 * 1024 * 1024)
+#define FINAL_SIZE      (REC_SIZE - 100)
+#define PIECE_SECTORS   8
+#define FLUSH_EVERY     (1024 * 1024 / (PIECE_SECTORS * 512))
+
+/* SD stream model */
+
+SD_INFO_T  SD0, SD1;
+
+static UINT32  stream_opens, stream_sectors, stream_errors;
+
+unsigned int SD_StreamOpen(SD_STREAM_T *pStream, unsigned int u32CardNum, unsigned int u32StartSec,
+                           unsigned int u32PreEraseCount, int bIsWrite)
+{
+    memset(pStream, 0, sizeof(SD_STREAM_T));
+    pStream->u32CardNum = u32CardNum;
+    pStream->u32NextSec = u32StartSec;
+    pStream->bIsWrite = bIsWrite;
+    stream_opens++;
+    return 0;
+}
+
+unsigned int SD_StreamXfer(SD_STREAM_T *pStream, unsigned char *pu8BufAddr, unsigned int u32SecCount)
+{
+    if (!pStream->bIsWrite || !((UINT32)pu8BufAddr & HOST_NONCACHE_BIT) || ((UINT32)pu8BufAddr & 0x3))
+    {
+        stream_errors++;
+        return SD_SELECT_ERROR;
+    }
+    /* raw sector run, not seen by FatFs or the disk_write() counters */
+    memcpy(ram_disk_data(pStream->u32NextSec), HOST_PTR(pu8BufAddr), u32SecCount * 512);
+    pStream->u32NextSec += u32SecCount;
+    pStream->u32Transferred += u32SecCount;
+    stream_sectors += u32SecCount;
+    return 0;
+}
+
+unsigned int SD_StreamClose(SD_STREAM_T *pStream)
+{
+    return 0;
+}
+
+/* the recorder under test */
+#include "../Source/sd_recorder.c"
+
+/* disk_write() counters of FatFs */
+
+static DWORD   fat_start, fat_end;      /* FAT sectors of the volume */
+static UINT32  fs_writes, fs_write_sectors, fs_fat_sectors;
+
+static DRESULT count_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    UINT  i;
+
+    fs_writes++;
+    fs_write_sectors += count;
+    for (i = 0; i < count; i++)
+    {
+        if ((sector + i >= fat_start) && (sector + i < fat_end))
+            fs_fat_sectors++;
+    }
+    return ram_disk_write(pdrv, buff, sector, count);
+}
+
+static void reset_counters(void)
+{
+    fs_writes = 0;
+    fs_write_sectors = 0;
+    fs_fat_sectors = 0;
+}
+
+static BYTE  piece[PIECE_SECTORS * 512] __attribute__((aligned(32)));
+static BYTE  image[DISK_SECTORS * 512];
+
+static void fill_piece(DWORD pos)
+{
+    UINT  i;
+
+    for (i = 0; i < sizeof(piece); i += 4)
+        *(UINT32 *)(piece + i) = pos + i;
+}
+
+static int check_file(const char *path, FSIZE_t u32Size)
+{
+    FIL     fil;
+    FSIZE_t pos;
+    UINT    br, i;
+
+    if ((f_open(&fil, path, FA_READ) != FR_OK) || (f_size(&fil) != u32Size))
+        return -1;
+    for (pos = 0; pos < u32Size; pos += br)
+    {
+        if ((f_read(&fil, piece, sizeof(piece), &br) != FR_OK) || (br == 0))
+            return -1;
+        for (i = 0; i + 4 <= br; i += 4)
+        {
+            if (*(UINT32 *)(piece + i) != pos + i)
+                return -1;
+        }
+    }
+    f_close(&fil);
+    return 0;
+}
+
+int main(void)
+{
+    static FATFS  fs;
+    static SD_REC_T  rec;
+    FATFS   *pfs;
+    FIL     fil;
+    DWORD   free0, free1, pos, s;
+    UINT    i, bw;
+    int     bad = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    SD0.CardType = SD_TYPE_SD_HIGH;
+    ram_disk_init(DISK_SECTORS);
+    host_disk_attach(0, ram_disk_read, count_write, NULL);
+    if ((host_disk_mkfs("0:", 4096) != FR_OK) || (f_mount(&fs, "0:", 1) != FR_OK) ||
+        (f_getfree("0:", &free0, &pfs) != FR_OK))
+    {
+        printf("FAIL: cannot make the test volume\n");
+        return 1;
+    }
+    fat_start = pfs->fatbase;
+    fat_end = pfs->fatbase + pfs->n_fats * pfs->fsize;
+
+    /* recorder */
+    reset_counters();
+    if (sd_rec_open(&rec, SD_PORT0, "0:/rec.bin", EXTENT_SIZE) != FR_OK)
+    {
+        printf("FAIL: sd_rec_open()\n");
+        return 1;
+    }
+    printf("sd_rec_open():  %4u disk_write() commands, %4u sectors, %3u FAT sectors\n",
+           fs_writes, fs_write_sectors, fs_fat_sectors);
+
+    memcpy(image, ram_disk_data(0), sizeof(image));
+    reset_counters();
+    for (pos = 0, i = 0; pos < REC_SIZE; pos += sizeof(piece), i++)
+    {
+        fill_piece(pos);
+        if (sd_rec_write(&rec, piece, PIECE_SECTORS) != FR_OK)
+        {
+            printf("FAIL: sd_rec_write() at %u\n", pos);
+            bad++;
+            break;
+        }
+        if ((i % FLUSH_EVERY) == FLUSH_EVERY - 1)
+            sd_rec_flush(&rec);
+    }
+    printf("streaming:      %4u disk_write() commands, %4u sectors, %3u FAT sectors, %u sectors streamed in %u sessions\n",
+           fs_writes, fs_write_sectors, fs_fat_sectors, stream_sectors, stream_opens);
+
+    if (fs_writes != 0)
+    {
+        printf("FAIL: FatFs wrote %u sectors while streaming\n", fs_write_sectors);
+        bad++;
+    }
+    for (s = 0; s < DISK_SECTORS; s++)
+    {
+        if ((s >= rec.u32StartSec) && (s < rec.u32StartSec + rec.u32SecCount))
+            continue;
+        if (memcmp(ram_disk_data(s), image + s * 512, 512) != 0)
+        {
+            printf("FAIL: sector %u outside the extent changed while streaming%s\n", s,
+                   ((s >= fat_start) && (s < fat_end)) ? " (FAT)" : "");
+            bad++;
+            break;
+        }
+    }
+    if (stream_errors || (stream_sectors != REC_SIZE / 512))
+    {
+        printf("FAIL: %u stream errors, %u of %u sectors streamed\n", stream_errors, stream_sectors, REC_SIZE / 512);
+        bad++;
+    }
+
+    reset_counters();
+    if (sd_rec_close(&rec, FINAL_SIZE) != FR_OK)
+    {
+        printf("FAIL: sd_rec_close()\n");
+        bad++;
+    }
+    printf("sd_rec_close(): %4u disk_write() commands, %4u sectors, %3u FAT sectors\n",
+           fs_writes, fs_write_sectors, fs_fat_sectors);
+
+    if (check_file("0:/rec.bin", FINAL_SIZE) != 0)
+    {
+        printf("FAIL: recorded file does not read back\n");
+        bad++;
+    }
+    f_getfree("0:", &free1, &pfs);
+    if (free1 != free0 - (FINAL_SIZE + 4095) / 4096)
+    {
+        printf("FAIL: %u clusters free after close, expected %u\n", free1, free0 - (FINAL_SIZE + 4095) / 4096);
+        bad++;
+    }
+
+    /* the same recording through f_write() */
+    reset_counters();
+    if (f_open(&fil, "0:/fw.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return 1;
+    for (pos = 0, i = 0; pos < REC_SIZE; pos += sizeof(piece), i++)
+    {
+        fill_piece(pos);
+        f_write(&fil, piece, sizeof(piece), &bw);
+        if ((i % FLUSH_EVERY) == FLUSH_EVERY - 1)
+            f_sync(&fil);
+    }
+    f_close(&fil);
+    printf("f_write():      %4u disk_write() commands, %4u sectors, %3u FAT sectors\n",
+           fs_writes, fs_write_sectors, fs_fat_sectors);
+
+    f_mount(NULL, "0:", 0);
+    if (!bad)
+        printf("no FAT or directory update while streaming\n");
+    return bad ? 1 : 0;
+}
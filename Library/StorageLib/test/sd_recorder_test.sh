@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Build sd_recorder.c and FatFs against the RAM disk and the SD stream
+# model of sd_recorder_test.c and run it: a recording must not write a
+# single FAT or directory sector between sd_rec_open() and sd_rec_close().
+#
+#   test/sd_recorder_test.sh
+#
+# Stream buffers carry the non-cacheable alias, address | 0x80000000, as
+# 32-bit values, so the test is linked without PIE.
+# FatFs types are forced to 32 bits by test/host_types.h.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/sd_recorder_test.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -IInclude -Itest"
+
+# the library keeps addresses in UINT32
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host_types.h $INC -o "$OUT/test" \
+    test/sd_recorder_test.c test/host.c test/ramdisk.c \
+    $ROOT/ThirdParty/FatFs/source/ff.c || exit 1
+
+"$OUT/test"
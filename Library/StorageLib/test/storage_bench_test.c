@@ -0,0 +1,345 @@
+/*
+ * storage_bench_test - host build and check of storage_bench.c.
+ *
+ * Runs the four tests of the benchmark on the RAM disk and, when an image
+ * path is given, on a file backed disk, first as raw block tests through
+ * disk_read()/disk_write() and then as file level tests on a FAT volume
+ * made on the same medium. Every test must complete its requests, cover
+ * the test area once, fill the latency histogram with one entry per request
+ * and send exactly the requests it reports to the medium, inside the test
+ * area and with one CTRL_SYNC per raw write test. What a write test wrote
+ * must read back, and a failing medium must stop a test with FR_DISK_ERR
+ * and the requests done before the error.
+ *
+ *   storage_bench_test.sh
+ *
+ * The host figures only show that the numbers come out, they say nothing
+ * about a card.
+ */
+
+#include "host.h"
+#include "ramdisk.h"
+#include "storage_bench.h"
+
+#define DISK_SECTORS    (32 * 1024)     /* 16 MB */
+#define RAW_START       1024
+#define AREA_SECTORS    4096            /* 2 MB */
+#define MAX_REQ_SEC     64
+#define ERR_TAIL        100             /* raw area running past the end of the medium */
+
+static const UINT  req_sizes[] = { MAX_REQ_SEC, 8, 1 };
+
+static BYTE  buff[MAX_REQ_SEC * 512] __attribute__((aligned(32)));
+static BYTE  check[512];
+
+/* file backed medium */
+
+static FILE  *image;
+
+static DRESULT file_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    if ((count == 0) || (sector >= DISK_SECTORS) || (count > DISK_SECTORS - sector) ||
+        (fseek(image, (long)sector * 512, SEEK_SET) != 0) ||
+        (fread(HOST_PTR(buff), 512, count, image) != count))
+        return RES_ERROR;
+    return RES_OK;
+}
+
+static DRESULT file_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    if ((count == 0) || (sector >= DISK_SECTORS) || (count > DISK_SECTORS - sector) ||
+        (fseek(image, (long)sector * 512, SEEK_SET) != 0) ||
+        (fwrite(HOST_PTR(buff), 512, count, image) != count))
+        return RES_ERROR;
+    return RES_OK;
+}
+
+static int file_disk_open(const char *path)
+{
+    image = fopen(path, "w+b");
+    if ((image == NULL) || (fseek(image, (long)DISK_SECTORS * 512 - 1, SEEK_SET) != 0) ||
+        (fputc(0, image) == EOF) || (fflush(image) != 0))
+        return -1;
+    return 0;
+}
+
+/* counters between the benchmark and the medium */
+
+typedef struct media_stat_t
+{
+    UINT32  u32ReadCmds;
+    UINT32  u32WriteCmds;
+    UINT32  u32Syncs;
+    UINT32  u32Outside;     /* raw commands outside the test area or of another size */
+} MEDIA_STAT_T;
+
+static HOST_DISK_READ_FUNC   media_read;
+static HOST_DISK_WRITE_FUNC  media_write;
+static MEDIA_STAT_T  media_stat;
+static DWORD  raw_start, raw_end;
+static UINT   raw_count;            /* 0 while FatFs owns the medium */
+
+static void raw_check(DWORD sector, UINT count)
+{
+    if (raw_count && ((sector < raw_start) || (sector + count > raw_end) || (count != raw_count)))
+        media_stat.u32Outside++;
+}
+
+static DRESULT count_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    media_stat.u32ReadCmds++;
+    raw_check(sector, count);
+    return media_read(pdrv, buff, sector, count);
+}
+
+static DRESULT count_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    media_stat.u32WriteCmds++;
+    raw_check(sector, count);
+    return media_write(pdrv, buff, sector, count);
+}
+
+static DRESULT count_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if (cmd == CTRL_SYNC)
+    {
+        media_stat.u32Syncs++;
+        if (image != NULL)
+            return (fflush(image) == 0) ? RES_OK : RES_ERROR;
+    }
+    else if (cmd == GET_SECTOR_COUNT)
+    {
+        *(DWORD *)buff = DISK_SECTORS;
+        return RES_OK;
+    }
+    return RES_PARERR;
+}
+
+static void fill_buff(UINT32 u32Tag)
+{
+    UINT  i;
+
+    for (i = 0; i < sizeof(buff); i += 4)
+        *(UINT32 *)(buff + i) = u32Tag + i;
+}
+
+/* every request lands in one histogram bin, the area is moved once */
+static int check_result(const char *name, INT32 i32Test, const SBENCH_CFG_T *pCfg, FRESULT res,
+                        const SBENCH_RESULT_T *pResult)
+{
+    UINT32  u32Slots = pCfg->u32AreaSec / pCfg->u32ReqSec;
+    UINT32  u32Hist = 0;
+    int     i;
+
+    for (i = 0; i < SBENCH_HIST_BINS; i++)
+        u32Hist += pResult->au32Hist[i];
+
+    if ((res != FR_OK) || (pResult->u32Requests != u32Slots) ||
+        (pResult->u32Sectors != u32Slots * pCfg->u32ReqSec) || (u32Hist != pResult->u32Requests) ||
+        (pResult->u32MinLat > pResult->u32MaxLat))
+    {
+        printf("FAIL: %s test %d, %u sec/req: rc=%d, %u requests, %u sectors, %u in histogram\n",
+               name, i32Test, pCfg->u32ReqSec, res, pResult->u32Requests, pResult->u32Sectors, u32Hist);
+        return 1;
+    }
+    return 0;
+}
+
+static int run_raw(const char *name)
+{
+    SBENCH_CFG_T     cfg;
+    SBENCH_RESULT_T  result;
+    FRESULT  res;
+    UINT32   u32Cmds;
+    DWORD    s;
+    UINT     r;
+    INT32    i;
+    int      bad = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.u8Drv = 0;
+    cfg.pPath = NULL;
+    cfg.u32StartSec = RAW_START;
+    cfg.u32AreaSec = AREA_SECTORS;
+    cfg.pu8Buff = buff;
+    cfg.i32TimerNo = 0;
+    cfg.u32TicksPerSec = HOST_TICKS_PER_SEC;
+    cfg.u32Seed = 1;
+
+    raw_start = RAW_START;
+    raw_end = RAW_START + AREA_SECTORS;
+
+    for (r = 0; r < sizeof(req_sizes) / sizeof(req_sizes[0]); r++)
+    {
+        cfg.u32ReqSec = req_sizes[r];
+        raw_count = cfg.u32ReqSec;
+        for (i = 0; i < SBENCH_TESTS; i++)
+        {
+            fill_buff(r << 24);
+            memset(&media_stat, 0, sizeof(media_stat));
+            res = sbench_run(&cfg, i, &result);
+            sbench_report(&cfg, i, &result);
+            bad += check_result(name, i, &cfg, res, &result);
+
+            u32Cmds = ((i == SBENCH_SEQ_WRITE) || (i == SBENCH_RAND_WRITE)) ? media_stat.u32WriteCmds : media_stat.u32ReadCmds;
+            if ((u32Cmds != result.u32Requests) || (media_stat.u32ReadCmds + media_stat.u32WriteCmds != u32Cmds) ||
+                media_stat.u32Outside ||
+                (media_stat.u32Syncs != (((i == SBENCH_SEQ_WRITE) || (i == SBENCH_RAND_WRITE)) ? 1 : 0)))
+            {
+                printf("FAIL: %s raw test %d: %u reads, %u writes, %u syncs, %u commands outside the area\n",
+                       name, i, media_stat.u32ReadCmds, media_stat.u32WriteCmds, media_stat.u32Syncs,
+                       media_stat.u32Outside);
+                bad++;
+            }
+        }
+
+        /* the sequential write left the buffer in every slot, the random write only the same buffer again */
+        raw_count = 0;
+        for (s = RAW_START; s < RAW_START + AREA_SECTORS; s++)
+        {
+            if ((media_read(0, check, s, 1) != RES_OK) ||
+                (memcmp(check, buff + ((s - RAW_START) % cfg.u32ReqSec) * 512, 512) != 0))
+            {
+                printf("FAIL: %s raw area sector %u does not read back\n", name, s);
+                bad++;
+                break;
+            }
+        }
+        printf("\n");
+    }
+
+    /* a request past the end of the medium ends the test */
+    cfg.u32StartSec = DISK_SECTORS - ERR_TAIL;
+    cfg.u32AreaSec = 2 * ERR_TAIL;
+    cfg.u32ReqSec = 8;
+    raw_count = 0;
+    res = sbench_run(&cfg, SBENCH_SEQ_READ, &result);
+    if ((res != FR_DISK_ERR) || (result.u32Requests != ERR_TAIL / 8) || (result.u32Sectors != ERR_TAIL / 8 * 8))
+    {
+        printf("FAIL: %s read past the end: rc=%d after %u requests\n", name, res, result.u32Requests);
+        bad++;
+    }
+
+    cfg.u32ReqSec = 0;
+    if (sbench_run(&cfg, SBENCH_SEQ_READ, &result) != FR_INVALID_PARAMETER)
+    {
+        printf("FAIL: %s 0 sectors per request accepted\n", name);
+        bad++;
+    }
+    return bad;
+}
+
+static int run_file(const char *name)
+{
+    static FATFS  fs;
+    SBENCH_CFG_T     cfg;
+    SBENCH_RESULT_T  result;
+    FRESULT  res;
+    FILINFO  fno;
+    FIL      fil;
+    DWORD    s;
+    UINT     r, br;
+    INT32    i;
+    int      bad = 0;
+
+    if ((host_disk_mkfs("0:", 4096) != FR_OK) || (f_mount(&fs, "0:", 1) != FR_OK))
+    {
+        printf("FAIL: %s cannot make the test volume\n", name);
+        return 1;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.pPath = "0:/sbench.bin";
+    cfg.u32AreaSec = AREA_SECTORS;
+    cfg.pu8Buff = buff;
+    cfg.i32TimerNo = 0;
+    cfg.u32TicksPerSec = HOST_TICKS_PER_SEC;
+    cfg.u32Seed = 1;
+    cfg.u32ReqSec = MAX_REQ_SEC;
+
+    /* read tests need the file of a write test */
+    if (sbench_run(&cfg, SBENCH_SEQ_READ, &result) != FR_NO_FILE)
+    {
+        printf("FAIL: %s read test without a test file\n", name);
+        bad++;
+    }
+
+    for (r = 0; r < sizeof(req_sizes) / sizeof(req_sizes[0]); r++)
+    {
+        cfg.u32ReqSec = req_sizes[r];
+        for (i = 0; i < SBENCH_TESTS; i++)
+        {
+            fill_buff((r << 24) | 0x800000);
+            res = sbench_run(&cfg, i, &result);
+            sbench_report(&cfg, i, &result);
+            bad += check_result(name, i, &cfg, res, &result);
+        }
+
+        if ((f_stat(cfg.pPath, &fno) != FR_OK) || (fno.fsize != (FSIZE_t)AREA_SECTORS * 512) ||
+            (f_open(&fil, cfg.pPath, FA_READ) != FR_OK))
+        {
+            printf("FAIL: %s test file missing or not %u bytes\n", name, AREA_SECTORS * 512);
+            bad++;
+            continue;
+        }
+        for (s = 0; s < AREA_SECTORS; s++)
+        {
+            if ((f_read(&fil, check, 512, &br) != FR_OK) || (br != 512) ||
+                (memcmp(check, buff + (s % cfg.u32ReqSec) * 512, 512) != 0))
+            {
+                printf("FAIL: %s test file sector %u does not read back\n", name, s);
+                bad++;
+                break;
+            }
+        }
+        f_close(&fil);
+        printf("\n");
+    }
+
+    f_unlink(cfg.pPath);
+    f_mount(NULL, "0:", 0);
+    return bad;
+}
+
+static int run_suite(const char *name)
+{
+    int  bad;
+
+    host_disk_attach(0, count_read, count_write, count_ioctl);
+
+    printf("%s, raw block tests from sector %u:\n\n", name, RAW_START);
+    bad = run_raw(name);
+    printf("%s, file level tests:\n\n", name);
+    bad += run_file(name);
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    int  bad;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    ram_disk_init(DISK_SECTORS);
+    media_read = ram_disk_read;
+    media_write = ram_disk_write;
+    bad = run_suite("RAM disk");
+
+    if (argc > 1)
+    {
+        if (file_disk_open(argv[1]) != 0)
+        {
+            printf("FAIL: cannot create %s\n", argv[1]);
+            return 1;
+        }
+        media_read = file_disk_read;
+        media_write = file_disk_write;
+        bad += run_suite("file disk");
+        fclose(image);
+        image = NULL;
+    }
+
+    if (!bad)
+        printf("all tests moved their area once and read back\n");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Build storage_bench.c and FatFs against the RAM disk and a file backed
+# disk and run storage_bench_test: the four benchmark tests as raw block
+# and as file level tests, checked against what reached the medium.
+#
+#   test/storage_bench_test.sh
+#
+# FatFs types are forced to 32 bits by test/host_types.h.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/storage_bench_test.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -IInclude -Itest"
+
+# the library keeps addresses in UINT32
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host_types.h $INC -o "$OUT/test" \
+    test/storage_bench_test.c test/host.c test/ramdisk.c Source/storage_bench.c \
+    $ROOT/ThirdParty/FatFs/source/ff.c || exit 1
+
+"$OUT/test" "$OUT/disk.img"
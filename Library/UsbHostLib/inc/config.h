@@ -67,12 +67,23 @@
 #define MAX_EP_PER_IFACE       8       /*!< maximum number of endpoints per interface                 */
 #define MAX_HUB_DEVICE         8       /*!< Maximum number of hub devices                             */
 
-/* Host controller hardware transfer descriptors memory pool. ED/TD/ITD of OHCI and QH/QTD of EHCI
-   are all allocated from this pool. Allocated unit size is determined by MEM_POOL_UNIT_SIZE.
-   May allocate one or more units depend on hardware descriptor type.                                 */
+/* Host controller hardware transfer descriptors memory pool. ED/TD of OHCI and QH/qTD/iTD/siTD of
+   EHCI are allocated from per-type partitions of this pool, one MEM_POOL_UNIT_SIZE unit each.
+   A type that has used up its own partition takes units from the shared partition, so each type
+   can have up to its own number plus MEM_POOL_SHARED_NUM. Increase the number of a type, or the
+   shared number, if its allocation failed.                                                   */
 
 #define MEM_POOL_UNIT_SIZE     128     /*!< A fixed hard coding setting. Do not change it!            */
-#define MEM_POOL_UNIT_NUM      256     /*!< Increase this or heap size if memory allocate failed.     */
+#define MEM_POOL_ED_NUM        16      /*!< Number of OHCI EDs                                        */
+#define MEM_POOL_TD_NUM        32      /*!< Number of OHCI TDs                                        */
+#define MEM_POOL_QH_NUM        16      /*!< Number of EHCI QHs                                        */
+#define MEM_POOL_QTD_NUM       48      /*!< Number of EHCI qTDs                                       */
+#define MEM_POOL_ITD_NUM       32      /*!< Number of EHCI iTDs, up to 8 per isochronous UTR          */
+#define MEM_POOL_SITD_NUM      16      /*!< Number of EHCI siTDs, 8 per isochronous UTR               */
+#define MEM_POOL_SHARED_NUM    96      /*!< Number of units taken by any type beyond its own number   */
+#define MEM_POOL_UNIT_NUM      (MEM_POOL_ED_NUM + MEM_POOL_TD_NUM + MEM_POOL_QH_NUM + \
+                                MEM_POOL_QTD_NUM + MEM_POOL_ITD_NUM + MEM_POOL_SITD_NUM + \
+                                MEM_POOL_SHARED_NUM)
 
 /*----------------------------------------------------------------------------------------*/
 /*   Re-defined staff for various compiler                                                */
@@ -89,6 +100,7 @@
 #define ENABLE_DEBUG_MSG                    /* enable debug messages                      */
 //#define ENABLE_VERBOSE_DEBUG              /* verbos debug messages                      */
 //#define DUMP_DESCRIPTOR                   /* dump descriptors                           */
+//#define ENABLE_USB_TRACE                  /* record UTR submit/done into trace ring     */
 
 #ifdef ENABLE_ERROR_MSG
 #define USB_error            sysprintf
@@ -22,7 +22,33 @@ struct ep_info_t;
 /*  Periodic Frame List Size (256, 512, or 1024)                                          */
 /*----------------------------------------------------------------------------------------*/
 #define FL_SIZE              1024            /* frame list size can be 256, 512, or 1024   */
-#define NUM_IQH              11              /* depends on FL_SIZE, 256:9, 512:10, 1024:11 */
+#define PERIODIC_FRAMES      32              /* interrupt tree and bandwidth table span in
+                                                frames, power of 2 and not over FL_SIZE    */
+#define NUM_IQH              (PERIODIC_FRAMES * 2 - 1)  /* one node per interval and phase */
+
+
+/*----------------------------------------------------------------------------------------*/
+/*  Periodic bandwidth budget (USB 2.0 spec. 5.7.4 and 11.18.1)                           */
+/*----------------------------------------------------------------------------------------*/
+#define UFRAME_BW_MAX_US     100             /* 80% of a 125 us micro-frame                */
+#define TT_FRAME_BW_MAX_US   900             /* 90% of a 1 ms full speed frame behind TT   */
+
+/*
+ *  Periodic bandwidth reserved by an interrupt or isochronous endpoint. The endpoint is
+ *  serviced in frames <phase>, <phase>+<period>, ... of the bandwidth table, and in the
+ *  micro-frames of <smask> and <cmask> in each of these frames.
+ */
+typedef struct ehci_bw_t
+{
+    uint16_t      uf_interval;              /* endpoint interval in micro-frames          */
+    uint16_t      tt_us;                    /* full/low speed bus time per frame on TT    */
+    uint8_t       hs_us;                    /* bus time in each micro-frame of <smask>    */
+    uint8_t       cs_us;                    /* bus time in each micro-frame of <cmask>    */
+    uint8_t       smask;                    /* micro-frames of transfers or start-splits  */
+    uint8_t       cmask;                    /* micro-frames of complete-splits            */
+    uint8_t       period;                   /* frame period in table, 0 if not reserved   */
+    uint8_t       phase;                    /* first frame in table, 0 ~ <period>-1       */
+}  EHCI_BW_T;
 
 
 /*----------------------------------------------------------------------------------------*/
@@ -104,6 +130,7 @@ typedef struct qh_t
     qTD_T       *qtd_list;                  /* currently linked qTD transfers             */
     qTD_T       *done_list;                 /* currently linked qTD transfers             */
     struct qh_t *next;                      /* point to the next QH in remove list        */
+    EHCI_BW_T   bw;                         /* reserved bandwidth of interrupt QH         */
 }  QH_T;
 
 /*  HLink[0] T field of "Queue Head Horizontal Link Pointer" */
@@ -256,6 +283,7 @@ typedef struct sitd_t
 
 #define HLINK_IS_TERMINATED(x)    (((uint32_t)(x) & 0x1) ? 1 : 0)
 #define HLINK_IS_SITD(x)          ((((uint32_t)(x) & 0x6) == 0x4) ? 1 : 0)
+#define HLINK_IS_QH(x)            ((((uint32_t)(x) & 0x6) == 0x2) ? 1 : 0)
 
 /*----------------------------------------------------------------------------------------*/
 /*  Isochronous endpoint transfer information block. (Software only)                      */
@@ -269,9 +297,12 @@ typedef struct iso_ep_t
     siTD_T        *sitd_list;               /* Reference to a list of installed siTDs     */
     siTD_T        *sitd_done_list;          /* Reference to a list of completed siTDs     */
     struct iso_ep_t  *next;                 /* used by software to maintain ISO EP list   */
+    EHCI_BW_T     bw;                       /* reserved bandwidth                         */
 } ISO_EP_T;
 
 extern void scan_isochronous_list(void);
+extern int  ehci_bw_alloc(struct udev_t *udev, struct ep_info_t *ep, EHCI_BW_T *bw);
+extern void ehci_bw_free(EHCI_BW_T *bw);
 
 /// @endcond
 
@@ -0,0 +1,114 @@
+/**************************************************************************//**
+ * @file     uac_i2s.h
+ * @brief    USB Audio Class to I2S bridge with clock drift compensation
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __INCLUDED_UAC_I2S_H__
+#define __INCLUDED_UAC_I2S_H__
+
+#include "usbh_lib.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_Library USB Host Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_EXPORTED_CONSTANTS USB Host Exported Constants
+  @{
+*/
+
+#define UAC_RING_FIXED          0           /*!< Read exactly the frames asked, insert or drop one frame to follow drift */
+#define UAC_RING_ELASTIC        1           /*!< Read one frame more or less than asked to follow drift            */
+
+#define UAC_RING_DRIFT_SPAN     256         /*!< Drift loop gain. A fill error of E frames makes one correction every
+                                                 (target * UAC_RING_DRIFT_SPAN / E) frames read. */
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_CONSTANTS */
+
+
+/** @addtogroup N9H31_USBH_EXPORTED_STRUCT Data structure
+  @{
+*/
+
+typedef struct uac_ring_stat_t              /*!< PCM ring counters                                */
+{
+    uint32_t  level;                        /*!< Frames in ring now                               */
+    uint32_t  underrun;                     /*!< Reads that found the ring empty                  */
+    uint32_t  overrun;                      /*!< Writes that found the ring full                  */
+    uint32_t  drift_fast;                   /*!< Corrections that read one frame more             */
+    uint32_t  drift_slow;                   /*!< Corrections that read one frame less             */
+}  UAC_RING_STAT_T;
+
+/*
+ *  Single producer, single consumer PCM ring. The producer only moves head and the
+ *  consumer only moves tail, so one side can run in an interrupt handler without locking.
+ */
+typedef struct uac_ring_t                   /*!< PCM ring                                         */
+{
+    uint8_t   *buff;                        /*!< Ring storage                                     */
+    int       size;                         /*!< Ring size in bytes, multiple of frame_size       */
+    int       frame_size;                   /*!< Bytes of one sample frame of all channels        */
+    int       target;                       /*!< Fill level kept by drift compensation, in frames */
+    volatile int  head;                     /*!< Write offset, moved by producer only             */
+    volatile int  tail;                     /*!< Read offset, moved by consumer only              */
+    int       primed;                       /*!< Consumer reached target fill level once          */
+    int       phase;                        /*!< Accumulated fill error of drift compensation     */
+    volatile UAC_RING_STAT_T  stat;         /*!< Counters                                         */
+}  UAC_RING_T;
+
+typedef struct uac_i2s_t                    /*!< UAC to I2S bridge                                */
+{
+    struct uac_dev_t  *uac;                 /*!< Audio Class device                               */
+    uint32_t  srate;                        /*!< Sampling rate of both UAC and I2S                */
+    int       channels;                     /*!< Number of 16-bit channels                        */
+    int       period;                       /*!< I2S DMA half buffer in frames                    */
+    uint32_t  pkt_acc;                      /*!< Sampling rate accumulator of USB packet sizes    */
+    int       pkt_uframes;                  /*!< Speaker packet period in 125 us micro-frames     */
+    uint8_t   *play_dma;                    /*!< I2S play DMA buffer, non-cacheable               */
+    uint8_t   *rec_dma;                     /*!< I2S record DMA buffer, non-cacheable             */
+    UAC_RING_T  play;                       /*!< UAC microphone to I2S play                       */
+    UAC_RING_T  rec;                        /*!< I2S record to UAC speaker                        */
+}  UAC_I2S_T;
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_STRUCT */
+
+
+/** @addtogroup N9H31_USBH_EXPORTED_FUNCTIONS USB Host Exported Functions
+  @{
+*/
+
+extern int  uac_ring_init(UAC_RING_T *ring, uint8_t *buff, int size, int frame_size, int target);
+extern int  uac_ring_write(UAC_RING_T *ring, uint8_t *data, int len);
+extern int  uac_ring_read(UAC_RING_T *ring, uint8_t *data, int frames, int mode);
+extern void uac_ring_get_stat(UAC_RING_T *ring, UAC_RING_STAT_T *stat);
+
+extern int  uac_i2s_init(UAC_I2S_T *br, struct uac_dev_t *uac, uint32_t srate, int channels, int period);
+extern int  uac_i2s_start_play(UAC_I2S_T *br, uint8_t *dma_buff, uint8_t *ring_buff, int ring_size);
+extern int  uac_i2s_stop_play(UAC_I2S_T *br);
+extern int  uac_i2s_start_record(UAC_I2S_T *br, uint8_t *dma_buff, uint8_t *ring_buff, int ring_size);
+extern int  uac_i2s_stop_record(UAC_I2S_T *br);
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_USBH_Library */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INCLUDED_UAC_I2S_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
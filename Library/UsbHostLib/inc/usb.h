@@ -209,6 +209,9 @@ typedef struct
     /* root hub support */
     int   (*rthub_port_reset)(int port);
     int   (*rthub_polling) (void);
+
+    /* periodic bandwidth check, NULL if not accounted */
+    int   (*bw_check)(struct udev_t *udev, struct ep_info_t *ep);
 } HC_DRV_T;
 
 
@@ -312,6 +315,20 @@ typedef struct utr_t
     struct utr_t  *next;              /* point to the next UTR of the same endpoint. \hideinitializer */
 } UTR_T;
 
+/*
+ *  USB_malloc() memory pool statistics
+ */
+typedef struct usb_mem_stat_t
+{
+    uint32_t    total;                /*!< size of the memory pool               \hideinitializer */
+    uint32_t    allocated;            /*!< bytes held by allocated blocks        \hideinitializer */
+    uint32_t    requested;            /*!< bytes asked for by current allocations \hideinitializer */
+    uint32_t    max_allocated;        /*!< high-water mark of allocated          \hideinitializer */
+    uint32_t    largest_free;         /*!< largest block that can be allocated   \hideinitializer */
+    uint32_t    alloc_cnt;            /*!< number of successful allocations      \hideinitializer */
+    uint32_t    fail_cnt;             /*!< number of failed allocations          \hideinitializer */
+} USB_MEM_STAT_T;
+
 
 /*----------------------------------------------------------------------------------*/
 /*  Global variables                                                                */
@@ -352,6 +369,9 @@ extern void * USB_malloc(int wanted_size, int boundary);
 extern void USB_free(void *);
 extern int  USB_available_memory(void);
 extern int  USB_allocated_memory(void);
+extern void USB_memory_stat(USB_MEM_STAT_T *stat);
+extern int  usb_mem_lock(void);
+extern void usb_mem_unlock(int flags);
 extern void usbh_memory_init(void);
 extern uint32_t  usbh_memory_used(void);
 extern void * usbh_alloc_mem(int size);
@@ -376,11 +396,23 @@ extern siTD_T * alloc_ehci_siTD(void);
 extern void free_ehci_siTD(siTD_T *sitd);
 
 
+/*
+ *  Hub events posted from interrupt handlers. usbh_pooling_hubs() only handles the
+ *  sources which have posted an event since its last call.
+ */
+#define HUB_EVT_EHCI_RH        0x1       /* EHCI root hub port change                  */
+#define HUB_EVT_OHCI_RH        0x2       /* OHCI root hub port change                  */
+#define HUB_EVT_HUB            0x4       /* status change reported by an external hub  */
+#define HUB_EVT_ALL            0x7
+
 extern void usbh_hub_init(void);
+extern void usbh_hub_event(uint32_t event);
+extern void usbh_hub_service(void);
 extern int  connect_device(UDEV_T *);
 extern void disconnect_device(UDEV_T *);
 extern int  usbh_register_driver(UDEV_DRV_T *driver);
 extern EP_INFO_T * usbh_iface_find_ep(IFACE_T *iface, uint8_t ep_addr, uint8_t dir_type);
+extern int  usbh_check_alt_bandwidth(IFACE_T *iface, ALT_IFACE_T *aif);
 extern int  usbh_reset_device(UDEV_T *);
 
 /*
@@ -396,6 +428,23 @@ extern int usbh_ctrl_xfer(UDEV_T *udev, uint8_t bmRequestType, uint8_t bRequest,
 extern int usbh_bulk_xfer(UTR_T *utr);
 extern int usbh_int_xfer(UTR_T *utr);
 extern int usbh_iso_xfer(UTR_T *utr);
+extern int usbh_iso_xfer_batch(UTR_T *utr[], int count);
+
+/*
+ *  Transfer trace. Submit records are written by usb_core.c, done records by the host
+ *  controller drivers right before calling back utr->func().
+ */
+#ifdef ENABLE_USB_TRACE
+extern USBH_TRACE_REC_T  *_usbh_trace_ring;
+extern void usbh_trace_utr(UTR_T *utr, int event, int status);
+#define USB_TRACE_SUBMIT(utr)       do { if (_usbh_trace_ring != NULL) usbh_trace_utr(utr, USBH_TRACE_SUBMIT, 0); } while (0)
+#define USB_TRACE_DONE(utr)         do { if (_usbh_trace_ring != NULL) usbh_trace_utr(utr, USBH_TRACE_DONE, (utr)->status); } while (0)
+#define USB_TRACE_FAIL(utr, ret)    do { if (_usbh_trace_ring != NULL) usbh_trace_utr(utr, USBH_TRACE_DONE, ret); } while (0)
+#else
+#define USB_TRACE_SUBMIT(utr)
+#define USB_TRACE_DONE(utr)
+#define USB_TRACE_FAIL(utr, ret)
+#endif
 extern int usbh_quit_utr(UTR_T *utr);
 extern int usbh_quit_xfer(UDEV_T *udev, EP_INFO_T *ep);
 
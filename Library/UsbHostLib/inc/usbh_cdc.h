@@ -29,6 +29,8 @@ extern "C"
 
 #define CDC_STATUS_BUFF_SIZE    64
 #define CDC_RX_BUFF_SIZE        512
+#define CDC_QUEUE_DEPTH_MAX     8           /* maximum UTRs of a bulk queue          */
+#define CDC_QUEUE_RETRY_MAX     3           /* bulk in recoveries before giving up   */
 
 /* Interface Class Codes (defined in usbh.h) */
 //#define USB_CLASS_COMM        0x02
@@ -140,6 +142,28 @@ typedef struct __attribute__((__packed__)) cdc_if_header
 
 struct cdc_dev_t;
 
+/*
+ *  Queued bulk transfer. UTR slots are used round robin and slots [head, head+cnt) hold
+ *  data in order. Bulk in: slot (head+cnt) is on the bus if posted is set. Bulk out: slot
+ *  head is on the bus if posted is set. The host controller drivers take one UTR per bulk
+ *  endpoint, so at most one slot is on the bus and depth is a number of buffers, not of
+ *  pre-posted transfers. The next slot is posted from the completion interrupt before the
+ *  data of the completed one is handled.
+ */
+typedef struct cdc_queue_t
+{
+    UTR_T               *utr[CDC_QUEUE_DEPTH_MAX];
+    int                 depth;          /* number of UTR slots                                */
+    int                 xfer_size;      /* buffer size of a UTR slot                          */
+    int                 head;           /* oldest slot holding data                           */
+    int                 cnt;            /* number of slots holding data                       */
+    volatile uint8_t    posted;         /* a slot is submitted                                */
+    uint8_t             running;        /* cleared to stop posting                            */
+    uint8_t             failed;         /* bulk in failed, recovered by usbh_cdc_read()       */
+    uint8_t             retry;          /* recoveries since the last good transfer            */
+    uint32_t            last_ticks;     /* get_ticks() of the last completion                 */
+}   CDC_QUEUE_T;
+
 /// @endcond HIDDEN_SYMBOLS
 
 
@@ -168,6 +192,24 @@ typedef struct __attribute__((__packed__)) line_coding_t
 }  LINE_CODING_T;
 #endif
 
+/*
+ *  Queued bulk transfer counters
+ */
+typedef struct cdc_queue_stat_t
+{
+    uint32_t   rx_xfers;               /* Bulk in transfers completed                             */
+    uint32_t   rx_bytes;               /* Bytes received                                          */
+    uint32_t   rx_errors;              /* Bulk in transfers failed                                */
+    uint32_t   rx_gaps;                /* Completions that found no free UTR to post next         */
+    uint32_t   rx_gap_max;             /* Longest time between two completions, in get_ticks()    */
+    uint32_t   rx_throttle;            /* Times the receive ring filled up and receiving paused   */
+    uint32_t   tx_xfers;               /* Bulk out transfers completed                            */
+    uint32_t   tx_bytes;               /* Bytes sent                                              */
+    uint32_t   tx_errors;              /* Bulk out transfers failed                               */
+    uint32_t   tx_gaps;                /* Completions that found no more data queued to send      */
+    uint32_t   tx_full;                /* usbh_cdc_write() calls that could not queue all data    */
+}  CDC_QUEUE_STAT_T;
+
 /*
  * USB-specific CDC device struct
  */
@@ -189,6 +231,15 @@ typedef struct cdc_dev_t
     uint8_t             rx_busy;        /* Bulk in transfer is on going                       */
     struct cdc_dev_t    *next;
     void                *client;
+    CDC_QUEUE_T         rxq;            /* Queued bulk in                                     */
+    CDC_QUEUE_T         txq;            /* Queued bulk out                                    */
+    uint8_t             *rx_ring;       /* Receive ring provided by user                      */
+    int                 rx_ring_size;
+    volatile int        rx_ring_head;   /* Moved by bulk in completion only                   */
+    volatile int        rx_ring_tail;   /* Moved by usbh_cdc_read() only                      */
+    CDC_FC_FUNC         *fc_func;       /* Receive flow control callback                      */
+    uint8_t             rx_throttled;   /* Receiving paused for a full receive ring           */
+    CDC_QUEUE_STAT_T    qstat;          /* Queued bulk transfer counters                      */
 }   CDC_DEV_T;
 
 /*@}*/ /* end of group USBH_EXPORTED_STRUCTURES */
@@ -51,6 +51,7 @@ extern "C"
 #define USBH_ERR_PORT_RESET         -255   /*!< Hub port reset failed                           */
 #define USBH_ERR_SCH_OVERRUN        -257   /*!< USB isochronous schedule overrun                */
 #define USBH_ERR_DISCONNECTED       -259   /*!< USB device was disconnected                     */
+#define USBH_ERR_NO_BANDWIDTH       -261   /*!< Not enough periodic bandwidth for the endpoint  */
 
 #define USBH_ERR_TRANSACTION        -271   /*!< USB transaction timeout, CRC, Bad PID, etc.     */
 #define USBH_ERR_BABBLE_DETECTED    -272   /*!< A babble is detected during the transaction   */
@@ -77,6 +78,9 @@ extern "C"
 #define USBH_ERR_EHCI_INIT          -501   /*!< Failed to initialize EHCI controller.           */
 #define USBH_ERR_EHCI_QH_BUSY       -503   /*!< the Queue Head is busy.                         */
 
+#define USBH_TRACE_SUBMIT           1      /*!< Trace record of an UTR submitted                */
+#define USBH_TRACE_DONE             2      /*!< Trace record of an UTR completed or aborted     */
+
 #define UMAS_OK                     0      /*!< No error.                                       */
 #define UMAS_ERR_NO_DEVICE          -1031  /*!< No Mass Stroage Device found.                   */
 #define UMAS_ERR_IO                 -1033  /*!< Device read/write failed.                       */
@@ -118,6 +122,7 @@ extern "C"
 #define UVC_RET_NOT_SUPPORT         -3012  /*!< Not supported.                                  */
 #define UVC_RET_PARSER              -3013  /*!< Failed to parse UVC descriptor                  */
 #define UVC_RET_IS_STREAMING        -3015  /*!< Video pipe is on streaming.                     */
+#define UVC_RET_NO_FRAME            -3017  /*!< No received image is ready in the frame ring.   */
 
 /*@}*/ /* end of group N9H31_USBH_EXPORTED_CONSTANTS */
 
@@ -127,9 +132,13 @@ extern "C"
 */
 struct udev_t;
 typedef void (CONN_FUNC)(struct udev_t *udev, int param);
+typedef void (HUB_EVT_FUNC)(void);         /*!< hub event callback function \hideinitializer */
+typedef uint32_t (USBH_TIMER_FUNC)(void);  /*!< free-running counter read function \hideinitializer */
 struct line_coding_t;
 struct cdc_dev_t;
+struct cdc_queue_stat_t;
 typedef void (CDC_CB_FUNC)(struct cdc_dev_t *cdev, uint8_t *rdata, int data_len);
+typedef void (CDC_FC_FUNC)(struct cdc_dev_t *cdev, int throttle);     /*!< receive flow control callback function \hideinitializer */
 
 struct usbhid_dev;
 typedef void (HID_IR_FUNC)(struct usbhid_dev *hdev, uint16_t ep_addr, int status, uint8_t *rdata, uint32_t data_len);    /*!< interrupt in callback function \hideinitializer */
@@ -151,6 +160,54 @@ typedef enum image_format_e
     UVC_FORMAT_MJPEG   = 11,
 }  IMAGE_FORMAT_E;
 
+typedef struct umas_stat_t             /*!< USB mass storage transfer statistics of a drive */
+{
+    uint32_t  read_req;                /*!< usbh_umas_read() calls                          */
+    uint32_t  write_req;               /*!< usbh_umas_write() calls                         */
+    uint32_t  read_cmd;                /*!< READ_10 commands sent to the device             */
+    uint32_t  write_cmd;               /*!< WRITE_10 commands sent to the device            */
+    uint32_t  read_sectors;            /*!< Sectors moved by READ_10 commands               */
+    uint32_t  write_sectors;           /*!< Sectors moved by WRITE_10 commands              */
+    uint32_t  cache_hits;              /*!< Sectors read served from the sector cache       */
+    uint32_t  write_merges;            /*!< Write requests merged into a pending write run  */
+    uint32_t  cache_read_ahead;        /*!< Read misses that loaded a whole cache window    */
+}  UMAS_STAT_T;
+
+typedef struct uvc_frame_t             /*!< An image buffer of the UVC frame ring           */
+{
+    uint8_t   *buff;                   /*!< Image buffer provided by user                   */
+    int       buff_size;               /*!< Size of the image buffer                        */
+    int       len;                     /*!< Length of the received image                    */
+    uint32_t  pts;                     /*!< Presentation time stamp of the payload header, 0 if not sent */
+    uint32_t  ticks;                   /*!< get_ticks() when the image was completed        */
+    uint32_t  seq;                     /*!< Sequence number of the image                    */
+    uint8_t   state;                   /*!< Used by the UVC driver                          */
+}  UVC_FRAME_T;
+
+typedef struct usbh_irq_stat_t         /*!< EHCI interrupt handler counters                 */
+{
+    uint32_t  irq_cnt;                 /*!< Interrupts handled                              */
+    uint32_t  cycles_total;            /*!< Sum of counter ticks spent in the handler       */
+    uint32_t  cycles_max;              /*!< Longest handler run in counter ticks            */
+    uint32_t  iso_visited;             /*!< iTDs/siTDs visited by reclamation scan          */
+    uint32_t  iso_reclaimed;           /*!< iTDs/siTDs reclaimed by reclamation scan        */
+}  USBH_IRQ_STAT_T;
+
+typedef struct usbh_trace_rec_t        /*!< A record of the transfer trace ring             */
+{
+    uint32_t  seq;                     /*!< Record sequence number, gaps mean lost records  */
+    uint32_t  ticks;                   /*!< Timer counter, or get_ticks() if no timer given */
+    uint32_t  utr;                     /*!< UTR address, pairs SUBMIT and DONE records      */
+    uint32_t  len;                     /*!< SUBMIT: requested length, DONE: transferred length */
+    int16_t   status;                  /*!< DONE: UTR status or submit error, SUBMIT: 0     */
+    uint8_t   event;                   /*!< USBH_TRACE_SUBMIT or USBH_TRACE_DONE            */
+    uint8_t   hc;                      /*!< 0: OHCI, 1: EHCI                                */
+    uint8_t   dev_num;                 /*!< Device number                                   */
+    uint8_t   ep_addr;                 /*!< Endpoint address, 0 for control transfer        */
+    uint8_t   ep_type;                 /*!< Endpoint transfer type, bmAttributes bits 1..0  */
+    uint8_t   reserved;
+}  USBH_TRACE_REC_T;
+
 /*@}*/ /* end of group N9H31_USBH_EXPORTED_STRUCT */
 
 
@@ -167,10 +224,20 @@ typedef enum image_format_e
 /*------------------------------------------------------------------*/
 extern void usbh_core_init(void);
 extern int  usbh_pooling_hubs(void);
+extern int  usbh_hub_event_pending(void);
+extern void usbh_install_hub_event_callback(HUB_EVT_FUNC *func);
+extern int  usbh_start_hub_task(uint32_t priority, HUB_EVT_FUNC *change_func);   /* FreeRTOS only, hub_task.c */
 extern void usbh_install_conn_callback(CONN_FUNC *conn_func, CONN_FUNC *disconn_func);
 extern void usbh_suspend(void);
 extern void usbh_resume(void);
 extern struct udev_t * usbh_find_device(char *hub_id, int port);
+extern void usbh_install_irq_timer(USBH_TIMER_FUNC *func, uint32_t mask);
+extern void usbh_get_irq_stat(USBH_IRQ_STAT_T *stat, int clear);
+extern int  usbh_trace_start(USBH_TRACE_REC_T *ring, int count, USBH_TIMER_FUNC *timer, uint32_t mask);   /* ENABLE_USB_TRACE only */
+extern void usbh_trace_stop(void);
+extern int  usbh_trace_read(USBH_TRACE_REC_T *rec, int max_cnt);
+extern void usbh_trace_dump(void);
+extern void usbh_trace_dump_stat(void);
 extern uint32_t get_ticks(void);   /* This function must be provided by user application. */
 
 /*------------------------------------------------------------------*/
@@ -188,6 +255,13 @@ extern int32_t  usbh_cdc_set_control_line_state(struct cdc_dev_t *cdev, int acti
 extern int32_t  usbh_cdc_start_polling_status(struct cdc_dev_t *cdev, CDC_CB_FUNC *func);
 extern int32_t  usbh_cdc_start_to_receive_data(struct cdc_dev_t *cdev, CDC_CB_FUNC *func);
 extern int32_t  usbh_cdc_send_data(struct cdc_dev_t *cdev, uint8_t *buff, int buff_len);
+extern int32_t  usbh_cdc_start_rx_queue(struct cdc_dev_t *cdev, int depth, int xfer_size, uint8_t *ring_buff, int ring_size, CDC_FC_FUNC *fc_func);
+extern int32_t  usbh_cdc_stop_rx_queue(struct cdc_dev_t *cdev);
+extern int      usbh_cdc_read(struct cdc_dev_t *cdev, uint8_t *buff, int len);
+extern int32_t  usbh_cdc_start_tx_queue(struct cdc_dev_t *cdev, int depth, int xfer_size);
+extern int32_t  usbh_cdc_stop_tx_queue(struct cdc_dev_t *cdev);
+extern int      usbh_cdc_write(struct cdc_dev_t *cdev, uint8_t *data, int len);
+extern void     usbh_cdc_get_queue_stat(struct cdc_dev_t *cdev, struct cdc_queue_stat_t *stat, int clear);
 
 /*------------------------------------------------------------------*/
 /*                                                                  */
@@ -219,6 +293,8 @@ extern int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *bu
 extern int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff);
 extern int  usbh_umas_ioctl(int drv_no, int cmd, void *buff);
 extern int  usbh_umas_reset_disk(int drv_no);
+extern int  usbh_umas_get_stat(int drv_no, UMAS_STAT_T *stat);
+extern int  usbh_umas_reset_stat(int drv_no);
 
 /*------------------------------------------------------------------*/
 /*                                                                  */
@@ -252,6 +328,10 @@ extern int  usbh_set_video_format(struct uvc_dev_t *vdev, IMAGE_FORMAT_E format,
 extern void usbh_uvc_set_video_buffer(struct uvc_dev_t *vdev, uint8_t *image_buff, int img_buff_size);
 extern int usbh_uvc_start_streaming(struct uvc_dev_t *vdev, UVC_CB_FUNC *func);
 extern int usbh_uvc_stop_streaming(struct uvc_dev_t *vdev);
+extern int  usbh_uvc_set_frame_ring(struct uvc_dev_t *vdev, uint8_t *buff[], int buff_size, int count);
+extern UVC_FRAME_T * usbh_uvc_acquire_frame(struct uvc_dev_t *vdev);
+extern int  usbh_uvc_release_frame(struct uvc_dev_t *vdev, UVC_FRAME_T *frame);
+extern void usbh_uvc_get_frame_stat(struct uvc_dev_t *vdev, uint32_t *received, uint32_t *dropped, uint32_t *errors);
 
 /// @cond HIDDEN_SYMBOLS
 
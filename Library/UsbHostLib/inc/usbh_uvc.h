@@ -25,6 +25,7 @@
 #define UVC_UTR_PER_STREAM      4
 // #define IF_PER_UTR           8           /* defined in usb.h                        */
 #define UVC_UTR_INBUF_SIZE      (IF_PER_UTR * 3072)
+#define UVC_MAX_FRAME_BUFF      4           /* Maximum number of image buffers in the frame ring */
 
 #define UVC_REQ_TIMEOUT         50          /*!< UAC control request timeout value in tick (10ms unit)     */
 
@@ -569,6 +570,14 @@ typedef struct uvc_ctrl_t
 #define UVC_PL_EOF    0x02
 #define UVC_PL_FID    0x01
 
+/*
+ *  Frame ring image buffer state
+ */
+#define UVC_FRAME_FREE      0               /* free to receive an image                   */
+#define UVC_FRAME_FILLING   1               /* an image is being received into it         */
+#define UVC_FRAME_READY     2               /* holding an image not yet acquired by user  */
+#define UVC_FRAME_ACQUIRED  3               /* image acquired by user                     */
+
 
 typedef struct uvc_strm_t
 {
@@ -628,6 +637,14 @@ typedef struct uvc_dev_t
     int               img_buff_size;  /* Size of the image buffer provided by user          */
     int               img_size;       /* Size of the image data stored in img_buff          */
     UVC_CB_FUNC       *func_rx;       /* user callback function for receiving images        */
+    UVC_FRAME_T       frame[UVC_MAX_FRAME_BUFF];      /* frame ring image buffers           */
+    int               frame_num;      /* number of frame ring buffers, 0 if not used        */
+    int               frame_fill;     /* index of the image buffer being received, or -1    */
+    uint8_t           ready_q[UVC_MAX_FRAME_BUFF];    /* ready images, oldest first         */
+    int               ready_cnt;      /* number of images in ready_q                        */
+    uint32_t          frame_seq;      /* number of images received                          */
+    uint32_t          frame_drop;     /* images dropped for no free image buffer            */
+    uint32_t          frame_err;      /* images dropped for stream errors or overrun        */
     struct uvc_dev_t  *next;
 }   UVC_DEV_T;
 /*@}*/ /* end of group N9H31_USBH_EXPORTED_STRUCTURES */
@@ -0,0 +1,102 @@
+/**************************************************************************//**
+ * @file     uvc_display.h
+ * @brief    UVC MJPEG to LCD display pipeline
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#ifndef __INCLUDED_UVC_DISPLAY_H__
+#define __INCLUDED_UVC_DISPLAY_H__
+
+#include "usbh_lib.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_Library USB Host Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_EXPORTED_CONSTANTS USB Host Exported Constants
+  @{
+*/
+
+#define UVC_DISP_FB_MAX         3           /*!< Maximum number of display buffers                */
+#define UVC_DISP_STOP_TIMEOUT   50          /*!< uvc_disp_stop() wait for decode, in get_ticks() unit */
+
+#define UVC_DISP_LAYER_VA       0           /*!< Flip the VPOST video layer buffer                */
+#define UVC_DISP_LAYER_OSD      1           /*!< Flip the VPOST OSD layer buffer                  */
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_CONSTANTS */
+
+
+/** @addtogroup N9H31_USBH_EXPORTED_STRUCT Data structure
+  @{
+*/
+
+typedef struct uvc_disp_stat_t              /*!< Display pipeline counters                        */
+{
+    uint32_t  shown;                        /*!< Images flipped onto the panel                    */
+    uint32_t  decoded;                      /*!< Images decoded                                   */
+    uint32_t  skipped;                      /*!< Images received or decoded but never shown       */
+    uint32_t  decode_err;                   /*!< Images failed to decode                          */
+    uint32_t  lat_min;                      /*!< Shortest image received to shown time, in get_ticks() unit */
+    uint32_t  lat_max;                      /*!< Longest image received to shown time             */
+    uint32_t  lat_avg;                      /*!< Average image received to shown time             */
+}  UVC_DISP_STAT_T;
+
+typedef struct uvc_disp_t                   /*!< Display pipeline                                 */
+{
+    struct uvc_dev_t  *vdev;                /*!< UVC device streaming in frame ring mode          */
+    uint8_t   *fb[UVC_DISP_FB_MAX];         /*!< Display buffers, non-cacheable                   */
+    int       fb_cnt;                       /*!< Number of display buffers                        */
+    int       width;                        /*!< Display width in pixels                          */
+    int       height;                       /*!< Display height in pixels                         */
+    int       img_width;                    /*!< Camera image width in pixels                     */
+    int       img_height;                   /*!< Camera image height in pixels                    */
+    uint32_t  out_format;                   /*!< JPEG decode output format                        */
+    int       layer;                        /*!< UVC_DISP_LAYER_VA or UVC_DISP_LAYER_OSD          */
+    volatile int  front;                    /*!< Display buffer on the panel                      */
+    volatile int  pending;                  /*!< Decoded buffer waiting for vsync, or -1          */
+    int       decode;                       /*!< Display buffer being decoded into, or -1         */
+    UVC_FRAME_T   *frame;                   /*!< Image being decoded                              */
+    uint32_t  decode_ticks;                 /*!< Receive time of the image being decoded          */
+    uint32_t  pending_ticks;                /*!< Receive time of the pending image                */
+    volatile UVC_DISP_STAT_T  stat;         /*!< Counters                                         */
+    volatile uint32_t  lat_sum;             /*!< Sum of latencies of shown images                 */
+}  UVC_DISP_T;
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_STRUCT */
+
+
+/** @addtogroup N9H31_USBH_EXPORTED_FUNCTIONS USB Host Exported Functions
+  @{
+*/
+
+extern int  uvc_disp_init(UVC_DISP_T *disp, struct uvc_dev_t *vdev, uint8_t *fb[], int fb_cnt,
+                          int width, int height, int img_width, int img_height, uint32_t out_format, int layer);
+extern int  uvc_disp_poll(UVC_DISP_T *disp);
+extern void uvc_disp_stop(UVC_DISP_T *disp);
+extern void uvc_disp_vsync(UVC_DISP_T *disp);
+extern void uvc_disp_get_stat(UVC_DISP_T *disp, UVC_DISP_STAT_T *stat);
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_USBH_Library */
+
+/*@}*/ /* end of group N9H31_Library */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INCLUDED_UVC_DISPLAY_H__ */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
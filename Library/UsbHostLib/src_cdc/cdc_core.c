@@ -439,6 +439,585 @@ int32_t usbh_cdc_send_data(CDC_DEV_T *cdev, uint8_t *buff, int buff_len)
     return 0;
 }
 
+/// @cond HIDDEN_SYMBOLS
+
+static EP_INFO_T * cdc_get_bulk_ep(CDC_DEV_T *cdev, int dir)
+{
+    EP_INFO_T   *ep;
+
+    ep = (dir == EP_ADDR_DIR_IN) ? cdev->ep_rx : cdev->ep_tx;
+    if (ep != NULL)
+        return ep;
+
+    ep = usbh_iface_find_ep(cdev->iface_data, 0, dir | EP_ATTR_TT_BULK);
+    if (ep == NULL)
+    {
+        CDC_DBGMSG("Bulk-%s endpoint not found in this CDC device!\n", (dir == EP_ADDR_DIR_IN) ? "in" : "out");
+        return NULL;
+    }
+    if (dir == EP_ADDR_DIR_IN)
+        cdev->ep_rx = ep;
+    else
+        cdev->ep_tx = ep;
+    return ep;
+}
+
+static void  cdc_queue_free(CDC_QUEUE_T *q)
+{
+    int   i;
+
+    for (i = 0; i < q->depth; i++)
+    {
+        if (q->utr[i] == NULL)
+            continue;
+        if (q->utr[i]->buff != NULL)
+            usbh_free_mem(q->utr[i]->buff, q->xfer_size);
+        free_utr(q->utr[i]);
+        q->utr[i] = NULL;
+    }
+    q->depth = 0;
+}
+
+static int  cdc_queue_alloc(CDC_DEV_T *cdev, CDC_QUEUE_T *q, EP_INFO_T *ep, int depth, int xfer_size, FUNC_UTR_T func)
+{
+    UTR_T   *utr;
+    int     i;
+
+    memset(q, 0, sizeof(*q));
+    q->depth = depth;
+    q->xfer_size = xfer_size;
+
+    for (i = 0; i < depth; i++)
+    {
+        utr = alloc_utr(cdev->udev);
+        if (utr == NULL)
+            goto mem_out;
+        q->utr[i] = utr;
+
+        utr->buff = (uint8_t *)usbh_alloc_mem(xfer_size);
+        if (utr->buff == NULL)
+            goto mem_out;
+        utr->context = cdev;
+        utr->ep = ep;
+        utr->data_len = xfer_size;
+        utr->func = func;
+    }
+    return 0;
+
+mem_out:
+    CDC_DBGMSG("Failed to allocated UTR queue!\n");
+    cdc_queue_free(q);
+    return USBH_ERR_MEMORY_OUT;
+}
+
+/*
+ *  Stop posting and abort the UTR on the bus. Waits for the abort call back, so that the
+ *  UTRs can be freed. If it does not come, the UTRs may still be owned by the host
+ *  controller. They are kept allocated and the queue stays stopped, so that a later call
+ *  can free them.
+ */
+static int  cdc_queue_stop(CDC_QUEUE_T *q, int slot)
+{
+    uint32_t  t0;
+    int       flags;
+
+    flags = usb_mem_lock();
+    q->running = 0;
+    usb_mem_unlock(flags);
+
+    if (q->posted)
+    {
+        usbh_quit_utr(q->utr[slot]);
+        t0 = get_ticks();
+        while (q->posted && (get_ticks() - t0 < USB_XFER_TIMEOUT))
+            ;
+        if (q->posted)
+        {
+            CDC_ERRMSG("CDC queue stop - UTR not returned, buffers kept!\n");
+            return USBH_ERR_TIMEOUT;
+        }
+    }
+    cdc_queue_free(q);
+    return 0;
+}
+
+/*
+ *  Submit the next free bulk in slot, if any. Called with USB interrupts held off.
+ */
+static int  cdc_rxq_post(CDC_DEV_T *cdev)
+{
+    CDC_QUEUE_T  *q = &cdev->rxq;
+    UTR_T   *utr;
+    int     ret;
+
+    if (!q->running || q->failed || q->posted || (q->cnt >= q->depth))
+        return 0;
+
+    utr = q->utr[(q->head + q->cnt) % q->depth];
+    utr->data_len = q->xfer_size;
+    utr->xfer_len = 0;
+    utr->bIsTransferDone = 0;
+
+    ret = usbh_bulk_xfer(utr);
+    if (ret < 0)
+    {
+        cdev->qstat.rx_errors++;            /* retried on the next usbh_cdc_read()        */
+        return ret;
+    }
+    q->posted = 1;
+    return 0;
+}
+
+/*
+ *  Copy data of completed bulk in slots into the receive ring, oldest first. A slot stays
+ *  queued if the ring has no room for all of its data. Called with USB interrupts held off.
+ */
+static void  cdc_rxq_drain(CDC_DEV_T *cdev)
+{
+    CDC_QUEUE_T  *q = &cdev->rxq;
+    UTR_T   *utr;
+    int     head, room, len, n;
+
+    while (q->cnt > 0)
+    {
+        utr = q->utr[q->head];
+        len = utr->xfer_len;
+        head = cdev->rx_ring_head;
+        room = (cdev->rx_ring_tail - head - 1 + cdev->rx_ring_size) % cdev->rx_ring_size;
+        if (len > room)
+            break;
+
+        n = cdev->rx_ring_size - head;      /* contiguous room up to the ring end         */
+        if (n > len)
+            n = len;
+        memcpy(cdev->rx_ring + head, utr->buff, n);
+        memcpy(cdev->rx_ring, utr->buff + n, len - n);
+        cdev->rx_ring_head = (head + len) % cdev->rx_ring_size;
+
+        q->head = (q->head + 1) % q->depth;
+        q->cnt--;
+    }
+}
+
+/*
+ * CDC queued BULK-in complete function
+ */
+static void  cdc_rxq_irq(UTR_T *utr)
+{
+    CDC_DEV_T    *cdev = (CDC_DEV_T *)utr->context;
+    CDC_QUEUE_T  *q = &cdev->rxq;
+    uint32_t     now;
+
+    q->posted = 0;
+
+    if (utr->status < 0)
+    {
+        /*
+         *  Posting again from here would loop on a stalled or halted endpoint. Stop posting
+         *  and let usbh_cdc_read() clear the halt in task context.
+         */
+        cdev->qstat.rx_errors++;
+        if ((utr->status == USBH_ERR_ABORT) || (utr->status == USBH_ERR_DISCONNECTED))
+            q->running = 0;
+        else
+            q->failed = 1;
+        return;
+    }
+    q->retry = 0;
+
+    now = get_ticks();
+    if ((q->last_ticks != 0) && (now - q->last_ticks > cdev->qstat.rx_gap_max))
+        cdev->qstat.rx_gap_max = now - q->last_ticks;
+    q->last_ticks = now;
+
+    cdev->qstat.rx_xfers++;
+    cdev->qstat.rx_bytes += utr->xfer_len;
+    q->cnt++;                               /* this slot now holds data                   */
+
+    cdc_rxq_post(cdev);                     /* keep the bus busy before copying           */
+    if (!q->posted)
+        cdev->qstat.rx_gaps++;
+
+    cdc_rxq_drain(cdev);
+    cdc_rxq_post(cdev);
+
+    if ((q->cnt > 0) && !cdev->rx_throttled)
+    {
+        cdev->rx_throttled = 1;             /* receive ring is full                       */
+        cdev->qstat.rx_throttle++;
+        if (cdev->fc_func)
+            cdev->fc_func(cdev, 1);
+    }
+}
+
+/*
+ *  Clear the halt of a failed bulk in endpoint and let the queue post again. Called in task
+ *  context. The hardware pipe is dropped, so that the next transfer starts with DATA0 as the
+ *  device does after CLEAR_FEATURE.
+ */
+static int  cdc_rxq_recover(CDC_DEV_T *cdev)
+{
+    CDC_QUEUE_T  *q = &cdev->rxq;
+    EP_INFO_T    *ep = cdev->ep_rx;
+    int   flags;
+
+    if (q->retry >= CDC_QUEUE_RETRY_MAX)
+        return USBH_ERR_TRANSFER;           /* restart the queue to try again             */
+    q->retry++;
+
+    usbh_clear_halt(cdev->udev, ep->bEndpointAddress);
+    cdev->udev->hc_driver->quit_xfer(NULL, ep);
+    ep->bToggle = 0;
+
+    flags = usb_mem_lock();
+    q->failed = 0;
+    usb_mem_unlock(flags);
+    return 0;
+}
+
+/*
+ *  Submit the oldest bulk out slot. Called with USB interrupts held off.
+ */
+static int  cdc_txq_post(CDC_DEV_T *cdev)
+{
+    CDC_QUEUE_T  *q = &cdev->txq;
+    UTR_T   *utr;
+    int     ret;
+
+    if (!q->running || q->posted || (q->cnt == 0))
+        return 0;
+
+    utr = q->utr[q->head];
+    utr->xfer_len = 0;
+    utr->bIsTransferDone = 0;
+
+    ret = usbh_bulk_xfer(utr);
+    if (ret < 0)
+    {
+        cdev->qstat.tx_errors++;            /* retried on the next usbh_cdc_write()       */
+        return ret;
+    }
+    q->posted = 1;
+    return 0;
+}
+
+/*
+ * CDC queued BULK-out complete function
+ */
+static void  cdc_txq_irq(UTR_T *utr)
+{
+    CDC_DEV_T    *cdev = (CDC_DEV_T *)utr->context;
+    CDC_QUEUE_T  *q = &cdev->txq;
+
+    q->posted = 0;
+
+    if (utr->status < 0)
+    {
+        cdev->qstat.tx_errors++;
+        if ((utr->status == USBH_ERR_ABORT) || (utr->status == USBH_ERR_DISCONNECTED))
+        {
+            q->running = 0;
+            return;
+        }
+    }
+    else
+    {
+        cdev->qstat.tx_xfers++;
+        cdev->qstat.tx_bytes += utr->xfer_len;
+    }
+
+    q->head = (q->head + 1) % q->depth;     /* data of a failed slot is dropped           */
+    q->cnt--;
+
+    if (q->cnt > 0)
+        cdc_txq_post(cdev);
+    else
+        cdev->qstat.tx_gaps++;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+/**
+ * @brief  Start queued receiving from the CDC device's bulk-in transfer pipe. One bulk-in transfer
+ *         is on the bus at a time, and the next one is issued in the completion interrupt of the
+ *         previous one. Received data is copied into a receive ring to be read by usbh_cdc_read().
+ *         If the ring is full, completed transfers are held in the queue, and receiving pauses
+ *         once all of them are held. The device then sees NAK until usbh_cdc_read() makes room.
+ *         A failed transfer stops receiving, and usbh_cdc_read() clears the endpoint halt and
+ *         resumes it, up to CDC_QUEUE_RETRY_MAX times in a row.
+ *  @param[in] cdev       CDC device
+ *  @param[in] depth      Number of bulk-in transfer buffers, 2 ~ CDC_QUEUE_DEPTH_MAX. This is
+ *                        how many completed transfers can be held, not how many are posted.
+ *  @param[in] xfer_size  Buffer size of a bulk-in transfer. Rounded up to the max. packet size.
+ *                        0 for one max. packet. The buffers are allocated from USB memory pool.
+ *  @param[in] ring_buff  Receive ring buffer.
+ *  @param[in] ring_size  Receive ring size. Must be larger than xfer_size.
+ *  @param[in] fc_func    Flow control callback, or NULL. It is called in interrupt context with
+ *                        throttle 1 when the ring becomes full, and in usbh_cdc_read() with
+ *                        throttle 0 when receiving resumes. It must not issue USB requests.
+ *  @return   Success or not.
+ * @retval   0           Success
+ * @retval   Otherwise   Failed
+ */
+int32_t usbh_cdc_start_rx_queue(CDC_DEV_T *cdev, int depth, int xfer_size, uint8_t *ring_buff, int ring_size, CDC_FC_FUNC *fc_func)
+{
+    EP_INFO_T   *ep;
+    int         ret, flags;
+
+    if ((cdev == NULL) || (cdev->iface_data == NULL))
+        return USBH_ERR_NOT_FOUND;
+
+    if ((depth < 2) || (depth > CDC_QUEUE_DEPTH_MAX) || (ring_buff == NULL) || (xfer_size < 0) ||
+            (cdev->rxq.depth != 0) || cdev->rx_busy)
+        return USBH_ERR_INVALID_PARAM;
+
+    ep = cdc_get_bulk_ep(cdev, EP_ADDR_DIR_IN);
+    if (ep == NULL)
+        return USBH_ERR_EP_NOT_FOUND;
+
+    xfer_size = ((xfer_size + ep->wMaxPacketSize - 1) / ep->wMaxPacketSize) * ep->wMaxPacketSize;
+    if (xfer_size == 0)
+        xfer_size = ep->wMaxPacketSize;
+    if (ring_size <= xfer_size)
+        return USBH_ERR_INVALID_PARAM;
+
+    ret = cdc_queue_alloc(cdev, &cdev->rxq, ep, depth, xfer_size, cdc_rxq_irq);
+    if (ret < 0)
+        return ret;
+
+    cdev->rx_ring = ring_buff;
+    cdev->rx_ring_size = ring_size;
+    cdev->rx_ring_head = 0;
+    cdev->rx_ring_tail = 0;
+    cdev->rx_throttled = 0;
+    cdev->fc_func = fc_func;
+    cdev->rxq.running = 1;
+
+    flags = usb_mem_lock();
+    ret = cdc_rxq_post(cdev);
+    usb_mem_unlock(flags);
+
+    if (ret < 0)
+    {
+        CDC_DBGMSG("Error - failed to submit bulk in request (%d)", ret);
+        cdev->rxq.running = 0;
+        cdc_queue_free(&cdev->rxq);
+        return ret;
+    }
+    return 0;
+}
+
+/**
+ * @brief  Stop queued receiving started by usbh_cdc_start_rx_queue().
+ *  @param[in] cdev       CDC device
+ *  @return   Success or not.
+ * @retval   0           Success
+ * @retval   USBH_ERR_TIMEOUT  The transfer on the bus did not return. Receiving is stopped but
+ *                       the buffers are kept. Call it again to free them.
+ * @retval   Otherwise   Failed
+ */
+int32_t usbh_cdc_stop_rx_queue(CDC_DEV_T *cdev)
+{
+    CDC_QUEUE_T  *q;
+    int          ret;
+
+    if (cdev == NULL)
+        return USBH_ERR_NOT_FOUND;
+
+    q = &cdev->rxq;
+    if (q->depth == 0)
+        return 0;
+
+    ret = cdc_queue_stop(q, (q->head + q->cnt) % q->depth);
+    if (ret < 0)
+        return ret;
+    cdev->rx_ring = NULL;
+    return 0;
+}
+
+/**
+ * @brief  Read received data from the receive ring of queued receiving. If the last bulk-in
+ *         transfer failed, the endpoint halt is cleared and receiving resumes.
+ *  @param[in] cdev       CDC device
+ *  @param[out] buff      Buffer to receive data.
+ *  @param[in] len        Maximum number of bytes to read.
+ *  @return   Number of bytes read, or an error code if < 0. USBH_ERR_TRANSFER is returned once
+ *            the ring is empty and bulk-in failed CDC_QUEUE_RETRY_MAX times in a row.
+ */
+int usbh_cdc_read(CDC_DEV_T *cdev, uint8_t *buff, int len)
+{
+    int    tail, avail, n, cnt, flags;
+    int    resume = 0, ret = 0;
+
+    if ((cdev == NULL) || (cdev->rx_ring == NULL))
+        return USBH_ERR_INVALID_PARAM;
+
+    tail = cdev->rx_ring_tail;
+    avail = (cdev->rx_ring_head - tail + cdev->rx_ring_size) % cdev->rx_ring_size;
+    if (len > avail)
+        len = avail;
+
+    for (cnt = 0; cnt < len; cnt += n)
+    {
+        n = cdev->rx_ring_size - tail;
+        if (n > len - cnt)
+            n = len - cnt;
+        memcpy(buff + cnt, cdev->rx_ring + tail, n);
+        tail = (tail + n) % cdev->rx_ring_size;
+    }
+    cdev->rx_ring_tail = tail;
+
+    if (cdev->rxq.failed)
+        ret = cdc_rxq_recover(cdev);
+
+    flags = usb_mem_lock();
+    cdc_rxq_drain(cdev);                    /* move held transfers into the room made     */
+    cdc_rxq_post(cdev);
+    if (cdev->rx_throttled && (cdev->rxq.cnt == 0))
+    {
+        cdev->rx_throttled = 0;
+        cdev->rxq.last_ticks = 0;           /* pause is not counted as a gap              */
+        resume = 1;
+    }
+    usb_mem_unlock(flags);
+
+    if (resume && cdev->fc_func)
+        cdev->fc_func(cdev, 0);
+
+    if ((cnt == 0) && (ret < 0))
+        return ret;
+    return cnt;
+}
+
+/**
+ * @brief  Start queued sending to the CDC device's bulk-out transfer pipe. Data written by
+ *         usbh_cdc_write() is queued in up to depth bulk-out transfers, which are issued one
+ *         after another from the completion interrupt.
+ *  @param[in] cdev       CDC device
+ *  @param[in] depth      Number of bulk-out transfers, 2 ~ CDC_QUEUE_DEPTH_MAX.
+ *  @param[in] xfer_size  Buffer size of a bulk-out transfer. Rounded up to the max. packet size.
+ *                        0 for one max. packet. The buffers are allocated from USB memory pool.
+ *  @return   Success or not.
+ * @retval   0           Success
+ * @retval   Otherwise   Failed
+ */
+int32_t usbh_cdc_start_tx_queue(CDC_DEV_T *cdev, int depth, int xfer_size)
+{
+    EP_INFO_T   *ep;
+    int         ret;
+
+    if ((cdev == NULL) || (cdev->iface_data == NULL))
+        return USBH_ERR_NOT_FOUND;
+
+    if ((depth < 2) || (depth > CDC_QUEUE_DEPTH_MAX) || (xfer_size < 0) || (cdev->txq.depth != 0))
+        return USBH_ERR_INVALID_PARAM;
+
+    ep = cdc_get_bulk_ep(cdev, EP_ADDR_DIR_OUT);
+    if (ep == NULL)
+        return USBH_ERR_EP_NOT_FOUND;
+
+    xfer_size = ((xfer_size + ep->wMaxPacketSize - 1) / ep->wMaxPacketSize) * ep->wMaxPacketSize;
+    if (xfer_size == 0)
+        xfer_size = ep->wMaxPacketSize;
+
+    ret = cdc_queue_alloc(cdev, &cdev->txq, ep, depth, xfer_size, cdc_txq_irq);
+    if (ret < 0)
+        return ret;
+
+    cdev->txq.running = 1;
+    return 0;
+}
+
+/**
+ * @brief  Stop queued sending started by usbh_cdc_start_tx_queue(). Data not sent yet is dropped.
+ *  @param[in] cdev       CDC device
+ *  @return   Success or not.
+ * @retval   0           Success
+ * @retval   Otherwise   Failed
+ */
+int32_t usbh_cdc_stop_tx_queue(CDC_DEV_T *cdev)
+{
+    if (cdev == NULL)
+        return USBH_ERR_NOT_FOUND;
+
+    if (cdev->txq.depth == 0)
+        return 0;
+
+    return cdc_queue_stop(&cdev->txq, cdev->txq.head);
+}
+
+/**
+ * @brief  Queue data to be sent via the CDC device's bulk-out transfer pipe. This function does
+ *         not wait for the transfer. Small writes are merged into the last queued transfer.
+ *  @param[in] cdev       CDC device
+ *  @param[in] data       Data to be sent.
+ *  @param[in] len        Length in bytes of data.
+ *  @return   Number of bytes queued, less than len if the queue is full, or an error code if < 0.
+ */
+int usbh_cdc_write(CDC_DEV_T *cdev, uint8_t *data, int len)
+{
+    CDC_QUEUE_T  *q;
+    UTR_T   *utr;
+    int     cnt, n, flags;
+
+    if (cdev == NULL)
+        return USBH_ERR_NOT_FOUND;
+
+    q = &cdev->txq;
+    if ((q->depth == 0) || !q->running)
+        return USBH_ERR_INVALID_PARAM;
+
+    flags = usb_mem_lock();
+    for (cnt = 0; cnt < len; cnt += n)
+    {
+        utr = NULL;
+        if ((q->cnt > 0) && !(q->posted && (q->cnt == 1)))
+        {
+            utr = q->utr[(q->head + q->cnt - 1) % q->depth];    /* last one, not on bus  */
+            if (utr->data_len >= q->xfer_size)
+                utr = NULL;
+        }
+        if (utr == NULL)
+        {
+            if (q->cnt >= q->depth)
+                break;                      /* queue full                                 */
+            utr = q->utr[(q->head + q->cnt) % q->depth];
+            utr->data_len = 0;
+            q->cnt++;
+        }
+
+        n = q->xfer_size - utr->data_len;
+        if (n > len - cnt)
+            n = len - cnt;
+        memcpy(utr->buff + utr->data_len, data + cnt, n);
+        utr->data_len += n;
+    }
+    if (cnt < len)
+        cdev->qstat.tx_full++;
+
+    cdc_txq_post(cdev);
+    usb_mem_unlock(flags);
+    return cnt;
+}
+
+/**
+ * @brief  Get the counters of queued receiving and sending.
+ *  @param[in] cdev       CDC device
+ *  @param[out] stat      Counters copied here.
+ *  @param[in] clear      Non-zero to clear the counters after read.
+ *  @return   None
+ */
+void usbh_cdc_get_queue_stat(CDC_DEV_T *cdev, CDC_QUEUE_STAT_T *stat, int clear)
+{
+    int   flags;
+
+    flags = usb_mem_lock();
+    *stat = cdev->qstat;
+    if (clear)
+        memset(&cdev->qstat, 0, sizeof(cdev->qstat));
+    usb_mem_unlock(flags);
+}
+
 /*@}*/ /* end of group USBH_EXPORTED_FUNCTIONS */
 
 /*@}*/ /* end of group USBH_Library */
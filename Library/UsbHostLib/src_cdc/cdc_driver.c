@@ -212,6 +212,9 @@ static void  cdc_disconnect(IFACE_T *iface)
     if_cdc = cdev->iface_cdc;
     if_data = cdev->iface_data;
 
+    usbh_cdc_stop_rx_queue(cdev);
+    usbh_cdc_stop_tx_queue(cdev);
+
     /*
      *  Quit transfers of all endpoints of COMM and DATA interface.
      */
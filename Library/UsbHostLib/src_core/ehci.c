@@ -35,6 +35,18 @@ uint32_t  *_PFList;
 
 QH_T  * _Iqh[NUM_IQH];
 
+/* interrupt tree nodes, too many for the QH pool */
+static uint8_t  _Iqh_mem[NUM_IQH][(sizeof(QH_T) + 31) & ~31] __attribute__((aligned(32)));
+
+static uint8_t   _bw_uf[PERIODIC_FRAMES][8];  /* reserved high speed us of micro-frames   */
+static uint16_t  _bw_tt[PERIODIC_FRAMES];     /* reserved full/low speed us of TT frames  */
+
+static int  is_int_tree_node(QH_T *qh);
+
+USBH_IRQ_STAT_T  _ehci_irq_stat;           /* EHCI interrupt counters                    */
+static USBH_TIMER_FUNC  *_irq_timer_func;   /* free-running counter read by IRQ handler   */
+static uint32_t  _irq_timer_mask;
+
 
 #ifdef ENABLE_ERROR_MSG
 void dump_ehci_regs()
@@ -120,17 +132,21 @@ void dump_ehci_asynclist_simple(void)
 
 void dump_ehci_period_frame_list_simple(void)
 {
-    QH_T     *qh = _Iqh[NUM_IQH-1];
+    QH_T     *qh;
+    int      i;
 
     USB_debug(">>> EHCI period frame list simple <<<\n");
-    USB_debug("[FList] => ");
-    do
+    for (i = 0; i < NUM_IQH; i++)
     {
-        USB_debug("0x%08x ", (int)qh);
-        qh = QH_PTR(qh->HLink);
+        USB_debug("[Iqh %d] => ", i);
+        qh = QH_PTR(_Iqh[i]->HLink);
+        while ((qh != NULL) && !is_int_tree_node(qh))
+        {
+            USB_debug("0x%08x ", (int)qh);
+            qh = QH_PTR(qh->HLink);
+        }
+        USB_debug("\n");
     }
-    while (qh != NULL);
-    USB_debug("\n");
 }
 
 void dump_ehci_period_frame_list()
@@ -154,92 +170,308 @@ void dump_ehci_period_frame_list()
 
 #endif  /* ENABLE_ERROR_MSG */
 
+/*
+ *  _Iqh[interval-1+phase] is the head node of interrupt QHs polled every <interval> frames
+ *  from frame <phase>. Each node links to the node of half the interval and the same phase,
+ *  so that a frame walks through the nodes of all intervals it services.
+ */
 static void init_periodic_frame_list()
 {
-    QH_T   *qh_p;
-    int    i, idx, interval;
+    QH_T   *qh;
+    int    i, interval, phase;
 
     _PFList = (uint32_t *)((uint32_t)_PFList_mem | NON_CACHE_MASK);
     memset(_PFList, 0, sizeof(_PFList_mem));
 
     iso_ep_list = NULL;
 
-    for (i = NUM_IQH-1; i >= 0; i--)        /* interval = i^2                             */
+    memset(_bw_uf, 0, sizeof(_bw_uf));
+    memset(_bw_tt, 0, sizeof(_bw_tt));
+
+    i = 0;
+    for (interval = 1; interval <= PERIODIC_FRAMES; interval *= 2)
     {
-        _Iqh[i] = alloc_ehci_QH();
+        for (phase = 0; phase < interval; phase++, i++)
+        {
+            qh = (QH_T *)((uint32_t)&_Iqh_mem[i][0] | NON_CACHE_MASK);
+            memset(qh, 0, sizeof(*qh));
+
+            if (interval == 1)
+                qh->HLink = QH_HLNK_END;
+            else
+                qh->HLink = QH_HLNK_QH(_Iqh[interval/2 - 1 + phase % (interval/2)]);
+            qh->Curr_qTD        = (uint32_t)_ghost_qtd;
+            qh->OL_Next_qTD     = QTD_LIST_END;
+            qh->OL_Alt_Next_qTD = (uint32_t)_ghost_qtd;
+            qh->OL_Token        = QTD_STS_HALT;
+            _Iqh[i] = qh;
+        }
+    }
+
+    for (i = 0; i < FL_SIZE; i++)
+        _PFList[i] = QH_HLNK_QH(_Iqh[PERIODIC_FRAMES - 1 + (i % PERIODIC_FRAMES)]);
+}
 
-        _Iqh[i]->HLink           = QH_HLNK_END;
-        _Iqh[i]->Curr_qTD        = (uint32_t)_ghost_qtd;
-        _Iqh[i]->OL_Next_qTD     = QTD_LIST_END;
-        _Iqh[i]->OL_Alt_Next_qTD = (uint32_t)_ghost_qtd;
-        _Iqh[i]->OL_Token        = QTD_STS_HALT;
+static int  is_int_tree_node(QH_T *qh)
+{
+    uint32_t  addr = (uint32_t)qh & ~NON_CACHE_MASK;
+
+    return ((addr >= (uint32_t)&_Iqh_mem[0][0]) && (addr < (uint32_t)&_Iqh_mem[NUM_IQH][0]));
+}
+
+/*----------------------------------------------------------------------------------------*/
+/*  Periodic bandwidth accounting                                                         */
+/*----------------------------------------------------------------------------------------*/
 
-        interval = 0x1 << i;
+/* bus time in ns, worst case bit stuffing (USB 2.0 spec. 5.11.3)                         */
+#define BIT_TIME(bytes)           (7 * 8 * (bytes) / 6)
+#define NS_TO_US(ns)              (((ns) + 999) / 1000)
+#define HS_NSECS(bytes)           (((55 * 8 * 2083) + (2083 * (3 + BIT_TIME(bytes)))) / 1000 + 5)
+#define HS_NSECS_ISO(bytes)       (((38 * 8 * 2083) + (2083 * (3 + BIT_TIME(bytes)))) / 1000 + 5)
+#define FS_NSECS(base, bytes)     ((base) + 1000 + (83540 * (3 + BIT_TIME(bytes))) / 1000)
+#define LS_NSECS(base, bytes)     ((base) + 2 * 333 + 1000 + (67667 * (31 + 10 * BIT_TIME(bytes))) / 1000)
+
+/*
+ *  Fill the endpoint interval and bus time of each kind of micro-frame in <bw>.
+ *  Return the number of start micro-frame candidates.
+ */
+static int  bw_endpoint_cost(UDEV_T *udev, EP_INFO_T *ep, EHCI_BW_T *bw)
+{
+    int   is_iso, is_in, maxpkt, mult, bi, frames, scnt;
 
-        for (idx = interval - 1; idx < FL_SIZE; idx += interval)
+    is_iso = ((ep->bmAttributes & EP_ATTR_TT_MASK) == EP_ATTR_TT_ISO);
+    is_in = ((ep->bEndpointAddress & EP_ADDR_DIR_MASK) == EP_ADDR_DIR_IN);
+    maxpkt = ep->wMaxPacketSize & 0x7FF;
+    mult = ((ep->wMaxPacketSize >> 11) & 0x3) + 1;
+
+    bi = ep->bInterval;
+    if (bi < 1)
+        bi = 1;
+    if (bi > 16)
+        bi = 16;
+
+    memset(bw, 0, sizeof(*bw));
+
+    if (udev->speed == SPEED_HIGH)
+    {
+        bw->uf_interval = 0x1 << (bi - 1);
+        if (is_iso)
+            bw->hs_us = mult * NS_TO_US(HS_NSECS_ISO(maxpkt));
+        else
+            bw->hs_us = mult * NS_TO_US(HS_NSECS(maxpkt));
+        return (bw->uf_interval < 8) ? bw->uf_interval : 8;
+    }
+
+    /*
+     *  Full/low speed endpoint behind the TT of a high speed hub
+     */
+    if (is_iso)
+    {
+        bw->uf_interval = 8 << (bi - 1);
+        bw->tt_us = NS_TO_US(FS_NSECS(is_in ? 7268 : 6265, maxpkt));
+
+        scnt = (maxpkt + 187) / 188;        /* 188 bytes of full speed data per uframe    */
+        if (scnt == 0)
+            scnt = 1;
+        if (is_in)
+        {
+            bw->hs_us = NS_TO_US(HS_NSECS_ISO(1));
+            bw->cs_us = NS_TO_US(HS_NSECS_ISO((maxpkt < 188) ? maxpkt : 188));
+            return (scnt < 4) ? (5 - scnt) : 1;  /* complete-splits up to micro-frame 7   */
+        }
+        bw->hs_us = NS_TO_US(HS_NSECS_ISO((maxpkt < 188) ? maxpkt : 188));
+        return 8 - scnt;                    /* start-splits up to micro-frame 6           */
+    }
+
+    for (frames = 1; frames * 2 <= bi; frames *= 2)
+        ;                                   /* interval in ms rounded down to power of 2  */
+    bw->uf_interval = frames * 8;
+    if (udev->speed == SPEED_LOW)
+        bw->tt_us = NS_TO_US(LS_NSECS(is_in ? 64060 : 64107, maxpkt));
+    else
+        bw->tt_us = NS_TO_US(FS_NSECS(9107, maxpkt));
+    bw->hs_us = NS_TO_US(HS_NSECS(is_in ? 1 : maxpkt));
+    bw->cs_us = NS_TO_US(HS_NSECS(is_in ? maxpkt : 1));
+    return 3;                               /* complete-splits up to micro-frame 7        */
+}
+
+/*
+ *  S-mask and C-mask of the <n>'th start micro-frame candidate.
+ */
+static void  bw_uframe_masks(UDEV_T *udev, EP_INFO_T *ep, EHCI_BW_T *bw, int n)
+{
+    int   maxpkt, scnt;
+
+    if (udev->speed == SPEED_HIGH)
+    {
+        if (bw->uf_interval == 1)
+            bw->smask = 0xFF;
+        else if (bw->uf_interval == 2)
+            bw->smask = 0x55 << n;
+        else if (bw->uf_interval == 4)
+            bw->smask = 0x11 << n;
+        else
+            bw->smask = 0x1 << n;
+        bw->cmask = 0;
+        return;
+    }
+
+    if ((ep->bmAttributes & EP_ATTR_TT_MASK) == EP_ATTR_TT_ISO)
+    {
+        maxpkt = ep->wMaxPacketSize & 0x7FF;
+        scnt = (maxpkt + 187) / 188;
+        if (scnt == 0)
+            scnt = 1;
+        if ((ep->bEndpointAddress & EP_ADDR_DIR_MASK) == EP_ADDR_DIR_IN)
+        {
+            bw->smask = 0x1 << n;
+            bw->cmask = (((0x1 << (scnt + 2)) - 1) << (n + 2)) & 0xFF;
+        }
+        else
         {
-            if (_PFList[idx] == 0)          /* is empty list, insert directly             */
+            bw->smask = ((0x1 << scnt) - 1) << n;
+            bw->cmask = 0;
+        }
+        return;
+    }
+
+    bw->smask = 0x1 << n;                   /* interrupt split transaction                */
+    bw->cmask = 0x3C << n;
+}
+
+/*
+ *  Place the endpoint on the frame phase and micro-frames with the least load.
+ *  Return 0 if placed, otherwise USBH_ERR_NO_BANDWIDTH.
+ */
+static int  bw_place(UDEV_T *udev, EP_INFO_T *ep, EHCI_BW_T *bw, int commit)
+{
+    EHCI_BW_T  cand;
+    int        n_cand, n, phase, period, f, u, load, peak, tt_peak, score;
+    int        best = -1, best_n = 0, best_phase = 0, flags;
+
+    n_cand = bw_endpoint_cost(udev, ep, &cand);
+
+    period = cand.uf_interval / 8;
+    if (period == 0)
+        period = 1;
+    if (period > PERIODIC_FRAMES)
+        period = PERIODIC_FRAMES;           /* reserve more often than serviced           */
+
+    flags = usb_mem_lock();
+
+    for (phase = 0; phase < period; phase++)
+    {
+        for (n = 0; n < n_cand; n++)
+        {
+            bw_uframe_masks(udev, ep, &cand, n);
+            peak = tt_peak = 0;
+
+            for (f = phase; f < PERIODIC_FRAMES; f += period)
             {
-                _PFList[idx] = QH_HLNK_QH(_Iqh[i]);
+                for (u = 0; u < 8; u++)
+                {
+                    if (!((cand.smask | cand.cmask) & (0x1 << u)))
+                        continue;           /* only the micro-frames it is put in         */
+                    load = _bw_uf[f][u];
+                    if (cand.smask & (0x1 << u))
+                        load += cand.hs_us;
+                    if (cand.cmask & (0x1 << u))
+                        load += cand.cs_us;
+                    if (load > peak)
+                        peak = load;
+                }
+                if (_bw_tt[f] + cand.tt_us > tt_peak)
+                    tt_peak = _bw_tt[f] + cand.tt_us;
             }
-            else
+
+            if ((peak > UFRAME_BW_MAX_US) || (tt_peak > TT_FRAME_BW_MAX_US))
+                continue;
+
+            score = (tt_peak << 8) | peak;  /* TT frame load first, then micro-frame load */
+            if ((best < 0) || (score < best))
             {
-                qh_p = QH_PTR(_PFList[idx]);
+                best = score;
+                best_n = n;
+                best_phase = phase;
+            }
+        }
+    }
 
-                while (1)
-                {
-                    if (qh_p == _Iqh[i])
-                        break;                   /* already chained by previous visit     */
-
-                    if (qh_p->HLink == QH_HLNK_END)        /* reach end of list?          */
-                    {
-                        qh_p->HLink = QH_HLNK_QH(_Iqh[i]);
-                        break;
-                    }
-                    qh_p = QH_PTR(qh_p->HLink);
-                }
+    if (best < 0)
+    {
+        usb_mem_unlock(flags);
+        USB_debug("EHCI no bandwidth for EP 0x%x, %d bytes, interval %d uframes\n",
+                  ep->bEndpointAddress, ep->wMaxPacketSize, cand.uf_interval);
+        return USBH_ERR_NO_BANDWIDTH;
+    }
+
+    bw_uframe_masks(udev, ep, &cand, best_n);
+    cand.period = period;
+    cand.phase = best_phase;
+
+    if (commit)
+    {
+        for (f = cand.phase; f < PERIODIC_FRAMES; f += cand.period)
+        {
+            for (u = 0; u < 8; u++)
+            {
+                if (cand.smask & (0x1 << u))
+                    _bw_uf[f][u] += cand.hs_us;
+                if (cand.cmask & (0x1 << u))
+                    _bw_uf[f][u] += cand.cs_us;
             }
+            _bw_tt[f] += cand.tt_us;
         }
     }
+    usb_mem_unlock(flags);
+
+    memcpy(bw, &cand, sizeof(*bw));
+    return 0;
 }
 
-static QH_T * get_int_tree_head_node(int interval)
+/*
+ *  Reserve periodic bandwidth for an interrupt or isochronous endpoint.
+ */
+int  ehci_bw_alloc(UDEV_T *udev, EP_INFO_T *ep, EHCI_BW_T *bw)
 {
-    int    i;
+    return bw_place(udev, ep, bw, 1);
+}
+
+/*
+ *  Give back the bandwidth reserved by ehci_bw_alloc().
+ */
+void  ehci_bw_free(EHCI_BW_T *bw)
+{
+    int   f, u, flags;
 
-    interval /= 8;                          /* each frame list entry for 8 micro-frame    */
+    if (bw->period == 0)
+        return;                             /* not reserved                               */
 
-    for (i = 0; i < NUM_IQH-1; i++)
+    flags = usb_mem_lock();
+    for (f = bw->phase; f < PERIODIC_FRAMES; f += bw->period)
     {
-        interval >>= 1;
-        if (interval == 0)
-            return _Iqh[i];
+        for (u = 0; u < 8; u++)
+        {
+            if (bw->smask & (0x1 << u))
+                _bw_uf[f][u] -= bw->hs_us;
+            if (bw->cmask & (0x1 << u))
+                _bw_uf[f][u] -= bw->cs_us;
+        }
+        _bw_tt[f] -= bw->tt_us;
     }
-    return _Iqh[NUM_IQH-1];
+    bw->period = 0;
+    usb_mem_unlock(flags);
 }
 
-static int  make_int_s_mask(int bInterval)
+static int  ehci_bw_check(UDEV_T *udev, EP_INFO_T *ep)
 {
-    int   order, interval;
+    EHCI_BW_T  bw;
 
-    interval = 1;
-    while (bInterval > 1)
-    {
-        interval *= 2;
-        bInterval--;
-    }
+    if (((ep->bmAttributes & EP_ATTR_TT_MASK) != EP_ATTR_TT_INT) &&
+            ((ep->bmAttributes & EP_ATTR_TT_MASK) != EP_ATTR_TT_ISO))
+        return 0;                           /* not a periodic endpoint                    */
 
-    if (interval < 2)
-        return 0xFF;                        /* interval 1                                 */
-    if (interval < 4)
-        return 0x55;                        /* interval 2                                 */
-    if (interval < 8)
-        return 0x22;                        /* interval 4                                 */
-    for (order = 0; (interval > 1); order++)
-    {
-        interval >>= 1;
-    }
-    return (0x1 << (order % 8));
+    return bw_place(udev, ep, &bw, 0);
 }
 
 static int  ehci_init(void)
@@ -295,7 +527,8 @@ static int  ehci_init(void)
     /*------------------------------------------------------------------------------------*/
 
     _ehci->UCFGR = 0x1;                          /* enable port routing to EHCI           */
-    _ehci->UIENR = HSUSBH_UIENR_USBIEN_Msk | HSUSBH_UIENR_UERRIEN_Msk | HSUSBH_UIENR_HSERREN_Msk | HSUSBH_UIENR_IAAEN_Msk;
+    _ehci->UIENR = HSUSBH_UIENR_USBIEN_Msk | HSUSBH_UIENR_UERRIEN_Msk | HSUSBH_UIENR_HSERREN_Msk | HSUSBH_UIENR_IAAEN_Msk |
+                   HSUSBH_UIENR_PCIEN_Msk;
 
     delay_us(1000);                              /* dealy 1 ms                            */
 
@@ -370,21 +603,25 @@ static void move_qh_to_remove_list(QH_T *qh)
     /*------------------------------------------------------------------------------------*/
     /*  Search periodic frame list and remove qh if found in list.                        */
     /*------------------------------------------------------------------------------------*/
-    q =  _Iqh[NUM_IQH-1];
-    while (q->HLink != QH_HLNK_END)
+    if (qh->bw.period != 0)                 /* is an interrupt QH?                        */
     {
-        if (QH_PTR(q->HLink) == qh)
+        q = _Iqh[qh->bw.period - 1 + qh->bw.phase];   /* the tree node qh was linked to   */
+        while ((QH_PTR(q->HLink) != NULL) && !is_int_tree_node(QH_PTR(q->HLink)))
         {
-            /* q's next QH is qh, found...           */
-            q->HLink = qh->HLink;                /* remove qh from list                   */
-
-            qh->next = qh_remove_list;           /* add qh to qh_remove_list              */
-            qh_remove_list = qh;
-            _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA interrupt             */
-            ENABLE_EHCI_IRQ();
-            return;                              /* done                                  */
+            if (QH_PTR(q->HLink) == qh)
+            {
+                /* q's next QH is qh, found...           */
+                q->HLink = qh->HLink;            /* remove qh from list                   */
+
+                qh->next = qh_remove_list;       /* add qh to qh_remove_list              */
+                qh_remove_list = qh;
+                ehci_bw_free(&qh->bw);
+                _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA interrupt         */
+                ENABLE_EHCI_IRQ();
+                return;                          /* done                                  */
+            }
+            q = QH_PTR(q->HLink);           /* advance to next QH of this tree node       */
         }
-        q = QH_PTR(q->HLink);               /* advance to next QH in asynchronous list    */
     }
     ENABLE_EHCI_IRQ();
 }
@@ -626,16 +863,21 @@ static int ehci_ctrl_xfer(UTR_T *utr)
     return 0;
 }
 
+/*
+ *  A bulk UTR may be submitted while earlier UTRs of the endpoint are still running. Its qTDs
+ *  are linked behind theirs, so that the HC goes on without waiting for software.
+ */
 static int ehci_bulk_xfer(UTR_T *utr)
 {
     UDEV_T     *udev;
     EP_INFO_T  *ep = utr->ep;
     QH_T       *qh;
-    qTD_T      *qtd, *qtd_pre;
+    qTD_T      *qtd, *qtd_pre, *qtd_first;
     uint32_t   data_len, xfer_len;
     uint8_t    *buff;
     uint32_t   token;
     int        is_new_qh = 0;
+    int        flags;
 
     //USB_debug("Bulk XFER =>\n");
     // dump_ehci_asynclist_simple();
@@ -644,11 +886,7 @@ static int ehci_bulk_xfer(UTR_T *utr)
 
     if (ep->hw_pipe != NULL)
     {
-        qh = (QH_T *)ep->hw_pipe ;
-        if (qh->qtd_list)
-        {
-            return USBH_ERR_EHCI_QH_BUSY;
-        }
+        qh = (QH_T *)ep->hw_pipe;           /* may be busy, the new qTDs are queued       */
     }
     else
     {
@@ -665,6 +903,7 @@ static int ehci_bulk_xfer(UTR_T *utr)
     /*------------------------------------------------------------------------------------*/
     data_len = utr->data_len;
     buff = utr->buff;
+    qtd_first = NULL;
     qtd_pre = NULL;
 
     while (data_len > 0)
@@ -672,12 +911,11 @@ static int ehci_bulk_xfer(UTR_T *utr)
         qtd = alloc_ehci_qTD(utr);
         if (qtd == NULL)                    /* failed to allocate a qTD                   */
         {
-            qtd = qh->qtd_list;
-            while (qtd != NULL)
+            while (qtd_first != NULL)
             {
-                qtd_pre = qtd;
-                qtd = qtd->next;
-                free_ehci_qTD(qtd_pre);
+                qtd = qtd_first;
+                qtd_first = qtd->next;
+                free_ehci_qTD(qtd);
             }
             if (is_new_qh)
             {
@@ -703,9 +941,8 @@ static int ehci_bulk_xfer(UTR_T *utr)
 
         qtd->qh = qh;
         qtd->Next_qTD = (uint32_t)_ghost_qtd;
-        qtd->Alt_Next_qTD = QTD_LIST_END; //(uint32_t)_ghost_qtd;
+        qtd->Alt_Next_qTD = (uint32_t)_ghost_qtd;  /* a short packet ends the UTR         */
         write_qtd_bptr(qtd, (uint32_t)buff, xfer_len);
-        append_to_qtd_list_of_QH(qh, qtd);
         qtd->Token = (xfer_len << 16) | token;
 
         buff += xfer_len;                   /* advanced buffer pointer                    */
@@ -718,23 +955,50 @@ static int ehci_bulk_xfer(UTR_T *utr)
         }
 
         if (qtd_pre != NULL)
+        {
             qtd_pre->Next_qTD = (uint32_t)qtd;
+            qtd_pre->next = qtd;
+        }
+        else
+        {
+            qtd_first = qtd;
+        }
         qtd_pre = qtd;
     }
 
-    //USB_debug("BULK utr=0x%x, qh=0x%x, qtd=0x%x\n", (int)utr, (int)qh, (int)qh->qtd_list);
+    //USB_debug("BULK utr=0x%x, qh=0x%x, qtd=0x%x\n", (int)utr, (int)qh, (int)qtd_first);
 
-    qtd = qh->qtd_list;
-
-    qh->OL_Next_qTD = (uint32_t)qtd;
+    /*------------------------------------------------------------------------------------*/
+    /* Link qTDs to QH                                                                    */
+    /*------------------------------------------------------------------------------------*/
+    flags = usb_mem_lock();
+    if (qh->qtd_list != NULL)
+    {
+        /*
+         *  Behind the last qTD of the earlier UTRs. If the HC has already fetched it, it
+         *  stops on _ghost_qtd and scan_asynchronous_list() restarts it at the new qTDs.
+         */
+        qtd = qh->qtd_list;
+        while (qtd->next != NULL)
+            qtd = qtd->next;
+        qtd->Next_qTD = (uint32_t)qtd_first;
+        qtd->next = qtd_first;
+    }
+    else
+    {
+        qh->qtd_list = qtd_first;
+        qh->OL_Next_qTD = (uint32_t)qtd_first;
+        qh->OL_Alt_Next_qTD = (uint32_t)qtd_first;
+    }
+    usb_mem_unlock(flags);
 
     /*------------------------------------------------------------------------------------*/
     /* Link QH and start asynchronous transfer                                            */
     /*------------------------------------------------------------------------------------*/
     if (is_new_qh)
     {
-        memcpy(&(qh->OL_Bptr[0]), &(qtd->Bptr[0]), 20);
-        qh->Curr_qTD = (uint32_t)qtd;
+        memcpy(&(qh->OL_Bptr[0]), &(qtd_first->Bptr[0]), 20);
+        qh->Curr_qTD = (uint32_t)qtd_first;
 
         qh->OL_Token = 0; // qtd->Token;
 
@@ -775,14 +1039,13 @@ static int ehci_int_xfer(UTR_T *utr)
         write_qh(udev, ep, qh);
         qh->Chrst &= ~0xF0000000;
 
-        if (udev->speed == SPEED_HIGH)
+        if (ehci_bw_alloc(udev, ep, &qh->bw) < 0)
         {
-            qh->Cap = (0x1 << QH_MULT_Pos) | (qh->Cap & 0xff) | make_int_s_mask(ep->bInterval);
-        }
-        else
-        {
-            qh->Cap = (0x1 << QH_MULT_Pos) | (qh->Cap & ~(QH_C_MASK_Msk | QH_S_MASK_Msk)) | 0x7802;
+            free_ehci_QH(qh);
+            return USBH_ERR_NO_BANDWIDTH;
         }
+        qh->Cap = (0x1 << QH_MULT_Pos) | (qh->Cap & ~(QH_C_MASK_Msk | QH_S_MASK_Msk)) |
+                  (qh->bw.cmask << 8) | qh->bw.smask;
         ep->hw_pipe = (void *)qh;           /* associate QH with endpoint                 */
     }
 
@@ -794,6 +1057,7 @@ static int ehci_int_xfer(UTR_T *utr)
     {
         if (is_new_qh)
         {
+            ehci_bw_free(&qh->bw);
             free_ehci_QH(qh);
             ep->hw_pipe = NULL;
         }
@@ -824,10 +1088,7 @@ static int ehci_int_xfer(UTR_T *utr)
         qh->Curr_qTD = (uint32_t)qtd;
         qh->OL_Token = qtd->Token;
 
-        if (udev->speed == SPEED_HIGH)      /* get head node of this interval             */
-            iqh = get_int_tree_head_node(ep->bInterval);
-        else
-            iqh = get_int_tree_head_node(ep->bInterval * 8);
+        iqh = _Iqh[qh->bw.period - 1 + qh->bw.phase];  /* head node of interval and phase */
         qh->HLink = iqh->HLink;             /* Add to list of the same interval           */
         iqh->HLink = QH_HLNK_QH(qh);
     }
@@ -895,7 +1156,13 @@ static int visit_qtd(qTD_T *qtd)
         {
             USB_error("qTD 0x%x error token=0x%x!  0x%x\n", (int)qtd, qtd->Token, qtd->Bptr[0]);
             if (qtd->utr->status == 0)
-                qtd->utr->status = USBH_ERR_TRANSACTION;
+            {
+                /* halted with no other error bit: the device returned STALL        */
+                if ((qtd->Token & (QTD_STS_DATA_BUFF_ERR | QTD_STS_BABBLE | QTD_STS_XactErr | QTD_STS_MISS_MF)) == 0)
+                    qtd->utr->status = USBH_ERR_STALL;
+                else
+                    qtd->utr->status = USBH_ERR_TRANSACTION;
+            }
         }
         else
         {
@@ -910,61 +1177,98 @@ static int visit_qtd(qTD_T *qtd)
     return 0;
 }
 
+static void ehci_utr_done(QH_T *qh, UTR_T *utr)
+{
+    // sysprintf("T %d [%d]\n", (qh->Chrst>>8)&0xf, (qh->OL_Token&QTD_DT) ? 1 : 0);
+    if (qh->OL_Token & QTD_DT)
+        utr->ep->bToggle = 1;
+    else
+        utr->ep->bToggle = 0;
+
+    utr->bIsTransferDone = 1;
+    USB_TRACE_DONE(utr);
+    if (utr->func)
+        utr->func(utr);
+
+    _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA to reclaim done_list          */
+}
+
+/*
+ *  Has the HC stopped on _ghost_qtd with qTDs still queued? It does when the last qTD of a
+ *  UTR was fetched before the next UTR was linked behind it, or when a short packet took
+ *  the alternate pointer. Either retires a qTD with an interrupt, so this is checked after
+ *  each scan. A halted QH stays halted until it is removed.
+ */
+static int  qh_is_parked(QH_T *qh)
+{
+    uint32_t  next;
+
+    if (qh->OL_Token & (QTD_STS_ACTIVE | QTD_STS_HALT))
+        return 0;
+
+    if ((QTD_TODO_LEN(qh->OL_Token) != 0) && !(qh->OL_Alt_Next_qTD & QTD_LIST_END))
+        next = qh->OL_Alt_Next_qTD;
+    else
+        next = qh->OL_Next_qTD;
+    return ((next & ~0x1F) == (uint32_t)_ghost_qtd);
+}
+
 static void scan_asynchronous_list()
 {
     QH_T    *qh, *qh_tmp;
     qTD_T   *q_pre, *qtd, *qtd_tmp;
     UTR_T   *utr;
+    int     is_end;
 
     qh =  QH_PTR(_H_qh->HLink);
     while (qh != _H_qh)
     {
         // USB_debug("Scan qh=0x%x, 0x%x\n", (int)qh, qh->OL_Token);
 
-        utr = NULL;
+        q_pre = NULL;
         qtd = qh->qtd_list;
         while (qtd != NULL)
         {
-            if (visit_qtd(qtd))                  /* if TRUE, reclaim this qtd             */
+            if (!visit_qtd(qtd))                 /* if FALSE, not completed yet           */
             {
-                /* qTD is completed, will remove it      */
-                utr = qtd->utr;
-                if (qtd == qh->qtd_list)
-                    qh->qtd_list = qtd->next;    /* unlink the qTD from qtd_list          */
-                else
-                    q_pre->next = qtd->next;     /* unlink the qTD from qtd_list          */
+                q_pre = qtd;                     /* remember this qTD as a preceder       */
+                qtd = qtd->next;                 /* advance to next qTD                   */
+                continue;
+            }
 
+            /*
+             *  qTD is completed, will remove it. After a halt, or a short packet on a qTD
+             *  that leaves through _ghost_qtd, the HC does not run the rest of the UTR.
+             */
+            utr = qtd->utr;
+            is_end = (qtd->Token & QTD_STS_HALT) ||
+                     ((QTD_TODO_LEN(qtd->Token) != 0) && (qtd->Alt_Next_qTD == (uint32_t)_ghost_qtd));
+            do
+            {
                 qtd_tmp = qtd;                   /* remember this qTD for freeing later   */
                 qtd = qtd->next;                 /* advance to the next qTD               */
+                if (q_pre == NULL)
+                    qh->qtd_list = qtd;          /* unlink the qTD from qtd_list          */
+                else
+                    q_pre->next = qtd;           /* unlink the qTD from qtd_list          */
 
                 qtd_tmp->next = qh->done_list;   /* push this qTD to QH's done list       */
                 qh->done_list = qtd_tmp;
             }
-            else
-            {
-                q_pre = qtd;                     /* remember this qTD as a preceder       */
-                qtd = qtd->next;                 /* advance to next qTD                   */
-            }
+            while (is_end && (qtd != NULL) && (qtd->utr == utr));
+
+            /* The last qTD of the UTR, call-back to requester. Later UTRs may follow.    */
+            if ((qtd == NULL) || (qtd->utr != utr))
+                ehci_utr_done(qh, utr);
         }
 
         qh_tmp = qh;
         qh = QH_PTR(qh->HLink);                  /* advance to the next QH                */
 
-        /* If all TDs are done, call-back to requester and then remove this QH.           */
-        if ((qh_tmp->qtd_list == NULL) && utr)
+        if ((qh_tmp->qtd_list != NULL) && qh_is_parked(qh_tmp))
         {
-            // sysprintf("T %d [%d]\n", (qh_tmp->Chrst>>8)&0xf, (qh_tmp->OL_Token&QTD_DT) ? 1 : 0);
-            if (qh_tmp->OL_Token & QTD_DT)
-                utr->ep->bToggle = 1;
-            else
-                utr->ep->bToggle = 0;
-
-            utr->bIsTransferDone = 1;
-            if (utr->func)
-                utr->func(utr);
-
-            _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA to reclaim done_list  */
-
+            qh_tmp->OL_Next_qTD = (uint32_t)qh_tmp->qtd_list;
+            qh_tmp->OL_Alt_Next_qTD = (uint32_t)qh_tmp->qtd_list;
         }
     }
 }
@@ -974,49 +1278,54 @@ static void scan_periodic_frame_list()
     QH_T    *qh;
     qTD_T   *qtd;
     UTR_T   *utr;
+    int     i;
 
     /*------------------------------------------------------------------------------------*/
     /* Scan interrupt frame list                                                          */
     /*------------------------------------------------------------------------------------*/
-    qh =  _Iqh[NUM_IQH-1];
-    while (qh != NULL)
+    for (i = 0; i < NUM_IQH; i++)
     {
-        qtd = qh->qtd_list;                 /* There's only one qTD in list at most.      */
-
-        if (qtd == NULL)
+        qh = QH_PTR(_Iqh[i]->HLink);
+        while ((qh != NULL) && !is_int_tree_node(qh))
         {
-            /* empty QH                                   */
-            qh = QH_PTR(qh->HLink);         /* advance to the next QH                     */
-            continue;
-        }
+            qtd = qh->qtd_list;             /* There's only one qTD in list at most.      */
 
-        if (visit_qtd(qtd))                 /* if TRUE, reclaim this qtd                  */
-        {
-            qtd->next = qh->done_list;      /* push qTD into the done list                */
-            qh->done_list = qtd;
-            qh->qtd_list = NULL;            /* qtd_list becomes empty                     */
-        }
+            if (qtd == NULL)
+            {
+                /* empty QH                                   */
+                qh = QH_PTR(qh->HLink);     /* advance to the next QH                     */
+                continue;
+            }
 
-        qtd = qh->done_list;
+            if (visit_qtd(qtd))             /* if TRUE, reclaim this qtd                  */
+            {
+                qtd->next = qh->done_list;  /* push qTD into the done list                */
+                qh->done_list = qtd;
+                qh->qtd_list = NULL;        /* qtd_list becomes empty                     */
+            }
 
-        /* If all TDs are done, call-back to requester and then remove this QH.           */
-        if ((qtd != NULL) && (qh->qtd_list == NULL))
-        {
-            utr = qtd->utr;
+            qtd = qh->done_list;
 
-            if (qh->OL_Token & QTD_DT)
-                utr->ep->bToggle = 1;
-            else
-                utr->ep->bToggle = 0;
+            /* If all TDs are done, call-back to requester and then remove this QH.       */
+            if ((qtd != NULL) && (qh->qtd_list == NULL))
+            {
+                utr = qtd->utr;
 
-            utr->bIsTransferDone = 1;
-            if (utr->func)
-                utr->func(utr);
+                if (qh->OL_Token & QTD_DT)
+                    utr->ep->bToggle = 1;
+                else
+                    utr->ep->bToggle = 0;
 
-            _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA to reclaim done_list  */
-        }
+                utr->bIsTransferDone = 1;
+                USB_TRACE_DONE(utr);
+                if (utr->func)
+                    utr->func(utr);
 
-        qh = QH_PTR(qh->HLink);                  /* advance to the next QH                */
+                _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;   /* trigger IAA to reclaim done_list  */
+            }
+
+            qh = QH_PTR(qh->HLink);              /* advance to the next QH                */
+        }
     }
 
     /*------------------------------------------------------------------------------------*/
@@ -1031,6 +1340,7 @@ void iaad_remove_qh()
     QH_T    *qh;
     qTD_T   *qtd;
     UTR_T   *utr;
+    int     i;
 
     /*------------------------------------------------------------------------------------*/
     /* Remove all QHs in qh_remove_list...                                                */
@@ -1049,19 +1359,22 @@ void iaad_remove_qh()
             free_ehci_qTD(qtd);
         }
 
-        if (qh->qtd_list != NULL)           /* still have incompleted qTDs?               */
+        while (qh->qtd_list != NULL)        /* still have incompleted qTDs?               */
         {
-            utr = qh->qtd_list->utr;
-            while (qh->qtd_list)
+            qtd = qh->qtd_list;
+            qh->qtd_list = qtd->next;
+            utr = qtd->utr;
+            free_ehci_qTD(qtd);
+
+            /* a bulk QH may hold several UTRs, abort each after its last qTD             */
+            if ((qh->qtd_list == NULL) || (qh->qtd_list->utr != utr))
             {
-                qtd = qh->qtd_list;
-                qh->qtd_list = qtd->next;
-                free_ehci_qTD(qtd);
+                utr->status = USBH_ERR_ABORT;
+                utr->bIsTransferDone = 1;
+                USB_TRACE_DONE(utr);
+                if (utr->func)
+                    utr->func(utr);         /* call back                                  */
             }
-            utr->status = USBH_ERR_ABORT;
-            utr->bIsTransferDone = 1;
-            if (utr->func)
-                utr->func(utr);             /* call back                                  */
         }
         free_ehci_QH(qh);                   /* free the QH                                */
     }
@@ -1084,22 +1397,29 @@ void iaad_remove_qh()
     /*------------------------------------------------------------------------------------*/
     /* Free all qTD in done_list of each QH of periodic frame list                        */
     /*------------------------------------------------------------------------------------*/
-    qh =  _Iqh[NUM_IQH-1];
-    while (qh != NULL)
+    for (i = 0; i < NUM_IQH; i++)
     {
-        while (qh->done_list)               /* we can free the qTDs now                   */
+        qh = QH_PTR(_Iqh[i]->HLink);
+        while ((qh != NULL) && !is_int_tree_node(qh))
         {
-            qtd = qh->done_list;
-            qh->done_list = qtd->next;
-            free_ehci_qTD(qtd);
+            while (qh->done_list)           /* we can free the qTDs now                   */
+            {
+                qtd = qh->done_list;
+                qh->done_list = qtd->next;
+                free_ehci_qTD(qtd);
+            }
+            qh = QH_PTR(qh->HLink);              /* advance to the next QH                */
         }
-        qh = QH_PTR(qh->HLink);                  /* advance to the next QH                */
     }
 }
 
 void EHCI_IRQHandler(void)
 {
     uint32_t  intsts;
+    uint32_t  t0 = 0, cycles;
+
+    if (_irq_timer_func != NULL)
+        t0 = _irq_timer_func();
 
     intsts = _ehci->USTSR;
     _ehci->USTSR = intsts;                  /* clear interrupt status                     */
@@ -1124,6 +1444,20 @@ void EHCI_IRQHandler(void)
     {
         iaad_remove_qh();
     }
+
+    if (intsts & HSUSBH_USTSR_PCD_Msk)
+    {
+        usbh_hub_event(HUB_EVT_EHCI_RH);
+    }
+
+    _ehci_irq_stat.irq_cnt++;
+    if (_irq_timer_func != NULL)
+    {
+        cycles = (_irq_timer_func() - t0) & _irq_timer_mask;
+        _ehci_irq_stat.cycles_total += cycles;
+        if (cycles > _ehci_irq_stat.cycles_max)
+            _ehci_irq_stat.cycles_max = cycles;
+    }
 }
 
 static UDEV_T * ehci_find_device_by_port(int port)
@@ -1234,7 +1568,7 @@ static int ehci_rh_polling(void)
                 /* port reset failed, maybe an USB 1.1 device */
                 _ehci->UPSCR[port] |= HSUSBH_UPSCR_PO_Msk;     /* change port owner to OHCI     */
                 _ehci->UPSCR[port] |= HSUSBH_UPSCR_CSC_Msk;    /* clear all status change bits  */
-                return 0;
+                continue;
             }
 
             /*
@@ -1242,7 +1576,7 @@ static int ehci_rh_polling(void)
              */
             udev = alloc_device();
             if (udev == NULL)
-                return 0;                       /* out-of-memory, do nothing...           */
+                continue;                       /* out-of-memory, do nothing...           */
 
             udev->parent = NULL;
             udev->port_num = port+1;
@@ -1284,10 +1618,44 @@ HC_DRV_T  ehci_driver =
     ehci_iso_xfer,           /* iso_xfer           */
     ehci_quit_xfer,          /* quit_xfer          */
     ehci_rh_port_reset,      /* rthub_port_reset   */
-    ehci_rh_polling          /* rthub_polling      */
+    ehci_rh_polling,         /* rthub_polling      */
+    ehci_bw_check            /* bw_check           */
 };
 
 
 /// @endcond HIDDEN_SYMBOLS
 
+
+/**
+  * @brief    Install a free-running counter used to measure the time spent in EHCI interrupt
+  *           handler. The ARM926 core has no cycle counter, so a hardware timer running in
+  *           continuous counting mode, for example ETIMER with its 24-bit counter, is read.
+  * @param[in]  func   Function returning the current counter value. NULL stops measuring.
+  * @param[in]  mask   Mask of valid counter bits, 0xFFFFFF for a 24-bit counter.
+  * @return   None
+  */
+void usbh_install_irq_timer(USBH_TIMER_FUNC *func, uint32_t mask)
+{
+    DISABLE_EHCI_IRQ();
+    _irq_timer_func = func;
+    _irq_timer_mask = mask;
+    ENABLE_EHCI_IRQ();
+}
+
+/**
+  * @brief    Get the EHCI interrupt handler counters.
+  * @param[out] stat   Counters copied here.
+  * @param[in]  clear  Non-zero to clear the counters after read.
+  * @return   None
+  */
+void usbh_get_irq_stat(USBH_IRQ_STAT_T *stat, int clear)
+{
+    DISABLE_EHCI_IRQ();
+    *stat = _ehci_irq_stat;
+    if (clear)
+        memset(&_ehci_irq_stat, 0, sizeof(_ehci_irq_stat));
+    ENABLE_EHCI_IRQ();
+}
+
+
 /*** (C) COPYRIGHT 2017 Nuvoton Technology Corp. ***/
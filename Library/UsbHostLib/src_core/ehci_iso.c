@@ -28,25 +28,27 @@ ISO_EP_T  *iso_ep_list;                     /* list of activated isochronous pip
 
 extern uint32_t *_PFList;                   /* Periodic frame list                        */
 
+extern USBH_IRQ_STAT_T  _ehci_irq_stat;     /* EHCI interrupt statistics                  */
+
+static uint32_t  _iso_scan_frame;           /* first frame not reclaimed by scan yet      */
+
 static const uint16_t sitd_OUT_Smask [] = { 0x01, 0x03, 0x07, 0x0f, 0x1f, 0x3f };
 
 static int ehci_iso_split_xfer(UTR_T *utr, ISO_EP_T *iso_ep);
 
 /*
  *  Inspect the iTD can be reclaimed or not. If yes, collect the transaction results.
+ *  The UTR is called back by the caller after the iTD has been unlinked.
+ *  <passed> is 1 if the frame of this iTD has been passed by the host controller.
  *  Return:  1 - reclaimed
  *           0 - not completed
  */
-static int  review_itd(iTD_T *itd)
+static int  review_itd(iTD_T *itd, int passed)
 {
     UTR_T      *utr;
-    uint32_t   frnidx = itd->sched_frnidx;
-    uint32_t   now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
     int        i, fidx;
 
-    // sysprintf("R - %d %d, 0x%x\n", now_frame, frnidx, itd->Transaction[0]);
-
-    if (now_frame == frnidx)
+    if (!passed)
     {
         for (i = 0; i < 8; i++)
         {
@@ -54,16 +56,6 @@ static int  review_itd(iTD_T *itd)
                 return 0;                   /* have any not completed frames              */
         }
     }
-    else if (now_frame > frnidx)
-    {
-        if ((now_frame - frnidx) > EHCI_ISO_RCLM_RANGE)
-            return 0;                       /* don't touch it                             */
-    }
-    else
-    {
-        if (now_frame + FL_SIZE - frnidx > EHCI_ISO_RCLM_RANGE)
-            return 0;                       /* don't touch it                             */
-    }
 
     /*
      *  Reclaim this iTD
@@ -105,46 +97,27 @@ static int  review_itd(iTD_T *itd)
         }
         fidx++;
     }
-    utr->td_cnt--;
-
-    if (utr->td_cnt == 0)                   /* All iTD of this UTR done                   */
-    {
-        utr->bIsTransferDone = 1;
-        if (utr->func)
-            utr->func(utr);
-    }
-
     return 1;                               /* to be reclaimed                            */
 }
 
 /*
  *  Inspect the siTD can be reclaimed or not. If yes, collect the transaction results.
+ *  The UTR is called back by the caller after the siTD has been unlinked.
+ *  <passed> is 1 if the frame of this siTD has been passed by the host controller.
  *  Return:  1 - reclaimed
  *           0 - not completed
  */
-static int  review_sitd(siTD_T *sitd)
+static int  review_sitd(siTD_T *sitd, int passed)
 {
     UTR_T      *utr;
-    uint32_t   frnidx = sitd->sched_frnidx;
-    uint32_t   now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
     int        fidx;
     uint32_t   TotalBytesToTransfer;
 
-    if (now_frame == frnidx)
+    if (!passed)
     {
         if (SITD_STATUS(sitd->StsCtrl) == SITD_STATUS_ACTIVE)
             return 0;
     }
-    else if (now_frame > frnidx)
-    {
-        if ((now_frame - frnidx) > EHCI_ISO_RCLM_RANGE)
-            return 0;                       /* don't touch it                             */
-    }
-    else
-    {
-        if (now_frame + FL_SIZE - frnidx > EHCI_ISO_RCLM_RANGE)
-            return 0;                       /* don't touch it                             */
-    }
 
     /*
      *  Reclaim this siTD
@@ -180,155 +153,137 @@ static int  review_sitd(siTD_T *sitd)
         utr->iso_xlen[fidx] =  utr->iso_xlen[fidx] - TotalBytesToTransfer;
         utr->iso_status[fidx] = 0;
     }
+    return 1;                               /* to be reclaimed                            */
+}
+
+/*
+ *  One iTD/siTD of <utr> reclaimed. Call back when all are done. The callback may submit
+ *  the UTR again, which links new iTDs/siTDs into the periodic frame list.
+ */
+static void  iso_utr_td_done(UTR_T *utr)
+{
     utr->td_cnt--;
 
     if (utr->td_cnt == 0)                   /* All iTD of this UTR done                   */
     {
         utr->bIsTransferDone = 1;
+        USB_TRACE_DONE(utr);
         if (utr->func)
             utr->func(utr);
     }
-    return 1;                               /* to be reclaimed                            */
+}
+
+static void  remove_itd_from_iso_ep(iTD_T *itd)
+{
+    ISO_EP_T   *iso_ep = itd->iso_ep;
+    iTD_T      *p;
+
+    if (iso_ep->itd_list == itd)
+    {
+        iso_ep->itd_list = itd->next;       /* the oldest one, usually                    */
+        return;
+    }
+    for (p = iso_ep->itd_list; p != NULL; p = p->next)
+    {
+        if (p->next == itd)
+        {
+            p->next = itd->next;
+            return;
+        }
+    }
+}
+
+static void  remove_sitd_from_iso_ep(siTD_T *sitd)
+{
+    ISO_EP_T   *iso_ep = sitd->iso_ep;
+    siTD_T     *p;
+
+    if (iso_ep->sitd_list == sitd)
+    {
+        iso_ep->sitd_list = sitd->next;     /* the oldest one, usually                    */
+        return;
+    }
+    for (p = iso_ep->sitd_list; p != NULL; p = p->next)
+    {
+        if (p->next == sitd)
+        {
+            p->next = sitd->next;
+            return;
+        }
+    }
 }
 
 /*
- *  Some iTD/siTD may be scheduled but not serviced due to time missed.
- *  This function scan several earlier frames and drop unserviced iTD/siTD if found.
+ *  Reclaim completed iTDs/siTDs. The periodic frame list serves as the index of them by
+ *  frame number, since iTDs/siTDs are linked ahead of the interrupt QHs of their frame.
+ *  Only the frames passed since the last scan, up to EHCI_ISO_RCLM_RANGE frames, and the
+ *  current frame are visited. iTDs/siTDs of frames passed without being serviced due to
+ *  time missed are dropped with error status.
  */
 void scan_isochronous_list(void)
 {
-    ISO_EP_T   *iso_ep = iso_ep_list;
-    iTD_T      *itd, *itd_pre, *p;
-    siTD_T     *sitd, *sitd_pre, *sp;
-    uint32_t   frnidx;
+    iTD_T      *itd;
+    siTD_T     *sitd;
+    UTR_T      *utr;
+    uint32_t   *link_p;
+    uint32_t   frnidx, now_frame;
+    int        passed;
 
     DISABLE_EHCI_IRQ();
 
-    while (iso_ep != NULL)                  /* Search all activated iso endpoints         */
-    {
-        /*--------------------------------------------------------------------------------*/
-        /*  Scan all iTDs                                                                 */
-        /*--------------------------------------------------------------------------------*/
-        itd = iso_ep->itd_list;             /* get the first iTD from iso_ep's iTD list   */
-        itd_pre = NULL;
-        while (itd != NULL)                 /* traverse all iTDs of itd list              */
-        {
-            if (review_itd(itd))            /* inspect and reclaim iTD                    */
-            {
-                /*------------------------------------------------------------------------*/
-                /*  Remove this iTD from period frame list                                */
-                /*------------------------------------------------------------------------*/
-                frnidx = itd->sched_frnidx;
-                if (_PFList[frnidx] == ITD_HLNK_ITD(itd))
-                {
-                    /* is the first entry, just change to next     */
-                    _PFList[frnidx] = itd->Next_Link;
-                }
-                else
-                {
-                    p = ITD_PTR(_PFList[frnidx]);     /* find the preceding iTD            */
-                    while ((ITD_PTR(p->Next_Link) != itd) && (p != NULL))
-                    {
-                        p = ITD_PTR(p->Next_Link);
-                    }
-
-                    if (p == NULL)                    /* link list out of control!         */
-                    {
-                        USB_error("An iTD lost refernece to periodic frame list! 0x%x -> %d\n", (int)itd, frnidx);
-                    }
-                    else                              /* remove iTD from list              */
-                    {
-                        p->Next_Link = itd->Next_Link;
-                    }
-                }
+    now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
+    if (((now_frame + FL_SIZE - _iso_scan_frame) % FL_SIZE) > EHCI_ISO_RCLM_RANGE)
+        _iso_scan_frame = (now_frame + FL_SIZE - EHCI_ISO_RCLM_RANGE) % FL_SIZE;
 
-                /*------------------------------------------------------------------------*/
-                /*  Remove this iTD from iso_ep's iTD list                                */
-                /*------------------------------------------------------------------------*/
-                if (itd_pre == NULL)
-                {
-                    iso_ep->itd_list = itd->next;
-                }
-                else
-                {
-                    itd_pre->next = itd->next;
-                }
-                p = itd->next;
-                free_ehci_iTD(itd);
-                itd = p;
-            }
-            else
-            {
-                itd_pre = itd;
-                itd = itd->next;            /* traverse to the next iTD of iTD list       */
-            }
-        }
+    frnidx = _iso_scan_frame;
+    while (1)
+    {
+        passed = (frnidx != now_frame);
+        link_p = &_PFList[frnidx];
 
-        /*--------------------------------------------------------------------------------*/
-        /*  Scan all siTDs                                                                */
-        /*--------------------------------------------------------------------------------*/
-        sitd = iso_ep->sitd_list;           /* get the first siTD from iso_ep's siTD list */
-        sitd_pre = NULL;
-        while (sitd != NULL)                /* traverse all siTDs of sitd list            */
+        while (!HLINK_IS_TERMINATED(*link_p) && !HLINK_IS_QH(*link_p))
         {
-            if (review_sitd(sitd))          /* inspect and reclaim siTD                   */
-            {
-                /*------------------------------------------------------------------------*/
-                /*  Remove this siTD from period frame list                               */
-                /*------------------------------------------------------------------------*/
-                frnidx = sitd->sched_frnidx;
-                if (_PFList[frnidx] == SITD_HLNK_SITD(sitd))
-                {
-                    /* is the first entry, just change to next     */
-                    _PFList[frnidx] = sitd->Next_Link;
-                }
-                else
-                {
-                    sp = SITD_PTR(_PFList[frnidx]);   /* find the preceding siTD           */
-                    while ((SITD_PTR(sp->Next_Link) != sitd) && (sp != NULL))
-                    {
-                        sp = SITD_PTR(sp->Next_Link);
-                    }
-
-                    if (sp == NULL)                   /* link list out of control!         */
-                    {
-                        USB_error("An siTD lost reference to periodic frame list! 0x%x -> %d\n", (int)sitd, frnidx);
-                    }
-                    else                              /* remove iTD from list              */
-                    {
-                        sp->Next_Link = sitd->Next_Link;
-                    }
-                }
+            _ehci_irq_stat.iso_visited++;
 
-                /*------------------------------------------------------------------------*/
-                /*  Remove this siTD from iso_ep's siTD list                              */
-                /*------------------------------------------------------------------------*/
-                if (sitd_pre == NULL)
-                {
-                    iso_ep->sitd_list = sitd->next;
-                }
-                else
+            if (HLINK_IS_SITD(*link_p))
+            {
+                sitd = SITD_PTR(*link_p);
+                if (!review_sitd(sitd, passed))
                 {
-                    sitd_pre->next = sitd->next;
+                    link_p = &sitd->Next_Link;
+                    continue;
                 }
-                sp = sitd->next;
+                *link_p = sitd->Next_Link;  /* remove this siTD from periodic frame list  */
+                remove_sitd_from_iso_ep(sitd);
+                utr = sitd->utr;
                 free_ehci_siTD(sitd);
-                sitd = sp;
             }
             else
             {
-                sitd_pre = sitd;
-                sitd = sitd->next;           /* traverse to the next siTD of siTD list     */
+                itd = ITD_PTR(*link_p);
+                if (!review_itd(itd, passed))
+                {
+                    link_p = &itd->Next_Link;
+                    continue;
+                }
+                *link_p = itd->Next_Link;   /* remove this iTD from periodic frame list   */
+                remove_itd_from_iso_ep(itd);
+                utr = itd->utr;
+                free_ehci_iTD(itd);
             }
+            _ehci_irq_stat.iso_reclaimed++;
+            iso_utr_td_done(utr);
         }
 
-        iso_ep = iso_ep->next;
+        if (!passed)
+            break;
+        frnidx = (frnidx + 1) % FL_SIZE;
     }
+    _iso_scan_frame = now_frame;            /* current frame may still have active ones   */
 
     ENABLE_EHCI_IRQ();
 }
 
-
 static void  write_itd_info(UTR_T *utr, iTD_T *itd)
 {
     UDEV_T     *udev = utr->udev;
@@ -418,6 +373,19 @@ static __inline void  add_itd_to_iso_ep(ISO_EP_T *iso_ep, iTD_T *itd)
     p->next = itd;
 }
 
+/*
+ *  Frame number to start a new schedule: at least EHCI_ISO_DELAY frames ahead, on the
+ *  frame phase of the bandwidth reserved for the endpoint.
+ */
+static uint32_t  iso_start_frame(ISO_EP_T *iso_ep)
+{
+    uint32_t   frame;
+
+    frame = (((_ehci->UFINDR + (EHCI_ISO_DELAY * 8)) & HSUSBH_UFINDR_FI_Msk) >> 3) & 0x3FF;
+    frame += (iso_ep->bw.phase - frame) & (iso_ep->bw.period - 1);
+    return frame % FL_SIZE;
+}
+
 int ehci_iso_xfer(UTR_T *utr)
 {
     EP_INFO_T  *ep = utr->ep;               /* reference to isochronous endpoint          */
@@ -427,13 +395,14 @@ int ehci_iso_xfer(UTR_T *utr)
     int        trans_mask;                  /* bit mask of used xfer in an iTD            */
     int        fidx;                        /* index to the 8 iso frames of UTR           */
     int        interval;                    /* frame interval of iTD                      */
+    int        flags;
 
     if (ep->hw_pipe != NULL)
     {
         iso_ep = (ISO_EP_T *)ep->hw_pipe;   /* get reference of the isochronous endpoint  */
 
         if (utr->bIsoNewSched)
-            iso_ep->next_frame = (((_ehci->UFINDR + (EHCI_ISO_DELAY * 8)) & HSUSBH_UFINDR_FI_Msk) >> 3) & 0x3FF;
+            iso_ep->next_frame = iso_start_frame(iso_ep);
     }
     else
     {
@@ -444,17 +413,23 @@ int ehci_iso_xfer(UTR_T *utr)
 
         memset(iso_ep, 0, sizeof(*iso_ep));
         iso_ep->ep = ep;
-        iso_ep->next_frame = (((_ehci->UFINDR + (EHCI_ISO_DELAY * 8)) & HSUSBH_UFINDR_FI_Msk) >> 3) & 0x3FF;
+
+        if (ehci_bw_alloc(utr->udev, ep, &iso_ep->bw) < 0)
+        {
+            usbh_free_mem(iso_ep, sizeof(*iso_ep));
+            return USBH_ERR_NO_BANDWIDTH;
+        }
+        iso_ep->next_frame = iso_start_frame(iso_ep);
 
         ep->hw_pipe = iso_ep;
 
         /*
          *  Add this iso_ep into iso_ep_list
          */
-        DISABLE_EHCI_IRQ();
+        flags = usb_mem_lock();
         iso_ep->next = iso_ep_list;
         iso_ep_list = iso_ep;
-        ENABLE_EHCI_IRQ();
+        usb_mem_unlock(flags);
     }
 
     if (utr->udev->speed == SPEED_FULL)
@@ -464,48 +439,16 @@ int ehci_iso_xfer(UTR_T *utr)
     /*  Allocate iTDs                                                                     */
     /*------------------------------------------------------------------------------------*/
 
-    if (ep->bInterval < 2)                  /* transfer interval is 1 micro-frame         */
-    {
-        trans_mask = 0xFF;
-        itd_cnt = 1;                        /* required 1 iTD for one UTR                 */
-        interval = 1;                       /* iTD frame interval of this ednpoint        */
-    }
-    else if (ep->bInterval < 4)             /* transfer interval is 2 micro-frames        */
+    trans_mask = iso_ep->bw.smask;          /* reserved micro-frames                      */
+    for (i = 0, itd_cnt = 0; i < 8; i++)
     {
-        trans_mask = 0x55;
-        itd_cnt = 2;                        /* required 2 iTDs for one UTR                */
-        interval = 1;                       /* iTD frame interval of this ednpoint        */
-    }
-    else if (ep->bInterval < 8)             /* transfer interval is 4 micro-frames        */
-    {
-        trans_mask = 0x44;
-        itd_cnt = 4;                        /* required 4 iTDs for one UTR                */
-        interval = 1;                       /* iTD frame interval of this ednpoint        */
-    }
-    else if (ep->bInterval < 16)            /* transfer interval is 8 micro-frames        */
-    {
-        trans_mask = 0x08;                  /* there's 1 transfer in one iTD              */
-        itd_cnt = 8;                        /* required 8 iTDs for one UTR                */
-        interval = 1;                       /* iTD frame interval of this ednpoint        */
-    }
-    else if (ep->bInterval < 32)            /* transfer interval is 16 micro-frames       */
-    {
-        trans_mask = 0x10;                  /* there's 1 transfer in one iTD              */
-        itd_cnt = 8;                        /* required 8 iTDs for one UTR                */
-        interval = 2;                       /* iTD frame interval of this ednpoint        */
-    }
-    else if (ep->bInterval < 64)            /* transfer interval is 32 micro-frames       */
-    {
-        trans_mask = 0x02;                  /* there's 1 transfer in one iTD              */
-        itd_cnt = 8;                        /* required 8 iTDs for one UTR                */
-        interval = 4;                       /* iTD frame interval of this ednpoint        */
-    }
-    else                                    /* transfer interval is 64 micro-frames       */
-    {
-        trans_mask = 0x04;                  /* there's 1 transfer in one iTD              */
-        itd_cnt = 8;                        /* required 8 iTDs for one UTR                */
-        interval = 8;                       /* iTD frame interval of this ednpoint        */
+        if (trans_mask & (0x1 << i))
+            itd_cnt++;
     }
+    itd_cnt = IF_PER_UTR / itd_cnt;         /* number of iTDs required by one UTR         */
+    interval = iso_ep->bw.uf_interval / 8;  /* iTD frame interval of this endpoint        */
+    if (interval == 0)
+        interval = 1;
 
     for (i = 0; i < itd_cnt; i++)           /* allocate all iTDs required by UTR          */
     {
@@ -542,6 +485,7 @@ int ehci_iso_xfer(UTR_T *utr)
         }
 
         itd->utr = utr;
+        itd->iso_ep = iso_ep;
         itd->fidx = fidx;                   /* index to UTR's n'th IF_PER_UTR frame       */
         itd->buff_base = (uint32_t)(utr->iso_buff[fidx]);    /* iTD buffer base is buffer of the first UTR iso frame serviced by this iTD */
         itd->trans_mask = trans_mask;
@@ -574,13 +518,13 @@ int ehci_iso_xfer(UTR_T *utr)
         /*
          *  Link iTD to period frame list
          */
-        DISABLE_EHCI_IRQ();
+        flags = usb_mem_lock();
         itd->sched_frnidx = iso_ep->next_frame;       /* remember it for reclamation scan */
         add_itd_to_iso_ep(iso_ep, itd);               /* add to software itd list         */
         itd->Next_Link = _PFList[itd->sched_frnidx];  /* keep the next link               */
         _PFList[itd->sched_frnidx] = ITD_HLNK_ITD(itd);
         iso_ep->next_frame = (iso_ep->next_frame + interval) % FL_SIZE;
-        ENABLE_EHCI_IRQ();
+        usb_mem_unlock(flags);
 
         itd = itd_next;
     }
@@ -626,9 +570,10 @@ static void  write_sitd_info(UTR_T *utr, siTD_T *sitd)
 {
     UDEV_T     *udev = utr->udev;
     EP_INFO_T  *ep = utr->ep;               /* reference to isochronous endpoint          */
+    ISO_EP_T   *iso_ep = (ISO_EP_T *)ep->hw_pipe;
     uint32_t   buff_page_addr;
     int        xlen = utr->iso_xlen[sitd->fidx];
-    int        scnt;
+    int        scnt, start;
 
     sitd->Chrst = (udev->port_num << SITD_PORT_NUM_Pos) |
                   (udev->parent->iface->udev->dev_num << SITD_HUB_ADDR_Pos) |
@@ -640,18 +585,21 @@ static void  write_sitd_info(UTR_T *utr, siTD_T *sitd)
     sitd->Bptr[1] = buff_page_addr + 0x1000;
 
     scnt = (xlen + 187) / 188;
+    if (scnt == 0)
+        scnt = 1;                           /* zero length packet                         */
+
+    for (start = 0; !(iso_ep->bw.smask & (0x1 << start)); start++)
+        ;                                   /* reserved start-split micro-frame           */
 
     if ((ep->bEndpointAddress & EP_ADDR_DIR_MASK) == EP_ADDR_DIR_IN)   /* I/O               */
     {
         sitd->Chrst |= SITD_XFER_IN;
-        sitd->Sched = (1 << (scnt + 2)) - 1;
-        sitd->Sched = (sitd->Sched << 10) | 0x1;
-        //sitd->Sched <<= 1;
+        sitd->Sched = (iso_ep->bw.cmask << 8) | iso_ep->bw.smask;
     }
     else
     {
         sitd->Chrst |= SITD_XFER_OUT;
-        sitd->Sched = sitd_OUT_Smask[scnt-1];
+        sitd->Sched = sitd_OUT_Smask[scnt-1] << start;
         if (scnt > 1)
         {
             sitd->Bptr[1] |= (0x1 << 3);        /* Transaction position (TP)  01b: Begin  */
@@ -659,7 +607,7 @@ static void  write_sitd_info(UTR_T *utr, siTD_T *sitd)
         sitd->Bptr[1] |= scnt;                  /* Transaction count (T-Count)            */
     }
 
-    if (sitd->fidx == IF_PER_UTR)
+    if (sitd->fidx == IF_PER_UTR - 1)       /* interrupt on the last frame of the UTR     */
     {
         sitd->Sched |= SITD_IOC;
     }
@@ -670,56 +618,10 @@ static void  write_sitd_info(UTR_T *utr, siTD_T *sitd)
 }
 
 
-static void ehci_sitd_adjust_schedule(siTD_T *sitd)
-{
-    siTD_T     *hlink = (siTD_T  *)_PFList[sitd->sched_frnidx];
-    uint32_t   uframe_mask = 0x00;
-
-    while (hlink && !HLINK_IS_TERMINATED(hlink) && HLINK_IS_SITD(hlink))
-    {
-        hlink = SITD_PTR(hlink);
-        if (hlink != sitd)
-        {
-            if ((hlink->Chrst & SITD_XFER_IO_Msk) == SITD_XFER_IN)
-            {
-                uframe_mask |= (hlink->Sched & 0xFF);         /* mark micro-frames used by IN S-mask   */
-                uframe_mask |= ((hlink->Sched >> 8) & 0xFF);  /* mark micro-frames used by IN C-mask   */
-            }
-            else
-            {
-                uframe_mask |= (hlink->Sched & 0xFF);         /* mark micro-frames used by OUT S-mask  */
-            }
-        }
-        hlink = SITD_PTR(hlink->Next_Link);
-    }
-
-    uframe_mask = uframe_mask | (uframe_mask << 8);           /* mark both S-mask and C-mask           */
-
-    if (uframe_mask)
-    {
-        /*
-         *  Shift afterward one micro-frame until no conflicts.
-         */
-        while (1)
-        {
-            if (sitd->Sched & uframe_mask)
-            {
-                sitd->Sched = (sitd->Sched & 0xFFFF0000) | ((sitd->Sched << 1) & 0xFFFF);
-            }
-            else
-            {
-                break;                      /* no conflit, done.                          */
-            }
-        }
-    }
-}
-
-
 static int ehci_iso_split_xfer(UTR_T *utr, ISO_EP_T *iso_ep)
 {
-    EP_INFO_T  *ep = utr->ep;               /* reference to isochronous endpoint          */
     siTD_T     *sitd, *sitd_next, *sitd_list = NULL;
-    int        i;
+    int        i, flags;
     int        fidx;                        /* index to the 8 iso frames of UTR           */
 
     if (utr->udev->parent == NULL)
@@ -766,6 +668,7 @@ static int ehci_iso_split_xfer(UTR_T *utr, ISO_EP_T *iso_ep)
         }
 
         sitd->utr = utr;
+        sitd->iso_ep = iso_ep;
         sitd->fidx = fidx;                   /* index to UTR's n'th IF_PER_UTR frame       */
 
         write_sitd_info(utr, sitd);
@@ -777,13 +680,12 @@ static int ehci_iso_split_xfer(UTR_T *utr, ISO_EP_T *iso_ep)
          *  Link iTD to period frame list
          */
         sitd->sched_frnidx = iso_ep->next_frame;      /* remember it for reclamation scan */
-        DISABLE_EHCI_IRQ();
-        ehci_sitd_adjust_schedule(sitd);
+        flags = usb_mem_lock();
         add_sitd_to_iso_ep(iso_ep, sitd);             /* add to software itd list         */
         sitd->Next_Link = _PFList[sitd->sched_frnidx];/* keep the next link               */
         _PFList[sitd->sched_frnidx] = SITD_HLNK_SITD(sitd);
-        iso_ep->next_frame = (iso_ep->next_frame + ep->bInterval) % FL_SIZE;
-        ENABLE_EHCI_IRQ();
+        iso_ep->next_frame = (iso_ep->next_frame + iso_ep->bw.uf_interval / 8) % FL_SIZE;
+        usb_mem_unlock(flags);
 
         sitd = sitd_next;
     }
@@ -802,15 +704,64 @@ malloc_failed:
     return USBH_ERR_MEMORY_OUT;
 }
 
+/*
+ *  Remove an iTD or siTD from the periodic frame list. The descriptor is identified by
+ *  its horizontal link pointer value.
+ */
+static void  unlink_periodic_td(uint32_t frnidx, uint32_t hlink)
+{
+    uint32_t   *link_p;
+    uint32_t   now_frame;
+
+    /*
+     *  Prevent to race with Host Controller. If the descriptor to be removed is located in
+     *  current or next frame, wait until HC passed through it.
+     */
+    while (1)
+    {
+        now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
+        if ((now_frame == frnidx) || (((now_frame+1)%1024) == frnidx))
+            continue;
+        break;
+    }
+
+    /* iTD and siTD both start with the Next_Link pointer                                 */
+    link_p = &_PFList[frnidx];
+    while (!HLINK_IS_TERMINATED(*link_p) && !HLINK_IS_QH(*link_p))
+    {
+        if (*link_p == hlink)
+        {
+            *link_p = *(uint32_t *)ITD_PTR(hlink);
+            return;
+        }
+        link_p = (uint32_t *)ITD_PTR(*link_p);
+    }
+    USB_error("ehci_quit_iso_xfer - A TD lost reference to periodic frame list! 0x%x on %d\n", hlink, frnidx);
+}
+
+static void  iso_quit_utr_td(UTR_T *utr)
+{
+    utr->td_cnt--;
+    if (utr->td_cnt == 0)
+    {
+        /* All iTD of this UTR done                   */
+        utr->bIsTransferDone = 1;
+        utr->status = USBH_ERR_ABORT;
+        USB_TRACE_DONE(utr);
+        if (utr->func)
+            utr->func(utr);
+    }
+}
+
 /*
  *  If it's an isochronous endpoint, quit current trasnfer via UTR or hardware EP.
  */
 int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
 {
     ISO_EP_T   *iso_ep;
-    iTD_T      *itd, *itd_next, *p;
-    uint32_t   frnidx;
-    uint32_t   now_frame;
+    iTD_T      *itd, *itd_next;
+    siTD_T     *sitd, *sitd_next;
+    int        flags;
 
     if (ep == NULL)
     {
@@ -839,6 +790,8 @@ int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
     if (iso_ep == NULL)
         return 0;                           /* should have been removed                   */
 
+    flags = usb_mem_lock();                 /* keep reclamation scan off the lists        */
+
     itd = iso_ep->itd_list;                 /* get the first iTD from iso_ep's iTD list   */
 
     while (itd != NULL)                     /* traverse all iTDs of itd list              */
@@ -846,73 +799,39 @@ int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
         itd_next = itd->next;               /* remember the next iTD                      */
         utr = itd->utr;
 
-        /*--------------------------------------------------------------------------------*/
-        /*  Remove this iTD from period frame list                                        */
-        /*--------------------------------------------------------------------------------*/
-        frnidx = itd->sched_frnidx;
-
-        /*
-         *  Prevent to race with Host Controller. If the iTD to be removed is located in
-         *  current or next frame, wait until HC passed through it.
-         */
-        while (1)
-        {
-            now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
-            if ((now_frame == frnidx) || (((now_frame+1)%1024) == frnidx))
-                continue;
-            break;
-        }
+        unlink_periodic_td(itd->sched_frnidx, ITD_HLNK_ITD(itd));
+        iso_quit_utr_td(utr);
+        free_ehci_iTD(itd);
+        itd = itd_next;
+    }
+    iso_ep->itd_list = NULL;
 
-        if (_PFList[frnidx] == ITD_HLNK_ITD(itd))
-        {
-            /* is the first entry, just change to next     */
-            _PFList[frnidx] = itd->Next_Link;
-        }
-        else
-        {
-            /*
-             * find the preceding iTD
-             */
-            p = ITD_PTR(_PFList[frnidx]);   /* find the preceding iTD                     */
-            while ((ITD_PTR(p->Next_Link) != itd) && (p != NULL))
-            {
-                p = ITD_PTR(p->Next_Link);
-            }
+    sitd = iso_ep->sitd_list;               /* split iso endpoint keeps siTDs instead     */
 
-            if (p == NULL)                  /* link list out of control!                  */
-            {
-                USB_error("ehci_quit_iso_xfer - An iTD lost reference to periodic frame list! 0x%x on %d\n", (int)itd, frnidx);
-            }
-            else                            /* remove iTD from list                       */
-            {
-                p->Next_Link = itd->Next_Link;
-            }
-        }
-
-        utr->td_cnt--;
-        if (utr->td_cnt == 0)
-        {
-            /* All iTD of this UTR done                   */
-            utr->bIsTransferDone = 1;
-            if (utr->func)
-                utr->func(utr);
-            utr->status = USBH_ERR_ABORT;
-        }
+    while (sitd != NULL)
+    {
+        sitd_next = sitd->next;
+        utr = sitd->utr;
 
-        free_ehci_iTD(itd);
-        itd = itd_next;
+        unlink_periodic_td(sitd->sched_frnidx, SITD_HLNK_SITD(sitd));
+        iso_quit_utr_td(utr);
+        free_ehci_siTD(sitd);
+        sitd = sitd_next;
     }
+    iso_ep->sitd_list = NULL;
 
     /*
      *  Remove iso_ep from iso_ep_list
      */
     remove_iso_ep_from_list(iso_ep);
+    ehci_bw_free(&iso_ep->bw);
     usbh_free_mem(iso_ep, sizeof(*iso_ep));      /* free this iso_ep                      */
     ep->hw_pipe = NULL;
 
     if (iso_ep_list == NULL)
         _ehci->UCMDR &= ~HSUSBH_UCMDR_PSEN_Msk;
 
+    usb_mem_unlock(flags);
     return 0;
 }
 
@@ -29,6 +29,9 @@
 
 static HUB_DEV_T  g_hub_dev[MAX_HUB_DEVICE];
 
+static volatile uint32_t  _hub_events;      /* HUB_EVT_xxx posted and not handled yet     */
+static HUB_EVT_FUNC  *_hub_evt_func;
+
 static int do_port_reset(HUB_DEV_T *hub, int port);
 
 static HUB_DEV_T *alloc_hub_device(void)
@@ -206,6 +209,7 @@ static void hub_status_irq(UTR_T *utr)
             hub->sc_bitmap |= (utr->buff[i] << (i * 8));
         }
         HUB_DBGMSG("hub_status_irq - status bitmap: 0x%x\n", hub->sc_bitmap);
+        usbh_hub_event(HUB_EVT_HUB);
     }
 }
 
@@ -573,19 +577,12 @@ static int  port_status_change(HUB_DEV_T *hub, int port)
     return 0;
 }
 
-static  volatile  uint8_t   _hub_polling_mutex = 0;
-
 static int  hub_polling(void)
 {
     HUB_DEV_T   *hub;
     UTR_T       *utr;
     int         i, ret, port, change = 0;
 
-    if (_hub_polling_mutex)                 /* do nothing                                 */
-        return 0;
-
-    _hub_polling_mutex = 1;
-
     for (i = 0; i < MAX_HUB_DEVICE; i++)
     {
         if ((g_hub_dev[i].iface != NULL) && (g_hub_dev[i].sc_bitmap))
@@ -624,7 +621,6 @@ static int  hub_polling(void)
             }
         }
     }
-    _hub_polling_mutex = 0;
     return change;
 }
 
@@ -637,61 +633,159 @@ void usbh_hub_init(void)
 {
     memset((char *)&g_hub_dev[0], 0, sizeof(g_hub_dev));
     usbh_register_driver(&hub_driver);
+    _hub_events = HUB_EVT_ALL;              /* scan ports connected before init           */
+}
+
+
+/*
+ *  Post hub events. Called from the EHCI/OHCI interrupt handlers, or with their
+ *  interrupts masked.
+ */
+void usbh_hub_event(uint32_t event)
+{
+    _hub_events |= event;
+    if (_hub_evt_func != NULL)
+        _hub_evt_func();
+}
+
+/*
+ *  Take one event source right before it is polled. An event posted while the source
+ *  is being polled sets the bit again and is handled by the next call.
+ */
+static int  hub_take_event(uint32_t event)
+{
+    int   flags, ret;
+
+    flags = usb_mem_lock();
+    ret = (_hub_events & event) ? 1 : 0;
+    _hub_events &= ~event;
+    usb_mem_unlock(flags);
+    return ret;
 }
 
+static  volatile  uint8_t   _hub_polling_mutex = 0;
 
 /// @endcond HIDDEN_SYMBOLS
 
 /**
-  * @brief    Let USB stack polls all roothubs and downstream hubs. If there's any hub port
-  *           change found, USB stack will manage the hub events in this function call.
+  * @brief    Let USB stack handle root hub and downstream hub port changes. Port changes are
+  *           reported by the EHCI/OHCI root hub interrupts and hub status change interrupt
+  *           transfers, and only the hubs reporting a change are visited. If nothing has
+  *           changed since the last call, this function returns at once.
   *           In this function, USB stack enumerates newly connected devices and remove staff
   *           of disconnedted devices. User's application should periodically invoke this
-  *           function.
+  *           function, or call it when the callback installed by
+  *           usbh_install_hub_event_callback() is invoked.
   * @return   There's hub port change or not.
   * @retval   0   No any hub port status changes found.
   * @retval   1   There's hub port status changes.
   */
 int  usbh_pooling_hubs(void)
 {
-    int   ret, change = 0;
+    int       ret, change = 0;
+
+    /*
+     *  A nested call, from a class driver probe for example, leaves the events pending
+     *  for the outer call instead of taking them and dropping them.
+     */
+    if (_hub_polling_mutex || (_hub_events == 0))
+        return 0;
+
+    _hub_polling_mutex = 1;
 
 #ifdef ENABLE_EHCI
-    do
+    if (hub_take_event(HUB_EVT_EHCI_RH))
     {
-        ret = ehci_driver.rthub_polling();
-        if (ret)
-            change = 1;
+        do
+        {
+            ret = ehci_driver.rthub_polling();
+            if (ret)
+                change = 1;
+        }
+        while (ret == 1);
     }
-    while (ret == 1);
 
     // scan_isochronous_list();
 
+#else
+    hub_take_event(HUB_EVT_EHCI_RH);        /* no such controller, drop the event         */
 #endif
 
 #ifdef ENABLE_OHCI
-    do
+    if (hub_take_event(HUB_EVT_OHCI_RH))
     {
-        ret = ohci_driver.rthub_polling();
-        if (ret)
-            change = 1;
+        do
+        {
+            ret = ohci_driver.rthub_polling();
+            if (ret)
+                change = 1;
+        }
+        while (ret == 1);
     }
-    while (ret == 1);
+#else
+    hub_take_event(HUB_EVT_OHCI_RH);        /* no such controller, drop the event         */
 #endif
 
-
-    do
+    if (hub_take_event(HUB_EVT_HUB))
     {
-        ret = hub_polling();
-        if (ret)
-            change = 1;
+        do
+        {
+            ret = hub_polling();
+            if (ret)
+                change = 1;
+        }
+        while (ret == 1);
     }
-    while (ret == 1);
 
+    _hub_polling_mutex = 0;
     return change;
 }
 
 
+/*
+ *  Get pending hub events handled from inside the USB stack. If the application has
+ *  installed a hub event callback, the code it wakes (for example the hub task) owns
+ *  hub polling, so it is woken instead of polling from the caller's context.
+ */
+void usbh_hub_service(void)
+{
+    if (_hub_evt_func != NULL)
+    {
+        if (_hub_events)
+            _hub_evt_func();
+    }
+    else
+    {
+        usbh_pooling_hubs();
+    }
+}
+
+
+/**
+  * @brief    Check if any hub port change is waiting for usbh_pooling_hubs().
+  * @return   Hub event pending or not.
+  * @retval   0   No hub event.
+  * @retval   1   usbh_pooling_hubs() has work to do.
+  */
+int  usbh_hub_event_pending(void)
+{
+    return (_hub_events != 0) ? 1 : 0;
+}
+
+
+/**
+  * @brief    Install a callback function invoked when a hub port change is posted.
+  *           It is called from the USB host interrupt handlers, so it must be short, for
+  *           example give a semaphore or set a flag to wake the code calling usbh_pooling_hubs().
+  * @param[in]  func    Hub event callback function, or NULL to remove it.
+  * @return   None
+  */
+void usbh_install_hub_event_callback(HUB_EVT_FUNC *func)
+{
+    _hub_evt_func = func;
+}
+
+
 /**
   * @brief    Find the device under the specified hub port.
   * @param[in]  hub_id    Hub identify ID
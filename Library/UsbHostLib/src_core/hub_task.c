@@ -0,0 +1,93 @@
+/**************************************************************************//**
+ * @file     hub_task.c
+ * @version  V1.00
+ * @brief    USB Host library hub event task for FreeRTOS.
+ *
+ *           Add this file to FreeRTOS projects only, see USBH_HID_FreeRTOS
+ *           sample. Bare-metal applications call usbh_pooling_hubs() from their
+ *           main loop instead, and their GCC projects exclude this file.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "N9H31.h"
+
+#include "usb.h"
+#include "usbh_lib.h"
+
+
+/// @cond HIDDEN_SYMBOLS
+
+#define HUB_TASK_STACK_SIZE     1024        /* in words, enumeration calls class probes   */
+
+static SemaphoreHandle_t  _hub_sem;
+static HUB_EVT_FUNC  *_hub_change_func;
+
+/*
+ *  Called from the EHCI/OHCI interrupt handlers. The ARM9 port has no yield from ISR,
+ *  so the hub task runs at the next tick at the latest.
+ */
+static void  hub_task_notify(void)
+{
+    BaseType_t  woken = pdFALSE;
+
+    xSemaphoreGiveFromISR(_hub_sem, &woken);
+}
+
+static void  hub_task(void *pvParameters)
+{
+    for (;;)
+    {
+        xSemaphoreTake(_hub_sem, portMAX_DELAY);
+
+        while (usbh_hub_event_pending())
+        {
+            if (usbh_pooling_hubs() && (_hub_change_func != NULL))
+                _hub_change_func();
+        }
+    }
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+
+/**
+  * @brief    Start a task handling hub port changes. The task sleeps until an EHCI/OHCI root
+  *           hub or hub interrupt posts a port change, then enumerates or removes devices.
+  *           Once the task is started, the application must not call usbh_pooling_hubs().
+  * @param[in]  priority      FreeRTOS priority of the hub task.
+  * @param[in]  change_func   Called in the hub task after devices have been connected or
+  *                           disconnected, or NULL. The application can rescan its device
+  *                           lists here.
+  * @return   Success or not.
+  * @retval   0          Success
+  * @retval   Otherwise  Failed
+  * @note     Call it after usbh_core_init() and the class driver init functions.
+  */
+int  usbh_start_hub_task(uint32_t priority, HUB_EVT_FUNC *change_func)
+{
+    _hub_sem = xSemaphoreCreateBinary();
+    if (_hub_sem == NULL)
+        return USBH_ERR_MEMORY_OUT;
+
+    _hub_change_func = change_func;
+
+    if (xTaskCreate(hub_task, "usbh_hub", HUB_TASK_STACK_SIZE, NULL, priority, NULL) != pdPASS)
+        return USBH_ERR_MEMORY_OUT;
+
+    usbh_install_hub_event_callback(hub_task_notify);
+    xSemaphoreGive(_hub_sem);               /* handle devices connected before start      */
+    return 0;
+}
+
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
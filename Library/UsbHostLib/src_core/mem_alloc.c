@@ -34,8 +34,55 @@ uint8_t  _mem_pool_buff[MEM_POOL_UNIT_NUM][MEM_POOL_UNIT_SIZE];
 uint8_t _mem_pool_buff[MEM_POOL_UNIT_NUM][MEM_POOL_UNIT_SIZE] __attribute__((aligned(1024)));
 #endif
 
-static uint8_t * _mem_pool[MEM_POOL_UNIT_NUM];
-static uint8_t  _unit_used[MEM_POOL_UNIT_NUM];
+/*
+ *  Hardware descriptors of each type are allocated from their own partition of
+ *  _mem_pool_buff, and from the shared partition once their own is used up.
+ *  Free units of a partition are kept in a FIFO list linked by unit index, so
+ *  allocate and free are O(1), and a just freed descriptor, which the host
+ *  controller may still have cached, is the last one to be reused.
+ */
+#define UNIT_IN_USE     0xFFFE
+#define UNIT_NONE       0xFFFF
+
+enum
+{
+    POOL_ED, POOL_TD, POOL_QH, POOL_QTD, POOL_ITD, POOL_SITD, POOL_SHARED, POOL_TYPE_NUM
+};
+
+#define POOL_TD_FIRST       (MEM_POOL_ED_NUM)
+#define POOL_QH_FIRST       (POOL_TD_FIRST + MEM_POOL_TD_NUM)
+#define POOL_QTD_FIRST      (POOL_QH_FIRST + MEM_POOL_QH_NUM)
+#define POOL_ITD_FIRST      (POOL_QTD_FIRST + MEM_POOL_QTD_NUM)
+#define POOL_SITD_FIRST     (POOL_ITD_FIRST + MEM_POOL_ITD_NUM)
+#define POOL_SHARED_FIRST   (POOL_SITD_FIRST + MEM_POOL_SITD_NUM)
+
+typedef struct
+{
+    const char  *name;
+    uint16_t    first;          /* first unit of the partition          */
+    uint16_t    num;            /* number of units of the partition     */
+    uint16_t    head;           /* free list head, UNIT_NONE if empty   */
+    uint16_t    tail;           /* free list tail                       */
+    uint16_t    used;           /* units allocated, shared ones included */
+    uint16_t    max_used;       /* high-water mark of used              */
+    uint16_t    shared;         /* units held from the shared partition */
+    uint32_t    fail_cnt;       /* allocations failed for exhaustion    */
+}  DESC_POOL_T;
+
+static DESC_POOL_T  _desc_pool[POOL_TYPE_NUM] =
+{
+    { "ED",   0,                  MEM_POOL_ED_NUM     },
+    { "TD",   POOL_TD_FIRST,      MEM_POOL_TD_NUM     },
+    { "QH",   POOL_QH_FIRST,      MEM_POOL_QH_NUM     },
+    { "qTD",  POOL_QTD_FIRST,     MEM_POOL_QTD_NUM    },
+    { "iTD",  POOL_ITD_FIRST,     MEM_POOL_ITD_NUM    },
+    { "siTD", POOL_SITD_FIRST,    MEM_POOL_SITD_NUM   },
+    { "any",  POOL_SHARED_FIRST,  MEM_POOL_SHARED_NUM },
+};
+
+static uint16_t  _unit_next[MEM_POOL_UNIT_NUM];     /* free list link, or UNIT_IN_USE */
+static uint8_t   _unit_type[MEM_POOL_SHARED_NUM];   /* type holding a shared unit */
+static uint32_t  _mem_pool_base;
 
 static volatile int  _usbh_mem_used;
 static volatile int  _usbh_max_mem_used;
@@ -47,15 +94,14 @@ UDEV_T * g_udev_list;
 uint8_t  _dev_addr_pool[128];
 static volatile int  _device_addr;
 
-static  int  _sidx = 0;;
-
 /*--------------------------------------------------------------------------*/
 /*   Memory alloc/free recording                                            */
 /*--------------------------------------------------------------------------*/
 
 void usbh_memory_init(void)
 {
-    int   i;
+    DESC_POOL_T  *pool;
+    int   i, t;
 
     if (sizeof(TD_T) > MEM_POOL_UNIT_SIZE)
     {
@@ -69,17 +115,33 @@ void usbh_memory_init(void)
         while (1);
     }
 
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if ((sizeof(QH_T) > MEM_POOL_UNIT_SIZE) || (sizeof(qTD_T) > MEM_POOL_UNIT_SIZE) ||
+        (sizeof(iTD_T) > MEM_POOL_UNIT_SIZE) || (sizeof(siTD_T) > MEM_POOL_UNIT_SIZE))
     {
-        _unit_used[i] = 0;
-        _mem_pool[i] = (uint8_t *)((uint32_t)&_mem_pool_buff[i] | NON_CACHE_MASK);
+        USB_error("EHCI descriptor - MEM_POOL_UNIT_SIZE too small!\n");
+        while (1);
+    }
+
+    _mem_pool_base = (uint32_t)&_mem_pool_buff[0] | NON_CACHE_MASK;
+
+    for (t = 0; t < POOL_TYPE_NUM; t++)
+    {
+        pool = &_desc_pool[t];
+        for (i = pool->first; i < pool->first + pool->num - 1; i++)
+            _unit_next[i] = i + 1;
+        _unit_next[i] = UNIT_NONE;
+        pool->head = pool->first;
+        pool->tail = pool->first + pool->num - 1;
+        pool->used = 0;
+        pool->max_used = 0;
+        pool->shared = 0;
+        pool->fail_cnt = 0;
     }
 
     _usbh_mem_used = 0L;
     _usbh_max_mem_used = 0L;
 
     _mem_pool_used = 0;
-    _sidx = 0;
 
     g_udev_list = NULL;
 
@@ -91,7 +153,19 @@ void usbh_memory_init(void)
 
 uint32_t  usbh_memory_used(void)
 {
+    USB_MEM_STAT_T  stat;
+    int   t;
+
+    USB_memory_stat(&stat);
     sysprintf("USB static memory: %d/%d, heap used: %d\n", _mem_pool_used, MEM_POOL_UNIT_NUM, _usbh_mem_used);
+    sysprintf("USB DMA pool: %d/%d (max %d), requested %d, largest free %d, allocs %d, fails %d\n",
+              stat.allocated, stat.total, stat.max_allocated, stat.requested,
+              stat.largest_free, stat.alloc_cnt, stat.fail_cnt);
+    for (t = 0; t < POOL_TYPE_NUM; t++)
+    {
+        sysprintf("    %-4s: %d/%d (max %d, shared %d), exhausted %d\n", _desc_pool[t].name, _desc_pool[t].used,
+                  _desc_pool[t].num, _desc_pool[t].max_used, _desc_pool[t].shared, _desc_pool[t].fail_cnt);
+    }
     return _usbh_mem_used;
 }
 
@@ -240,46 +314,130 @@ void free_utr(UTR_T *utr)
     memory_counter(0-(int)sizeof(*utr));
 }
 
+/*--------------------------------------------------------------------------*/
+/*   Hardware descriptor pool                                               */
+/*--------------------------------------------------------------------------*/
+
+/* take the head of the free list of a partition, UNIT_NONE if empty */
+static int desc_list_get(DESC_POOL_T *pool)
+{
+    int   idx = pool->head;
+
+    if (idx != UNIT_NONE)
+    {
+        pool->head = _unit_next[idx];
+        _unit_next[idx] = UNIT_IN_USE;
+    }
+    return idx;
+}
+
+static void desc_list_put(DESC_POOL_T *pool, int idx)
+{
+    _unit_next[idx] = UNIT_NONE;
+    if (pool->head == UNIT_NONE)
+        pool->head = idx;
+    else
+        _unit_next[pool->tail] = idx;
+    pool->tail = idx;
+}
+
+static void * desc_unit_alloc(int type)
+{
+    DESC_POOL_T  *pool = &_desc_pool[type];
+    DESC_POOL_T  *shared = &_desc_pool[POOL_SHARED];
+    int   idx, flags;
+
+    flags = usb_mem_lock();
+    idx = desc_list_get(pool);
+    if (idx == UNIT_NONE)
+    {
+        idx = desc_list_get(shared);
+        if (idx == UNIT_NONE)
+        {
+            pool->fail_cnt++;
+            shared->fail_cnt++;
+            usb_mem_unlock(flags);
+            return NULL;
+        }
+        _unit_type[idx - shared->first] = type;
+        pool->shared++;
+        shared->used++;
+        if (shared->used > shared->max_used)
+            shared->max_used = shared->used;
+    }
+    pool->used++;
+    if (pool->used > pool->max_used)
+        pool->max_used = pool->used;
+    _mem_pool_used++;
+    usb_mem_unlock(flags);
+
+    return (void *)(_mem_pool_base + idx * MEM_POOL_UNIT_SIZE);
+}
+
+/* return 0 on success, -1 if p is not an allocated unit of this type */
+static int desc_unit_free(int type, void *p)
+{
+    DESC_POOL_T  *pool = &_desc_pool[type];
+    DESC_POOL_T  *shared = &_desc_pool[POOL_SHARED];
+    uint32_t  offset = (uint32_t)p - _mem_pool_base;
+    int   idx, flags, is_shared;
+
+    if ((offset % MEM_POOL_UNIT_SIZE) != 0)
+        return -1;
+    idx = offset / MEM_POOL_UNIT_SIZE;
+    is_shared = (idx >= shared->first) && (idx < shared->first + shared->num);
+    if (!is_shared && ((idx < pool->first) || (idx >= pool->first + pool->num)))
+        return -1;
+
+    flags = usb_mem_lock();
+    if ((_unit_next[idx] != UNIT_IN_USE) || (is_shared && (_unit_type[idx - shared->first] != type)))
+    {
+        usb_mem_unlock(flags);
+        return -1;
+    }
+    if (is_shared)
+    {
+        desc_list_put(shared, idx);
+        shared->used--;
+        pool->shared--;
+    }
+    else
+    {
+        desc_list_put(pool, idx);
+    }
+    pool->used--;
+    _mem_pool_used--;
+    usb_mem_unlock(flags);
+    return 0;
+}
+
 /*--------------------------------------------------------------------------*/
 /*   OHCI ED allocate/free                                                  */
 /*--------------------------------------------------------------------------*/
 
 ED_T * alloc_ohci_ED(void)
 {
-    int    i;
     ED_T   *ed;
 
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    ed = (ED_T *)desc_unit_alloc(POOL_ED);
+    if (ed == NULL)
     {
-        if (_unit_used[i] == 0)
-        {
-            _unit_used[i] = 1;
-            _mem_pool_used++;
-            ed = (ED_T *)_mem_pool[i];
-            memset(ed, 0, sizeof(*ed));
-            mem_debug("[ALLOC] [ED] - 0x%x\n", (int)ed);
-            return ed;
-        }
+        USB_error("alloc_ohci_ED failed!\n");
+        return NULL;
     }
-    USB_error("alloc_ohci_ED failed!\n");
-    return NULL;
+    memset(ed, 0, sizeof(*ed));
+    mem_debug("[ALLOC] [ED] - 0x%x\n", (int)ed);
+    return ed;
 }
 
 void free_ohci_ED(ED_T *ed)
 {
-    int      i;
-
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_ED, ed) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)ed)
-        {
-            mem_debug("[FREE]  [ED] - 0x%x\n", (int)ed);
-            _unit_used[i] = 0;
-            _mem_pool_used--;
-            return;
-        }
+        USB_debug("free_ohci_ED - not found! (ignored in case of multiple UTR)\n");
+        return;
     }
-    USB_debug("free_ohci_ED - not found! (ignored in case of multiple UTR)\n");
+    mem_debug("[FREE]  [ED] - 0x%x\n", (int)ed);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -287,42 +445,28 @@ void free_ohci_ED(ED_T *ed)
 /*--------------------------------------------------------------------------*/
 TD_T * alloc_ohci_TD(UTR_T *utr)
 {
-    int    i;
     TD_T   *td;
 
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    td = (TD_T *)desc_unit_alloc(POOL_TD);
+    if (td == NULL)
     {
-        if (_unit_used[i] == 0)
-        {
-            _unit_used[i] = 1;
-            _mem_pool_used++;
-            td = (TD_T *)_mem_pool[i];
-
-            memset(td, 0, sizeof(*td));
-            td->utr = utr;
-            mem_debug("[ALLOC] [TD] - 0x%x\n", (int)td);
-            return td;
-        }
+        USB_error("alloc_ohci_TD failed!\n");
+        return NULL;
     }
-    USB_error("alloc_ohci_TD failed!\n");
-    return NULL;
+    memset(td, 0, sizeof(*td));
+    td->utr = utr;
+    mem_debug("[ALLOC] [TD] - 0x%x\n", (int)td);
+    return td;
 }
 
 void free_ohci_TD(TD_T *td)
 {
-    int   i;
-
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_TD, td) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)td)
-        {
-            mem_debug("[FREE]  [TD] - 0x%x\n", (int)td);
-            _unit_used[i] = 0;
-            _mem_pool_used--;
-            return;
-        }
+        USB_error("free_ohci_TD - not found!\n");
+        return;
     }
-    USB_error("free_ohci_TD - not found!\n");
+    mem_debug("[FREE]  [TD] - 0x%x\n", (int)td);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -330,27 +474,16 @@ void free_ohci_TD(TD_T *td)
 /*--------------------------------------------------------------------------*/
 QH_T * alloc_ehci_QH(void)
 {
-    int    i;
-    QH_T   *qh = NULL;
+    QH_T   *qh;
 
-    for (i = (_sidx+1) % MEM_POOL_UNIT_NUM; i != _sidx; i = (i+1) % MEM_POOL_UNIT_NUM)
-    {
-        if (_unit_used[i] == 0)
-        {
-            _unit_used[i] = 1;
-            _sidx = i;
-            _mem_pool_used++;
-            qh = (QH_T *)_mem_pool[i];
-            memset(qh, 0, sizeof(*qh));
-            mem_debug("[ALLOC] [QH] - 0x%x\n", (int)qh);
-            break;
-        }
-    }
+    qh = (QH_T *)desc_unit_alloc(POOL_QH);
     if (qh == NULL)
     {
         USB_error("alloc_ehci_QH failed!\n");
         return NULL;
     }
+    memset(qh, 0, sizeof(*qh));
+    mem_debug("[ALLOC] [QH] - 0x%x\n", (int)qh);
     qh->Curr_qTD        = QTD_LIST_END;
     qh->OL_Next_qTD     = QTD_LIST_END;
     qh->OL_Alt_Next_qTD = QTD_LIST_END;
@@ -360,19 +493,12 @@ QH_T * alloc_ehci_QH(void)
 
 void free_ehci_QH(QH_T *qh)
 {
-    int      i;
-
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_QH, qh) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)qh)
-        {
-            mem_debug("[FREE]  [QH] - 0x%x\n", (int)qh);
-            _unit_used[i] = 0;
-            _mem_pool_used--;
-            return;
-        }
+        USB_debug("free_ehci_QH - not found! (ignored in case of multiple UTR)\n");
+        return;
     }
-    USB_debug("free_ehci_QH - not found! (ignored in case of multiple UTR)\n");
+    mem_debug("[FREE]  [QH] - 0x%x\n", (int)qh);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -380,46 +506,31 @@ void free_ehci_QH(QH_T *qh)
 /*--------------------------------------------------------------------------*/
 qTD_T * alloc_ehci_qTD(UTR_T *utr)
 {
-    int     i;
     qTD_T   *qtd;
 
-    for (i = (_sidx+1) % MEM_POOL_UNIT_NUM; i != _sidx; i = (i+1) % MEM_POOL_UNIT_NUM)
+    qtd = (qTD_T *)desc_unit_alloc(POOL_QTD);
+    if (qtd == NULL)
     {
-        if (_unit_used[i] == 0)
-        {
-            _unit_used[i] = 1;
-            _sidx = i;
-            _mem_pool_used++;
-            qtd = (qTD_T *)_mem_pool[i];
-
-            memset(qtd, 0, sizeof(*qtd));
-            qtd->Next_qTD     = QTD_LIST_END;
-            qtd->Alt_Next_qTD = QTD_LIST_END;
-            qtd->Token        = 0x1197B7F; // QTD_STS_HALT;  visit_qtd() will not remove a qTD with this mark. It means the qTD still not ready for transfer.
-            qtd->utr = utr;
-            mem_debug("[ALLOC] [qTD] - 0x%x\n", (int)qtd);
-            return qtd;
-        }
+        USB_error("alloc_ehci_qTD failed!\n");
+        return NULL;
     }
-    USB_error("alloc_ehci_qTD failed!\n");
-    return NULL;
+    memset(qtd, 0, sizeof(*qtd));
+    qtd->Next_qTD     = QTD_LIST_END;
+    qtd->Alt_Next_qTD = QTD_LIST_END;
+    qtd->Token        = 0x1197B7F; // QTD_STS_HALT;  visit_qtd() will not remove a qTD with this mark. It means the qTD still not ready for transfer.
+    qtd->utr = utr;
+    mem_debug("[ALLOC] [qTD] - 0x%x\n", (int)qtd);
+    return qtd;
 }
 
 void free_ehci_qTD(qTD_T *qtd)
 {
-    int   i;
-
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_QTD, qtd) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)qtd)
-        {
-            mem_debug("[FREE]  [qTD] - 0x%x\n", (int)qtd);
-            _unit_used[i] = 0;
-            _mem_pool_used--;
-            return;
-        }
+        USB_error("free_ehci_qTD 0x%x - not found!\n", (int)qtd);
+        return;
     }
-    USB_error("free_ehci_qTD 0x%x - not found!\n", (int)qtd);
+    mem_debug("[FREE]  [qTD] - 0x%x\n", (int)qtd);
 }
 
 /*--------------------------------------------------------------------------*/
@@ -427,86 +538,55 @@ void free_ehci_qTD(qTD_T *qtd)
 /*--------------------------------------------------------------------------*/
 iTD_T * alloc_ehci_iTD(void)
 {
-    int     i;
     iTD_T   *itd;
 
-    for (i = (_sidx+1) % MEM_POOL_UNIT_NUM; i != _sidx; i = (i+1) % MEM_POOL_UNIT_NUM)
+    itd = (iTD_T *)desc_unit_alloc(POOL_ITD);
+    if (itd == NULL)
     {
-        if (i+2 >= MEM_POOL_UNIT_NUM)
-            continue;
-
-        if ((_unit_used[i] == 0) && (_unit_used[i+1] == 0))
-        {
-            _unit_used[i] = _unit_used[i+1] = 1;
-            _sidx = i+1;
-            _mem_pool_used += 2;
-            itd = (iTD_T *)_mem_pool[i];
-            memset(itd, 0, sizeof(*itd));
-            mem_debug("[ALLOC] [iTD] - 0x%x\n", (int)itd);
-            return itd;
-        }
+        USB_error("alloc_ehci_iTD failed!\n");
+        return NULL;
     }
-    USB_error("alloc_ehci_iTD failed!\n");
-    return NULL;
+    memset(itd, 0, sizeof(*itd));
+    mem_debug("[ALLOC] [iTD] - 0x%x\n", (int)itd);
+    return itd;
 }
 
 void free_ehci_iTD(iTD_T *itd)
 {
-    int   i;
-
-    for (i = 0; i+1 < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_ITD, itd) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)itd)
-        {
-            mem_debug("[FREE]  [iTD] - 0x%x\n", (int)itd);
-            _unit_used[i] = _unit_used[i+1] = 0;
-            _mem_pool_used -= 2;
-            return;
-        }
+        USB_error("free_ehci_iTD 0x%x - not found!\n", (int)itd);
+        return;
     }
-    USB_error("free_ehci_iTD 0x%x - not found!\n", (int)itd);
+    mem_debug("[FREE]  [iTD] - 0x%x\n", (int)itd);
 }
 
 /*--------------------------------------------------------------------------*/
-/*   EHCI iTD allocate/free                                                 */
+/*   EHCI siTD allocate/free                                                */
 /*--------------------------------------------------------------------------*/
 siTD_T * alloc_ehci_siTD(void)
 {
-    int     i;
     siTD_T  *sitd;
 
-    for (i = (_sidx+1) % MEM_POOL_UNIT_NUM; i != _sidx; i = (i+1) % MEM_POOL_UNIT_NUM)
+    sitd = (siTD_T *)desc_unit_alloc(POOL_SITD);
+    if (sitd == NULL)
     {
-        if (_unit_used[i] == 0)
-        {
-            _unit_used[i] = 1;
-            _sidx = i;
-            _mem_pool_used ++;
-            sitd = (siTD_T *)_mem_pool[i];
-            memset(sitd, 0, sizeof(*sitd));
-            mem_debug("[ALLOC] [siTD] - 0x%x\n", (int)sitd);
-            return sitd;
-        }
+        USB_error("alloc_ehci_siTD failed!\n");
+        return NULL;
     }
-    USB_error("alloc_ehci_siTD failed!\n");
-    return NULL;
+    memset(sitd, 0, sizeof(*sitd));
+    mem_debug("[ALLOC] [siTD] - 0x%x\n", (int)sitd);
+    return sitd;
 }
 
 void free_ehci_siTD(siTD_T *sitd)
 {
-    int   i;
-
-    for (i = 0; i < MEM_POOL_UNIT_NUM; i++)
+    if (desc_unit_free(POOL_SITD, sitd) != 0)
     {
-        if ((uint32_t)_mem_pool[i] == (uint32_t)sitd)
-        {
-            mem_debug("[FREE]  [siTD] - 0x%x\n", (int)sitd);
-            _unit_used[i] = 0;
-            _mem_pool_used--;
-            return;
-        }
+        USB_error("free_ehci_siTD 0x%x - not found!\n", (int)sitd);
+        return;
     }
-    USB_error("free_ehci_siTD 0x%x - not found!\n", (int)sitd);
+    mem_debug("[FREE]  [siTD] - 0x%x\n", (int)sitd);
 }
 
 /// @endcond HIDDEN_SYMBOLS
@@ -212,7 +212,8 @@ static int  ohci_init(void)
     _ohci->HcRhStatus = USBH_HcRhStatus_LPSC_Msk;
 #endif
 
-    _ohci->HcInterruptEnable = USBH_HcInterruptEnable_MIE_Msk | USBH_HcInterruptEnable_WDH_Msk | USBH_HcInterruptEnable_SF_Msk;
+    _ohci->HcInterruptEnable = USBH_HcInterruptEnable_MIE_Msk | USBH_HcInterruptEnable_WDH_Msk | USBH_HcInterruptEnable_SF_Msk |
+                               USBH_HcInterruptEnable_RHSC_Msk;
 
     /* POTPGT delay is bits 24-31, in 20 ms units.                                         */
     delay_us(20000);
@@ -691,7 +692,7 @@ static int ohci_iso_xfer(UTR_T *utr)
     EP_INFO_T  *ep = utr->ep;
     ED_T       *ed, *ied;
     TD_T       *td, *td_list, *last_td;
-    int        i;
+    int        i, flags;
     uint32_t   info;
     uint32_t   buff_addr;
     int8_t     bIsNewED = 0;
@@ -767,7 +768,7 @@ static int ohci_iso_xfer(UTR_T *utr)
     /*  Hook ED and TD list to HCCA interrupt table                                       */
     /*------------------------------------------------------------------------------------*/
     utr->status = 0;
-    DISABLE_OHCI_IRQ();
+    flags = usb_mem_lock();                 /* nests in usbh_iso_xfer_batch()             */
 
     if ((ed->HeadP & ~0x3) == 0)
         ed->HeadP = (ed->HeadP & 0x2) | (uint32_t)td_list;   /* keep toggleCarry bit      */
@@ -789,7 +790,7 @@ static int ohci_iso_xfer(UTR_T *utr)
         ied->NextED = (uint32_t)ed;
     }
 
-    ENABLE_OHCI_IRQ();
+    usb_mem_unlock(flags);
     ED_debug("Link ISO ED 0x%x: 0x%x 0x%x 0x%x 0x%x\n", (int)ed, ed->Info, ed->TailP, ed->HeadP, ed->NextED);
     _ohci->HcControl |= USBH_HcControl_PLE_Msk | USBH_HcControl_IE_Msk;  /* enable periodic list and isochronous transfer  */
 
@@ -939,6 +940,7 @@ static int ohci_rh_polling(void)
             change = 1;
         }
     }
+    _ohci->HcInterruptEnable = USBH_HcInterruptEnable_RHSC_Msk;   /* wait for the next port change */
     return change;
 }
 
@@ -1022,6 +1024,7 @@ td_out:
     if (utr->td_cnt == 0)
     {
         utr->bIsTransferDone = 1;
+        USB_TRACE_DONE(utr);
         if (utr->func)
             utr->func(utr);
     }
@@ -1132,6 +1135,7 @@ static void remove_ed()
                     {
                         utr->status = USBH_ERR_ABORT;
                         utr->bIsTransferDone = 1;
+                        USB_TRACE_DONE(utr);
                         if (utr->func)
                             utr->func(utr);
                     }
@@ -1204,7 +1208,9 @@ void OHCI_IRQHandler(void)
 
     if (int_sts & USBH_HcInterruptStatus_RHSC_Msk)
     {
+        /* port change bits stay set until ohci_rh_polling() clears them */
         _ohci->HcInterruptDisable = USBH_HcInterruptDisable_RHSC_Msk;
+        usbh_hub_event(HUB_EVT_OHCI_RH);
     }
 
     _ohci->HcInterruptStatus = int_sts;
@@ -1283,7 +1289,8 @@ HC_DRV_T  ohci_driver =
     ohci_iso_xfer,           /* iso_xfer           */
     ohci_quit_xfer,          /* quit_xfer          */
     ohci_rh_port_reset,      /* rthub_port_reset   */
-    ohci_rh_polling          /* rthub_polling      */
+    ohci_rh_polling,         /* rthub_polling      */
+    NULL                     /* bw_check           */
 };
 
 /// @endcond HIDDEN_SYMBOLS
@@ -19,43 +19,224 @@
 /// @cond HIDDEN_SYMBOLS
 
 
+/*
+ *  USB_malloc() carves the pool into USB_MEM_BLOCK_SIZE blocks in two regions.
+ *
+ *  Requests up to USB_MEM_SMALL_MAX bytes (UTRs, device and interface records,
+ *  control and interrupt buffers) come from a buddy allocator over the first
+ *  USB_MEM_BUDDY_SIZE bytes. A request is rounded up to a power-of-2 run of
+ *  blocks, taken from the free list of the smallest run size available and
+ *  split down. Freed runs are merged with their buddy. Both are bounded by
+ *  USB_MEM_MAX_ORDER steps, so the OHCI/EHCI IRQs are only masked for a short
+ *  while.
+ *
+ *  Larger requests (isochronous, CDC and descriptor buffers) are carved first
+ *  fit from the rest of the pool in whole blocks, so a 6.3 KB audio buffer
+ *  takes 6.375 KB and a 1.2 KB IFACE_T 1.25 KB, not the 8 KB and 2 KB runs of
+ *  the buddy. Freed runs are merged
+ *  with both neighbours through the run length kept at the head and the tail
+ *  of each run. The walk is bounded by the number of runs in that region,
+ *  which stays small as its users are few and long lived. Small requests
+ *  fall back to it when the buddy region is full.
+ *
+ *  Block headers are kept in side tables, the pool only holds user data.
+ *  USB_memory_stat() reports the usage.
+ */
 #define  USB_MEMORY_POOL_SIZE   (32*1024)
 #define  USB_MEM_BLOCK_SIZE     128
+#define  USB_MEM_BLOCK_NUM      (USB_MEMORY_POOL_SIZE / USB_MEM_BLOCK_SIZE)
+#define  USB_MEM_BUDDY_SIZE     (4*1024)                                      /* small request region at the pool base */
+#define  USB_MEM_BUDDY_NUM      (USB_MEM_BUDDY_SIZE / USB_MEM_BLOCK_SIZE)     /* must be a power of 2 */
+#define  USB_MEM_MAX_ORDER      5                                             /* log2(USB_MEM_BUDDY_NUM) */
+#define  USB_MEM_SMALL_MAX      1024                                          /* larger requests go to the large region */
+#define  USB_MEM_POOL_ALIGN     4096                                          /* largest boundary supported */
+
+#define  BLK_NONE               0xFFFF
 
-#define  BOUNDARY_WORD          4
+#define  BLK_HEAD_NONE          0      /* not the first block of a run */
+#define  BLK_HEAD_FREE          1      /* first block of a free run */
+#define  BLK_HEAD_USED          2      /* first block of an allocated run */
 
 
 static uint32_t  _FreeMemorySize;
 uint32_t  _AllocatedMemorySize;
 
+#ifdef __ICCARM__
+#pragma data_alignment=4096
+uint8_t  _USBMemoryPool[USB_MEMORY_POOL_SIZE];
+#else
+uint8_t  _USBMemoryPool[USB_MEMORY_POOL_SIZE] __attribute__((aligned(USB_MEM_POOL_ALIGN)));
+#endif
+
+static uint32_t  _MemoryPoolBase, _MemoryPoolEnd;
+
+static uint8_t   _blk_head[USB_MEM_BLOCK_NUM];     /* BLK_HEAD_xxx                                  */
+static uint8_t   _blk_order[USB_MEM_BLOCK_NUM];    /* run of (1 << order) blocks, valid at run head  */
+static uint16_t  _blk_len[USB_MEM_BLOCK_NUM];      /* large region run length, at run head and tail  */
+static uint16_t  _blk_req[USB_MEM_BLOCK_NUM];      /* requested size of an allocated run             */
+static uint16_t  _blk_next[USB_MEM_BLOCK_NUM];     /* free list links of a free run                  */
+static uint16_t  _blk_prev[USB_MEM_BLOCK_NUM];
+static uint16_t  _free_head[USB_MEM_MAX_ORDER+1];  /* buddy free list of each run size               */
+static uint32_t  _free_orders;                     /* bit n set if _free_head[n] is not empty        */
+
+static USB_MEM_STAT_T  _mem_stat;
 
-#define USB_MEM_ALLOC_MAGIC     0x19685788    /* magic number in leading block */
 
-typedef struct USB_mhdr
+/*
+ *  Mask the OHCI and EHCI interrupts around a short update of USB memory pools.
+ *  Only the USB host interrupts are masked; the returned flags restore them.
+ */
+int  usb_mem_lock(void)
 {
-    uint32_t  flag;  /* 0:free, 1:allocated, 0x3:first block */
-    uint32_t  bcnt;  /* if allocated, the block count of allocated memory block */
-    uint32_t  magic;
-    uint32_t  reserved;
-}  USB_MHDR_T;
+    int   flags = 0;
 
-uint8_t  _USBMemoryPool[USB_MEMORY_POOL_SIZE] __attribute__((aligned(USB_MEM_BLOCK_SIZE)));
+    if (IS_OHCI_IRQ_ENABLED())
+    {
+        flags |= 0x1;
+        DISABLE_OHCI_IRQ();
+    }
+    if (IS_EHCI_IRQ_ENABLED())
+    {
+        flags |= 0x2;
+        DISABLE_EHCI_IRQ();
+    }
+    return flags;
+}
 
+void  usb_mem_unlock(int flags)
+{
+    if (flags & 0x1)
+        ENABLE_OHCI_IRQ();
+    if (flags & 0x2)
+        ENABLE_EHCI_IRQ();
+}
 
-static USB_MHDR_T  *_pCurrent;
-uint32_t  *_USB_pCurrent = (uint32_t *)&_pCurrent;
+static void  free_list_push(int idx, int order)
+{
+    _blk_head[idx] = BLK_HEAD_FREE;
+    _blk_order[idx] = order;
+    _blk_prev[idx] = BLK_NONE;
+    _blk_next[idx] = _free_head[order];
+    if (_free_head[order] != BLK_NONE)
+        _blk_prev[_free_head[order]] = idx;
+    _free_head[order] = idx;
+    _free_orders |= (1 << order);
+}
 
-static uint32_t  _MemoryPoolBase, _MemoryPoolEnd;
+static void  free_list_remove(int idx, int order)
+{
+    if (_blk_prev[idx] != BLK_NONE)
+        _blk_next[_blk_prev[idx]] = _blk_next[idx];
+    else
+        _free_head[order] = _blk_next[idx];
+
+    if (_blk_next[idx] != BLK_NONE)
+        _blk_prev[_blk_next[idx]] = _blk_prev[idx];
+
+    if (_free_head[order] == BLK_NONE)
+        _free_orders &= ~(1 << order);
+    _blk_head[idx] = BLK_HEAD_NONE;
+}
+
+static void  large_run_set(int idx, int len, int head)
+{
+    _blk_head[idx] = head;
+    _blk_len[idx] = len;
+    _blk_len[idx + len - 1] = len;
+}
+
+/* first fit of nblk blocks starting at a multiple of align blocks, -1 if none */
+static int  large_run_alloc(int nblk, int align)
+{
+    int   idx, start, end;
+
+    for (idx = USB_MEM_BUDDY_NUM; idx < USB_MEM_BLOCK_NUM; idx += _blk_len[idx])
+    {
+        if (_blk_head[idx] != BLK_HEAD_FREE)
+            continue;
+
+        start = (idx + align - 1) & ~(align - 1);
+        end = idx + _blk_len[idx];
+        if (start + nblk > end)
+            continue;
+
+        if (start > idx)
+            large_run_set(idx, start - idx, BLK_HEAD_FREE);
+        if (start + nblk < end)
+            large_run_set(start + nblk, end - start - nblk, BLK_HEAD_FREE);
+        large_run_set(start, nblk, BLK_HEAD_USED);
+        return start;
+    }
+    return -1;
+}
+
+static void  large_run_free(int idx)
+{
+    int   len = _blk_len[idx];
+    int   prev;
+
+    _blk_head[idx] = BLK_HEAD_NONE;
+
+    if ((idx + len < USB_MEM_BLOCK_NUM) && (_blk_head[idx + len] == BLK_HEAD_FREE))
+    {
+        _blk_head[idx + len] = BLK_HEAD_NONE;
+        len += _blk_len[idx + len];
+    }
+    if (idx > USB_MEM_BUDDY_NUM)
+    {
+        prev = idx - _blk_len[idx - 1];
+        if (_blk_head[prev] == BLK_HEAD_FREE)
+        {
+            len += idx - prev;
+            idx = prev;
+        }
+    }
+    large_run_set(idx, len, BLK_HEAD_FREE);
+}
+
+static uint32_t  largest_free_run(void)
+{
+    int   idx, order, nblk = 0;
+
+    for (idx = USB_MEM_BUDDY_NUM; idx < USB_MEM_BLOCK_NUM; idx += _blk_len[idx])
+    {
+        if ((_blk_head[idx] == BLK_HEAD_FREE) && (_blk_len[idx] > nblk))
+            nblk = _blk_len[idx];
+    }
+
+    for (order = USB_MEM_MAX_ORDER; order >= 0; order--)
+    {
+        if (_free_orders & (1 << order))
+        {
+            if ((1 << order) > nblk)
+                nblk = 1 << order;
+            break;
+        }
+    }
+    return nblk * USB_MEM_BLOCK_SIZE;
+}
 
 
 void  USB_InitializeMemoryPool()
 {
+    int   i;
+
     _MemoryPoolBase = (UINT32)&_USBMemoryPool[0] | NON_CACHE_MASK;
     _MemoryPoolEnd = _MemoryPoolBase + USB_MEMORY_POOL_SIZE;
     _FreeMemorySize = _MemoryPoolEnd - _MemoryPoolBase;
     _AllocatedMemorySize = 0;
-    _pCurrent = (USB_MHDR_T *)_MemoryPoolBase;
     memset((char *)_MemoryPoolBase, 0, _FreeMemorySize);
+
+    memset(_blk_head, BLK_HEAD_NONE, sizeof(_blk_head));
+    for (i = 0; i <= USB_MEM_MAX_ORDER; i++)
+        _free_head[i] = BLK_NONE;
+    _free_orders = 0;
+    free_list_push(0, USB_MEM_MAX_ORDER);
+    large_run_set(USB_MEM_BUDDY_NUM, USB_MEM_BLOCK_NUM - USB_MEM_BUDDY_NUM, BLK_HEAD_FREE);
+
+    memset(&_mem_stat, 0, sizeof(_mem_stat));
+    _mem_stat.total = USB_MEMORY_POOL_SIZE;
+    _mem_stat.largest_free = USB_MEMORY_POOL_SIZE - USB_MEM_BUDDY_SIZE;
 }
 
 
@@ -71,178 +252,105 @@ int  USB_allocated_memory()
 }
 
 
-void  *USB_malloc(INT wanted_size, INT boundary)
+void  USB_memory_stat(USB_MEM_STAT_T *stat)
 {
-    USB_MHDR_T  *pPrimitivePos = _pCurrent;
-    USB_MHDR_T  *pFound;
-    INT   found_size=-1;
-    INT   i, block_count;
-    INT   wrap = 0;
-    int   disable_ohci_irq, disable_ehci_irq;
+    int   flags;
 
-    if (IS_OHCI_IRQ_ENABLED())
-        disable_ohci_irq = 1;
-    else
-        disable_ohci_irq = 0;
+    flags = usb_mem_lock();
+    _mem_stat.allocated = _AllocatedMemorySize;
+    _mem_stat.largest_free = largest_free_run();
+    memcpy(stat, &_mem_stat, sizeof(*stat));
+    usb_mem_unlock(flags);
+}
 
-    if (IS_EHCI_IRQ_ENABLED())
-        disable_ehci_irq = 1;
-    else
-        disable_ehci_irq = 0;
 
-    if (disable_ohci_irq)
-        DISABLE_OHCI_IRQ();
-    if (disable_ehci_irq)
-        DISABLE_EHCI_IRQ();
+void  *USB_malloc(INT wanted_size, INT boundary)
+{
+    int   order, avail, idx, nblk, flags;
+    int   size;
+
+    if (wanted_size <= 0)
+        return NULL;
 
-    if (wanted_size >= _FreeMemorySize)
+    if (boundary > USB_MEM_POOL_ALIGN)
     {
-        sysprintf("USB_malloc - want=%d, free=%d\n", wanted_size, _FreeMemorySize);
-        if (disable_ohci_irq)
-            ENABLE_OHCI_IRQ();
-        if (disable_ehci_irq)
-            ENABLE_EHCI_IRQ();
+        sysprintf("USB_malloc - boundary %d not supported!\n", boundary);
         return NULL;
     }
 
-    if ((UINT32)_pCurrent >= _MemoryPoolEnd)
-        _pCurrent = (USB_MHDR_T *)_MemoryPoolBase;   /* wrapped */
-
-    do
+    size = (boundary > wanted_size) ? boundary : wanted_size;
+    nblk = (wanted_size + USB_MEM_BLOCK_SIZE - 1) / USB_MEM_BLOCK_SIZE;
+    if (nblk > USB_MEM_BLOCK_NUM - USB_MEM_BUDDY_NUM)
     {
-        if (_pCurrent->flag)          /* is not a free block */
-        {
-            if (_pCurrent->magic != USB_MEM_ALLOC_MAGIC)
-            {
-                sysprintf("\nUSB_malloc - incorrect magic number! C:%x F:%x, wanted:%d, Base:0x%x, End:0x%x\n", (UINT32)_pCurrent, _FreeMemorySize, wanted_size, (UINT32)_MemoryPoolBase, (UINT32)_MemoryPoolEnd);
-                if (disable_ohci_irq)
-                    ENABLE_OHCI_IRQ();
-                if (disable_ehci_irq)
-                    ENABLE_EHCI_IRQ();
-                return NULL;
-            }
+        sysprintf("USB_malloc - want=%d, pool=%d\n", wanted_size, USB_MEMORY_POOL_SIZE - USB_MEM_BUDDY_SIZE);
+        return NULL;
+    }
 
-            if (_pCurrent->flag == 0x3)
-                _pCurrent = (USB_MHDR_T *)((UINT32)_pCurrent + _pCurrent->bcnt * USB_MEM_BLOCK_SIZE);
-            else
-            {
-                sysprintf("USB_malloc warning - not the first block!\n");
-                _pCurrent = (USB_MHDR_T *)((UINT32)_pCurrent + USB_MEM_BLOCK_SIZE);
-            }
+    flags = usb_mem_lock();
 
-            if ((UINT32)_pCurrent > _MemoryPoolEnd)
-                sysprintf("USB_malloc - behind limit!!\n");
+    idx = -1;
+    if (size <= USB_MEM_SMALL_MAX)
+    {
+        /*
+         *  A run of (1 << order) blocks starts at a multiple of its own size from the
+         *  pool base, so a larger boundary is met by asking for a larger run.
+         */
+        for (order = 0; (USB_MEM_BLOCK_SIZE << order) < size; order++)
+            ;
+
+        avail = _free_orders & ~((1 << order) - 1);
+        if (avail != 0)
+        {
+            /* take the smallest run that fits and split it down */
+            for (avail = order; !(_free_orders & (1 << avail)); avail++)
+                ;
+            idx = _free_head[avail];
+            free_list_remove(idx, avail);
 
-            if ((UINT32)_pCurrent == _MemoryPoolEnd)
+            while (avail > order)
             {
-                //sysprintf("USB_alloc - warp!!\n");
-                wrap = 1;
-                _pCurrent = (USB_MHDR_T *)_MemoryPoolBase;   /* wrapped */
+                avail--;
+                free_list_push(idx + (1 << avail), avail);
             }
 
-            found_size = -1;          /* reset the accumlator */
+            _blk_head[idx] = BLK_HEAD_USED;
+            _blk_order[idx] = order;
+            nblk = 1 << order;
         }
-        else                         /* is a free block */
-        {
-            if (found_size == -1)     /* the leading block */
-            {
-                pFound = _pCurrent;
-                block_count = 1;
-
-                if (boundary > BOUNDARY_WORD)
-                    found_size = 0;    /* not use the data area of the leading block */
-                else
-                    found_size = USB_MEM_BLOCK_SIZE - sizeof(USB_MHDR_T);
-
-                /* check boundary -
-                 * If boundary > BOUNDARY_WORD, the start of next block should
-                 * be the beginning address of allocated memory. Thus, we check
-                 * the boundary of the next block. The leading block will be
-                 * used as a header only.
-                 */
-                if ((boundary > BOUNDARY_WORD) &&
-                        ((((UINT32)_pCurrent)+USB_MEM_BLOCK_SIZE >= _MemoryPoolEnd) ||
-                         ((((UINT32)_pCurrent)+USB_MEM_BLOCK_SIZE) % boundary != 0)))
-                    found_size = -1;   /* violate boundary, reset the accumlator */
-            }
-            else                      /* not the leading block */
-            {
-                found_size += USB_MEM_BLOCK_SIZE;
-                block_count++;
-            }
+    }
 
-            if (found_size >= wanted_size)
-            {
-                pFound->bcnt = block_count;
-                pFound->magic = USB_MEM_ALLOC_MAGIC;
-                _FreeMemorySize -= block_count * USB_MEM_BLOCK_SIZE;
-                _AllocatedMemorySize += block_count * USB_MEM_BLOCK_SIZE;
-                _pCurrent = pFound;
-                for (i=0; i<block_count; i++)
-                {
-                    _pCurrent->flag = 1;     /* allocate block */
-                    _pCurrent = (USB_MHDR_T *)((UINT32)_pCurrent + USB_MEM_BLOCK_SIZE);
-                }
-                pFound->flag = 0x3;
-
-                if (boundary > BOUNDARY_WORD)
-                {
-                    if (disable_ohci_irq)
-                        ENABLE_OHCI_IRQ();
-                    if (disable_ehci_irq)
-                        ENABLE_EHCI_IRQ();
-                    //sysprintf("- 0x%x, %d\n", (int)pFound, wanted_size);
-                    return (void *)((UINT32)pFound + USB_MEM_BLOCK_SIZE);
-                }
-                else
-                {
-                    //USB_debug("USB_malloc(%d,%d):%x\tsize:%d, C:0x%x, %d\n", wanted_size, boundary, (UINT32)pFound + sizeof(USB_MHDR_T), block_count * USB_MEM_BLOCK_SIZE, _pCurrent, block_count);
-                    if (disable_ohci_irq)
-                        ENABLE_OHCI_IRQ();
-                    if (disable_ehci_irq)
-                        ENABLE_EHCI_IRQ();
-                    //sysprintf("- 0x%x, %d\n", (int)pFound, wanted_size);
-                    return (void *)((UINT32)pFound + sizeof(USB_MHDR_T));
-                }
-            }
+    /* large requests, and small ones the buddy region cannot hold, in whole blocks */
+    if (idx < 0)
+        idx = large_run_alloc(nblk, (boundary > USB_MEM_BLOCK_SIZE) ? boundary / USB_MEM_BLOCK_SIZE : 1);
 
-            /* advance to the next block */
-            _pCurrent = (USB_MHDR_T *)((UINT32)_pCurrent + USB_MEM_BLOCK_SIZE);
-            if ((UINT32)_pCurrent >= _MemoryPoolEnd)
-            {
-                wrap = 1;
-                _pCurrent = (USB_MHDR_T *)_MemoryPoolBase;   /* wrapped */
-                found_size = -1;     /* reset accumlator */
-            }
-        }
+    if (idx < 0)
+    {
+        _mem_stat.fail_cnt++;
+        usb_mem_unlock(flags);
+        sysprintf("USB_malloc - No free memory! want=%d, free=%d\n", wanted_size, _FreeMemorySize);
+        return NULL;
     }
-    while ((wrap == 0) || (_pCurrent < pPrimitivePos));
 
-    sysprintf("USB_malloc - No free memory!\n");
-    if (disable_ohci_irq)
-        ENABLE_OHCI_IRQ();
-    if (disable_ehci_irq)
-        ENABLE_EHCI_IRQ();
-    return NULL;
+    _blk_req[idx] = wanted_size;
+
+    _FreeMemorySize -= nblk * USB_MEM_BLOCK_SIZE;
+    _AllocatedMemorySize += nblk * USB_MEM_BLOCK_SIZE;
+    _mem_stat.requested += wanted_size;
+    _mem_stat.alloc_cnt++;
+    if (_AllocatedMemorySize > _mem_stat.max_allocated)
+        _mem_stat.max_allocated = _AllocatedMemorySize;
+
+    usb_mem_unlock(flags);
+
+    //sysprintf("- 0x%x, %d\n", _MemoryPoolBase + idx * USB_MEM_BLOCK_SIZE, wanted_size);
+    return (void *)(_MemoryPoolBase + idx * USB_MEM_BLOCK_SIZE);
 }
 
 
 void  USB_free(void *alloc_addr)
 {
-    USB_MHDR_T  *pMblk;
     UINT32  addr = (UINT32)alloc_addr;
-    INT     i, count;
-    int     disable_ohci_irq, disable_ehci_irq;
-
-    if (IS_OHCI_IRQ_ENABLED())
-        disable_ohci_irq = 1;
-    else
-        disable_ohci_irq = 0;
-
-    if (IS_EHCI_IRQ_ENABLED())
-        disable_ehci_irq = 1;
-    else
-        disable_ehci_irq = 0;
+    int     idx, buddy, order, flags;
 
     //sysprintf("USB_free: 0x%x\n", (int)alloc_addr);
 
@@ -253,69 +361,54 @@ void  USB_free(void *alloc_addr)
         return;
     }
 
-    if (disable_ohci_irq)
-        DISABLE_OHCI_IRQ();
-    if (disable_ehci_irq)
-        DISABLE_EHCI_IRQ();
-
-    //sysprintf("USB_free:%x\n", (INT)addr+USB_MEM_BLOCK_SIZE);
-
-    /* get the leading block address */
-    if (addr % USB_MEM_BLOCK_SIZE == 0)
-        addr -= USB_MEM_BLOCK_SIZE;
-    else
-        addr -= sizeof(USB_MHDR_T);
-
-    if (addr % USB_MEM_BLOCK_SIZE != 0)
+    if ((addr - _MemoryPoolBase) % USB_MEM_BLOCK_SIZE != 0)
     {
         sysprintf("USB_free fatal error on address: %x!!\n", (UINT32)alloc_addr);
-        if (disable_ohci_irq)
-            ENABLE_OHCI_IRQ();
-        if (disable_ehci_irq)
-            ENABLE_EHCI_IRQ();
         return;
     }
 
-    pMblk = (USB_MHDR_T *)addr;
-    if (pMblk->flag == 0)
+    idx = (addr - _MemoryPoolBase) / USB_MEM_BLOCK_SIZE;
+
+    flags = usb_mem_lock();
+
+    if (_blk_head[idx] != BLK_HEAD_USED)
     {
-        sysprintf("USB_free(), warning - try to free a free block: %x\n", (UINT32)alloc_addr);
-        if (disable_ohci_irq)
-            ENABLE_OHCI_IRQ();
-        if (disable_ehci_irq)
-            ENABLE_EHCI_IRQ();
+        usb_mem_unlock(flags);
+        sysprintf("USB_free(), warning - try to free a free or unknown block: %x\n", (UINT32)alloc_addr);
         return;
     }
-    if (pMblk->magic != USB_MEM_ALLOC_MAGIC)
+
+    _mem_stat.requested -= _blk_req[idx];
+
+    if (idx >= USB_MEM_BUDDY_NUM)
     {
-        sysprintf("USB_free(), warning - try to free an unknow block at address:%x.\n", addr);
-        if (disable_ohci_irq)
-            ENABLE_OHCI_IRQ();
-        if (disable_ehci_irq)
-            ENABLE_EHCI_IRQ();
+        _FreeMemorySize += _blk_len[idx] * USB_MEM_BLOCK_SIZE;
+        _AllocatedMemorySize -= _blk_len[idx] * USB_MEM_BLOCK_SIZE;
+        large_run_free(idx);
+        usb_mem_unlock(flags);
         return;
     }
 
-    //_pCurrent = pMblk;
-
-    //sysprintf("+ 0x%x, %d\n", (int)pMblk, pMblk->bcnt);
+    order = _blk_order[idx];
+    _blk_head[idx] = BLK_HEAD_NONE;
+    _FreeMemorySize += USB_MEM_BLOCK_SIZE << order;
+    _AllocatedMemorySize -= USB_MEM_BLOCK_SIZE << order;
 
-    count = pMblk->bcnt;
-    for (i = 0; i < count; i++)
+    /* merge with the buddy as long as it is a whole free run of the same size */
+    while (order < USB_MEM_MAX_ORDER)
     {
-        pMblk->flag = 0;     /* release block */
-        pMblk = (USB_MHDR_T *)((UINT32)pMblk + USB_MEM_BLOCK_SIZE);
+        buddy = idx ^ (1 << order);
+        if ((_blk_head[buddy] != BLK_HEAD_FREE) || (_blk_order[buddy] != order))
+            break;
+        free_list_remove(buddy, order);
+        if (buddy < idx)
+            idx = buddy;
+        order++;
     }
+    free_list_push(idx, order);
 
-    _FreeMemorySize += count * USB_MEM_BLOCK_SIZE;
-    _AllocatedMemorySize -= count * USB_MEM_BLOCK_SIZE;
-    if (disable_ohci_irq)
-        ENABLE_OHCI_IRQ();
-    if (disable_ehci_irq)
-        ENABLE_EHCI_IRQ();
-    return;
+    usb_mem_unlock(flags);
 }
 
 
 /// @endcond HIDDEN_SYMBOLS
-
@@ -206,6 +206,8 @@ void usbh_resume(void)
     }
     delay_us(1000);
 #endif
+
+    usbh_hub_event(HUB_EVT_ALL);            /* devices may have gone while suspended      */
 }
 
 
@@ -280,9 +282,11 @@ int usbh_ctrl_xfer(UDEV_T *udev, uint8_t bmRequestType, uint8_t bRequest, uint16
     utr->buff = buff;
     utr->data_len = wLength;
     utr->bIsTransferDone = 0;
+    USB_TRACE_SUBMIT(utr);
     status = udev->hc_driver->ctrl_xfer(utr);
     if (status < 0)
     {
+        USB_TRACE_FAIL(utr, status);
         udev->ep0.hw_pipe = NULL;
         free_utr(utr);
         return status;
@@ -322,7 +326,13 @@ int usbh_ctrl_xfer(UDEV_T *udev, uint8_t bmRequestType, uint8_t bRequest, uint16
   */
 int usbh_bulk_xfer(UTR_T *utr)
 {
-    return utr->udev->hc_driver->bulk_xfer(utr);
+    int   ret;
+
+    USB_TRACE_SUBMIT(utr);
+    ret = utr->udev->hc_driver->bulk_xfer(utr);
+    if (ret < 0)
+        USB_TRACE_FAIL(utr, ret);
+    return ret;
 }
 
 /**
@@ -335,8 +345,14 @@ int usbh_bulk_xfer(UTR_T *utr)
   */
 int usbh_int_xfer(UTR_T *utr)
 {
+    int   ret;
+
     sysFlushCache(I_D_CACHE);
-    return utr->udev->hc_driver->int_xfer(utr);
+    USB_TRACE_SUBMIT(utr);
+    ret = utr->udev->hc_driver->int_xfer(utr);
+    if (ret < 0)
+        USB_TRACE_FAIL(utr, ret);
+    return ret;
 }
 
 /**
@@ -349,6 +365,8 @@ int usbh_int_xfer(UTR_T *utr)
   */
 int usbh_iso_xfer(UTR_T *utr)
 {
+    int   ret;
+
     if (utr->udev->hc_driver == NULL)
     {
         sysprintf("hc_driver - 0x%x\n", (int)utr->udev->hc_driver);
@@ -359,7 +377,37 @@ int usbh_iso_xfer(UTR_T *utr)
         sysprintf("iso_xfer - 0x%x\n", (int)utr->udev->hc_driver->iso_xfer);
         return -1;
     }
-    return utr->udev->hc_driver->iso_xfer(utr);
+    USB_TRACE_SUBMIT(utr);
+    ret = utr->udev->hc_driver->iso_xfer(utr);
+    if (ret < 0)
+        USB_TRACE_FAIL(utr, ret);
+    return ret;
+}
+
+/**
+  * @brief    Issue a batch of isochronous transfer requests of the same endpoint. The host
+  *           controller interrupts are held off until all requests have been linked, so the
+  *           completion scan never sees a partially queued batch and the requests are
+  *           scheduled back-to-back.
+  * @param[in]  utr    Array of isochronous transfer requests.
+  * @param[in]  count  Number of requests in array.
+  * @retval   0     Transfer success
+  * @retval   < 0   Failed. Refer to error code definitions. Requests before the failed one
+  *                 have been issued.
+  */
+int usbh_iso_xfer_batch(UTR_T *utr[], int count)
+{
+    int   i, flags, ret = 0;
+
+    flags = usb_mem_lock();
+    for (i = 0; i < count; i++)
+    {
+        ret = usbh_iso_xfer(utr[i]);
+        if (ret < 0)
+            break;
+    }
+    usb_mem_unlock(flags);
+    return ret;
 }
 
 /**
@@ -1094,7 +1142,7 @@ int  usbh_reset_device(UDEV_T *udev)
 
     USB_debug("Reset device =>\n");
 
-    usbh_pooling_hubs();
+    usbh_hub_service();
 
     /*------------------------------------------------------------------------------------*/
     /*  Disconnect device                                                                 */
@@ -1264,6 +1312,31 @@ EP_INFO_T * usbh_iface_find_ep(IFACE_T *iface, uint8_t ep_addr, uint8_t dir_type
     return NULL;
 }
 
+/**
+ *  @brief    Check that the interrupt and isochronous endpoints of an alternative interface
+ *            fit in the periodic bandwidth not yet reserved on the host controller. Class
+ *            drivers use it to fall back to a smaller alternative setting.
+ *  @param[in]  iface    The interface
+ *  @param[in]  aif      The alternative interface to check
+ *  @retval   0  All endpoints fit, or the host controller does not account bandwidth.
+ *  @retval   USBH_ERR_NO_BANDWIDTH   Some endpoint does not fit.
+ */
+int  usbh_check_alt_bandwidth(IFACE_T *iface, ALT_IFACE_T *aif)
+{
+    UDEV_T  *udev = iface->udev;
+    int     i;
+
+    if (udev->hc_driver->bw_check == NULL)
+        return 0;
+
+    for (i = 0; i < aif->ifd->bNumEndpoints; i++)
+    {
+        if (udev->hc_driver->bw_check(udev, &aif->ep[i]) != 0)
+            return USBH_ERR_NO_BANDWIDTH;
+    }
+    return 0;
+}
+
 void  usbh_dump_buff_bytes(uint8_t *buff, int nSize)
 {
     int     nIdx, i;
@@ -1314,4 +1387,239 @@ void usbh_dump_ep_info(EP_INFO_T *ep)
 /// @endcond HIDDEN_SYMBOLS
 
 
+#ifdef ENABLE_USB_TRACE
+
+/// @cond HIDDEN_SYMBOLS
+
+#define TRACE_STAT_EP_MAX      16          /* endpoints summarized by usbh_trace_dump_stat() */
+
+USBH_TRACE_REC_T  *_usbh_trace_ring;       /* ring being recorded, NULL if stopped       */
+static USBH_TRACE_REC_T  *_trace_buff;     /* ring kept for read out after stop          */
+static uint32_t   _trace_mask;             /* ring size - 1                              */
+static uint32_t   _trace_head;             /* sequence number of the next record         */
+static uint32_t   _trace_tail;             /* sequence number of the oldest unread record */
+static USBH_TIMER_FUNC  *_trace_timer;
+static uint32_t   _trace_tmask;            /* valid bits of time stamp                   */
+
+/*
+ *  Write a trace record. Called in task context on submit and in interrupt context on
+ *  completion. The oldest record is overwritten if the ring is full.
+ */
+void usbh_trace_utr(UTR_T *utr, int event, int status)
+{
+    USBH_TRACE_REC_T  *rec;
+    EP_INFO_T  *ep = utr->ep;
+    uint32_t   len;
+    int        i, flags;
+
+    if ((ep != NULL) && ((ep->bmAttributes & EP_ATTR_TT_MASK) == EP_ATTR_TT_ISO))
+    {
+        for (i = 0, len = 0; i < IF_PER_UTR; i++)
+            len += utr->iso_xlen[i];
+    }
+    else
+    {
+        len = (event == USBH_TRACE_SUBMIT) ? utr->data_len : utr->xfer_len;
+    }
+
+    flags = usb_mem_lock();
+    if (_usbh_trace_ring != NULL)
+    {
+        rec = &_usbh_trace_ring[_trace_head & _trace_mask];
+        rec->seq = _trace_head;
+        rec->ticks = (_trace_timer != NULL) ? _trace_timer() : get_ticks();
+        rec->utr = (uint32_t)utr;
+        rec->len = len;
+        rec->status = (int16_t)status;
+        rec->event = (uint8_t)event;
+        rec->hc = (utr->udev->hc_driver == &ehci_driver) ? 1 : 0;
+        rec->dev_num = utr->udev->dev_num;
+        rec->ep_addr = (ep != NULL) ? ep->bEndpointAddress : 0;
+        rec->ep_type = (ep != NULL) ? (ep->bmAttributes & EP_ATTR_TT_MASK) : 0;
+        rec->reserved = 0;
+        _trace_head++;
+        if (_trace_head - _trace_tail > _trace_mask + 1)
+            _trace_tail = _trace_head - (_trace_mask + 1);     /* the oldest overwritten  */
+    }
+    usb_mem_unlock(flags);
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+
+/**
+  * @brief    Start recording UTR submit and completion events into a trace ring. Records
+  *           of the previous trace are discarded. The trace functions are built only if
+  *           ENABLE_USB_TRACE is defined in config.h.
+  * @param[in]  ring    Trace ring buffer provided by application.
+  * @param[in]  count   Number of records of the ring. Must be a power of 2.
+  * @param[in]  timer   Function reading a free-running counter used as time stamp, or NULL
+  *                     to use get_ticks(). get_ticks() has 10 ms resolution only, so the
+  *                     counter installed by usbh_install_irq_timer() is suggested.
+  * @param[in]  mask    Mask of valid counter bits, 0xFFFFFF for a 24-bit counter. Ignored
+  *                     if timer is NULL.
+  * @retval   0     Success
+  * @retval   < 0   Invalid ring size
+  */
+int usbh_trace_start(USBH_TRACE_REC_T *ring, int count, USBH_TIMER_FUNC *timer, uint32_t mask)
+{
+    int   flags;
+
+    if ((ring == NULL) || (count < 2) || (count & (count - 1)))
+        return USBH_ERR_INVALID_PARAM;
+
+    flags = usb_mem_lock();
+    _trace_buff = ring;
+    _trace_mask = count - 1;
+    _trace_head = 0;
+    _trace_tail = 0;
+    _trace_timer = timer;
+    _trace_tmask = (timer != NULL) ? mask : 0xFFFFFFFF;
+    _usbh_trace_ring = ring;
+    usb_mem_unlock(flags);
+    return 0;
+}
+
+/**
+  * @brief    Stop recording. Records left in the ring can still be read out by
+  *           usbh_trace_read() or usbh_trace_dump().
+  * @return   None
+  */
+void usbh_trace_stop(void)
+{
+    _usbh_trace_ring = NULL;
+}
+
+/**
+  * @brief    Read out the oldest trace records and remove them from the ring.
+  * @param[out] rec      Records copied here.
+  * @param[in]  max_cnt  Maximum number of records to read.
+  * @return   Number of records read.
+  */
+int usbh_trace_read(USBH_TRACE_REC_T *rec, int max_cnt)
+{
+    int   i, flags;
+
+    if (_trace_buff == NULL)
+        return 0;
+
+    flags = usb_mem_lock();
+    for (i = 0; (i < max_cnt) && (_trace_tail != _trace_head); i++)
+    {
+        rec[i] = _trace_buff[_trace_tail & _trace_mask];
+        _trace_tail++;
+    }
+    usb_mem_unlock(flags);
+    return i;
+}
+
+/**
+  * @brief    Print and remove all trace records, one comma separated line per record:
+  *           seq,ticks,event,hc,dev,ep,type,len,status,utr. The event is S for submit
+  *           and D for done. Capture the console output and analyze it on a PC with
+  *           UsbHostLib/tools/usbh_trace.py.
+  * @return   None
+  */
+void usbh_trace_dump(void)
+{
+    USBH_TRACE_REC_T  rec;
+
+    sysprintf("seq,ticks,event,hc,dev,ep,type,len,status,utr\n");
+    while (usbh_trace_read(&rec, 1) == 1)
+    {
+        sysprintf("%d,%u,%c,%s,%d,0x%02x,%d,%d,%d,0x%x\n", rec.seq, rec.ticks,
+                  (rec.event == USBH_TRACE_SUBMIT) ? 'S' : 'D', rec.hc ? "EHCI" : "OHCI",
+                  rec.dev_num, rec.ep_addr, rec.ep_type, rec.len, rec.status, rec.utr);
+    }
+}
+
+/**
+  * @brief    Print per-endpoint latency and throughput statistics of the records now in
+  *           the ring. Records are not removed. Latency is from submit to done of an UTR,
+  *           throughput is bytes done over the time from the first submit to the last done
+  *           of the endpoint. Times are in units of the trace time stamp. Call it after
+  *           usbh_trace_stop() to get a consistent snapshot.
+  * @return   None
+  */
+void usbh_trace_dump_stat(void)
+{
+    struct
+    {
+        uint8_t   dev_num, ep_addr, hc;
+        uint32_t  done, errors, bytes;
+        uint32_t  lat_total, lat_max, lat_min;
+        uint32_t  t_first, t_last;
+    }  st[TRACE_STAT_EP_MAX];
+    USBH_TRACE_REC_T  *rec, *sub;
+    uint32_t   head, tail, seq, s, lat;
+    int        i, n = 0;
+
+    if (_trace_buff == NULL)
+        return;
+
+    head = _trace_head;
+    tail = _trace_tail;
+
+    for (seq = tail; seq != head; seq++)
+    {
+        rec = &_trace_buff[seq & _trace_mask];
+        if (rec->event != USBH_TRACE_DONE)
+            continue;
+
+        sub = NULL;
+        for (s = seq; (s != tail) && (sub == NULL); )   /* find the submit of this UTR    */
+        {
+            s--;
+            if ((_trace_buff[s & _trace_mask].utr == rec->utr) &&
+                    (_trace_buff[s & _trace_mask].event == USBH_TRACE_SUBMIT))
+                sub = &_trace_buff[s & _trace_mask];
+        }
+        if (sub == NULL)
+            continue;                       /* submit record overwritten                  */
+
+        for (i = 0; i < n; i++)
+        {
+            if ((st[i].dev_num == rec->dev_num) && (st[i].ep_addr == rec->ep_addr) && (st[i].hc == rec->hc))
+                break;
+        }
+        if (i == n)
+        {
+            if (n >= TRACE_STAT_EP_MAX)
+                continue;
+            memset(&st[i], 0, sizeof(st[i]));
+            st[i].dev_num = rec->dev_num;
+            st[i].ep_addr = rec->ep_addr;
+            st[i].hc = rec->hc;
+            st[i].lat_min = 0xFFFFFFFF;
+            st[i].t_first = sub->ticks;
+            n++;
+        }
+
+        lat = (rec->ticks - sub->ticks) & _trace_tmask;
+        st[i].done++;
+        if (rec->status < 0)
+            st[i].errors++;
+        else
+            st[i].bytes += rec->len;
+        st[i].lat_total += lat;
+        if (lat > st[i].lat_max)
+            st[i].lat_max = lat;
+        if (lat < st[i].lat_min)
+            st[i].lat_min = lat;
+        st[i].t_last = rec->ticks;
+    }
+
+    sysprintf("HC   dev ep   done  err   bytes      lat_min  lat_avg  lat_max  bytes/Ktick\n");
+    for (i = 0; i < n; i++)
+    {
+        sysprintf("%s %3d 0x%02x %5d %4d %10d %8d %8d %8d %8d\n", st[i].hc ? "EHCI" : "OHCI",
+                  st[i].dev_num, st[i].ep_addr, st[i].done, st[i].errors, st[i].bytes,
+                  st[i].lat_min, st[i].lat_total / st[i].done, st[i].lat_max,
+                  ((st[i].t_last - st[i].t_first) & _trace_tmask) ? (int)((uint64_t)st[i].bytes * 1000 / ((st[i].t_last - st[i].t_first) & _trace_tmask)) : 0);
+    }
+}
+
+#endif  /* ENABLE_USB_TRACE */
+
+
 /*** (C) COPYRIGHT 2017 Nuvoton Technology Corp. ***/
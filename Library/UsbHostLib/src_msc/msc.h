@@ -16,6 +16,25 @@
 #endif
 
 
+#ifndef MSC_PIPELINE_XFER
+#define MSC_PIPELINE_XFER         1      /* 1: overlap BOT stages of READ_10/WRITE_10 on the two bulk pipes */
+#endif
+#define MSC_PIPE_MAX_SECTORS      128    /* max. sectors per READ_10/WRITE_10 in pipelined mode */
+#ifndef MSC_PIPE_DEPTH
+#define MSC_PIPE_DEPTH            2      /* READ_10/WRITE_10 commands queued on the bulk pipes at a time */
+#endif
+
+#ifndef MSC_CACHE_LUNS
+#define MSC_CACHE_LUNS            2      /* number of LUNs that can get a sector cache, 0 disables the cache */
+#endif
+#ifndef MSC_CACHE_SECTORS
+#define MSC_CACHE_SECTORS         64     /* size of a LUN sector cache, also the largest coalesced command */
+#endif
+#ifndef MSC_CACHE_BYPASS_SECTORS
+#define MSC_CACHE_BYPASS_SECTORS  (MSC_CACHE_SECTORS / 4)  /* requests of this many sectors or more skip the cache */
+#endif
+
+
 #define USBDRV_0                  3      /* FATFS assigned USB disk drive volumn number base   */
 #define USBDRV_MAX                9      /* FATFS assigned USB disk drive volumn number end    */
 #define USBDRV_CNT                (USBDRV_MAX - USBDRV_0 + 1)
@@ -93,17 +112,30 @@ typedef struct msc_t
     uint8_t     root;                    /* root instance?                                */
     struct bulk_cb_wrap  cmd_blk;        /* MSC Bulk-only command block                   */
     struct bulk_cs_wrap  cmd_status;     /* MSC Bulk-only command status                  */
+#if MSC_PIPELINE_XFER
+    struct bulk_cb_wrap  pipe_cbw[MSC_PIPE_DEPTH];  /* CBWs of the queued READ_10/WRITE_10 */
+    struct bulk_cs_wrap  pipe_csw[MSC_PIPE_DEPTH];  /* and their CSWs                      */
+#endif
     uint8_t     scsi_buff[SCSI_BUFF_LEN];/* buffer for SCSI commands                      */
     uint32_t    uTotalSectorN;
     uint32_t    nSectorSize;
     uint32_t    uDiskSize;
     int         drv_no;                  /* Logical drive number associated with this instance */
     FATFS       fatfs_vol;               /* FATFS volumn                                  */
+    uint8_t     *cache_buff;             /* sector cache (cacheable), NULL if this LUN has none */
+    uint32_t    cache_sec;               /* first sector held in cache_buff               */
+    uint32_t    cache_cnt;               /* number of valid sectors in cache_buff         */
+    uint8_t     cache_dirty;             /* cache_buff holds a write run not on disk yet  */
+    uint32_t    cache_next;              /* sector following the last read request        */
+    UMAS_STAT_T stat;                    /* READ_10/WRITE_10 statistics                   */
     struct msc_t  *next;                 /* point to next MSC device                      */
 }  MSC_T;
 
 
 extern int  run_scsi_command(MSC_T *msc, uint8_t *buff, uint32_t data_len, int bIsDataIn, int timeout_ticks);
+extern int  run_scsi_rw_pipelined(MSC_T *msc, int bIsRead, uint32_t sec_no, uint32_t sec_cnt, uint8_t *buff);
+extern void msc_reset(MSC_T *msc);
+extern void msc_clear_halt(MSC_T *msc);
 
 
 /// @endcond
@@ -110,6 +110,59 @@ static void msc_list_remove(MSC_T *msc)
 }
 
 
+#if MSC_CACHE_LUNS
+
+#ifdef __ICCARM__
+#pragma data_alignment=32
+static uint8_t  g_msc_cache_pool[MSC_CACHE_LUNS][MSC_CACHE_SECTORS * 512];
+#else
+static uint8_t  g_msc_cache_pool[MSC_CACHE_LUNS][MSC_CACHE_SECTORS * 512] __attribute__((aligned(32)));
+#endif
+static uint8_t  g_msc_cache_used[MSC_CACHE_LUNS];
+
+static void msc_cache_alloc(MSC_T *msc)
+{
+    int  i;
+
+    msc->cache_buff = NULL;
+    msc->cache_cnt = 0;
+    msc->cache_dirty = 0;
+
+    if (msc->nSectorSize != 512)
+        return;
+
+    for (i = 0; i < MSC_CACHE_LUNS; i++)
+    {
+        if (g_msc_cache_used[i] == 0)
+        {
+            g_msc_cache_used[i] = 1;
+            msc->cache_buff = &g_msc_cache_pool[i][0];
+            msc->cache_next = 0xFFFFFFFF;
+            return;
+        }
+    }
+    msc_debug_msg("No free MSC sector cache, drive %d runs uncached.\n", msc->drv_no);
+}
+
+static void msc_cache_free(MSC_T *msc)
+{
+    int  i;
+
+    if (msc->cache_dirty)
+        msc_debug_msg("Drive %d removed with %d sectors not written back!\n", msc->drv_no, msc->cache_cnt);
+
+    for (i = 0; i < MSC_CACHE_LUNS; i++)
+    {
+        if (msc->cache_buff == &g_msc_cache_pool[i][0])
+            g_msc_cache_used[i] = 0;
+    }
+    msc->cache_buff = NULL;
+    msc->cache_cnt = 0;
+    msc->cache_dirty = 0;
+}
+
+#endif  /* MSC_CACHE_LUNS */
+
 static void get_max_lun(MSC_T *msc)
 {
     UDEV_T    *udev = msc->iface->udev;
@@ -153,8 +206,7 @@ void msc_reset(MSC_T *msc)
         msc_debug_msg("UAMSS reset request failed!\n");
     }
 
-    usbh_clear_halt(udev, msc->ep_bulk_out->bEndpointAddress);
-    usbh_clear_halt(udev, msc->ep_bulk_in->bEndpointAddress);
+    msc_clear_halt(msc);
 }
 
 static int  msc_inquiry(MSC_T *msc)
@@ -249,6 +301,193 @@ static int  msc_test_unit_ready(MSC_T *msc)
     return ret;
 }
 
+/*
+ *  Issue READ_10/WRITE_10 commands for a sector run and account them in the drive statistics.
+ */
+static int  msc_rw_sectors(MSC_T *msc, int bIsRead, uint32_t sec_no, int sec_cnt, uint8_t *buff)
+{
+#if !MSC_PIPELINE_XFER
+    struct bulk_cb_wrap  *cmd_blk = &msc->cmd_blk;         /* MSC Bulk-only command block   */
+#endif
+    int   ret;
+
+#if MSC_PIPELINE_XFER
+    ret = run_scsi_rw_pipelined(msc, bIsRead, sec_no, sec_cnt, buff);
+    if (bIsRead)
+        msc->stat.read_cmd += (sec_cnt + MSC_PIPE_MAX_SECTORS - 1) / MSC_PIPE_MAX_SECTORS;
+    else
+        msc->stat.write_cmd += (sec_cnt + MSC_PIPE_MAX_SECTORS - 1) / MSC_PIPE_MAX_SECTORS;
+#else
+    memset(cmd_blk, 0, sizeof(*cmd_blk));
+
+    cmd_blk->Flags   = bIsRead ? 0x80 : 0;
+    cmd_blk->Length  = 10;
+    cmd_blk->CDB[0]  = bIsRead ? READ_10 : WRITE_10;
+    cmd_blk->CDB[1]  = msc->lun << 5;
+    cmd_blk->CDB[2]  = (sec_no >> 24) & 0xFF;
+    cmd_blk->CDB[3]  = (sec_no >> 16) & 0xFF;
+    cmd_blk->CDB[4]  = (sec_no >> 8) & 0xFF;
+    cmd_blk->CDB[5]  = sec_no & 0xFF;
+    cmd_blk->CDB[7]  = (sec_cnt >> 8) & 0xFF;
+    cmd_blk->CDB[8]  = sec_cnt & 0xFF;
+
+    ret = run_scsi_command(msc, buff, sec_cnt * 512, bIsRead, 500);
+    if (bIsRead)
+        msc->stat.read_cmd++;
+    else
+        msc->stat.write_cmd++;
+#endif
+    if (ret == 0)
+    {
+        if (bIsRead)
+            msc->stat.read_sectors += sec_cnt;
+        else
+            msc->stat.write_sectors += sec_cnt;
+    }
+    return ret;
+}
+
+#if MSC_CACHE_LUNS
+
+/*
+ *  The CPU works on the cache through the D-cache, the host controller through the
+ *  non-cacheable alias. Windows are 32-byte aligned, so the maintenance never touches a
+ *  D-cache line shared with other data.
+ */
+static int  msc_cache_media_read(MSC_T *msc, uint32_t sec_no, int sec_cnt)
+{
+    sysInvalidateDcache((uint32_t)msc->cache_buff, sec_cnt * 512);
+    return msc_rw_sectors(msc, 1, sec_no, sec_cnt, (uint8_t *)((uint32_t)msc->cache_buff | NON_CACHE_MASK));
+}
+
+static int  msc_cache_media_write(MSC_T *msc, uint32_t sec_no, int sec_cnt)
+{
+    sysCleanDcache((uint32_t)msc->cache_buff, sec_cnt * 512);
+    return msc_rw_sectors(msc, 0, sec_no, sec_cnt, (uint8_t *)((uint32_t)msc->cache_buff | NON_CACHE_MASK));
+}
+
+/*
+ *  Write the pending write run to disk. The data stays in the cache as a clean read window.
+ */
+static int  msc_cache_flush(MSC_T *msc)
+{
+    int   ret;
+
+    if (!msc->cache_dirty)
+        return 0;
+
+    ret = msc_cache_media_write(msc, msc->cache_sec, msc->cache_cnt);
+    if (ret < 0)
+        return ret;
+    msc->cache_dirty = 0;
+    return 0;
+}
+
+static int  msc_cache_overlap(MSC_T *msc, uint32_t sec_no, int sec_cnt)
+{
+    return (msc->cache_cnt != 0) && (sec_no < msc->cache_sec + msc->cache_cnt) &&
+           (sec_no + sec_cnt > msc->cache_sec);
+}
+
+static int  msc_cache_read(MSC_T *msc, uint32_t sec_no, int sec_cnt, uint8_t *buff)
+{
+    uint32_t  cnt;
+    int       ret, bSeq;
+
+    bSeq = (sec_no == msc->cache_next);
+    msc->cache_next = sec_no + sec_cnt;
+
+    if (sec_cnt >= MSC_CACHE_BYPASS_SECTORS)
+    {
+        if (msc->cache_dirty && msc_cache_overlap(msc, sec_no, sec_cnt))
+        {
+            ret = msc_cache_flush(msc);
+            if (ret < 0)
+                return ret;
+        }
+        return msc_rw_sectors(msc, 1, sec_no, sec_cnt, buff);
+    }
+
+    if ((msc->cache_cnt == 0) || (sec_no < msc->cache_sec) ||
+            (sec_no + sec_cnt > msc->cache_sec + msc->cache_cnt))
+    {
+        /*
+         *  Miss. A read that follows the previous one loads a window starting at the
+         *  requested sector, so that the next small reads of the sequential walk are
+         *  served from it. Any other read loads the requested sectors only.
+         */
+        ret = msc_cache_flush(msc);
+        if (ret < 0)
+            return ret;
+
+        cnt = sec_cnt;
+        if (bSeq)
+        {
+            cnt = MSC_CACHE_SECTORS;
+            if ((sec_no < msc->uTotalSectorN) && (sec_no + cnt > msc->uTotalSectorN))
+                cnt = msc->uTotalSectorN - sec_no;
+            if (cnt < sec_cnt)
+                cnt = sec_cnt;
+            msc->stat.cache_read_ahead++;
+        }
+
+        msc->cache_cnt = 0;
+        ret = msc_cache_media_read(msc, sec_no, cnt);
+        if (ret < 0)
+            return ret;
+        msc->cache_sec = sec_no;
+        msc->cache_cnt = cnt;
+    }
+    else
+    {
+        msc->stat.cache_hits += sec_cnt;
+    }
+
+    memcpy(buff, msc->cache_buff + (sec_no - msc->cache_sec) * 512, sec_cnt * 512);
+    return 0;
+}
+
+static int  msc_cache_write(MSC_T *msc, uint32_t sec_no, int sec_cnt, uint8_t *buff)
+{
+    int   ret;
+
+    if (sec_cnt >= MSC_CACHE_BYPASS_SECTORS)
+    {
+        if (msc_cache_overlap(msc, sec_no, sec_cnt))
+        {
+            ret = msc_cache_flush(msc);
+            if (ret < 0)
+                return ret;
+            msc->cache_cnt = 0;
+        }
+        return msc_rw_sectors(msc, 0, sec_no, sec_cnt, buff);
+    }
+
+    if (msc->cache_dirty && (sec_no >= msc->cache_sec) && (sec_no <= msc->cache_sec + msc->cache_cnt) &&
+            (sec_no + sec_cnt <= msc->cache_sec + MSC_CACHE_SECTORS))
+    {
+        /* extends or rewrites the pending run */
+        if (sec_no + sec_cnt > msc->cache_sec + msc->cache_cnt)
+            msc->cache_cnt = sec_no + sec_cnt - msc->cache_sec;
+        msc->stat.write_merges++;
+    }
+    else
+    {
+        /* start a new run, the previous contents of the cache are dropped */
+        ret = msc_cache_flush(msc);
+        if (ret < 0)
+            return ret;
+        msc->cache_sec = sec_no;
+        msc->cache_cnt = sec_cnt;
+        msc->cache_dirty = 1;
+    }
+
+    memcpy(msc->cache_buff + (sec_no - msc->cache_sec) * 512, buff, sec_cnt * 512);
+    return 0;
+}
+
+#endif  /* MSC_CACHE_LUNS */
+
 /**
   * @brief       Read a number of contiguous sectors from mass storage device.
   *
@@ -264,7 +503,6 @@ static int  msc_test_unit_ready(MSC_T *msc)
 int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
 {
     MSC_T   *msc;
-    struct bulk_cb_wrap  *cmd_blk;         /* MSC Bulk-only command block   */
     int   ret;
 
     msc_debug_msg("usbh_umas_read - %d, %d, 0x%x\n", sec_no, sec_cnt, (int)buff);
@@ -273,23 +511,13 @@ int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
     if (msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
-    cmd_blk = &msc->cmd_blk;
-
-    //msc_debug_msg("read sector 0x%x\n", sector_no);
-    memset(cmd_blk, 0, sizeof(*cmd_blk));
-
-    cmd_blk->Flags   = 0x80;
-    cmd_blk->Length  = 10;
-    cmd_blk->CDB[0]  = READ_10;
-    cmd_blk->CDB[1]  = msc->lun << 5;
-    cmd_blk->CDB[2]  = (sec_no >> 24) & 0xFF;
-    cmd_blk->CDB[3]  = (sec_no >> 16) & 0xFF;
-    cmd_blk->CDB[4]  = (sec_no >> 8) & 0xFF;
-    cmd_blk->CDB[5]  = sec_no & 0xFF;
-    cmd_blk->CDB[7]  = (sec_cnt >> 8) & 0xFF;
-    cmd_blk->CDB[8]  = sec_cnt & 0xFF;
-
-    ret = run_scsi_command(msc, buff, sec_cnt * 512, 1, 500);
+    msc->stat.read_req++;
+#if MSC_CACHE_LUNS
+    if (msc->cache_buff != NULL)
+        ret = msc_cache_read(msc, sec_no, sec_cnt, buff);
+    else
+#endif
+        ret = msc_rw_sectors(msc, 1, sec_no, sec_cnt, buff);
     if (ret != 0)
     {
         msc_debug_msg("usbh_umas_read failed! [%d]\n", ret);
@@ -309,11 +537,13 @@ int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
   * @retval      0       Success
   * @retval      - \ref UMAS_ERR_DRIVE_NOT_FOUND   There's no mass storage device mounted to this volume.
   * @retval      - \ref UMAS_ERR_IO      Failed to write disk.
+  *
+  * @note        Small writes may be held in the sector cache of the drive until CTRL_SYNC or
+  *              CTRL_EJECT is issued through \ref usbh_umas_ioctl.
   */
 int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
 {
     MSC_T   *msc;
-    struct bulk_cb_wrap  *cmd_blk;         /* MSC Bulk-only command block   */
     int   ret;
 
     //msc_debug_msg("usbh_umas_write - %d, %d\n", sec_no, sec_cnt);
@@ -322,21 +552,13 @@ int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
     if (msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
-    cmd_blk = &msc->cmd_blk;
-    memset((uint8_t *)&(msc->cmd_blk), 0, sizeof(msc->cmd_blk));
-
-    cmd_blk->Flags   = 0;
-    cmd_blk->Length  = 10;
-    cmd_blk->CDB[0]  = WRITE_10;
-    cmd_blk->CDB[1]  = msc->lun << 5;
-    cmd_blk->CDB[2]  = (sec_no >> 24) & 0xFF;
-    cmd_blk->CDB[3]  = (sec_no >> 16) & 0xFF;
-    cmd_blk->CDB[4]  = (sec_no >> 8) & 0xFF;
-    cmd_blk->CDB[5]  = sec_no & 0xFF;
-    cmd_blk->CDB[7]  = (sec_cnt >> 8) & 0xFF;
-    cmd_blk->CDB[8]  = sec_cnt & 0xFF;
-
-    ret = run_scsi_command(msc, buff, sec_cnt * 512, 0, 500);
+    msc->stat.write_req++;
+#if MSC_CACHE_LUNS
+    if (msc->cache_buff != NULL)
+        ret = msc_cache_write(msc, sec_no, sec_cnt, buff);
+    else
+#endif
+        ret = msc_rw_sectors(msc, 0, sec_no, sec_cnt, buff);
     if (ret < 0)
     {
         msc_debug_msg("usbh_umas_write failed!\n");
@@ -367,6 +589,18 @@ int  usbh_umas_ioctl(int drv_no, int cmd, void *buff)
     switch (cmd)
     {
     case CTRL_SYNC:
+#if MSC_CACHE_LUNS
+        if (msc_cache_flush(msc) < 0)
+            return RES_ERROR;
+#endif
+        return RES_OK;
+
+    case CTRL_EJECT:
+#if MSC_CACHE_LUNS
+        if (msc_cache_flush(msc) < 0)
+            return RES_ERROR;
+        msc->cache_cnt = 0;
+#endif
         return RES_OK;
 
     case GET_SECTOR_COUNT:
@@ -419,11 +653,55 @@ int  usbh_umas_reset_disk(int drv_no)
 
     udev = msc->iface->udev;
 
+#if MSC_CACHE_LUNS
+    msc_cache_flush(msc);           /* try to save pending writes, the device may be hung */
+    msc->cache_cnt = 0;
+    msc->cache_dirty = 0;
+#endif
     usbh_reset_device(udev);
 
     return 0;
 }
 
+/**
+ *  @brief    Get READ_10/WRITE_10 statistics of a USB disk drive.
+ *  @param[in]  drv_no    USB disk drive number.
+ *  @param[out] stat      Statistics counters.
+ *  @retval    0          Succes
+ *  @retval    - \ref UMAS_ERR_DRIVE_NOT_FOUND   There's no mass storage device mounted to this volume.
+ *  @note      Compare read_cmd/write_cmd with read_sectors/write_sectors to see how well small
+ *             requests are coalesced.
+ */
+int  usbh_umas_get_stat(int drv_no, UMAS_STAT_T *stat)
+{
+    MSC_T      *msc;
+
+    msc = find_msc_by_drive(drv_no);
+    if (msc == NULL)
+        return UMAS_ERR_DRIVE_NOT_FOUND;
+
+    memcpy(stat, &msc->stat, sizeof(*stat));
+    return 0;
+}
+
+/**
+ *  @brief    Clear READ_10/WRITE_10 statistics of a USB disk drive.
+ *  @param[in] drv_no    USB disk drive number.
+ *  @retval    0          Succes
+ *  @retval    - \ref UMAS_ERR_DRIVE_NOT_FOUND   There's no mass storage device mounted to this volume.
+ */
+int  usbh_umas_reset_stat(int drv_no)
+{
+    MSC_T      *msc;
+
+    msc = find_msc_by_drive(drv_no);
+    if (msc == NULL)
+        return UMAS_ERR_DRIVE_NOT_FOUND;
+
+    memset(&msc->stat, 0, sizeof(msc->stat));
+    return 0;
+}
+
 static int  umass_init_device(MSC_T *msc)
 {
     MSC_T     *try_msc = msc;
@@ -510,6 +788,10 @@ disk_found:
 
         msc_debug_msg("USB disk [%c] found: size=%d MB, uTotalSectorN=%d\n", msc->drv_no+'0', try_msc->uTotalSectorN / 2048, try_msc->uTotalSectorN);
 
+#if MSC_CACHE_LUNS
+        msc_cache_alloc(try_msc);
+#endif
+        memset(&try_msc->stat, 0, sizeof(try_msc->stat));
         msc_list_add(try_msc);
 
         _path[0] =  try_msc->drv_no + '0';
@@ -527,6 +809,7 @@ disk_found:
             break;
         }
         memcpy(try_msc, msc, sizeof(*msc));
+        try_msc->cache_buff = NULL;
     }
 
     if (bHasMedia)
@@ -619,6 +902,9 @@ static void msc_disconnect(IFACE_T *iface)
         if (msc->iface == iface)
         {
             fatfs_drive_free(msc->drv_no);
+#if MSC_CACHE_LUNS
+            msc_cache_free(msc);
+#endif
             msc_list_remove(msc);
             usbh_free_mem(msc, sizeof(*msc));
         }
@@ -27,15 +27,20 @@ static void bulk_xfer_done(UTR_T *utr)
     // msc_debug_msg("BULK XFER done - %d\n", utr->status);
 }
 
-int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_len, int timeout_ticks)
+/*
+ *  Start a bulk transfer and return without waiting for it. Returns NULL on failure
+ *  with the error code in *ret.
+ */
+static UTR_T *msc_bulk_submit(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_len, int *ret)
 {
     UTR_T     *utr;
-    uint32_t  t0;
-    int       ret;
 
     utr = alloc_utr(msc->iface->udev);
     if (!utr)
-        return USBH_ERR_MEMORY_OUT;
+    {
+        *ret = USBH_ERR_MEMORY_OUT;
+        return NULL;
+    }
 
     utr->ep = ep;
     utr->buff = data_buff;
@@ -44,24 +49,45 @@ int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_le
     utr->func = bulk_xfer_done;
     utr->bIsTransferDone = 0;
 
-    ret = usbh_bulk_xfer(utr);
-    if (ret < 0)
-        return ret;
+    *ret = usbh_bulk_xfer(utr);
+    if (*ret < 0)
+    {
+        free_utr(utr);
+        return NULL;
+    }
+    return utr;
+}
+
+/*
+ *  Wait for a bulk transfer started by msc_bulk_submit(). The UTR is not released.
+ */
+static int msc_bulk_wait(UTR_T *utr, int timeout_ticks)
+{
+    uint32_t  t0;
 
     t0 = get_ticks();
     while (utr->bIsTransferDone == 0)
     {
         if (get_ticks() - t0 > timeout_ticks)
-        {
-            usbh_quit_utr(utr);
-            free_utr(utr);
             return USBH_ERR_TIMEOUT;
-        }
     }
-    ret = utr->status;
-    free_utr(utr);
     msc_debug_msg("    <BULK> status: %d, xfer_len: %d\n", utr->status, utr->xfer_len);
+    return utr->status;
+}
+
+int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_len, int timeout_ticks)
+{
+    UTR_T     *utr;
+    int       ret;
+
+    utr = msc_bulk_submit(msc, ep, data_buff, data_len, &ret);
+    if (utr == NULL)
+        return ret;
 
+    ret = msc_bulk_wait(utr, timeout_ticks);
+    if (ret == USBH_ERR_TIMEOUT)
+        usbh_quit_utr(utr);
+    free_utr(utr);
     return ret;
 }
 
@@ -117,6 +143,270 @@ int  run_scsi_command(MSC_T *msc, uint8_t *buff, uint32_t data_len, int bIsDataI
     return do_scsi_command(msc, buff, data_len, bIsDataIn, timeout_ticks);
 }
 
+
+/*
+ *  Clear the halt of both bulk pipes. The device restarts them with DATA0, so the host pipes
+ *  are dropped to start over with DATA0 on the next transfer as well.
+ */
+void msc_clear_halt(MSC_T *msc)
+{
+    UDEV_T    *udev = msc->iface->udev;
+
+    usbh_quit_xfer(udev, msc->ep_bulk_out);
+    usbh_quit_xfer(udev, msc->ep_bulk_in);
+    usbh_clear_halt(udev, msc->ep_bulk_out->bEndpointAddress);
+    usbh_clear_halt(udev, msc->ep_bulk_in->bEndpointAddress);
+    msc->ep_bulk_out->bToggle = 0;
+    msc->ep_bulk_in->bToggle = 0;
+}
+
+
+#if MSC_PIPELINE_XFER
+
+/* Bulk-only stages of a queued command, in the order they are queued on their pipes */
+#define STAGE_CBW       0
+#define STAGE_DATA      1
+#define STAGE_CSW       2
+#define STAGE_NUM       3
+
+typedef struct
+{
+    UTR_T     *utr[STAGE_NUM];          /* submitted stages, released when the command retires */
+} PIPE_CMD_T;
+
+static void  write_rw_cbw(MSC_T *msc, struct bulk_cb_wrap *cmd_blk, int bIsRead, uint32_t sec_no, uint32_t sec_cnt)
+{
+    memset(cmd_blk, 0, sizeof(*cmd_blk));
+
+    cmd_blk->Signature = MSC_CB_SIGN;
+    cmd_blk->Tag = __tag++;
+    cmd_blk->DataTransferLength = sec_cnt * 512;
+    cmd_blk->Flags   = bIsRead ? 0x80 : 0;
+    cmd_blk->Lun     = msc->lun;
+    cmd_blk->Length  = 10;
+    cmd_blk->CDB[0]  = bIsRead ? READ_10 : WRITE_10;
+    cmd_blk->CDB[1]  = msc->lun << 5;
+    cmd_blk->CDB[2]  = (sec_no >> 24) & 0xFF;
+    cmd_blk->CDB[3]  = (sec_no >> 16) & 0xFF;
+    cmd_blk->CDB[4]  = (sec_no >> 8) & 0xFF;
+    cmd_blk->CDB[5]  = sec_no & 0xFF;
+    cmd_blk->CDB[7]  = (sec_cnt >> 8) & 0xFF;
+    cmd_blk->CDB[8]  = sec_cnt & 0xFF;
+}
+
+/*
+ *  0 if the CSW reports success. UMAS_ERR_CMD_STATUS if the command failed. USBH_ERR_NOT_EXPECTED
+ *  if it is not a CSW of the command or reports a phase error, the device then needs a reset.
+ */
+static int  check_csw(struct bulk_cs_wrap *cmd_status, uint32_t tag)
+{
+    if ((cmd_status->Signature != MSC_CS_SIGN) || (cmd_status->Tag != tag) ||
+            (cmd_status->Status == MSC_STAT_PHASE))
+    {
+        msc_debug_msg("    !! CSW invalid. tag 0x%x/0x%x, status %d\n", cmd_status->Tag, tag, cmd_status->Status);
+        return USBH_ERR_NOT_EXPECTED;
+    }
+    if ((cmd_status->Status != MSC_STAT_OK) || (cmd_status->Residue != 0))
+    {
+        msc_debug_msg("    !! CSW status error. status %d, residue %d\n", cmd_status->Status, cmd_status->Residue);
+        return UMAS_ERR_CMD_STATUS;
+    }
+    return 0;
+}
+
+static int  stage_ok(UTR_T *utr)
+{
+    return (utr != NULL) && utr->bIsTransferDone && (utr->status == 0);
+}
+
+/*
+ *  Submit a stage of command <n>. A host controller that takes one transfer per endpoint at a
+ *  time (OHCI) reports the endpoint busy; the oldest stage queued on it is waited for first.
+ */
+static int  pipe_submit(MSC_T *msc, PIPE_CMD_T *cmds, int first, int n, int stage, EP_INFO_T *ep,
+                        uint8_t *buff, int len)
+{
+    UTR_T     *utr;
+    int       i, s, ret;
+
+    while (1)
+    {
+        utr = msc_bulk_submit(msc, ep, buff, len, &ret);
+        if (utr != NULL)
+        {
+            cmds[n % MSC_PIPE_DEPTH].utr[stage] = utr;
+            return 0;
+        }
+        if ((ret != USBH_ERR_OHCI_EP_BUSY) && (ret != USBH_ERR_EHCI_QH_BUSY))
+            return ret;
+
+        utr = NULL;
+        for (i = first; (i <= n) && (utr == NULL); i++)
+        {
+            for (s = 0; s < STAGE_NUM; s++)
+            {
+                utr = cmds[i % MSC_PIPE_DEPTH].utr[s];
+                if ((utr != NULL) && (utr->ep == ep) && !utr->bIsTransferDone)
+                    break;
+                utr = NULL;
+            }
+        }
+        if (utr == NULL)
+            return ret;
+        ret = msc_bulk_wait(utr, 500);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+/*
+ *  Bulk-only error recovery (BOT 5.3 and 6.7). Both pipes are stopped and the commands still
+ *  queued on them are aborted. The device has taken the CBWs up to command <last> only: the
+ *  halt of both pipes is cleared and the CSW of <last> is read, if it has not arrived yet.
+ *  The device is then ready for the next CBW. It gets a reset recovery instead if a CBW
+ *  failed, a stage timed out, a CSW reported a phase error, or the CSW does not come.
+ */
+static void pipe_recover(MSC_T *msc, PIPE_CMD_T *cmds, int first, int err)
+{
+    struct bulk_cs_wrap  *cmd_status;
+    UTR_T     *utr;
+    int       i, stage, last = -1, reset = 0, ret;
+
+    msc_debug_msg("    !! pipelined transfer failed [%d]\n", err);
+
+    usbh_quit_xfer(msc->iface->udev, msc->ep_bulk_in);
+    usbh_quit_xfer(msc->iface->udev, msc->ep_bulk_out);
+
+    for (i = first; i < first + MSC_PIPE_DEPTH; i++)
+    {
+        for (stage = 0; stage < STAGE_NUM; stage++)
+        {
+            utr = cmds[i % MSC_PIPE_DEPTH].utr[stage];
+            if ((utr != NULL) && !utr->bIsTransferDone)
+                msc_bulk_wait(utr, 10);     /* aborted by the host controller driver      */
+        }
+        utr = cmds[i % MSC_PIPE_DEPTH].utr[STAGE_CBW];
+        if (stage_ok(utr))
+            last = i;
+        else if ((utr != NULL) && (utr->status != USBH_ERR_ABORT))
+            reset = 1;                      /* CBW failed, the device state is unknown    */
+    }
+
+    if ((err == USBH_ERR_TIMEOUT) || (err == USBH_ERR_NOT_EXPECTED))
+        reset = 1;                          /* no response, or a phase error              */
+
+    if ((last >= 0) && !reset)
+    {
+        cmd_status = &msc->pipe_csw[last % MSC_PIPE_DEPTH];
+        msc_clear_halt(msc);
+        if (!stage_ok(cmds[last % MSC_PIPE_DEPTH].utr[STAGE_CSW]))
+        {
+            ret = msc_bulk_transfer(msc, msc->ep_bulk_in, (uint8_t *)cmd_status, MSC_CS_WRAP_LEN, 100);
+            if (ret == USBH_ERR_STALL)
+            {
+                msc_clear_halt(msc);
+                ret = msc_bulk_transfer(msc, msc->ep_bulk_in, (uint8_t *)cmd_status, MSC_CS_WRAP_LEN, 100);
+            }
+            if (ret < 0)
+                reset = 1;
+        }
+        if (check_csw(cmd_status, msc->pipe_cbw[last % MSC_PIPE_DEPTH].Tag) == USBH_ERR_NOT_EXPECTED)
+            reset = 1;
+    }
+
+    if (reset)
+        msc_reset(msc);
+
+    for (i = 0; i < MSC_PIPE_DEPTH; i++)
+    {
+        for (stage = 0; stage < STAGE_NUM; stage++)
+        {
+            free_utr(cmds[i].utr[stage]);
+            cmds[i].utr[stage] = NULL;
+        }
+    }
+}
+
+/*
+ *  READ_10/WRITE_10 of any length, split into commands of at most MSC_PIPE_MAX_SECTORS.
+ *  Up to MSC_PIPE_DEPTH commands are queued at a time, each as a CBW, a data stage and a CSW
+ *  transfer. On bulk-in the data stages of reads and the CSWs follow each other; on bulk-out
+ *  the CBWs and the data stages of writes. The host controller moves from one to the next
+ *  without waiting for software, and the device takes the next CBW as soon as it has sent a
+ *  CSW. Each data stage is a chain of qTDs, so several chains are queued on a pipe.
+ *  A command that fails in its CSW does not stop the commands queued behind it; a failed
+ *  transfer stops both pipes for pipe_recover().
+ */
+int  run_scsi_rw_pipelined(MSC_T *msc, int bIsRead, uint32_t sec_no, uint32_t sec_cnt, uint8_t *buff)
+{
+    PIPE_CMD_T  cmds[MSC_PIPE_DEPTH];
+    EP_INFO_T   *ep_data;
+    uint32_t    cnt;
+    int         n_cmd, issued, retired, slot, stage, ret, result = 0;
+
+    memset(cmds, 0, sizeof(cmds));
+    ep_data = bIsRead ? msc->ep_bulk_in : msc->ep_bulk_out;
+    n_cmd = (sec_cnt + MSC_PIPE_MAX_SECTORS - 1) / MSC_PIPE_MAX_SECTORS;
+    issued = 0;
+    retired = 0;
+
+    while (retired < n_cmd)
+    {
+        /* queue commands until MSC_PIPE_DEPTH are in flight, no more after a failed one */
+        while ((issued < n_cmd) && (issued - retired < MSC_PIPE_DEPTH) && (result == 0))
+        {
+            slot = issued % MSC_PIPE_DEPTH;
+            cnt = sec_cnt - issued * MSC_PIPE_MAX_SECTORS;
+            if (cnt > MSC_PIPE_MAX_SECTORS)
+                cnt = MSC_PIPE_MAX_SECTORS;
+
+            write_rw_cbw(msc, &msc->pipe_cbw[slot], bIsRead, sec_no + issued * MSC_PIPE_MAX_SECTORS, cnt);
+            ret = pipe_submit(msc, cmds, retired, issued, STAGE_CBW, msc->ep_bulk_out,
+                              (uint8_t *)&msc->pipe_cbw[slot], MSC_CB_WRAP_LEN);
+            if (ret == 0)
+                ret = pipe_submit(msc, cmds, retired, issued, STAGE_DATA, ep_data,
+                                  buff + issued * MSC_PIPE_MAX_SECTORS * 512, cnt * 512);
+            if (ret == 0)
+                ret = pipe_submit(msc, cmds, retired, issued, STAGE_CSW, msc->ep_bulk_in,
+                                  (uint8_t *)&msc->pipe_csw[slot], MSC_CS_WRAP_LEN);
+            if (ret < 0)
+                goto xfer_err;
+            issued++;
+        }
+
+        if (retired == issued)
+            break;                          /* failed, and nothing is in flight any more  */
+
+        /* retire the oldest command */
+        slot = retired % MSC_PIPE_DEPTH;
+        for (stage = 0; stage < STAGE_NUM; stage++)
+        {
+            ret = msc_bulk_wait(cmds[slot].utr[stage], (stage == STAGE_CSW) ? 100 : 500);
+            if (ret < 0)
+                goto xfer_err;
+        }
+        ret = check_csw(&msc->pipe_csw[slot], msc->pipe_cbw[slot].Tag);
+        if (ret == USBH_ERR_NOT_EXPECTED)
+            goto xfer_err;
+        if ((ret < 0) && (result == 0))
+            result = ret;
+
+        for (stage = 0; stage < STAGE_NUM; stage++)
+        {
+            free_utr(cmds[slot].utr[stage]);
+            cmds[slot].utr[stage] = NULL;
+        }
+        retired++;
+    }
+    return result;
+
+xfer_err:
+    pipe_recover(msc, cmds, retired, ret);
+    return ret;
+}
+
+#endif  /* MSC_PIPELINE_XFER */
+
 /*** (C) COPYRIGHT 2017 Nuvoton Technology Corp. ***/
 
 
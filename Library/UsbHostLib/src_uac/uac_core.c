@@ -457,7 +457,8 @@ int  usbh_uac_auto_gain_control(UAC_DEV_T *uac, uint8_t target, uint8_t req, uin
 /// @cond HIDDEN_SYMBOLS
 
 /**
- *  @brief    Find the alternative interface whose endpoint has the maximum packet size.
+ *  @brief    Find the alternative interface whose endpoint has the maximum packet size and
+ *            fits in the free periodic bandwidth.
  *  @param[in]  ifcae     USB device interface
  *  @param[in]  dir       Endpoint bEndpointAddress[7] direction
  *  @param[in]  attr      Endpoint bmAttributes[1:0] transfer type
@@ -471,6 +472,7 @@ int  usbh_uac_find_max_alt(IFACE_T *iface, uint8_t dir, uint8_t attr, uint8_t *b
     EP_INFO_T    *ep;
     uint8_t      i,  j;
     uint16_t     wMaxPacketSize = 0;
+    int          no_bw = 0;
 
     for (i = 0; i < iface->num_alt; i++)
     {
@@ -482,16 +484,29 @@ int  usbh_uac_find_max_alt(IFACE_T *iface, uint8_t dir, uint8_t attr, uint8_t *b
                     ((ep->bmAttributes & EP_ATTR_TT_MASK) != attr))
                 continue;                   /* not interested endpoint                    */
 
-            if (ep->wMaxPacketSize > wMaxPacketSize)
+            if (ep->wMaxPacketSize <= wMaxPacketSize)
+                continue;                   /* not better than the current candidate      */
+
+            if (usbh_check_alt_bandwidth(iface, &iface->alt[i]) != 0)
             {
-                /* a better candidate endpoint found          */
-                *bAlternateSetting = i;
-                wMaxPacketSize = ep->wMaxPacketSize;
+                no_bw = 1;                  /* would overcommit, try smaller ones         */
+                continue;
             }
+
+            /* a better candidate endpoint found          */
+            *bAlternateSetting = i;
+            wMaxPacketSize = ep->wMaxPacketSize;
         }
     }
     if (wMaxPacketSize == 0)
+    {
+        if (no_bw)
+        {
+            UAC_DBGMSG("Audio interface %d has no alternative setting fitting in bandwidth!\n", iface->if_num);
+            return USBH_ERR_NO_BANDWIDTH;
+        }
         return USBH_ERR_NOT_FOUND;
+    }
 
     return 0;
 }
@@ -502,6 +517,7 @@ int  usbh_uac_find_max_alt(IFACE_T *iface, uint8_t dir, uint8_t attr, uint8_t *b
  *  @param[in]  dir       Endpoint bEndpointAddress[7] direction
  *  @param[in]  attr      Endpoint bmAttributes[1:0] transfer type
  *  @param[in]  pkt_sz    Find the endpoint whose wMaxPacketSize is larger than <pkt_sz> and is most cross to <pkt_sz>.
+ *                        Alternative interfaces not fitting in the free periodic bandwidth are skipped.
  *  @param[out] bAlternateSetting   The alternative interface number if found.
  *  @return   Success or not.
  *  @retval     0         Success.
@@ -523,7 +539,8 @@ int  usbh_uac_find_best_alt(IFACE_T *iface, uint8_t dir, uint8_t attr, int pkt_s
                     ((ep->bmAttributes & EP_ATTR_TT_MASK) != attr))
                 continue;                   /* not interested endpoint                    */
 
-            if ((ep->wMaxPacketSize >= pkt_sz) && (ep->wMaxPacketSize < wMaxPacketSize))
+            if ((ep->wMaxPacketSize >= pkt_sz) && (ep->wMaxPacketSize < wMaxPacketSize) &&
+                    (usbh_check_alt_bandwidth(iface, &iface->alt[i]) == 0))
             {
                 /* a better candidate endpoint found          */
                 *bAlternateSetting = i;
@@ -697,12 +714,13 @@ int usbh_uac_start_audio_in(UAC_DEV_T *uac, UAC_CB_FUNC *func)
         utr->context = uac;
         utr->ep = ep;
         utr->func = iso_in_irq;
-        ret = usbh_iso_xfer(utr);
-        if (ret < 0)
-        {
-            UAC_DBGMSG("Error - failed to start UTR %d isochronous-in transfer (%d)", i, ret);
-            goto err_out;
-        }
+    }
+
+    ret = usbh_iso_xfer_batch(asif->utr, NUM_UTR);
+    if (ret < 0)
+    {
+        UAC_DBGMSG("Error - failed to start isochronous-in transfer (%d)", ret);
+        goto err_out;
     }
     asif->flag_streaming = 1;
     uac->state = UAC_STATE_RUNNING;
@@ -939,13 +957,13 @@ int usbh_uac_start_audio_out(UAC_DEV_T *uac, UAC_CB_FUNC *func)
             utr->iso_buff[j] = utr->buff + (ep->wMaxPacketSize * j);
             utr->iso_xlen[j] = uac->func_au_out(uac, utr->iso_buff[j], ep->wMaxPacketSize);
         }
+    }
 
-        ret = usbh_iso_xfer(utr);
-        if (ret < 0)
-        {
-            UAC_DBGMSG("Error - failed to start UTR %d isochronous-in transfer (%d)", i, ret);
-            goto err_out;
-        }
+    ret = usbh_iso_xfer_batch(asif->utr, NUM_UTR);
+    if (ret < 0)
+    {
+        UAC_DBGMSG("Error - failed to start isochronous-out transfer (%d)", ret);
+        goto err_out;
     }
     asif->flag_streaming = 1;
     uac->state = UAC_STATE_RUNNING;
@@ -0,0 +1,523 @@
+/**************************************************************************//**
+ * @file     uac_i2s.c
+ * @version  V1.00
+ * @brief    USB Audio Class to I2S bridge with clock drift compensation
+ *
+ *           UAC isochronous callbacks and I2S DMA half buffer callbacks run in
+ *           different interrupt handlers and exchange PCM through one single
+ *           producer/single consumer ring per direction:
+ *
+ *             UAC microphone --(iso in)--> play ring --> I2S play DMA
+ *             I2S record DMA --> rec ring --(iso out)--> UAC speaker
+ *
+ *           USB frames and the I2S bit clock come from different crystals. The
+ *           consumer side of each ring follows the drift by keeping the ring
+ *           fill level around its target: the I2S play side inserts or drops a
+ *           sample frame, the USB speaker side sends one frame more or less in
+ *           an iso packet.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "i2s.h"
+
+#include "usb.h"
+#include "usbh_lib.h"
+#include "usbh_uac.h"
+#include "uac_i2s.h"
+
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_Library USB Host Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_EXPORTED_FUNCTIONS USB Host Exported Functions
+  @{
+*/
+
+/// @cond HIDDEN_SYMBOLS
+
+static UAC_I2S_T  *_uac_i2s;                /* I2S driver callbacks carry no context      */
+
+static int  ring_count(UAC_RING_T *ring)
+{
+    int   cnt = ring->head - ring->tail;
+
+    if (cnt < 0)
+        cnt += ring->size;
+    return cnt;
+}
+
+static void  ring_get(UAC_RING_T *ring, uint8_t *data, int len)
+{
+    int   tail = ring->tail;
+    int   n;
+
+    n = ring->size - tail;
+    if (n > len)
+        n = len;
+    memcpy(data, ring->buff + tail, n);
+    memcpy(data + n, ring->buff, len - n);
+
+    tail += len;
+    if (tail >= ring->size)
+        tail -= ring->size;
+    ring->tail = tail;                      /* publish after data is copied out           */
+}
+
+static void  ring_skip(UAC_RING_T *ring, int len)
+{
+    int   tail = ring->tail + len;
+
+    if (tail >= ring->size)
+        tail -= ring->size;
+    ring->tail = tail;
+}
+
+/*
+ *  Integrate the fill error over the frames read. Returns 1 if the producer runs fast
+ *  and one more frame should be read, -1 if it runs slow and one less should be read.
+ */
+static int  ring_drift(UAC_RING_T *ring, int level, int frames)
+{
+    int   span = ring->target * UAC_RING_DRIFT_SPAN;
+
+    ring->phase += (level - ring->target) * frames;
+    if (ring->phase >= span)
+    {
+        ring->phase -= span;
+        ring->stat.drift_fast++;
+        return 1;
+    }
+    if (ring->phase <= -span)
+    {
+        ring->phase += span;
+        ring->stat.drift_slow++;
+        return -1;
+    }
+    return 0;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+
+/**
+ *  @brief  Set up a PCM ring.
+ *  @param[out] ring        PCM ring.
+ *  @param[in]  buff        Ring storage.
+ *  @param[in]  size        Size of \a buff in bytes.
+ *  @param[in]  frame_size  Bytes of one sample frame, for example 4 for 16-bit stereo.
+ *  @param[in]  target      Fill level in frames kept by drift compensation. The consumer
+ *                          starts reading after the ring is filled up to this level, so it
+ *                          is also the latency of the ring.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int  uac_ring_init(UAC_RING_T *ring, uint8_t *buff, int size, int frame_size, int target)
+{
+    if ((buff == NULL) || (frame_size <= 0) || (target <= 0))
+        return UAC_RET_INVALID;
+
+    size -= size % frame_size;
+    if (target * frame_size >= size)
+        return UAC_RET_INVALID;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->buff = buff;
+    ring->size = size;
+    ring->frame_size = frame_size;
+    ring->target = target;
+    return UAC_RET_OK;
+}
+
+
+/**
+ *  @brief  Put PCM data into ring. Called by the producer only.
+ *  @param[in] ring       PCM ring.
+ *  @param[in] data       PCM data, whole sample frames.
+ *  @param[in] len        Length of \a data in bytes.
+ *  @return   Number of bytes put into ring. The rest is dropped and counted as overrun.
+ */
+int  uac_ring_write(UAC_RING_T *ring, uint8_t *data, int len)
+{
+    int   head = ring->head;
+    int   space, n;
+
+    space = ring->size - ring->frame_size - ring_count(ring);
+    len -= len % ring->frame_size;
+    if (len > space)
+    {
+        ring->stat.overrun++;
+        len = space;
+    }
+
+    n = ring->size - head;
+    if (n > len)
+        n = len;
+    memcpy(ring->buff + head, data, n);
+    memcpy(ring->buff, data + n, len - n);
+
+    head += len;
+    if (head >= ring->size)
+        head -= ring->size;
+    ring->head = head;                      /* publish after data is copied in            */
+    return len;
+}
+
+
+/**
+ *  @brief  Get PCM data from ring. Called by the consumer only.
+ *  @param[in]  ring      PCM ring.
+ *  @param[out] data      Buffer to receive PCM data.
+ *  @param[in]  frames    Number of frames wanted.
+ *  @param[in]  mode      UAC_RING_FIXED or UAC_RING_ELASTIC. In UAC_RING_FIXED mode,
+ *                        exactly \a frames frames are returned, and drift is followed by
+ *                        repeating or dropping the last frame. In UAC_RING_ELASTIC mode
+ *                        \a frames + 1 or \a frames - 1 frames may be returned, \a data must
+ *                        have room for \a frames + 1 frames.
+ *  @return   Number of frames put into \a data. Silence is returned before the ring reaches
+ *            its target level, and after an underrun until it does again.
+ */
+int  uac_ring_read(UAC_RING_T *ring, uint8_t *data, int frames, int mode)
+{
+    int   fs = ring->frame_size;
+    int   level, adj, take;
+
+    level = ring_count(ring) / fs;
+
+    if (!ring->primed)
+    {
+        if (level < ring->target)
+        {
+            memset(data, 0, frames * fs);
+            return frames;
+        }
+        ring->primed = 1;
+        ring->phase = 0;
+    }
+
+    adj = (frames > 1) ? ring_drift(ring, level, frames) : 0;
+    if (mode == UAC_RING_ELASTIC)
+        frames += adj;
+    take = frames + ((mode == UAC_RING_FIXED) ? adj : 0);
+
+    if (take > level)
+    {
+        /* producer stopped or fell far behind; play silence and refill to target */
+        ring->stat.underrun++;
+        ring->primed = 0;
+        ring_get(ring, data, level * fs);
+        memset(data + level * fs, 0, (frames - level) * fs);
+        return frames;
+    }
+
+    if (take < frames)
+    {
+        ring_get(ring, data, take * fs);
+        memcpy(data + take * fs, data + (take - 1) * fs, fs);   /* repeat the last frame */
+    }
+    else
+    {
+        ring_get(ring, data, frames * fs);
+        if (take > frames)
+            ring_skip(ring, fs);            /* drop one frame                             */
+    }
+    return frames;
+}
+
+
+/**
+ *  @brief  Get the ring counters.
+ *  @param[in]  ring      PCM ring.
+ *  @param[out] stat      Counters.
+ *  @return   None.
+ */
+void  uac_ring_get_stat(UAC_RING_T *ring, UAC_RING_STAT_T *stat)
+{
+    memcpy(stat, (void *)&ring->stat, sizeof(*stat));
+    stat->level = ring_count(ring) / ring->frame_size;
+}
+
+
+/// @cond HIDDEN_SYMBOLS
+
+static int  uac_i2s_mic_in(UAC_DEV_T *dev, uint8_t *data, int len)
+{
+    UAC_I2S_T  *br = _uac_i2s;
+
+    if ((br != NULL) && (br->play_dma != NULL))
+        uac_ring_write(&br->play, data, len);
+    return 0;
+}
+
+/*
+ *  Service period of the speaker endpoint in micro-frames. A high speed endpoint gets a packet
+ *  every 2^(bInterval-1) micro-frames, a full speed one every 2^(bInterval-1) frames.
+ */
+static int  uac_i2s_pkt_uframes(UAC_DEV_T *dev)
+{
+    EP_INFO_T  *ep = dev->asif_out.ep;
+    int   bi;
+
+    bi = (ep != NULL) ? ep->bInterval : 1;
+    if (bi < 1)
+        bi = 1;
+    if (bi > 16)
+        bi = 16;
+
+    if (dev->udev->speed == SPEED_HIGH)
+        return 1 << (bi - 1);
+    return 8 << (bi - 1);
+}
+
+static int  uac_i2s_spk_out(UAC_DEV_T *dev, uint8_t *data, int len)
+{
+    UAC_I2S_T  *br = _uac_i2s;
+    int   frames, mode;
+
+    if ((br == NULL) || (br->rec_dma == NULL))
+        return 0;
+
+    if (br->pkt_uframes == 0)
+        br->pkt_uframes = uac_i2s_pkt_uframes(dev);
+
+    /* nominal frames of this packet, 1 ms packets at 44.1 KHz alternate 44 and 45 frames */
+    br->pkt_acc += br->srate * br->pkt_uframes;
+    frames = br->pkt_acc / 8000;
+    br->pkt_acc %= 8000;
+
+    mode = ((frames + 1) * br->rec.frame_size <= len) ? UAC_RING_ELASTIC : UAC_RING_FIXED;
+    frames = uac_ring_read(&br->rec, data, frames, mode);
+    return frames * br->rec.frame_size;
+}
+
+static uint32_t  uac_i2s_play_cb(uint32_t u32Sn)
+{
+    UAC_I2S_T  *br = _uac_i2s;
+    uint8_t    *half;
+
+    if ((br == NULL) || (br->play_dma == NULL))
+        return 0;
+
+    /* half buffer just played can be refilled */
+    half = br->play_dma + ((u32Sn == 1) ? 0 : br->period * br->play.frame_size);
+    uac_ring_read(&br->play, half, br->period, UAC_RING_FIXED);
+    return 0;
+}
+
+static uint32_t  uac_i2s_rec_cb(uint32_t u32Sn)
+{
+    UAC_I2S_T  *br = _uac_i2s;
+    uint8_t    *half;
+
+    if ((br == NULL) || (br->rec_dma == NULL))
+        return 0;
+
+    /* half buffer just recorded */
+    half = br->rec_dma + ((u32Sn == 1) ? 0 : br->period * br->rec.frame_size);
+    uac_ring_write(&br->rec, half, br->period * br->rec.frame_size);
+    return 0;
+}
+
+static int  uac_i2s_ring_check(UAC_I2S_T *br, int ring_size)
+{
+    int   fs = br->channels * 2;
+
+    /* target is half the ring and must hold one I2S period plus one USB packet of up to 1 ms */
+    if (ring_size / fs / 2 < br->period + (int)(br->srate / 1000) + 1)
+        return UAC_RET_INVALID;
+    return UAC_RET_OK;
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+
+/**
+ *  @brief  Set up a UAC to I2S bridge. Only one bridge is supported.
+ *  @param[out] br        Bridge.
+ *  @param[in]  uac       Audio Class device opened by usbh_uac_open(), with sampling rate of
+ *                        speaker and microphone set to \a srate.
+ *  @param[in]  srate     Sampling rate of both UAC device and I2S.
+ *  @param[in]  channels  Number of channels, 1 or 2. Samples are 16 bits on both sides.
+ *  @param[in]  period    I2S DMA half buffer in frames. The I2S callbacks run once per period.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ *  @note     I2S must be opened and configured for \a srate, 16-bit and \a channels by the
+ *            application, as well as the codec.
+ */
+int  uac_i2s_init(UAC_I2S_T *br, UAC_DEV_T *uac, uint32_t srate, int channels, int period)
+{
+    if ((uac == NULL) || (srate < 1000) || (channels < 1) || (channels > 2) || (period <= 0))
+        return UAC_RET_INVALID;
+
+    memset(br, 0, sizeof(*br));
+    br->uac = uac;
+    br->srate = srate;
+    br->channels = channels;
+    br->period = period;
+    _uac_i2s = br;
+    return UAC_RET_OK;
+}
+
+
+/**
+ *  @brief  Start to play UAC microphone audio on I2S.
+ *  @param[in] br         Bridge.
+ *  @param[in] dma_buff   I2S play DMA buffer of 2 * period frames, 32 bytes aligned.
+ *  @param[in] ring_buff  Ring storage.
+ *  @param[in] ring_size  Size of \a ring_buff in bytes. The ring keeps half of it filled,
+ *                        which is the added latency.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int  uac_i2s_start_play(UAC_I2S_T *br, uint8_t *dma_buff, uint8_t *ring_buff, int ring_size)
+{
+    int   fs = br->channels * 2;
+    int   ret;
+
+    ret = uac_i2s_ring_check(br, ring_size);
+    if (ret < 0)
+        return ret;
+
+    ret = uac_ring_init(&br->play, ring_buff, ring_size, fs, ring_size / fs / 2);
+    if (ret < 0)
+        return ret;
+
+    br->play_dma = (uint8_t *)((uint32_t)dma_buff | 0x80000000);
+    memset(br->play_dma, 0, 2 * br->period * fs);
+    _uac_i2s = br;
+
+    i2sIoctl(I2S_SET_PLAY_DMA_INT_SEL, I2S_DMA_INT_HALF, 0);
+    i2sIoctl(I2S_SET_DMA_ADDRESS, I2S_PLAY, (uint32_t)br->play_dma);
+    i2sIoctl(I2S_SET_DMA_LENGTH, I2S_PLAY, 2 * br->period * fs);
+    i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_PLAY, (uint32_t)&uac_i2s_play_cb);
+
+    ret = usbh_uac_start_audio_in(br->uac, uac_i2s_mic_in);
+    if (ret < 0)
+    {
+        i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_PLAY, 0);
+        br->play_dma = NULL;
+        if (br->rec_dma == NULL)
+            _uac_i2s = NULL;
+        return ret;
+    }
+
+    i2sIoctl(I2S_SET_PLAY, I2S_START_PLAY, 0);
+    return UAC_RET_OK;
+}
+
+
+/**
+ *  @brief  Stop playing UAC microphone audio on I2S. The I2S call-back is removed, and the bridge
+ *          is released once both directions are stopped.
+ *  @param[in] br         Bridge.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int  uac_i2s_stop_play(UAC_I2S_T *br)
+{
+    int   ret;
+
+    ret = usbh_uac_stop_audio_in(br->uac);
+    i2sIoctl(I2S_SET_PLAY, I2S_STOP_PLAY, 0);
+    i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_PLAY, 0);
+    br->play_dma = NULL;
+    if (br->rec_dma == NULL)
+        _uac_i2s = NULL;
+    return ret;
+}
+
+
+/**
+ *  @brief  Start to send I2S record audio to UAC speaker.
+ *  @param[in] br         Bridge.
+ *  @param[in] dma_buff   I2S record DMA buffer of 2 * period frames, 32 bytes aligned.
+ *  @param[in] ring_buff  Ring storage.
+ *  @param[in] ring_size  Size of \a ring_buff in bytes. The ring keeps half of it filled,
+ *                        which is the added latency.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int  uac_i2s_start_record(UAC_I2S_T *br, uint8_t *dma_buff, uint8_t *ring_buff, int ring_size)
+{
+    int   fs = br->channels * 2;
+    int   ret;
+
+    ret = uac_i2s_ring_check(br, ring_size);
+    if (ret < 0)
+        return ret;
+
+    ret = uac_ring_init(&br->rec, ring_buff, ring_size, fs, ring_size / fs / 2);
+    if (ret < 0)
+        return ret;
+
+    br->rec_dma = (uint8_t *)((uint32_t)dma_buff | 0x80000000);
+    br->pkt_acc = 0;
+    br->pkt_uframes = 0;                    /* taken from the endpoint on the first packet */
+    _uac_i2s = br;
+
+    i2sIoctl(I2S_SET_REC_DMA_INT_SEL, I2S_DMA_INT_HALF, 0);
+    i2sIoctl(I2S_SET_DMA_ADDRESS, I2S_REC, (uint32_t)br->rec_dma);
+    i2sIoctl(I2S_SET_DMA_LENGTH, I2S_REC, 2 * br->period * fs);
+    i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_REC, (uint32_t)&uac_i2s_rec_cb);
+    i2sIoctl(I2S_SET_RECORD, I2S_START_REC, 0);
+
+    ret = usbh_uac_start_audio_out(br->uac, uac_i2s_spk_out);
+    if (ret < 0)
+    {
+        i2sIoctl(I2S_SET_RECORD, I2S_STOP_REC, 0);
+        i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_REC, 0);
+        br->rec_dma = NULL;
+        if (br->play_dma == NULL)
+            _uac_i2s = NULL;
+        return ret;
+    }
+    return UAC_RET_OK;
+}
+
+
+/**
+ *  @brief  Stop sending I2S record audio to UAC speaker. The I2S call-back is removed, and the bridge
+ *          is released once both directions are stopped.
+ *  @param[in] br         Bridge.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int  uac_i2s_stop_record(UAC_I2S_T *br)
+{
+    int   ret;
+
+    ret = usbh_uac_stop_audio_out(br->uac);
+    i2sIoctl(I2S_SET_RECORD, I2S_STOP_REC, 0);
+    i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_REC, 0);
+    br->rec_dma = NULL;
+    if (br->play_dma == NULL)
+        _uac_i2s = NULL;
+    return ret;
+}
+
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_USBH_Library */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
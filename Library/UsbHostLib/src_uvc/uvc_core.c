@@ -122,9 +122,26 @@ static int usbh_uvc_commit_control(UVC_DEV_T *vdev, UVC_CTRL_PARAM_T *param)
 }
 
 
+/*
+ *  Return 1 if the isochronous endpoint of alternative setting <alt_no> fits in the free
+ *  periodic bandwidth of the host controller.
+ */
+static int  uvc_alt_fits_bandwidth(IFACE_T *iface, int alt_no)
+{
+    int    i;
+
+    for (i = 0; i < iface->num_alt; i++)
+    {
+        if (iface->alt[i].ifd->bAlternateSetting == alt_no)
+            return (usbh_check_alt_bandwidth(iface, &iface->alt[i]) == 0);
+    }
+    return 0;
+}
+
 /*
  *  Based on the current parameter block information, select the best-fit alternative interface of
- *  UVC streaming interface.
+ *  UVC streaming interface. Settings that would overcommit the periodic bandwidth, such as
+ *  when audio and HID devices share the same high speed hub, are skipped.
  */
 static int  usbh_uvc_select_alt_interface(UVC_DEV_T *vdev)
 {
@@ -160,7 +177,7 @@ static int  usbh_uvc_select_alt_interface(UVC_DEV_T *vdev)
      */
     for (i = 0; i < vs->num_of_alt; i++)
     {
-        if (vs->max_pktsz[i] <= 3072)
+        if ((vs->max_pktsz[i] <= 3072) && uvc_alt_fits_bandwidth(iface, vs->alt_no[i]))
         {
             if (best == -1)
                 best = i;
@@ -175,7 +192,8 @@ static int  usbh_uvc_select_alt_interface(UVC_DEV_T *vdev)
     for (i = 0; i < vs->num_of_alt; i++)
     {
         UVC_DBGMSG("i=%d, best=%d, %d, %d\n", i, best, vs->max_pktsz[i], payload_size);
-        if ((vs->max_pktsz[i] >= payload_size) && (vs->max_pktsz[i] <= 3072))
+        if ((vs->max_pktsz[i] >= payload_size) && (vs->max_pktsz[i] <= 3072) &&
+                uvc_alt_fits_bandwidth(iface, vs->alt_no[i]))
         {
             if (best == -1)
                 best = i;
@@ -366,6 +384,72 @@ commit:
 /// @cond HIDDEN_SYMBOLS
 
 
+/*
+ *  Get a frame ring image buffer for the image about to start. A free buffer is
+ *  preferred. Otherwise the oldest ready image is dropped and its buffer reused,
+ *  so that the user always gets the latest images. Called from USB interrupt.
+ */
+static int  uvc_frame_begin(UVC_DEV_T *vdev)
+{
+    int   i, idx = -1;
+
+    if (vdev->frame_fill >= 0)
+        return 0;                           /* buffer of a broken image not used yet      */
+
+    for (i = 0; i < vdev->frame_num; i++)
+    {
+        if (vdev->frame[i].state == UVC_FRAME_FREE)
+        {
+            idx = i;
+            break;
+        }
+    }
+
+    if ((idx < 0) && (vdev->ready_cnt > 0))
+    {
+        idx = vdev->ready_q[0];
+        vdev->ready_cnt--;
+        for (i = 0; i < vdev->ready_cnt; i++)
+            vdev->ready_q[i] = vdev->ready_q[i+1];
+        vdev->frame_drop++;
+    }
+
+    if (idx < 0)
+        return -1;                          /* all image buffers acquired by user         */
+
+    vdev->frame[idx].state = UVC_FRAME_FILLING;
+    vdev->frame_fill = idx;
+    vdev->img_buff = vdev->frame[idx].buff;
+    vdev->img_buff_size = vdev->frame[idx].buff_size;
+    return 0;
+}
+
+static void  uvc_frame_complete(UVC_DEV_T *vdev)
+{
+    UVC_FRAME_T  *frame;
+
+    if (vdev->img_size == 0)
+        return;
+
+    if (vdev->frame_num == 0)
+    {
+        if (vdev->func_rx)
+            vdev->func_rx(vdev, vdev->img_buff, vdev->img_size);
+        return;
+    }
+
+    frame = &vdev->frame[vdev->frame_fill];
+    frame->len = vdev->img_size;
+    frame->ticks = get_ticks();
+    frame->seq = vdev->frame_seq++;
+    frame->state = UVC_FRAME_READY;
+    vdev->ready_q[vdev->ready_cnt++] = vdev->frame_fill;
+    vdev->frame_fill = -1;
+
+    if (vdev->func_rx)
+        vdev->func_rx(vdev, frame->buff, frame->len);
+}
+
 void  uvc_parse_streaming_data(UVC_DEV_T *vdev, uint8_t *buff, int pkt_len)
 {
     UVC_STRM_T   *vs = &vdev->vs;
@@ -394,6 +478,26 @@ void  uvc_parse_streaming_data(UVC_DEV_T *vdev, uint8_t *buff, int pkt_len)
         vs->current_frame_toggle = buff[1] & UVC_PL_FID;
         if (data_len > 0)
         {
+            if (vdev->frame_num > 0)
+            {
+                if (uvc_frame_begin(vdev) < 0)
+                {
+                    vdev->frame_drop++;
+                    vs->current_frame_error = 1;    /* skip this image                    */
+                    return;
+                }
+                if ((buff[1] & UVC_PL_PTS) && (buff[0] >= 6))
+                    vdev->frame[vdev->frame_fill].pts = buff[2] | (buff[3] << 8) | (buff[4] << 16) | (buff[5] << 24);
+                else
+                    vdev->frame[vdev->frame_fill].pts = 0;
+            }
+            if (data_len > vdev->img_buff_size)
+            {
+                UVC_DBGMSG("Image data overrun!\n");
+                vdev->frame_err++;
+                vs->current_frame_error = 1;
+                return;
+            }
             memcpy(vdev->img_buff, buff+buff[0], data_len);
             vdev->img_size = data_len;
             // sysprintf("![%d] %x %x %x %x %x\n", vdev->img_size, vdev->img_buff[0], vdev->img_buff[1], vdev->img_buff[2], vdev->img_buff[3], vdev->img_buff[4]);
@@ -405,20 +509,21 @@ void  uvc_parse_streaming_data(UVC_DEV_T *vdev, uint8_t *buff, int pkt_len)
         if ((buff[1] & UVC_PL_FID) != vs->current_frame_toggle)
         {
             UVC_DBGMSG("FID toggle error!\n");
+            vdev->frame_err++;
             vs->current_frame_error = 1;
             return;
         }
         if (buff[1] & UVC_PL_ERR)
         {
             UVC_DBGMSG("Payload ERR bit error!\n");
+            vdev->frame_err++;
             vs->current_frame_error = 1;
             return;
         }
 
         if ((buff[1] & UVC_PL_RES) && (buff[1] & UVC_PL_PTS))
         {
-            if (vdev->func_rx && (vdev->img_size > 0))
-                vdev->func_rx(vdev, vdev->img_buff, vdev->img_size);
+            uvc_frame_complete(vdev);
             vdev->img_size = 0;
             return;
         }
@@ -426,6 +531,7 @@ void  uvc_parse_streaming_data(UVC_DEV_T *vdev, uint8_t *buff, int pkt_len)
         if (vdev->img_size + data_len > vdev->img_buff_size)
         {
             UVC_DBGMSG("Image data overrun!\n");
+            vdev->frame_err++;
             vs->current_frame_error = 1;
             return;
         }
@@ -438,9 +544,7 @@ void  uvc_parse_streaming_data(UVC_DEV_T *vdev, uint8_t *buff, int pkt_len)
 
         if (buff[1] & UVC_PL_EOF)
         {
-            if (vdev->func_rx && (vdev->img_size > 0))
-                vdev->func_rx(vdev, vdev->img_buff, vdev->img_size);
-
+            uvc_frame_complete(vdev);
             vdev->img_size = 0;
         }
     }
@@ -502,16 +606,128 @@ static void iso_in_irq(UTR_T *utr)
  */
 void usbh_uvc_set_video_buffer(UVC_DEV_T *vdev, uint8_t *image_buff, int img_buff_size)
 {
+    vdev->frame_num = 0;                    /* leave frame ring mode                      */
     vdev->img_buff = image_buff;
     vdev->img_buff_size = img_buff_size;
     vdev->img_size = 0;
 }
 
 
+/**
+ *  @brief  Give a ring of image buffers to receive images into. Received images are kept
+ *          until acquired by usbh_uvc_acquire_frame() and given back by usbh_uvc_release_frame(),
+ *          so an image is never overwritten while the user is still reading it.
+ *  @param[in] vdev       Video Class device
+ *  @param[in] buff       Array of \a count image buffers. Use non-cacheable addresses if
+ *                        images are passed to a DMA engine such as the JPEG codec.
+ *  @param[in] buff_size  Size of each image buffer.
+ *  @param[in] count      Number of image buffers, 2 ~ UVC_MAX_FRAME_BUFF.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ *  @note     If no image buffer is free when an image starts, the oldest image not yet acquired
+ *            is dropped. If all buffers are acquired, the new image is dropped.
+ */
+int usbh_uvc_set_frame_ring(UVC_DEV_T *vdev, uint8_t *buff[], int buff_size, int count)
+{
+    int   i;
+
+    if ((vdev == NULL) || (buff == NULL) || (count < 2) || (count > UVC_MAX_FRAME_BUFF))
+        return UVC_RET_INVALID;
+
+    if (vdev->is_streaming)
+        return UVC_RET_IS_STREAMING;
+
+    memset(vdev->frame, 0, sizeof(vdev->frame));
+    for (i = 0; i < count; i++)
+    {
+        vdev->frame[i].buff = buff[i];
+        vdev->frame[i].buff_size = buff_size;
+        vdev->frame[i].state = UVC_FRAME_FREE;
+    }
+    vdev->frame_fill = -1;
+    vdev->ready_cnt = 0;
+    vdev->frame_seq = 0;
+    vdev->frame_drop = 0;
+    vdev->frame_err = 0;
+    vdev->img_size = 0;
+    vdev->frame_num = count;
+    return UVC_RET_OK;
+}
+
+
+/**
+ *  @brief  Acquire the oldest received image of the frame ring.
+ *  @param[in] vdev       Video Class device
+ *  @return   The image buffer holding the image, or NULL if no image is ready.
+ *            The image stays valid until given back by usbh_uvc_release_frame().
+ */
+UVC_FRAME_T * usbh_uvc_acquire_frame(UVC_DEV_T *vdev)
+{
+    UVC_FRAME_T  *frame = NULL;
+    int   i, flags;
+
+    if ((vdev == NULL) || (vdev->frame_num == 0))
+        return NULL;
+
+    flags = usb_mem_lock();
+    if (vdev->ready_cnt > 0)
+    {
+        frame = &vdev->frame[vdev->ready_q[0]];
+        frame->state = UVC_FRAME_ACQUIRED;
+        vdev->ready_cnt--;
+        for (i = 0; i < vdev->ready_cnt; i++)
+            vdev->ready_q[i] = vdev->ready_q[i+1];
+    }
+    usb_mem_unlock(flags);
+    return frame;
+}
+
+
+/**
+ *  @brief  Give an acquired image buffer back to the frame ring.
+ *  @param[in] vdev       Video Class device
+ *  @param[in] frame      Image buffer returned by usbh_uvc_acquire_frame().
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ */
+int usbh_uvc_release_frame(UVC_DEV_T *vdev, UVC_FRAME_T *frame)
+{
+    int   flags;
+
+    if ((vdev == NULL) || (frame < &vdev->frame[0]) || (frame >= &vdev->frame[vdev->frame_num]) ||
+        (frame->state != UVC_FRAME_ACQUIRED))
+        return UVC_RET_INVALID;
+
+    flags = usb_mem_lock();
+    frame->state = UVC_FRAME_FREE;
+    usb_mem_unlock(flags);
+    return UVC_RET_OK;
+}
+
+
+/**
+ *  @brief  Get the frame ring counters.
+ *  @param[in]  vdev      Video Class device
+ *  @param[out] received  Number of images received.
+ *  @param[out] dropped   Number of images dropped for no free image buffer.
+ *  @param[out] errors    Number of images dropped for stream errors or image buffer overrun.
+ *  @return   None.
+ */
+void usbh_uvc_get_frame_stat(UVC_DEV_T *vdev, uint32_t *received, uint32_t *dropped, uint32_t *errors)
+{
+    *received = vdev->frame_seq;
+    *dropped = vdev->frame_drop;
+    *errors = vdev->frame_err;
+}
+
+
 /**
  *  @brief  Start to receive video data from UVC device.
  *  @param[in] vdev       Video Class device
- *  @param[in] func       Video in callback function.
+ *  @param[in] func       Video in callback function. May be NULL if a frame ring is set,
+ *                        where it is called in interrupt context for each image made ready.
  *  @return   Success or not.
  *  @retval    0          Success
  *  @retval    Otherwise  Failed
@@ -523,7 +739,7 @@ int usbh_uvc_start_streaming(UVC_DEV_T *vdev, UVC_CB_FUNC *func)
     UTR_T        *utr;
     int          i, j, ret;
 
-    if ((vdev == NULL) || (func == NULL))
+    if ((vdev == NULL) || ((func == NULL) && (vdev->frame_num == 0)))
         return UVC_RET_INVALID;
 
     if (vdev->is_streaming)
@@ -588,12 +804,13 @@ int usbh_uvc_start_streaming(UVC_DEV_T *vdev, UVC_CB_FUNC *func)
         utr->context = vdev;
         utr->ep = ep;
         utr->func = iso_in_irq;
-        ret = usbh_iso_xfer(utr);
-        if (ret < 0)
-        {
-            UVC_DBGMSG("Error - failed to start UTR %d isochronous-in transfer (%d)", i, ret);
-            goto err_1;
-        }
+    }
+
+    ret = usbh_iso_xfer_batch(vdev->utr_rx, UVC_UTR_PER_STREAM);
+    if (ret < 0)
+    {
+        UVC_DBGMSG("Error - failed to start isochronous-in transfer (%d)", ret);
+        goto err_1;
     }
 
     return UVC_RET_OK;
@@ -0,0 +1,329 @@
+/**************************************************************************//**
+ * @file     uvc_display.c
+ * @version  V1.00
+ * @brief    UVC MJPEG to LCD display pipeline
+ *
+ *           Images received into the UVC frame ring are decoded by the JPEG
+ *           engine straight into a back display buffer, which is flipped onto
+ *           the panel by the next LCD vsync interrupt. USB reception, JPEG
+ *           decoding and display scan-out run at the same time on different
+ *           buffers. When the camera runs ahead of decode or display, the
+ *           pipeline keeps the latest image and skips older ones.
+ *
+ * @note
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+#include "lcd.h"
+#include "jpegcodec.h"
+#include "jpeg.h"
+
+#include "usb.h"
+#include "usbh_lib.h"
+#include "usbh_uvc.h"
+#include "uvc_display.h"
+
+
+/** @addtogroup N9H31_Library N9H31 Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_Library USB Host Library
+  @{
+*/
+
+/** @addtogroup N9H31_USBH_EXPORTED_FUNCTIONS USB Host Exported Functions
+  @{
+*/
+
+/// @cond HIDDEN_SYMBOLS
+
+static int  disp_lock(void)
+{
+    int   flags = (inpw(REG_AIC_IMR) >> LCD_IRQn) & 0x1;
+
+    if (flags)
+        sysDisableInterrupt(LCD_IRQn);
+    return flags;
+}
+
+static void  disp_unlock(int flags)
+{
+    if (flags)
+        sysEnableInterrupt(LCD_IRQn);
+}
+
+/*
+ *  Pick a buffer that is neither on the panel nor waiting for the flip and claim it as the
+ *  decode target. The LCD interrupt moves pending to front, so both are read under the lock.
+ */
+static int  disp_claim_fb(UVC_DISP_T *disp)
+{
+    int   i, flags;
+
+    flags = disp_lock();
+    for (i = 0; i < disp->fb_cnt; i++)
+    {
+        if ((i != disp->front) && (i != disp->pending) && (i != disp->decode))
+        {
+            disp->decode = i;
+            disp_unlock(flags);
+            return i;
+        }
+    }
+    disp_unlock(flags);
+    return -1;
+}
+
+/*
+ *  Take the latest received image. Older ready images are given back unseen.
+ */
+static UVC_FRAME_T * disp_latest_frame(UVC_DISP_T *disp)
+{
+    UVC_FRAME_T  *frame, *next;
+
+    frame = usbh_uvc_acquire_frame(disp->vdev);
+    if (frame == NULL)
+        return NULL;
+
+    while ((next = usbh_uvc_acquire_frame(disp->vdev)) != NULL)
+    {
+        usbh_uvc_release_frame(disp->vdev, frame);
+        disp->stat.skipped++;
+        frame = next;
+    }
+    return frame;
+}
+
+static void  disp_decode_done(UVC_DISP_T *disp)
+{
+    int   flags;
+
+    usbh_uvc_release_frame(disp->vdev, disp->frame);
+    disp->frame = NULL;
+
+    if (jpegWait() != E_SUCCESS)
+    {
+        disp->stat.decode_err++;
+        disp->decode = -1;
+        return;
+    }
+    disp->stat.decoded++;
+
+    flags = disp_lock();
+    if (disp->pending >= 0)
+        disp->stat.skipped++;               /* previous image not flipped yet, replace it */
+    disp->pending = disp->decode;
+    disp->pending_ticks = disp->decode_ticks;
+    disp->decode = -1;
+    disp_unlock(flags);
+}
+
+static void  disp_decode_start(UVC_DISP_T *disp, UVC_FRAME_T *frame, int fb)
+{
+    disp->frame = frame;
+    disp->decode = fb;
+    disp->decode_ticks = frame->ticks;
+
+    jpegInit();
+    jpegIoctl(JPEG_IOCTL_SET_BITSTREAM_ADDR, (UINT32)frame->buff, 0);
+    jpegIoctl(JPEG_IOCTL_SET_DECODE_MODE, disp->out_format, 0);
+    jpegIoctl(JPEG_IOCTL_SET_YADDR, (UINT32)disp->fb[fb], 0);
+    if ((disp->img_width > disp->width) || (disp->img_height > disp->height))
+        jpegIoctl(JPEG_IOCTL_SET_DECODE_DOWNSCALE, disp->height, disp->width);
+    jpegIoctl(JPEG_IOCTL_SET_DECODE_STRIDE, disp->width, 0);
+    jpegIoctl(JPEG_IOCTL_DECODE_TRIGGER, 0, 0);
+}
+
+/// @endcond HIDDEN_SYMBOLS
+
+
+/**
+ *  @brief  Set up a display pipeline.
+ *  @param[out] disp        Display pipeline.
+ *  @param[in]  vdev        Video Class device with a frame ring set by usbh_uvc_set_frame_ring().
+ *                          Image buffers of the ring must be non-cacheable.
+ *  @param[in]  fb          Array of \a fb_cnt display buffers, non-cacheable. fb[0] is the buffer
+ *                          currently on the panel.
+ *  @param[in]  fb_cnt      Number of display buffers, 2 ~ UVC_DISP_FB_MAX. With 3 buffers decoding
+ *                          does not wait for vsync.
+ *  @param[in]  width       Display width in pixels.
+ *  @param[in]  height      Display height in pixels.
+ *  @param[in]  img_width   Width of the MJPEG images selected by usbh_set_video_format().
+ *  @param[in]  img_height  Height of the MJPEG images.
+ *  @param[in]  out_format  JPEG decode output format matching the display layer, such as
+ *                          JPEG_DEC_PRIMARY_PACKET_YUV422 or JPEG_DEC_PRIMARY_PACKET_RGB565.
+ *  @param[in]  layer       UVC_DISP_LAYER_VA or UVC_DISP_LAYER_OSD.
+ *  @return   Success or not.
+ *  @retval    0          Success
+ *  @retval    Otherwise  Failed
+ *  @note     Images larger than the display are scaled down by the JPEG engine. jpegOpen() must
+ *            have been called. uvc_disp_vsync() must be called from the LCD interrupt handler.
+ */
+int  uvc_disp_init(UVC_DISP_T *disp, UVC_DEV_T *vdev, uint8_t *fb[], int fb_cnt,
+                   int width, int height, int img_width, int img_height, uint32_t out_format, int layer)
+{
+    UINT16  ratio_h, ratio_w;
+    int     i;
+
+    if ((vdev == NULL) || (vdev->frame_num == 0) || (fb_cnt < 2) || (fb_cnt > UVC_DISP_FB_MAX))
+        return UVC_RET_INVALID;
+
+    if ((img_width > width) || (img_height > height))
+    {
+        if (jpegCalScalingFactor(JPEG_DEC_PACKET_DOWNSCALE_MODE, img_height, img_width,
+                                 height, width, &ratio_h, &ratio_w) != E_SUCCESS)
+            return UVC_RET_NOT_SUPPORT;
+    }
+
+    memset(disp, 0, sizeof(*disp));
+    disp->vdev = vdev;
+    for (i = 0; i < fb_cnt; i++)
+        disp->fb[i] = fb[i];
+    disp->fb_cnt = fb_cnt;
+    disp->width = width;
+    disp->height = height;
+    disp->img_width = img_width;
+    disp->img_height = img_height;
+    disp->out_format = out_format;
+    disp->layer = layer;
+    disp->front = 0;
+    disp->pending = -1;
+    disp->decode = -1;
+    return UVC_RET_OK;
+}
+
+
+/**
+ *  @brief  Move the pipeline forward. Call it from the main loop as often as possible.
+ *          It never waits for the JPEG engine.
+ *  @param[in] disp       Display pipeline.
+ *  @return   1 if a decode was started, otherwise 0.
+ */
+int  uvc_disp_poll(UVC_DISP_T *disp)
+{
+    UVC_FRAME_T  *frame;
+    int   fb;
+
+    if (disp->decode >= 0)
+    {
+        if (!jpegIsReady())
+            return 0;
+        disp_decode_done(disp);
+    }
+
+    fb = disp_claim_fb(disp);
+    if (fb < 0)
+        return 0;                           /* wait for vsync to free a display buffer    */
+
+    frame = disp_latest_frame(disp);
+    if (frame == NULL)
+    {
+        disp->decode = -1;
+        return 0;
+    }
+
+    disp_decode_start(disp, frame, fb);
+    return 1;
+}
+
+
+/**
+ *  @brief  Stop the pipeline: wait for the image being decoded and drop the image not flipped yet.
+ *          The JPEG engine and display buffers can then be used by the application until the next
+ *          uvc_disp_poll(). A decode that does not end within UVC_DISP_STOP_TIMEOUT is counted as
+ *          a decode error and the JPEG engine is reset.
+ *  @param[in] disp       Display pipeline.
+ *  @return   None.
+ */
+void  uvc_disp_stop(UVC_DISP_T *disp)
+{
+    uint32_t  t0;
+    int   flags;
+
+    if (disp->decode >= 0)
+    {
+        t0 = get_ticks();
+        while (!jpegIsReady() && (get_ticks() - t0 < UVC_DISP_STOP_TIMEOUT))
+            ;
+        if (!jpegIsReady())
+        {
+            jpegInit();                     /* engine stuck, reset it */
+            disp->stat.decode_err++;
+        }
+        else if (jpegWait() != E_SUCCESS)
+        {
+            disp->stat.decode_err++;
+        }
+        usbh_uvc_release_frame(disp->vdev, disp->frame);
+        disp->frame = NULL;
+        disp->decode = -1;
+    }
+
+    flags = disp_lock();
+    disp->pending = -1;
+    disp_unlock(flags);
+}
+
+
+/**
+ *  @brief  Flip the latest decoded image onto the panel. Call it from the LCD interrupt
+ *          handler on the display frame interrupt (VPOSTB_DISP_F_INT).
+ *  @param[in] disp       Display pipeline.
+ *  @return   None.
+ */
+void  uvc_disp_vsync(UVC_DISP_T *disp)
+{
+    uint32_t  lat;
+
+    if (disp->pending < 0)
+        return;
+
+    if (disp->layer == UVC_DISP_LAYER_OSD)
+        vpostSetOSDBuffer(disp->fb[disp->pending]);
+    else
+        vpostSetFrameBuffer(disp->fb[disp->pending]);
+
+    disp->front = disp->pending;
+    disp->pending = -1;
+
+    lat = get_ticks() - disp->pending_ticks;
+    if ((disp->stat.shown == 0) || (lat < disp->stat.lat_min))
+        disp->stat.lat_min = lat;
+    if (lat > disp->stat.lat_max)
+        disp->stat.lat_max = lat;
+    disp->lat_sum += lat;
+    disp->stat.shown++;
+}
+
+
+/**
+ *  @brief  Get the pipeline counters.
+ *  @param[in]  disp      Display pipeline.
+ *  @param[out] stat      Counters. Frame rate is the change of \a shown over a period of time.
+ *  @return   None.
+ */
+void  uvc_disp_get_stat(UVC_DISP_T *disp, UVC_DISP_STAT_T *stat)
+{
+    int   flags;
+
+    flags = disp_lock();
+    memcpy(stat, (void *)&disp->stat, sizeof(*stat));
+    stat->lat_avg = (stat->shown > 0) ? (disp->lat_sum / stat->shown) : 0;
+    disp_unlock(flags);
+}
+
+
+/*@}*/ /* end of group N9H31_USBH_EXPORTED_FUNCTIONS */
+
+/*@}*/ /* end of group N9H31_USBH_Library */
+
+/*@}*/ /* end of group N9H31_Library */
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -0,0 +1,441 @@
+/*
+ * cdc_rx_ring_model - host model of the queued CDC bulk-in receiving of
+ * cdc_core.c: the UTR slots, the receive ring and the flow control of
+ * usbh_cdc_start_rx_queue(), usbh_cdc_read() and usbh_cdc_stop_rx_queue().
+ *
+ * cdc_core.c runs on a host controller stand-in that keeps the bulk-in UTR
+ * submitted to it, and a device that completes it with the next bytes of a
+ * counting stream: a full transfer, a short one or a zero length packet,
+ * chosen at random. Completions are delivered as the EHCI interrupt, so
+ * they are held off where the driver locks. A reader takes random amounts
+ * out of the ring at a random rate. After every step the model checks that
+ *
+ *   - at most one transfer is on the bus, and one is whenever a slot is free
+ *     and receiving has not failed,
+ *   - a slot holds data only if the ring has no room for all of it, and
+ *     none is on the bus once all slots hold data,
+ *   - the ring is throttled whenever a slot holds data, fc_func is called
+ *     with 1 from the interrupt and with 0 from usbh_cdc_read(), in turn,
+ *   - the reader gets the stream in order, nothing lost or repeated.
+ *
+ * The runs are a reader keeping up, which must never throttle, and a slow
+ * reader, which must. Then a STALL: usbh_cdc_read() must clear the halt and
+ * resume, and after CDC_QUEUE_RETRY_MAX recoveries in a row return
+ * USBH_ERR_TRANSFER once the ring is empty. Last, stopping with a transfer
+ * on the bus, and with one the host controller does not return, which must
+ * keep the buffers until a later stop frees them.
+ *
+ *   cdc_rx_ring_model.sh [-v]
+ */
+
+#include "host.h"
+#include "usbh_lib.h"
+#include "usbh_cdc.h"
+
+#define EP_IN           0x81
+#define MPS             512
+#define DEPTH           4
+#define XFER_SIZE       1024
+#define RING_SIZE       3000
+#define STEPS           200000
+
+static UDEV_T     udev;
+static IFACE_T    iface;
+static EP_INFO_T  ep_in;
+static CDC_DEV_T  cdev;
+static uint8_t    ring[RING_SIZE];
+
+static UTR_T      *bus_utr;         /* bulk in transfer on the bus */
+static int        bus_hold_quit;    /* quit_xfer() does not return the transfer */
+static int        dev_stall;        /* the device answers STALL */
+static uint8_t    dev_seq;          /* next byte of the device's stream */
+static uint8_t    rd_seq;           /* next byte the reader expects */
+static uint32_t   rd_bytes;
+static int        in_irq;
+static int        fc_state, fc_on, fc_off;
+static int        halt_clears, quits;
+static uint32_t   paused;           /* steps with all slots holding data */
+static int        bad;
+
+/* host controller stand-in */
+
+static int  hc_bulk_xfer(UTR_T *utr)
+{
+    if (bus_utr != NULL)
+    {
+        printf("FAIL: a bulk in transfer submitted with one on the bus\n");
+        bad++;
+    }
+    bus_utr = utr;
+    return 0;
+}
+
+static int  hc_ctrl_xfer(UTR_T *utr)
+{
+    if ((utr->setup.bRequest == USB_REQ_CLEAR_FEATURE) && (utr->setup.wIndex == EP_IN))
+        halt_clears++;
+    utr->status = 0;
+    utr->xfer_len = 0;
+    utr->bIsTransferDone = 1;
+    return 0;
+}
+
+static int  hc_quit_xfer(UTR_T *utr, EP_INFO_T *ep)
+{
+    quits++;
+    if ((bus_utr == NULL) || bus_hold_quit)
+        return 0;
+    if ((utr != bus_utr) && (ep != bus_utr->ep))
+        return 0;
+
+    utr = bus_utr;
+    bus_utr = NULL;
+    utr->status = USBH_ERR_ABORT;
+    utr->xfer_len = 0;
+    utr->bIsTransferDone = 1;
+    utr->func(utr);
+    return 0;
+}
+
+static HC_DRV_T  hc_driver =
+{
+    NULL, NULL, NULL, NULL,
+    hc_ctrl_xfer, hc_bulk_xfer, NULL, NULL, hc_quit_xfer,
+    NULL, NULL, NULL
+};
+
+/* the device completes the transfer on the bus */
+static void  device_irq(void)
+{
+    UTR_T  *utr = bus_utr;
+    int    i, len;
+
+    if (utr == NULL)
+        return;                             /* nothing asked, the device is not heard */
+    bus_utr = NULL;
+    if (dev_stall)
+    {
+        utr->status = USBH_ERR_STALL;
+        utr->xfer_len = 0;
+    }
+    else
+    {
+        switch (rand() % 4)
+        {
+        case 0:
+            len = rand() % utr->data_len;   /* short packet */
+            break;
+        case 1:
+            len = (rand() % 8 == 0) ? 0 : utr->data_len;
+            break;
+        default:
+            len = utr->data_len;
+            break;
+        }
+        for (i = 0; i < len; i++)
+            utr->buff[i] = dev_seq++;
+        utr->status = 0;
+        utr->xfer_len = len;
+    }
+    utr->bIsTransferDone = 1;
+
+    in_irq = 1;
+    utr->func(utr);
+    in_irq = 0;
+}
+
+static void  fc_func(CDC_DEV_T *c, int throttle)
+{
+    if ((throttle != !fc_state) || (in_irq != throttle))
+    {
+        printf("FAIL: fc_func(%d) %s interrupt, throttled %d\n", throttle, in_irq ? "in" : "out of", fc_state);
+        bad++;
+    }
+    fc_state = throttle;
+    if (throttle)
+        fc_on++;
+    else
+        fc_off++;
+}
+
+static int  read_some(int max)
+{
+    uint8_t  buff[RING_SIZE];
+    int      i, n;
+
+    n = usbh_cdc_read(&cdev, buff, max);
+    for (i = 0; i < n; i++)
+    {
+        if (buff[i] != rd_seq)
+        {
+            printf("FAIL: read 0x%02x at byte %d, 0x%02x expected\n", buff[i], rd_bytes + i, rd_seq);
+            bad++;
+            rd_seq = buff[i];
+        }
+        rd_seq++;
+    }
+    if (n > 0)
+        rd_bytes += n;
+    return n;
+}
+
+static int  check_state(void)
+{
+    CDC_QUEUE_T  *q = &cdev.rxq;
+    int  room;
+
+    if ((bus_utr == NULL) && q->running && !q->failed && (q->cnt < q->depth))
+    {
+        printf("FAIL: %d of %d slots hold data and no transfer is on the bus\n", q->cnt, q->depth);
+        return -1;
+    }
+    if ((bus_utr != NULL) && (q->cnt == q->depth))
+    {
+        printf("FAIL: a transfer on the bus with all slots holding data\n");
+        return -1;
+    }
+    room = (cdev.rx_ring_tail - cdev.rx_ring_head - 1 + cdev.rx_ring_size) % cdev.rx_ring_size;
+    if ((q->cnt > 0) && ((int)q->utr[q->head]->xfer_len <= room))
+    {
+        printf("FAIL: a slot of %d bytes held with %d bytes of room in the ring\n", q->utr[q->head]->xfer_len, room);
+        return -1;
+    }
+    if ((q->cnt > 0) != cdev.rx_throttled || (cdev.rx_throttled != fc_state))
+    {
+        printf("FAIL: %d slots hold data, throttled %d, fc_func %d\n", q->cnt, cdev.rx_throttled, fc_state);
+        return -1;
+    }
+    if (q->cnt == q->depth)
+        paused++;
+    return 0;
+}
+
+static int  start(void)
+{
+    int  ret;
+
+    dev_seq = rd_seq = 0;
+    rd_bytes = 0;
+    fc_state = fc_on = fc_off = 0;
+    paused = 0;
+    memset(&cdev.qstat, 0, sizeof(cdev.qstat));
+    ret = usbh_cdc_start_rx_queue(&cdev, DEPTH, XFER_SIZE, ring, RING_SIZE, fc_func);
+    if (ret != 0)
+    {
+        printf("FAIL: usbh_cdc_start_rx_queue() %d\n", ret);
+        bad++;
+    }
+    return ret;
+}
+
+static void  stop(void)
+{
+    int  ret = usbh_cdc_stop_rx_queue(&cdev);
+
+    if ((ret != 0) || (cdev.rx_ring != NULL) || (cdev.rxq.depth != 0))
+    {
+        printf("FAIL: usbh_cdc_stop_rx_queue() %d\n", ret);
+        bad++;
+    }
+}
+
+/*
+ *  <read_pct> percent of the steps read up to <read_max> bytes, the others complete a
+ *  transfer. With <read_pct> 0 every completion is read out at once.
+ */
+static void  run(const char *title, int read_pct, int read_max, int expect_throttle)
+{
+    int  step;
+
+    if (start() != 0)
+        return;
+
+    for (step = 0; step < STEPS; step++)
+    {
+        if (read_pct == 0)
+        {
+            host_irq(EHCI_IRQn, device_irq);
+            read_some(read_max);
+        }
+        else if ((rand() % 100 < read_pct) || (bus_utr == NULL))
+            read_some(1 + rand() % read_max);
+        else
+            host_irq(EHCI_IRQn, device_irq);
+
+        if (check_state() != 0)
+        {
+            bad++;
+            break;
+        }
+    }
+    while (read_some(RING_SIZE) > 0)
+        ;
+
+    printf("%s\n    %d transfers, %d bytes read of %d received, throttled %d times, paused %d of %d steps\n",
+           title, cdev.qstat.rx_xfers, rd_bytes, cdev.qstat.rx_bytes, cdev.qstat.rx_throttle, paused, STEPS);
+    if (cdev.qstat.rx_throttle != fc_on)
+    {
+        printf("FAIL: %d throttles counted, fc_func(1) called %d times\n", cdev.qstat.rx_throttle, fc_on);
+        bad++;
+    }
+    if (expect_throttle ? (fc_on == 0 || paused == 0) : (fc_on != 0))
+    {
+        printf("FAIL: the reader should %sthrottle\n", expect_throttle ? "" : "not ");
+        bad++;
+    }
+    stop();
+    printf("\n");
+}
+
+static void  run_stall(void)
+{
+    int  i, n, ret, clears;
+
+    printf("STALL in the middle of the stream\n");
+    if (start() != 0)
+        return;
+
+    for (i = 0; i < 20; i++)
+    {
+        host_irq(EHCI_IRQn, device_irq);
+        read_some(RING_SIZE);
+    }
+    dev_stall = 1;
+    host_irq(EHCI_IRQn, device_irq);
+    dev_stall = 0;
+    if ((bus_utr != NULL) || !cdev.rxq.failed)
+    {
+        printf("FAIL: receiving goes on after a STALL\n");
+        bad++;
+    }
+
+    /* the read clears the halt and posts again, with DATA0 */
+    ep_in.bToggle = 1;
+    clears = halt_clears;
+    while (read_some(RING_SIZE) > 0)
+        ;
+    if ((halt_clears != clears + 1) || (ep_in.bToggle != 0) || (bus_utr == NULL))
+    {
+        printf("FAIL: the halt is not cleared and receiving not resumed\n");
+        bad++;
+    }
+    for (i = 0; i < 20; i++)
+    {
+        host_irq(EHCI_IRQn, device_irq);
+        read_some(RING_SIZE);
+    }
+    printf("    recovered, %d bytes read of %d received\n", rd_bytes, cdev.qstat.rx_bytes);
+    if (rd_bytes != cdev.qstat.rx_bytes)
+        bad++;
+
+    /* a device that keeps stalling */
+    dev_stall = 1;
+    clears = halt_clears;
+    for (i = 0; i <= CDC_QUEUE_RETRY_MAX; i++)
+    {
+        host_irq(EHCI_IRQn, device_irq);
+        n = read_some(RING_SIZE);
+    }
+    ret = n;
+    printf("    %d halt clears on a stalling device, then usbh_cdc_read() %d\n", halt_clears - clears, ret);
+    if ((halt_clears - clears != CDC_QUEUE_RETRY_MAX) || (ret != USBH_ERR_TRANSFER))
+    {
+        printf("FAIL: %d recoveries expected, then USBH_ERR_TRANSFER\n", CDC_QUEUE_RETRY_MAX);
+        bad++;
+    }
+    dev_stall = 0;
+    stop();
+    printf("\n");
+}
+
+static void  run_stop(void)
+{
+    USB_MEM_STAT_T  stat;
+    uint32_t  used;
+    int  ret;
+
+    printf("stop with a transfer on the bus\n");
+    USB_memory_stat(&stat);
+    used = stat.allocated;
+
+    if (start() != 0)
+        return;
+    host_irq(EHCI_IRQn, device_irq);
+    stop();
+    USB_memory_stat(&stat);
+    if ((bus_utr != NULL) || (stat.allocated != used))
+    {
+        printf("FAIL: %d bytes of USB memory left after stop\n", stat.allocated - used);
+        bad++;
+    }
+
+    /* the host controller keeps the transfer: buffers are kept until a later stop */
+    if (start() != 0)
+        return;
+    bus_hold_quit = 1;
+    ret = usbh_cdc_stop_rx_queue(&cdev);
+    printf("    transfer not returned: usbh_cdc_stop_rx_queue() %d", ret);
+    if ((ret != USBH_ERR_TIMEOUT) || (cdev.rxq.depth == 0) || cdev.rxq.running)
+    {
+        printf("\nFAIL: USBH_ERR_TIMEOUT expected with the buffers kept and receiving stopped\n");
+        bad++;
+    }
+    host_irq(EHCI_IRQn, device_irq);        /* returned late, must not post again */
+    if (bus_utr != NULL)
+    {
+        printf("\nFAIL: a stopped queue posted again\n");
+        bad++;
+    }
+    bus_hold_quit = 0;
+    ret = usbh_cdc_stop_rx_queue(&cdev);
+    USB_memory_stat(&stat);
+    printf(", then %d\n\n", ret);
+    if ((ret != 0) || (stat.allocated != used))
+    {
+        printf("FAIL: %d bytes of USB memory left after the second stop\n", stat.allocated - used);
+        bad++;
+    }
+}
+
+static void  check_params(void)
+{
+    if ((usbh_cdc_start_rx_queue(&cdev, 1, XFER_SIZE, ring, RING_SIZE, NULL) != USBH_ERR_INVALID_PARAM) ||
+        (usbh_cdc_start_rx_queue(&cdev, DEPTH, XFER_SIZE, ring, XFER_SIZE, NULL) != USBH_ERR_INVALID_PARAM) ||
+        (usbh_cdc_start_rx_queue(&cdev, CDC_QUEUE_DEPTH_MAX + 1, 0, ring, RING_SIZE, NULL) != USBH_ERR_INVALID_PARAM))
+    {
+        printf("FAIL: bad parameters accepted\n");
+        bad++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+        host_verbose = 1;
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    usbh_memory_init();
+    ENABLE_EHCI_IRQ();
+    srand(1);
+
+    udev.speed = SPEED_HIGH;
+    udev.dev_num = 1;
+    udev.hc_driver = &hc_driver;
+    iface.udev = &udev;
+    ep_in.bEndpointAddress = EP_IN;
+    ep_in.bmAttributes = EP_ATTR_TT_BULK;
+    ep_in.wMaxPacketSize = MPS;
+    cdev.udev = &udev;
+    cdev.iface_data = &iface;
+    cdev.ep_rx = &ep_in;
+
+    check_params();
+    run("reader keeping up", 0, RING_SIZE, 0);
+    run("slow reader", 20, 700, 1);
+    run_stall();
+    run_stop();
+
+    if (!bad)
+        printf("stream intact, ring and flow control consistent\n");
+    return bad ? 1 : 0;
+}
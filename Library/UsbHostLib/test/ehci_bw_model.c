@@ -0,0 +1,454 @@
+/*
+ * ehci_bw_model - host model of the EHCI periodic bandwidth accounting of
+ * ehci_bw_alloc() and ehci_bw_free().
+ *
+ * The model keeps its own table of bus time per micro-frame and per TT frame
+ * over the PERIODIC_FRAMES frames of the driver, filled from the placements
+ * ehci_bw_alloc() returns. For every endpoint it checks that
+ *
+ *   - the bus time is within 1 us of the USB 2.0 5.11.3 formulas,
+ *   - the period, phase, S-mask and C-mask are legal for the speed and
+ *     type: a high speed endpoint in every micro-frame of its interval, an
+ *     interrupt split with its complete-splits in micro-frames 2 ~ 7 after
+ *     the start-split, an isochronous OUT split in micro-frames 0 ~ 6, an
+ *     isochronous IN split with all of its complete-splits in the frame,
+ *   - no micro-frame goes over UFRAME_BW_MAX_US and no TT frame over
+ *     TT_FRAME_BW_MAX_US,
+ *   - no other legal phase and start micro-frame had a lower TT frame peak,
+ *     or the same and a lower micro-frame peak, which is the balancing,
+ *   - an endpoint is refused only when no legal placement fits, and
+ *     bw_check() of the driver agrees with ehci_bw_alloc() and reserves
+ *     nothing.
+ *
+ * The scenarios are a hub with a camera, an audio device and HID devices,
+ * eight HID devices of the same interval and sixteen high speed interrupt
+ * endpoints next to an isochronous one, and high speed and TT isochronous
+ * endpoints until the budget is used up. Everything is then freed and the
+ * hub scenario run again, which must place the endpoints exactly as before.
+ *
+ *   ehci_bw_model.sh [-v]
+ */
+
+#include "host.h"
+
+#define MAX_EPS         64
+
+typedef struct model_ep_t
+{
+    const char  *name;
+    SPEED_E     speed;
+    uint8_t     type;           /* EP_ATTR_TT_INT or EP_ATTR_TT_ISO */
+    uint8_t     addr;
+    uint16_t    mps;            /* with the high bandwidth bits 12:11 */
+    uint8_t     interval;
+} MODEL_EP_T;
+
+static int  uf[PERIODIC_FRAMES][8];
+static int  tt[PERIODIC_FRAMES];
+
+static UDEV_T     udev;
+static EP_INFO_T  ep_info[MAX_EPS];
+static EHCI_BW_T  bw[MAX_EPS];
+static int        n_eps;
+static const MODEL_EP_T  *last_m;   /* endpoint placed last, and its bus time */
+static EHCI_BW_T  last_cost;
+static int        bad;
+
+/* bus time in ns of USB 2.0 5.11.3, host delay 5 ns high speed, 1000 ns full/low speed */
+static double  bit_stuff(int bytes)
+{
+    return 3.167 + (int)(7 * 8 * bytes / 6);
+}
+
+static int  spec_us(const MODEL_EP_T *m)
+{
+    int     is_iso = (m->type == EP_ATTR_TT_ISO);
+    int     is_in = (m->addr & EP_ADDR_DIR_IN) != 0;
+    int     maxpkt = m->mps & 0x7FF, mult = ((m->mps >> 11) & 0x3) + 1;
+    double  ns;
+
+    if (m->speed == SPEED_HIGH)
+    {
+        ns = (is_iso ? 38 : 55) * 8 * 2.083 + 2.083 * (int)bit_stuff(maxpkt) + 5;
+        return mult * (int)((ns + 999) / 1000);
+    }
+    if (m->speed == SPEED_FULL)
+        ns = (is_iso ? (is_in ? 7268 : 6265) : 9107) + 83.54 * (int)bit_stuff(maxpkt) + 1000;
+    else
+        ns = (is_in ? 64060 : 64107) + 2 * 333 + 676.67 * (int)bit_stuff(maxpkt) + 1000;
+    return (int)((ns + 999) / 1000);
+}
+
+/* legal S-mask and C-mask of start micro-frame <n>, 0 if <n> is not a start */
+static int  legal_masks(const MODEL_EP_T *m, int uf_interval, int n, int *smask, int *cmask)
+{
+    int  scnt = ((m->mps & 0x7FF) + 187) / 188, u;
+
+    if (scnt == 0)
+        scnt = 1;
+    *smask = *cmask = 0;
+
+    if (m->speed == SPEED_HIGH)
+    {
+        if (n >= ((uf_interval < 8) ? uf_interval : 8))
+            return 0;
+        for (u = n; u < 8; u += uf_interval)
+            *smask |= 1 << u;
+        return 1;
+    }
+    if (m->type == EP_ATTR_TT_INT)
+    {
+        if (n + 5 > 7)                  /* complete-splits in n+2 ~ n+5 */
+            return 0;
+        *smask = 1 << n;
+        *cmask = 0xF << (n + 2);
+        return 1;
+    }
+    if (!(m->addr & EP_ADDR_DIR_IN))
+    {
+        if (n + scnt - 1 > 6)           /* start-splits in n ~ n+scnt-1 */
+            return 0;
+        *smask = ((1 << scnt) - 1) << n;
+        return 1;
+    }
+    /* IN: complete-splits from n+2 over scnt+2 micro-frames, cut at 7 when it starts at 0 */
+    if ((n > 0) && (n + scnt + 3 > 7))
+        return 0;
+    *smask = 1 << n;
+    for (u = n + 2; (u <= n + scnt + 3) && (u < 8); u++)
+        *cmask |= 1 << u;
+    return 1;
+}
+
+static void  model_peaks(const EHCI_BW_T *b, int period, int phase, int smask, int cmask, int *peak, int *tt_peak)
+{
+    int  f, u, load;
+
+    *peak = *tt_peak = 0;
+    for (f = phase; f < PERIODIC_FRAMES; f += period)
+    {
+        for (u = 0; u < 8; u++)
+        {
+            if (!(((smask | cmask) >> u) & 1))
+                continue;
+            load = uf[f][u] + ((smask >> u) & 1) * b->hs_us + ((cmask >> u) & 1) * b->cs_us;
+            if (load > *peak)
+                *peak = load;
+        }
+        if (tt[f] + b->tt_us > *tt_peak)
+            *tt_peak = tt[f] + b->tt_us;
+    }
+}
+
+static void  model_apply(const EHCI_BW_T *b, int sign)
+{
+    int  f, u;
+
+    for (f = b->phase; f < PERIODIC_FRAMES; f += b->period)
+    {
+        for (u = 0; u < 8; u++)
+            uf[f][u] += sign * (((b->smask >> u) & 1) * b->hs_us + ((b->cmask >> u) & 1) * b->cs_us);
+        tt[f] += sign * b->tt_us;
+    }
+}
+
+static int  model_uf_interval(const MODEL_EP_T *m)
+{
+    int  bi = (m->interval < 1) ? 1 : ((m->interval > 16) ? 16 : m->interval);
+    int  frames;
+
+    if (m->speed == SPEED_HIGH)
+        return 1 << (bi - 1);
+    if (m->type == EP_ATTR_TT_ISO)
+        return 8 << (bi - 1);
+    for (frames = 1; frames * 2 <= bi; frames *= 2)
+        ;
+    return frames * 8;
+}
+
+/* best (TT peak, micro-frame peak) of the legal placements, -1 if none fits */
+static int  model_best(const MODEL_EP_T *m, const EHCI_BW_T *cost)
+{
+    int  uf_interval = model_uf_interval(m);
+    int  period = uf_interval / 8, phase, n, smask, cmask, peak, tt_peak, score, best = -1;
+
+    if (period == 0)
+        period = 1;
+    if (period > PERIODIC_FRAMES)
+        period = PERIODIC_FRAMES;
+
+    for (phase = 0; phase < period; phase++)
+    {
+        for (n = 0; n < 8; n++)
+        {
+            if (!legal_masks(m, uf_interval, n, &smask, &cmask))
+                continue;
+            model_peaks(cost, period, phase, smask, cmask, &peak, &tt_peak);
+            if ((peak > UFRAME_BW_MAX_US) || (tt_peak > TT_FRAME_BW_MAX_US))
+                continue;
+            score = (tt_peak << 8) | peak;
+            if ((best < 0) || (score < best))
+                best = score;
+        }
+    }
+    return best;
+}
+
+static int  check_placement(const MODEL_EP_T *m, const EHCI_BW_T *b)
+{
+    int  uf_interval = model_uf_interval(m);
+    int  period = uf_interval / 8, n, smask, cmask, peak, tt_peak;
+
+    if (period == 0)
+        period = 1;
+    if (period > PERIODIC_FRAMES)
+        period = PERIODIC_FRAMES;
+
+    if ((b->uf_interval != uf_interval) || (b->period != period) || (b->phase >= period))
+    {
+        printf("FAIL: %s: interval %d uframes, period %d, phase %d\n", m->name, b->uf_interval, b->period, b->phase);
+        return -1;
+    }
+    for (n = 0; n < 8; n++)
+    {
+        if (legal_masks(m, uf_interval, n, &smask, &cmask) && (smask == b->smask) && (cmask == b->cmask))
+            break;
+    }
+    if (n == 8)
+    {
+        printf("FAIL: %s: S-mask 0x%02x, C-mask 0x%02x not legal\n", m->name, b->smask, b->cmask);
+        return -1;
+    }
+
+    model_peaks(b, b->period, b->phase, b->smask, b->cmask, &peak, &tt_peak);
+    if ((peak > UFRAME_BW_MAX_US) || (tt_peak > TT_FRAME_BW_MAX_US))
+    {
+        printf("FAIL: %s: over budget, %d us in a micro-frame, %d us in a TT frame\n", m->name, peak, tt_peak);
+        return -1;
+    }
+    if (((tt_peak << 8) | peak) != model_best(m, b))
+    {
+        printf("FAIL: %s: peaks %d/%d us, a legal placement has less\n", m->name, tt_peak, peak);
+        return -1;
+    }
+    return 0;
+}
+
+/* returns 0 if placed, 1 if refused, -1 on a model mismatch */
+static int  model_alloc(const MODEL_EP_T *m)
+{
+    EP_INFO_T  *ep = &ep_info[n_eps];
+    EHCI_BW_T  *b = &bw[n_eps];
+    int        ret, chk, n;
+
+    udev.speed = m->speed;
+    memset(ep, 0, sizeof(*ep));
+    ep->bEndpointAddress = m->addr;
+    ep->bmAttributes = m->type;
+    ep->wMaxPacketSize = m->mps;
+    ep->bInterval = m->interval;
+
+    chk = ehci_driver.bw_check(&udev, ep);
+    ret = ehci_bw_alloc(&udev, ep, b);
+    if ((chk != 0) != (ret != 0))
+    {
+        printf("FAIL: %s: bw_check() %d, ehci_bw_alloc() %d\n", m->name, chk, ret);
+        return -1;
+    }
+
+    if (ret != 0)
+    {
+        /* the cost of a refused endpoint is the one of the same endpoint placed before it */
+        if ((last_m != m) || (model_best(m, &last_cost) >= 0))
+        {
+            printf("FAIL: %s refused (%d) with room left\n", m->name, ret);
+            return -1;
+        }
+        return 1;
+    }
+
+    n = (m->speed == SPEED_HIGH) ? b->hs_us : b->tt_us;
+    if (abs(n - spec_us(m)) > 1)
+    {
+        printf("FAIL: %s: %d us of bus time, USB 2.0 5.11.3 gives %d us\n", m->name, n, spec_us(m));
+        return -1;
+    }
+    if (check_placement(m, b) != 0)
+        return -1;
+
+    model_apply(b, 1);
+    last_m = m;
+    last_cost = *b;
+    if (host_verbose)
+        printf("    %-22s period %2d phase %2d S-mask 0x%02x C-mask 0x%02x  %3d/%3d/%3d us\n", m->name,
+               b->period, b->phase, b->smask, b->cmask, b->hs_us, b->cs_us, b->tt_us);
+    n_eps++;
+    return 0;
+}
+
+static void  free_all(void)
+{
+    while (n_eps > 0)
+    {
+        n_eps--;
+        model_apply(&bw[n_eps], -1);
+        ehci_bw_free(&bw[n_eps]);
+        if (bw[n_eps].period != 0)
+        {
+            printf("FAIL: ehci_bw_free() left the reservation marked\n");
+            bad++;
+        }
+    }
+}
+
+static void  peaks(int *peak, int *tt_peak)
+{
+    int  f, u;
+
+    *peak = *tt_peak = 0;
+    for (f = 0; f < PERIODIC_FRAMES; f++)
+    {
+        for (u = 0; u < 8; u++)
+            if (uf[f][u] > *peak)
+                *peak = uf[f][u];
+        if (tt[f] > *tt_peak)
+            *tt_peak = tt[f];
+    }
+}
+
+static const MODEL_EP_T  hub_mix[] =
+{
+    { "hub status",          SPEED_HIGH, EP_ATTR_TT_INT, 0x81, 1,                  12 },
+    { "camera video in",     SPEED_HIGH, EP_ATTR_TT_ISO, 0x81, (2 << 11) | 1024,  1 },
+    { "camera status",       SPEED_HIGH, EP_ATTR_TT_INT, 0x82, 16,                 8 },
+    { "audio out",           SPEED_FULL, EP_ATTR_TT_ISO, 0x01, 196,                1 },
+    { "audio in",            SPEED_FULL, EP_ATTR_TT_ISO, 0x82, 196,                1 },
+    { "audio HID",           SPEED_FULL, EP_ATTR_TT_INT, 0x83, 16,                 10 },
+    { "keyboard",            SPEED_LOW,  EP_ATTR_TT_INT, 0x81, 8,                  10 },
+    { "mouse",               SPEED_LOW,  EP_ATTR_TT_INT, 0x81, 4,                  10 },
+    { "game pad",            SPEED_FULL, EP_ATTR_TT_INT, 0x81, 64,                 4 },
+};
+
+static void  run_list(const char *title, const MODEL_EP_T *list, int count, EHCI_BW_T *out)
+{
+    int  i, peak, tt_peak;
+
+    printf("%s\n", title);
+    for (i = 0; i < count; i++)
+    {
+        if (model_alloc(&list[i]) != 0)
+        {
+            printf("FAIL: %s not placed\n", list[i].name);
+            bad++;
+            return;
+        }
+        if (out != NULL)
+            out[i] = bw[n_eps - 1];
+    }
+    peaks(&peak, &tt_peak);
+    printf("    %d endpoints, peak %d us in a micro-frame, %d us in a TT frame\n\n", count, peak, tt_peak);
+}
+
+static void  run_balance(void)
+{
+    MODEL_EP_T  hid = { "HID", SPEED_FULL, EP_ATTR_TT_INT, 0x81, 8, 8 };
+    MODEL_EP_T  hs = { "HS interrupt", SPEED_HIGH, EP_ATTR_TT_INT, 0x81, 64, 4 };
+    MODEL_EP_T  iso = { "HS iso", SPEED_HIGH, EP_ATTR_TT_ISO, 0x81, 1024, 4 };
+    uint32_t  phases = 0;
+    int  per_uf[8] = { 0 };
+    int  i, u, most = 0, peak, tt_peak;
+
+    printf("balance: a high speed isochronous endpoint of 1 ms, then 8 full speed HID devices of 8 ms\n"
+           "         and 16 high speed interrupt endpoints of 1 ms\n");
+    if (model_alloc(&iso) != 0)
+        bad++;
+    for (i = 0; i < 8; i++)
+    {
+        if (model_alloc(&hid) != 0)
+            bad++;
+        else
+            phases |= 1 << bw[n_eps - 1].phase;
+    }
+    for (i = 0; i < 16; i++)
+    {
+        if (model_alloc(&hs) != 0)
+        {
+            bad++;
+            continue;
+        }
+        for (u = 0; u < 8; u++)
+        {
+            if ((bw[n_eps - 1].smask >> u) & 1)
+                per_uf[u]++;
+            if (per_uf[u] > most)
+                most = per_uf[u];
+        }
+    }
+    peaks(&peak, &tt_peak);
+    printf("    HID in %d of 8 frame phases, at most %d HS endpoints in a micro-frame, peak %d us in a micro-frame, %d us in a TT frame\n\n",
+           __builtin_popcount(phases), most, peak, tt_peak);
+    if (phases != 0xFF)
+    {
+        printf("FAIL: the HID devices share frames\n");
+        bad++;
+    }
+    if (most > 3)                       /* 16 over the 7 micro-frames without the isochronous one */
+    {
+        printf("FAIL: the high speed endpoints pile up in a micro-frame\n");
+        bad++;
+    }
+    free_all();
+}
+
+static void  run_until_full(const char *title, const MODEL_EP_T *m)
+{
+    int  placed = 0, ret = 0, peak, tt_peak;
+
+    while ((n_eps < MAX_EPS) && ((ret = model_alloc(m)) == 0))
+        placed++;
+    peaks(&peak, &tt_peak);
+    printf("%s: %d placed, then refused, peak %d us in a micro-frame, %d us in a TT frame\n",
+           title, placed, peak, tt_peak);
+    if ((ret != 1) || (placed == 0))
+        bad++;
+    free_all();
+}
+
+int main(int argc, char *argv[])
+{
+    static EHCI_BW_T  first[sizeof(hub_mix) / sizeof(hub_mix[0])], again[sizeof(hub_mix) / sizeof(hub_mix[0])];
+    MODEL_EP_T  hs_iso = { "HS iso in 1024", SPEED_HIGH, EP_ATTR_TT_ISO, 0x81, 1024, 1 };
+    MODEL_EP_T  fs_iso = { "FS iso out 256", SPEED_FULL, EP_ATTR_TT_ISO, 0x01, 256, 1 };
+    MODEL_EP_T  fs_in = { "FS iso in 188", SPEED_FULL, EP_ATTR_TT_ISO, 0x81, 188, 1 };
+    int  count = sizeof(hub_mix) / sizeof(hub_mix[0]), peak, tt_peak;
+
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+        host_verbose = 1;
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    usbh_memory_init();
+
+    run_list("hub with a camera, an audio device and HID devices:", hub_mix, count, first);
+    free_all();
+    run_balance();
+    run_until_full("high speed 1024 byte isochronous IN", &hs_iso);
+    run_until_full("full speed 256 byte isochronous OUT", &fs_iso);
+    run_until_full("full speed 188 byte isochronous IN", &fs_in);
+
+    /* everything given back: the same endpoints land where they did */
+    free_all();
+    peaks(&peak, &tt_peak);
+    if (peak || tt_peak)
+        bad++;
+    run_list("\nhub scenario again after freeing everything:", hub_mix, count, again);
+    if (memcmp(first, again, sizeof(first)) != 0)
+    {
+        printf("FAIL: placements differ after ehci_bw_free()\n");
+        bad++;
+    }
+    free_all();
+
+    if (!bad)
+        printf("every placement legal, within budget and least loaded\n");
+    return bad ? 1 : 0;
+}
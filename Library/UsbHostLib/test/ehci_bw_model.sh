@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# Build the EHCI driver against the host stand-ins and run ehci_bw_model:
+# the placements of ehci_bw_alloc() checked against a model of the periodic
+# bandwidth table for legal masks, budget and balance, and ehci_bw_free().
+#
+#   test/ehci_bw_model.sh [-v]
+#
+# Descriptors and UTRs hold addresses in uint32_t, so the model is linked
+# without PIE. test/host.h is force-included into every library source.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/ehci_bw_model.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -Iinc -Itest"
+
+# the library keeps addresses in uint32_t, the rest is left as is from the
+# core sources on a 64-bit host
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Wno-overflow \
+      -Wno-parentheses -Wno-array-bounds -Wno-maybe-uninitialized -Wno-unused-variable"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host.h $INC -o "$OUT/model" \
+    test/ehci_bw_model.c test/host.c \
+    src_core/ehci.c src_core/ehci_iso.c src_core/ohci.c src_core/hub.c \
+    src_core/usb_core.c src_core/mem_alloc.c src_core/support.c || exit 1
+
+"$OUT/model" "$@"
@@ -0,0 +1,456 @@
+/*
+ * ehci_iso_reclaim - host test of the isochronous transfer reclamation of
+ * ehci_iso.c: the frame-indexed scan of scan_isochronous_list(), batched
+ * submission by usbh_iso_xfer_batch() and ehci_quit_iso_xfer().
+ *
+ * A periodic schedule model advances UFINDR every micro-frame and services
+ * the iTDs and siTDs linked ahead of the interrupt QHs of the current frame:
+ * an active iTD transaction of the micro-frame, an active siTD at the end of
+ * its frame. IN data is a packet sequence number per device written where
+ * the descriptor points. USBINT is raised for IOC and stays pending while
+ * the EHCI interrupt is disabled. Frames can be dropped, left unserviced.
+ *
+ * The streams are IN endpoints of NUM_UTR UTRs, each resubmitted from its
+ * call-back. For every stream the test checks that
+ *
+ *   - every UTR is called back, a full speed stream alone included,
+ *   - a resubmitted UTR starts where the previous one ended,
+ *   - packets arrive in order with the right length, and exactly the ones
+ *     of dropped frames are reported USBH_ERR_NOT_ACCESS0,
+ *   - a scan visits only the descriptors of the frames passed since the
+ *     last one, plus at most one still active per stream in the current
+ *     frame, also after the interrupt has been held off for HOLDOFF_MS,
+ *   - after the streams are stopped and quit, no iTD or siTD is left in the
+ *     periodic frame list and the descriptor pool is whole again.
+ *
+ * Last, a batch is quit right after submission: every UTR must be called
+ * back with USBH_ERR_ABORT.
+ *
+ *   ehci_iso_reclaim.sh [-v]
+ */
+
+#include "host.h"
+#include "hub.h"
+#include "ehci_model.h"
+
+#define NUM_UTR         3
+#define MPS_MAX         512
+#define HOLDOFF_MS      16
+#define DROP_FRAMES     4
+
+extern void EHCI_IRQHandler(void);
+extern uint32_t *_PFList;
+
+typedef struct stream_t
+{
+    const char  *name;
+    UDEV_T      *udev;
+    EP_INFO_T   ep;
+    UTR_T       utr[NUM_UTR];
+    uint8_t     buff[NUM_UTR][IF_PER_UTR][MPS_MAX];
+    int         resubmit;
+    uint16_t    next_sf;        /* frame the next resubmitted UTR should start on */
+    uint8_t     seq;            /* sequence number of the next packet */
+    uint32_t    done, packets, missed, bad;
+} STREAM_T;
+
+static HUB_DEV_T  hub;
+static IFACE_T    hub_iface;
+static UDEV_T     hub_udev, hs_udev, fs_udev;
+
+static STREAM_T   hs_in, fs_in;
+
+static uint8_t    model_seq[128];   /* next sequence number of each device */
+static uint32_t   model_frames;     /* frames run */
+static uint32_t   drop_from, drop_to;
+static int        irq_ran;
+static int        bad;
+
+static void  model_irq(void)
+{
+    irq_ran = 1;
+    EHCI_IRQHandler();
+}
+
+static void  model_deliver(int dev, uint8_t *buff, int len)
+{
+    memset(buff, 0, len);
+    buff[0] = model_seq[dev]++;
+}
+
+/* service the iTDs and siTDs of micro-frame <uf> of frame <frnidx> */
+static void  model_periodic(uint32_t frnidx, int uf)
+{
+    uint32_t  link = _PFList[frnidx];
+    uint32_t  t;
+    iTD_T     *itd;
+    siTD_T    *sitd;
+    int       pg, len;
+
+    while (!HLINK_IS_TERMINATED(link) && !HLINK_IS_QH(link))
+    {
+        if (HLINK_IS_SITD(link))
+        {
+            sitd = SITD_PTR(link);
+            if ((uf == 7) && (sitd->StsCtrl & SITD_STATUS_ACTIVE))
+            {
+                len = (sitd->StsCtrl & SITD_XFER_CNT_Msk) >> SITD_XFER_CNT_Pos;
+                model_deliver(sitd->Chrst & 0x7F, (uint8_t *)sitd->Bptr[0], len);
+                sitd->StsCtrl = 0;          /* all bytes moved */
+                if (sitd->Sched & SITD_IOC)
+                    _ehci->USTSR |= HSUSBH_USTSR_USBINT_Msk;
+            }
+            link = sitd->Next_Link;
+        }
+        else
+        {
+            itd = ITD_PTR(link);
+            t = itd->Transaction[uf];
+            if (t & ITD_STATUS_ACTIVE)
+            {
+                pg = (t >> ITD_PG_Pos) & 0x7;
+                model_deliver(ITD_DEV_ADDR(itd), (uint8_t *)((itd->Bptr[pg] & 0xFFFFF000) + (t & ITD_XFER_OFF_Msk)),
+                              ITD_XFER_LEN(t));
+                itd->Transaction[uf] = t & ~ITD_STATUS_ACTIVE;
+                if (t & ITD_IOC)
+                    _ehci->USTSR |= HSUSBH_USTSR_USBINT_Msk;
+            }
+            link = itd->Next_Link;
+        }
+    }
+}
+
+static void  model_uframe(void)
+{
+    uint32_t  pending;
+    int       uf;
+
+    _ehci->UFINDR = (_ehci->UFINDR + 1) & HSUSBH_UFINDR_FI_Msk;
+    uf = _ehci->UFINDR & 0x7;
+    if (uf == 0)
+        model_frames++;
+
+    if ((_ehci->UCMDR & HSUSBH_UCMDR_PSEN_Msk) && !((model_frames >= drop_from) && (model_frames < drop_to)))
+        model_periodic((_ehci->UFINDR >> 3) & 0x3FF, uf);
+
+    /* pending until the handler runs */
+    pending = _ehci->USTSR & _ehci->UIENR & HSUSBH_USTSR_USBINT_Msk;
+    if (pending)
+    {
+        irq_ran = 0;
+        host_irq(EHCI_IRQn, model_irq);
+        if (irq_ran)
+            _ehci->USTSR &= ~pending;
+    }
+}
+
+static void  stream_done(UTR_T *utr)
+{
+    STREAM_T  *s = (STREAM_T *)utr->context;
+    int  i;
+
+    s->done++;
+    if (utr->status == USBH_ERR_ABORT)
+        return;
+
+    for (i = 0; i < IF_PER_UTR; i++)
+    {
+        if (utr->iso_status[i] == USBH_ERR_NOT_ACCESS0)
+        {
+            s->missed++;
+            continue;
+        }
+        if ((utr->iso_status[i] != 0) || (utr->iso_xlen[i] != s->ep.wMaxPacketSize) ||
+            (utr->iso_buff[i][0] != s->seq))
+        {
+            if (s->bad++ == 0)
+                printf("FAIL: %s: packet %d of frame %d, status %d, %d bytes, sequence %d, %d expected\n",
+                       s->name, i, utr->iso_sf, utr->iso_status[i], utr->iso_xlen[i], utr->iso_buff[i][0], s->seq);
+        }
+        s->seq = utr->iso_buff[i][0] + 1;
+        s->packets++;
+    }
+
+    if (!s->resubmit)
+        return;
+
+    utr->status = 0;
+    utr->bIsTransferDone = 0;
+    for (i = 0; i < IF_PER_UTR; i++)
+        utr->iso_xlen[i] = s->ep.wMaxPacketSize;
+    if (usbh_iso_xfer(utr) != 0)
+    {
+        printf("FAIL: %s: resubmit failed\n", s->name);
+        s->bad++;
+        return;
+    }
+    if (utr->iso_sf != s->next_sf)
+    {
+        if (s->bad++ == 0)
+            printf("FAIL: %s: resubmitted on frame %d, the queue ends on %d\n", s->name, utr->iso_sf, s->next_sf);
+    }
+    s->next_sf = (utr->iso_sf + IF_PER_UTR) % FL_SIZE;
+}
+
+static void  stream_init(STREAM_T *s, const char *name, UDEV_T *udev, int mps)
+{
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    s->udev = udev;
+    s->ep.bEndpointAddress = EP_ADDR_DIR_IN | 1;
+    s->ep.bmAttributes = EP_ATTR_TT_ISO;
+    s->ep.wMaxPacketSize = mps;
+    s->ep.bInterval = (udev->speed == SPEED_HIGH) ? 4 : 1;    /* a packet per frame */
+    model_seq[udev->dev_num] = 0;
+}
+
+static int  stream_submit(STREAM_T *s, int resubmit)
+{
+    UTR_T  *list[NUM_UTR];
+    int    i, k, ret;
+
+    s->resubmit = resubmit;
+    for (i = 0; i < NUM_UTR; i++)
+    {
+        memset(&s->utr[i], 0, sizeof(s->utr[i]));
+        s->utr[i].udev = s->udev;
+        s->utr[i].ep = &s->ep;
+        s->utr[i].context = s;
+        s->utr[i].func = stream_done;
+        for (k = 0; k < IF_PER_UTR; k++)
+        {
+            s->utr[i].iso_buff[k] = s->buff[i][k];
+            s->utr[i].iso_xlen[k] = s->ep.wMaxPacketSize;
+        }
+        list[i] = &s->utr[i];
+    }
+    ret = usbh_iso_xfer_batch(list, NUM_UTR);
+
+    for (i = 1; i < NUM_UTR; i++)
+    {
+        if (s->utr[i].iso_sf != (s->utr[i - 1].iso_sf + IF_PER_UTR) % FL_SIZE)
+        {
+            printf("FAIL: %s: batch UTR %d on frame %d after frame %d\n", s->name, i,
+                   s->utr[i].iso_sf, s->utr[i - 1].iso_sf);
+            bad++;
+        }
+    }
+    s->next_sf = (s->utr[NUM_UTR - 1].iso_sf + IF_PER_UTR) % FL_SIZE;
+    return ret;
+}
+
+/* no iTD or siTD left linked, and all of them free */
+static int  check_clean(void)
+{
+    static void  *td[MEM_POOL_UNIT_NUM];
+    uint32_t  link;
+    int  f, n, fail = 0;
+
+    for (f = 0; f < FL_SIZE; f++)
+    {
+        link = _PFList[f];
+        if (!HLINK_IS_TERMINATED(link) && !HLINK_IS_QH(link))
+        {
+            printf("FAIL: frame %d still has a %s linked\n", f, HLINK_IS_SITD(link) ? "siTD" : "iTD");
+            fail++;
+            break;
+        }
+    }
+
+    for (n = 0; (n < MEM_POOL_UNIT_NUM) && ((td[n] = alloc_ehci_iTD()) != NULL); n++)
+        ;
+    if (n != MEM_POOL_ITD_NUM + MEM_POOL_SHARED_NUM)
+    {
+        printf("FAIL: %d iTDs free, %d expected\n", n, MEM_POOL_ITD_NUM + MEM_POOL_SHARED_NUM);
+        fail++;
+    }
+    while (n > 0)
+        free_ehci_iTD(td[--n]);
+
+    for (n = 0; (n < MEM_POOL_UNIT_NUM) && ((td[n] = alloc_ehci_siTD()) != NULL); n++)
+        ;
+    if (n != MEM_POOL_SITD_NUM + MEM_POOL_SHARED_NUM)
+    {
+        printf("FAIL: %d siTDs free, %d expected\n", n, MEM_POOL_SITD_NUM + MEM_POOL_SHARED_NUM);
+        fail++;
+    }
+    while (n > 0)
+        free_ehci_siTD(td[--n]);
+
+    if (_ehci->UCMDR & HSUSBH_UCMDR_PSEN_Msk)
+    {
+        printf("FAIL: periodic schedule left enabled\n");
+        fail++;
+    }
+    return fail;
+}
+
+static void  stream_stop(STREAM_T *s)
+{
+    int  i;
+
+    s->resubmit = 0;
+    delay_us((NUM_UTR * IF_PER_UTR + 4) * 1000);
+    for (i = 0; i < NUM_UTR; i++)
+    {
+        if (!s->utr[i].bIsTransferDone)
+        {
+            printf("FAIL: %s: UTR %d not called back after the queue ran out\n", s->name, i);
+            s->bad++;
+        }
+    }
+    usbh_quit_xfer(s->udev, &s->ep);
+}
+
+static int  stream_check(STREAM_T *s, int ms, int missed)
+{
+    printf("    %-16s %4d UTRs called back, %5d packets, %d missed\n", s->name, s->done, s->packets, s->missed);
+    if (s->done < ms / IF_PER_UTR - NUM_UTR)
+    {
+        printf("FAIL: %s: %d UTRs called back in %d ms\n", s->name, s->done, ms);
+        s->bad++;
+    }
+    if (s->missed != missed)
+    {
+        printf("FAIL: %s: %d packets missed, %d frames dropped\n", s->name, s->missed, missed);
+        s->bad++;
+    }
+    return s->bad ? -1 : 0;
+}
+
+static int  check_visits(int streams)
+{
+    USBH_IRQ_STAT_T  st;
+
+    usbh_get_irq_stat(&st, 1);
+    printf("    %d interrupts, %d TDs reclaimed, %d visited\n", st.irq_cnt, st.iso_reclaimed, st.iso_visited);
+    if (st.iso_visited > st.iso_reclaimed + st.irq_cnt * streams)
+    {
+        printf("FAIL: the scans visited %d TDs not done, at most %d in the current frames\n",
+               st.iso_visited - st.iso_reclaimed, st.irq_cnt * streams);
+        return -1;
+    }
+    return 0;
+}
+
+/* a full speed stream alone, its siTDs must raise the interrupts */
+static void  run_split_alone(void)
+{
+    USBH_IRQ_STAT_T  st;
+    int  ms = 400;
+
+    printf("full speed isochronous IN through a TT, %d ms\n", ms);
+    stream_init(&fs_in, "FS iso in", &fs_udev, 192);
+    usbh_get_irq_stat(&st, 1);
+    if (stream_submit(&fs_in, 1) != 0)
+        bad++;
+    delay_us(ms * 1000);
+    stream_stop(&fs_in);
+    if (check_visits(1) != 0)
+        bad++;
+    if (stream_check(&fs_in, ms, 0) != 0)
+        bad++;
+    bad += check_clean();
+    printf("\n");
+}
+
+/* high speed and split streams in the same frames, the interrupt held off and frames dropped */
+static void  run_mixed(void)
+{
+    int  ms = 1000;
+
+    printf("high speed and full speed isochronous IN, %d ms, interrupt held off %d ms, %d frames dropped\n",
+           ms, HOLDOFF_MS, DROP_FRAMES);
+    stream_init(&hs_in, "HS iso in", &hs_udev, MPS_MAX);
+    stream_init(&fs_in, "FS iso in", &fs_udev, 192);
+    if ((stream_submit(&hs_in, 1) != 0) || (stream_submit(&fs_in, 1) != 0))
+        bad++;
+
+    delay_us(300 * 1000);
+    DISABLE_EHCI_IRQ();
+    delay_us(HOLDOFF_MS * 1000);
+    ENABLE_EHCI_IRQ();
+
+    drop_from = model_frames + 300;
+    drop_to = drop_from + DROP_FRAMES;
+    delay_us((ms - 300 - HOLDOFF_MS) * 1000);
+
+    stream_stop(&hs_in);
+    stream_stop(&fs_in);
+    if (check_visits(2) != 0)
+        bad++;
+    if (stream_check(&hs_in, ms, DROP_FRAMES) != 0)
+        bad++;
+    if (stream_check(&fs_in, ms, DROP_FRAMES) != 0)
+        bad++;
+    bad += check_clean();
+    printf("\n");
+}
+
+/* quit a batch before any of it has been run */
+static void  run_quit(void)
+{
+    int  i;
+
+    printf("quit a batch right after submission\n");
+    stream_init(&hs_in, "HS iso in", &hs_udev, MPS_MAX);
+    stream_init(&fs_in, "FS iso in", &fs_udev, 192);
+    if ((stream_submit(&hs_in, 0) != 0) || (stream_submit(&fs_in, 0) != 0))
+        bad++;
+    usbh_quit_xfer(&hs_udev, &hs_in.ep);
+    usbh_quit_xfer(&fs_udev, &fs_in.ep);
+
+    for (i = 0; i < NUM_UTR; i++)
+    {
+        if ((hs_in.utr[i].status != USBH_ERR_ABORT) || (fs_in.utr[i].status != USBH_ERR_ABORT))
+        {
+            printf("FAIL: UTR %d status %d/%d after quit\n", i, hs_in.utr[i].status, fs_in.utr[i].status);
+            bad++;
+        }
+    }
+    printf("    %d and %d UTRs called back\n", hs_in.done, fs_in.done);
+    if ((hs_in.done != NUM_UTR) || (fs_in.done != NUM_UTR))
+        bad++;
+    bad += check_clean();
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+        host_verbose = 1;
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    usbh_memory_init();
+    if (ehci_model_init(NULL) != 0)
+    {
+        printf("FAIL: ehci_driver.init()\n");
+        return 1;
+    }
+    host_uframe_func = model_uframe;        /* the periodic schedule only */
+
+    /* a full speed device behind a high speed hub, and a high speed device */
+    hub_udev.speed = SPEED_HIGH;
+    hub_udev.dev_num = 1;
+    hub_udev.hc_driver = &ehci_driver;
+    hub_iface.udev = &hub_udev;
+    hub.iface = &hub_iface;
+
+    hs_udev.speed = SPEED_HIGH;
+    hs_udev.dev_num = 2;
+    hs_udev.hc_driver = &ehci_driver;
+
+    fs_udev.speed = SPEED_FULL;
+    fs_udev.dev_num = 3;
+    fs_udev.port_num = 2;
+    fs_udev.parent = &hub;
+    fs_udev.hc_driver = &ehci_driver;
+
+    run_split_alone();
+    run_mixed();
+    run_quit();
+
+    if (!bad)
+        printf("every UTR called back in order, scans visit the passed frames only\n");
+    return bad ? 1 : 0;
+}
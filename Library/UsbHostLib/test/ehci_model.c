@@ -0,0 +1,194 @@
+/*
+ * ehci_model.c - EHCI asynchronous schedule model, see ehci_model.h.
+ */
+
+#include "host.h"
+#include "ehci_model.h"
+
+#define XACT_OVERHEAD       48      /* token, handshake and inter-packet gaps, in byte times */
+#define UFRAME_BYTES        (13 * (512 + XACT_OVERHEAD))
+
+extern void EHCI_IRQHandler(void);
+
+EHCI_MODEL_STAT_T  ehci_model_stat;
+
+static HSUSBH_T         model_regs;
+static EHCI_MODEL_XACT  *model_xact;
+static int              model_uframe_bytes = UFRAME_BYTES;
+static QH_T             *model_next_qh;     /* where the next micro-frame continues */
+
+void ehci_model_set_uframe_bytes(int bytes)
+{
+    model_uframe_bytes = bytes;
+}
+
+static void qtd_write_back(QH_T *qh)
+{
+    qTD_T  *qtd = QTD_PTR(qh->Curr_qTD);
+
+    qtd->Token = qh->OL_Token;
+    qtd->Bptr[0] = qh->OL_Bptr[0];
+}
+
+/*
+ *  Visit a QH: fetch the next qTD into an inactive overlay, then run one transaction.
+ *  Returns the bus time used, 0 if the QH has nothing to do.
+ */
+static int qh_visit(QH_T *qh)
+{
+    qTD_T     *qtd;
+    uint32_t  next, token;
+    uint8_t   *buff;
+    int       maxp, len, ret, ep, pid, page, offset;
+
+    if (qh->Chrst & QH_RCLM_LIST_HEAD)
+        return 0;
+    if (qh->OL_Token & QTD_STS_HALT)
+        return 0;
+
+    if (!(qh->OL_Token & QTD_STS_ACTIVE))
+    {
+        /* 4.10.2 advance queue */
+        if ((QTD_TODO_LEN(qh->OL_Token) != 0) && !(qh->OL_Alt_Next_qTD & QTD_LIST_END))
+            next = qh->OL_Alt_Next_qTD;
+        else
+            next = qh->OL_Next_qTD;
+        if (next & QTD_LIST_END)
+            return 0;
+        qtd = QTD_PTR(next);
+        if (!(qtd->Token & QTD_STS_ACTIVE))
+            return 0;
+
+        /* 4.10.3 overlay, the toggle stays in the QH unless DTC is set */
+        token = qtd->Token & ~QTD_DT;
+        if (qh->Chrst & QH_DTC)
+            token |= qtd->Token & QTD_DT;
+        else
+            token |= qh->OL_Token & QTD_DT;
+        qh->Curr_qTD = (uint32_t)qtd;
+        qh->OL_Next_qTD = qtd->Next_qTD;
+        qh->OL_Alt_Next_qTD = qtd->Alt_Next_qTD;
+        qh->OL_Token = token;
+        memcpy(qh->OL_Bptr, qtd->Bptr, sizeof(qh->OL_Bptr));
+    }
+
+    /* 4.10.4 one transaction */
+    token = qh->OL_Token;
+    maxp = (qh->Chrst >> 16) & 0x7FF;
+    pid = (token & QTD_PID_Msk) >> 8;
+    ep = (qh->Chrst >> 8) & 0xF;
+    if (pid == EHCI_MODEL_PID_IN)
+        ep |= 0x80;
+    len = QTD_TODO_LEN(token);
+    if (len > maxp)
+        len = maxp;
+    page = (token >> 12) & 0x7;
+    offset = qh->OL_Bptr[0] & 0xFFF;
+    buff = (uint8_t *)(uintptr_t)((qh->OL_Bptr[page] & ~0xFFF) | offset);
+    if ((offset + len > 0x1000) && (page < 4) && (qh->OL_Bptr[page + 1] != (qh->OL_Bptr[page] & ~0xFFF) + 0x1000))
+    {
+        printf("FAIL: qTD 0x%x buffer pages are not contiguous\n", qh->Curr_qTD);
+        exit(1);
+    }
+
+    ret = model_xact(ep, pid, buff, len, (token & QTD_DT) ? 1 : 0);
+    if (ret == EHCI_MODEL_NAK)
+    {
+        ehci_model_stat.naks++;
+        return -XACT_OVERHEAD;      /* bus time, but no progress */
+    }
+    if (ret == EHCI_MODEL_STALL)
+    {
+        ehci_model_stat.stalls++;
+        qh->OL_Token = (token & ~QTD_STS_ACTIVE) | QTD_STS_HALT;
+        qtd_write_back(qh);
+        model_regs.USTSR |= HSUSBH_USTSR_UERRINT_Msk;
+        return XACT_OVERHEAD;
+    }
+
+    ehci_model_stat.packets++;
+    ehci_model_stat.bytes += ret;
+    offset += ret;
+    page += offset >> 12;
+    qh->OL_Bptr[0] = (qh->OL_Bptr[0] & ~0xFFF) | (offset & 0xFFF);
+    token = (token & ~(0x7FFF << 16) & ~(0x7 << 12)) | ((QTD_TODO_LEN(token) - ret) << 16) | (page << 12);
+    token ^= QTD_DT;
+
+    if ((QTD_TODO_LEN(token) == 0) || (ret < maxp))
+    {
+        /* done, or a short packet */
+        token &= ~QTD_STS_ACTIVE;
+        if ((token & QTD_IOC) || (QTD_TODO_LEN(token) != 0))
+            model_regs.USTSR |= HSUSBH_USTSR_USBINT_Msk;
+        qh->OL_Token = token;
+        qtd_write_back(qh);
+    }
+    else
+    {
+        qh->OL_Token = token;
+    }
+    return ret + XACT_OVERHEAD;
+}
+
+static void model_uframe(void)
+{
+    QH_T      *head, *qh;
+    uint32_t  pending;
+    int       budget, used, moved;
+
+    if (model_regs.UCMDR & HSUSBH_UCMDR_HCRST_Msk)
+        model_regs.UCMDR &= ~HSUSBH_UCMDR_HCRST_Msk;    /* reset done */
+
+    if ((model_regs.UCMDR & HSUSBH_UCMDR_RUN_Msk) && (model_regs.UCMDR & HSUSBH_UCMDR_ASEN_Msk))
+    {
+        head = QH_PTR(model_regs.UCALAR);
+        qh = (model_next_qh != NULL) ? model_next_qh : head;
+        budget = model_uframe_bytes;
+        moved = 1;
+        while (budget > 0)
+        {
+            if (qh == head)
+            {
+                if (!moved)
+                    break;          /* a whole round without progress */
+                moved = 0;
+            }
+            used = qh_visit(qh);
+            if (used > 0)
+                moved = 1;
+            budget -= (used < 0) ? -used : used;
+            qh = QH_PTR(qh->HLink);
+        }
+        model_next_qh = qh;
+    }
+
+    /* the IAA doorbell is answered at the end of the micro-frame */
+    if (model_regs.UCMDR & HSUSBH_UCMDR_IAAD_Msk)
+    {
+        model_regs.UCMDR &= ~HSUSBH_UCMDR_IAAD_Msk;
+        model_regs.USTSR |= HSUSBH_USTSR_IAA_Msk;
+        model_next_qh = NULL;       /* a removed QH may be freed now */
+    }
+
+    pending = model_regs.USTSR & model_regs.UIENR &
+              (HSUSBH_USTSR_USBINT_Msk | HSUSBH_USTSR_UERRINT_Msk | HSUSBH_USTSR_IAA_Msk);
+    if (pending)
+    {
+        ehci_model_stat.irqs++;
+        host_irq(EHCI_IRQn, EHCI_IRQHandler);
+        model_regs.USTSR &= ~pending;   /* write-1-to-clear by the handler */
+    }
+}
+
+int ehci_model_init(EHCI_MODEL_XACT *xact)
+{
+    int  ret;
+
+    model_xact = xact;
+    memset(&model_regs, 0, sizeof(model_regs));
+    _ehci = &model_regs;
+    host_uframe_func = model_uframe;
+    ret = ehci_driver.init();
+    ENABLE_EHCI_IRQ();
+    return ret;
+}
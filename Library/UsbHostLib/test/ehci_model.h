@@ -0,0 +1,52 @@
+/*
+ * ehci_model.h - EHCI asynchronous schedule model for the UsbHostLib host
+ * harnesses.
+ *
+ * Every micro-frame the model walks the asynchronous list from UCALAR the
+ * way the EHCI spec. (4.10) describes it: an inactive overlay advances to
+ * the Alternate Next qTD after a short packet or to the Next qTD otherwise,
+ * an active qTD is copied into the overlay and run one max-packet
+ * transaction per QH visit, and the QHs are visited round-robin until the
+ * micro-frame bus time is used up or no QH moves. Completed and halted qTDs
+ * are written back with USBINT/USBERRINT, IAAD is answered with IAA at the
+ * end of the micro-frame, and EHCI_IRQHandler() is called for them.
+ *
+ * Transactions go to one device, the harness' xact function.
+ */
+
+#ifndef EHCI_MODEL_H
+#define EHCI_MODEL_H
+
+#define EHCI_MODEL_NAK          (-1)
+#define EHCI_MODEL_STALL        (-2)
+
+#define EHCI_MODEL_PID_OUT      0
+#define EHCI_MODEL_PID_IN       1
+#define EHCI_MODEL_PID_SETUP    2
+
+/*
+ *  A transaction to endpoint <ep> of the device, bit 7 set for IN. OUT and
+ *  SETUP carry <len> bytes, IN may return up to <len>. <toggle> is the data
+ *  PID the host sends or expects. Returns the bytes moved, EHCI_MODEL_NAK
+ *  or EHCI_MODEL_STALL.
+ */
+typedef int (EHCI_MODEL_XACT)(int ep, int pid, uint8_t *buff, int len, int toggle);
+
+typedef struct ehci_model_stat_t
+{
+    uint32_t  packets;          /* data transactions */
+    uint32_t  bytes;
+    uint32_t  naks;
+    uint32_t  stalls;
+    uint32_t  irqs;
+} EHCI_MODEL_STAT_T;
+
+extern EHCI_MODEL_STAT_T  ehci_model_stat;
+
+/* set up the registers and run ehci_driver.init(), the USB memory pools must be initialized */
+int  ehci_model_init(EHCI_MODEL_XACT *xact);
+
+/* HS bulk bytes a micro-frame holds, 13 packets of 512 by default */
+void ehci_model_set_uframe_bytes(int bytes);
+
+#endif
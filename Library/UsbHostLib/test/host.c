@@ -0,0 +1,106 @@
+/*
+ * host.c - target stand-ins shared by the UsbHostLib host harnesses.
+ */
+
+#include <stdarg.h>
+
+#include "host.h"
+
+HOST_CACHE_STAT_T  host_cache_stat;
+uint32_t  host_time_us;
+void      (*host_uframe_func)(void);
+int       host_verbose;
+
+static UINT32  host_aic_imr;
+static int     host_in_irq;
+
+UINT32 host_reg_read(UINT32 u32Addr)
+{
+    if (u32Addr == REG_AIC_IMR)
+        return host_aic_imr;
+    return 0;
+}
+
+void host_reg_write(UINT32 u32Addr, UINT32 u32Value)
+{
+}
+
+INT32 sysEnableInterrupt(IRQn_Type eIntNo)
+{
+    host_aic_imr |= 1 << eIntNo;
+    return 0;
+}
+
+INT32 sysDisableInterrupt(IRQn_Type eIntNo)
+{
+    host_aic_imr &= ~(1 << eIntNo);
+    return 0;
+}
+
+/* the handler runs if the interrupt is enabled and no handler is running */
+void host_irq(IRQn_Type eIntNo, void (*handler)(void))
+{
+    if (!(host_aic_imr & (1 << eIntNo)) || host_in_irq)
+        return;
+    host_in_irq = 1;
+    handler();
+    host_in_irq = 0;
+}
+
+static void host_run_uframes(int n)
+{
+    while (n-- > 0)
+    {
+        host_time_us += HOST_UFRAME_US;
+        if ((host_uframe_func != NULL) && !host_in_irq)
+            host_uframe_func();
+    }
+}
+
+uint32_t get_ticks(void)
+{
+    host_run_uframes(1);
+    return host_time_us / 10000;
+}
+
+void delay_us(int usec)
+{
+    host_run_uframes((usec + HOST_UFRAME_US - 1) / HOST_UFRAME_US);
+}
+
+PVOID sysInstallISR(INT32 nIntTypeLevel, IRQn_Type eIntNo, PVOID pvNewISR)
+{
+    return NULL;
+}
+
+INT32 sysSetLocalInterrupt(INT32 nIntState)
+{
+    return 0;
+}
+
+void sysFlushCache(INT32 nCacheType)
+{
+}
+
+void sysCleanDcache(UINT32 buffer, UINT32 size)
+{
+    host_cache_stat.u32CleanBytes += size;
+    host_cache_stat.u32CleanCalls++;
+}
+
+void sysInvalidateDcache(UINT32 buffer, UINT32 size)
+{
+    host_cache_stat.u32InvalBytes += size;
+    host_cache_stat.u32InvalCalls++;
+}
+
+void sysprintf(PINT8 pcStr, ...)
+{
+    va_list  ap;
+
+    if (!host_verbose)
+        return;
+    va_start(ap, pcStr);
+    vprintf(pcStr, ap);
+    va_end(ap);
+}
@@ -0,0 +1,53 @@
+/*
+ * host.h - target stand-ins shared by the UsbHostLib host harnesses.
+ *
+ * The harness scripts force-include it (gcc -include) into every library
+ * source. Descriptors and UTRs hold addresses in uint32_t, so the harnesses
+ * are linked without PIE and all memory the host controller sees is static:
+ * the descriptor pool, the USB_malloc() pool and the harness buffers.
+ * NON_CACHE_MASK is 0, the host has a single view of memory.
+ *
+ * Time is simulated. get_ticks() and delay_us() advance it by 125 us
+ * micro-frames and run the host controller model, host_uframe_func, for
+ * each. The model raises interrupts through host_irq(), so the library sees
+ * them only where it polls or waits, like a single-threaded target.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "usb.h"
+
+#undef  NON_CACHE_MASK
+#define NON_CACHE_MASK      0
+
+#undef inpw
+#undef outpw
+#define inpw(port)          host_reg_read((UINT32)(port))
+#define outpw(port,value)   host_reg_write((UINT32)(port), (UINT32)(value))
+
+#define HOST_UFRAME_US      125
+
+typedef struct host_cache_stat_t
+{
+    UINT32  u32CleanBytes;      /* bytes passed to sysCleanDcache() */
+    UINT32  u32InvalBytes;      /* bytes passed to sysInvalidateDcache() */
+    UINT32  u32CleanCalls;
+    UINT32  u32InvalCalls;
+} HOST_CACHE_STAT_T;
+
+extern HOST_CACHE_STAT_T  host_cache_stat;
+extern uint32_t  host_time_us;              /* simulated time */
+extern void      (*host_uframe_func)(void); /* the host controller model, run every micro-frame */
+extern int       host_verbose;              /* sysprintf() output on */
+
+UINT32 host_reg_read(UINT32 u32Addr);
+void host_reg_write(UINT32 u32Addr, UINT32 u32Value);
+void host_irq(IRQn_Type eIntNo, void (*handler)(void));
+
+#endif
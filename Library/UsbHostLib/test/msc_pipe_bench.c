@@ -0,0 +1,428 @@
+/*
+ * msc_pipe_bench - host benchmark of the pipelined READ_10/WRITE_10 of the
+ * MSC driver against a simulated EHCI.
+ *
+ * msc_xfer.c and the EHCI driver run on the asynchronous schedule model of
+ * ehci_model.c with a Bulk-Only mass storage device behind it. The device
+ * NAKs the data of a READ_10 for the media access time after its CBW, and
+ * the CSW of a WRITE_10 for the programming time after its data. 4 MB are
+ * read and written once with one READ_10/WRITE_10 at a time through
+ * run_scsi_command(), as the driver did before, and once through
+ * run_scsi_rw_pipelined(). Reported is the throughput in simulated time.
+ *
+ *   msc_pipe_bench.sh
+ *
+ * The data must be right, the device must see no data toggle error, and the
+ * pipelined transfer must be faster by PIPE_MIN_GAIN percent. Then the
+ * error cases: a STALL in the data stage of a read and of a write in the
+ * middle of a pipelined run, a CSW that reports a failed command and one
+ * that reports a phase error. Only the phase error may cost a reset
+ * recovery. Every one must return an error, release its UTRs, and leave the
+ * device ready for the next transfer.
+ */
+
+#include "host.h"
+#include "ehci_model.h"
+#include "msc.h"
+
+#define DISK_SECTORS        8192        /* 4 MB */
+#define RUN_SECTORS         2048        /* per run_scsi_rw_pipelined() call */
+#define READ_ACCESS_US      250
+#define WRITE_PROGRAM_US    400
+#define PIPE_MIN_GAIN       5
+
+#define EP_IN               0x81
+#define EP_OUT              0x02
+
+/* Bulk-only mass storage device model */
+
+enum { BOT_CBW, BOT_DATA_IN, BOT_DATA_OUT, BOT_CSW };
+
+typedef struct bot_dev_t
+{
+    int       state;
+    int       halt_in, halt_out;
+    int       toggle_in, toggle_out;
+    uint32_t  tag, pos, remain, residue;
+    uint8_t   status;
+    uint32_t  ready_us;         /* media busy until */
+    int       cmd_no;           /* CBWs taken */
+    int       stall_cmd;        /* inject: STALL the data stage of this command */
+    int       fail_cmd;         /* inject: report this command failed */
+    int       phase_cmd;        /* inject: report a phase error for this command */
+    uint32_t  resets, clear_halts, toggle_errs, bad_cbws;
+} BOT_DEV_T;
+
+static BOT_DEV_T  dev;
+static uint8_t    disk[DISK_SECTORS * 512];
+
+static int bot_control(int pid, uint8_t *buff, int len)
+{
+    int  ep;
+
+    if (pid != EHCI_MODEL_PID_SETUP)
+        return 0;                       /* no data stage, the status stage */
+
+    if ((buff[0] == (REQ_TYPE_OUT | REQ_TYPE_STD_DEV | REQ_TYPE_TO_EP)) && (buff[1] == USB_REQ_CLEAR_FEATURE))
+    {
+        ep = buff[4];
+        if (ep == EP_IN)
+        {
+            dev.halt_in = 0;
+            dev.toggle_in = 0;
+        }
+        else if (ep == EP_OUT)
+        {
+            dev.halt_out = 0;
+            dev.toggle_out = 0;
+        }
+        dev.clear_halts++;
+    }
+    else if ((buff[0] == (REQ_TYPE_OUT | REQ_TYPE_CLASS_DEV | REQ_TYPE_TO_IFACE)) && (buff[1] == 0xFF))
+    {
+        dev.state = BOT_CBW;            /* halts and toggles stay, the host clears them */
+        dev.resets++;
+    }
+    return len;
+}
+
+static void bot_cbw(uint8_t *buff, int len)
+{
+    struct bulk_cb_wrap  cbw;
+    uint32_t  lba, cnt;
+
+    memcpy(&cbw, buff, MSC_CB_WRAP_LEN);
+    if ((len != MSC_CB_WRAP_LEN) || (cbw.Signature != MSC_CB_SIGN) ||
+            ((cbw.CDB[0] != READ_10) && (cbw.CDB[0] != WRITE_10)))
+    {
+        dev.bad_cbws++;                 /* BOT 6.6.1 */
+        dev.halt_in = 1;
+        dev.halt_out = 1;
+        return;
+    }
+
+    dev.cmd_no++;
+    lba = (cbw.CDB[2] << 24) | (cbw.CDB[3] << 16) | (cbw.CDB[4] << 8) | cbw.CDB[5];
+    cnt = (cbw.CDB[7] << 8) | cbw.CDB[8];
+    dev.tag = cbw.Tag;
+    dev.pos = lba * 512;
+    dev.remain = cnt * 512;
+    dev.residue = 0;
+    dev.status = MSC_STAT_OK;
+    dev.ready_us = host_time_us;
+    if ((lba + cnt > DISK_SECTORS) || (cbw.DataTransferLength != cnt * 512))
+        dev.bad_cbws++;
+
+    if (cbw.CDB[0] == READ_10)
+    {
+        dev.state = BOT_DATA_IN;
+        dev.ready_us = host_time_us + READ_ACCESS_US;
+    }
+    else
+    {
+        dev.state = BOT_DATA_OUT;
+    }
+
+    if (dev.cmd_no == dev.stall_cmd)
+    {
+        if (cbw.CDB[0] == READ_10)
+            dev.halt_in = 1;
+        else
+            dev.halt_out = 1;
+        dev.state = BOT_CSW;
+        dev.status = MSC_STAT_FAIL;
+        dev.residue = dev.remain;
+    }
+    if (dev.cmd_no == dev.fail_cmd)
+        dev.status = MSC_STAT_FAIL;
+    if (dev.cmd_no == dev.phase_cmd)
+        dev.status = MSC_STAT_PHASE;
+}
+
+static int bot_out(uint8_t *buff, int len, int toggle)
+{
+    if (dev.halt_out)
+        return EHCI_MODEL_STALL;
+    if ((dev.state != BOT_CBW) && (dev.state != BOT_DATA_OUT))
+        return EHCI_MODEL_NAK;          /* the next CBW waits for the CSW */
+
+    if (toggle != dev.toggle_out)
+    {
+        dev.toggle_errs++;              /* a retry of the last packet, ACK and drop */
+        return len;
+    }
+    dev.toggle_out ^= 1;
+
+    if (dev.state == BOT_CBW)
+    {
+        bot_cbw(buff, len);
+        return len;
+    }
+
+    memcpy(disk + dev.pos, buff, len);
+    dev.pos += len;
+    dev.remain -= len;
+    if (dev.remain == 0)
+    {
+        dev.state = BOT_CSW;
+        dev.ready_us = host_time_us + WRITE_PROGRAM_US;
+    }
+    return len;
+}
+
+static int bot_in(uint8_t *buff, int len, int toggle)
+{
+    struct bulk_cs_wrap  csw;
+
+    if (dev.halt_in)
+        return EHCI_MODEL_STALL;
+    if (((dev.state != BOT_DATA_IN) && (dev.state != BOT_CSW)) || (host_time_us < dev.ready_us))
+        return EHCI_MODEL_NAK;
+
+    if (toggle != dev.toggle_in)
+        dev.toggle_errs++;
+    dev.toggle_in ^= 1;
+
+    if (dev.state == BOT_DATA_IN)
+    {
+        if (len > dev.remain)
+            len = dev.remain;
+        memcpy(buff, disk + dev.pos, len);
+        dev.pos += len;
+        dev.remain -= len;
+        if (dev.remain == 0)
+            dev.state = BOT_CSW;
+        return len;
+    }
+
+    csw.Signature = MSC_CS_SIGN;
+    csw.Tag = dev.tag;
+    csw.Residue = dev.residue;
+    csw.Status = dev.status;
+    memcpy(buff, &csw, MSC_CS_WRAP_LEN);
+    dev.state = BOT_CBW;
+    return MSC_CS_WRAP_LEN;
+}
+
+static int bot_xact(int ep, int pid, uint8_t *buff, int len, int toggle)
+{
+    if ((ep & 0x7F) == 0)
+        return bot_control(pid, buff, len);
+    if (ep == EP_IN)
+        return bot_in(buff, len, toggle);
+    if (ep == EP_OUT)
+        return bot_out(buff, len, toggle);
+    return EHCI_MODEL_STALL;
+}
+
+/* the host side */
+
+/* msc_driver.c mounts the drives it finds, none here */
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt)
+{
+    return FR_OK;
+}
+
+static UDEV_T     udev;
+static IFACE_T    iface;
+static EP_INFO_T  ep_in, ep_out;
+static MSC_T      msc;
+static uint8_t    buff[RUN_SECTORS * 512] __attribute__((aligned(32)));
+
+/* msc_rw_sectors() without MSC_PIPELINE_XFER: one command at a time */
+static int serial_rw(int bIsRead, uint32_t sec_no, uint32_t sec_cnt, uint8_t *data)
+{
+    struct bulk_cb_wrap  *cmd_blk = &msc.cmd_blk;
+    uint32_t  cnt;
+    int       ret;
+
+    for (; sec_cnt > 0; sec_no += cnt, sec_cnt -= cnt, data += cnt * 512)
+    {
+        cnt = (sec_cnt > MSC_PIPE_MAX_SECTORS) ? MSC_PIPE_MAX_SECTORS : sec_cnt;
+        memset(cmd_blk, 0, sizeof(*cmd_blk));
+        cmd_blk->Flags   = bIsRead ? 0x80 : 0;
+        cmd_blk->Length  = 10;
+        cmd_blk->CDB[0]  = bIsRead ? READ_10 : WRITE_10;
+        cmd_blk->CDB[2]  = (sec_no >> 24) & 0xFF;
+        cmd_blk->CDB[3]  = (sec_no >> 16) & 0xFF;
+        cmd_blk->CDB[4]  = (sec_no >> 8) & 0xFF;
+        cmd_blk->CDB[5]  = sec_no & 0xFF;
+        cmd_blk->CDB[7]  = (cnt >> 8) & 0xFF;
+        cmd_blk->CDB[8]  = cnt & 0xFF;
+        ret = run_scsi_command(&msc, data, cnt * 512, bIsRead, 500);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void fill(uint8_t *p, uint32_t sec_no, uint32_t sec_cnt, uint32_t seed)
+{
+    uint32_t  i;
+
+    for (i = 0; i < sec_cnt * 128; i++)
+        ((uint32_t *)p)[i] = (sec_no * 128 + i) ^ seed;
+}
+
+static int check(uint8_t *p, uint32_t sec_no, uint32_t sec_cnt, uint32_t seed)
+{
+    uint32_t  i;
+
+    for (i = 0; i < sec_cnt * 128; i++)
+    {
+        if (((uint32_t *)p)[i] != ((sec_no * 128 + i) ^ seed))
+            return -1;
+    }
+    return 0;
+}
+
+/* 4 MB in RUN_SECTORS pieces, returns kB/s, 0 on error */
+static uint32_t run(int bPipe, int bIsRead, uint32_t seed)
+{
+    uint32_t  t0, sec;
+    int       ret;
+
+    t0 = host_time_us;
+    for (sec = 0; sec < DISK_SECTORS; sec += RUN_SECTORS)
+    {
+        if (!bIsRead)
+            fill(buff, sec, RUN_SECTORS, seed);
+        if (bPipe)
+            ret = run_scsi_rw_pipelined(&msc, bIsRead, sec, RUN_SECTORS, buff);
+        else
+            ret = serial_rw(bIsRead, sec, RUN_SECTORS, buff);
+        if (ret < 0)
+        {
+            printf("FAIL: %s %s at sector %u: %d\n", bPipe ? "pipelined" : "serial",
+                   bIsRead ? "read" : "write", sec, ret);
+            return 0;
+        }
+        if (check(bIsRead ? buff : disk + sec * 512, sec, RUN_SECTORS, seed) != 0)
+        {
+            printf("FAIL: %s %s at sector %u: data mismatch\n", bPipe ? "pipelined" : "serial",
+                   bIsRead ? "read" : "write", sec);
+            return 0;
+        }
+    }
+    return (uint64_t)DISK_SECTORS * 512 * 1000 / (host_time_us - t0);
+}
+
+/*
+ *  An error case on a pipelined run of 4 commands. The device is set up by the caller.
+ *  Expected: the call fails, <resets> reset recoveries are done, no UTR is left, and the
+ *  next run is right.
+ */
+static int error_case(const char *name, int bIsRead, uint32_t resets)
+{
+    uint32_t  resets0 = dev.resets, clear0 = dev.clear_halts;
+    int       mem0 = USB_allocated_memory();
+    int       ret, bad = 0;
+
+    if (!bIsRead)
+        fill(buff, 0, 4 * MSC_PIPE_MAX_SECTORS, 0x5A5A5A5A);
+    ret = run_scsi_rw_pipelined(&msc, bIsRead, 0, 4 * MSC_PIPE_MAX_SECTORS, buff);
+    dev.stall_cmd = 0;
+    dev.fail_cmd = 0;
+    dev.phase_cmd = 0;
+
+    printf("%-24s returns %5d, %u reset recovery, %u clear halt\n", name, ret,
+           dev.resets - resets0, dev.clear_halts - clear0);
+
+    if (ret >= 0)
+    {
+        printf("FAIL: %s: no error returned\n", name);
+        bad++;
+    }
+    if (dev.resets - resets0 != resets)
+    {
+        printf("FAIL: %s: %u reset recoveries, expected %u\n", name, dev.resets - resets0, resets);
+        bad++;
+    }
+    if (USB_allocated_memory() != mem0)
+    {
+        printf("FAIL: %s: %d bytes of UTRs left\n", name, USB_allocated_memory() - mem0);
+        bad++;
+    }
+
+    fill(disk, 0, 4 * MSC_PIPE_MAX_SECTORS, 0x12345678);
+    if ((run_scsi_rw_pipelined(&msc, 1, 0, 4 * MSC_PIPE_MAX_SECTORS, buff) != 0) ||
+            (check(buff, 0, 4 * MSC_PIPE_MAX_SECTORS, 0x12345678) != 0))
+    {
+        printf("FAIL: %s: the next read fails\n", name);
+        bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t  serial_rd, serial_wr, pipe_rd, pipe_wr;
+    int       bad = 0;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    host_verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+
+    usbh_memory_init();
+    if (ehci_model_init(bot_xact) != 0)
+    {
+        printf("FAIL: ehci_driver.init()\n");
+        return 1;
+    }
+
+    udev.speed = SPEED_HIGH;
+    udev.dev_num = 1;
+    udev.descriptor.bMaxPacketSize0 = 64;
+    udev.hc_driver = &ehci_driver;
+    iface.udev = &udev;
+    ep_in.bEndpointAddress = EP_IN;
+    ep_in.bmAttributes = EP_ATTR_TT_BULK;
+    ep_in.wMaxPacketSize = 512;
+    ep_out.bEndpointAddress = EP_OUT;
+    ep_out.bmAttributes = EP_ATTR_TT_BULK;
+    ep_out.wMaxPacketSize = 512;
+    msc.iface = &iface;
+    msc.ep_bulk_in = &ep_in;
+    msc.ep_bulk_out = &ep_out;
+    msc.uTotalSectorN = DISK_SECTORS;
+
+    printf("4 MB in %d sector READ_10/WRITE_10, media access %d us, programming %d us\n\n",
+           MSC_PIPE_MAX_SECTORS, READ_ACCESS_US, WRITE_PROGRAM_US);
+
+    fill(disk, 0, DISK_SECTORS, 0);
+    serial_rd = run(0, 1, 0);
+    pipe_rd = run(1, 1, 0);
+    serial_wr = run(0, 0, 0x11111111);
+    pipe_wr = run(1, 0, 0x22222222);
+
+    printf("%-10s %10s %10s\n", "", "read MB/s", "write MB/s");
+    printf("%-10s %6u.%03u %6u.%03u\n", "serial", serial_rd / 1000, serial_rd % 1000,
+           serial_wr / 1000, serial_wr % 1000);
+    printf("%-10s %6u.%03u %6u.%03u   depth %d\n\n", "pipelined", pipe_rd / 1000, pipe_rd % 1000,
+           pipe_wr / 1000, pipe_wr % 1000, MSC_PIPE_DEPTH);
+
+    if (!serial_rd || !serial_wr || !pipe_rd || !pipe_wr)
+        bad++;
+    if ((pipe_rd * 100 < serial_rd * (100 + PIPE_MIN_GAIN)) || (pipe_wr * 100 < serial_wr * (100 + PIPE_MIN_GAIN)))
+    {
+        printf("FAIL: pipelined transfer is not %d%% faster\n", PIPE_MIN_GAIN);
+        bad++;
+    }
+
+    dev.stall_cmd = dev.cmd_no + 2;
+    bad += error_case("read data STALL", 1, 0);
+    dev.stall_cmd = dev.cmd_no + 2;
+    bad += error_case("write data STALL", 0, 0);
+    dev.fail_cmd = dev.cmd_no + 2;
+    bad += error_case("CSW command failed", 1, 0);
+    dev.phase_cmd = dev.cmd_no + 2;
+    bad += error_case("CSW phase error", 1, 1);
+
+    printf("\n%u CBWs, %u bad CBWs, %u data toggle errors, %u NAKs, %u interrupts\n", dev.cmd_no,
+           dev.bad_cbws, dev.toggle_errs, ehci_model_stat.naks, ehci_model_stat.irqs);
+    if (dev.bad_cbws || dev.toggle_errs)
+    {
+        printf("FAIL: the device saw bad CBWs or data toggle errors\n");
+        bad++;
+    }
+    return bad ? 1 : 0;
+}
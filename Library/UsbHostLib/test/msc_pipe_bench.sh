@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Build msc_xfer.c and the EHCI driver against the asynchronous schedule
+# model of ehci_model.c and the Bulk-only device of msc_pipe_bench.c and run
+# it: pipelined READ_10/WRITE_10 against one command at a time, in MB/s of
+# simulated time, and the error recovery cases.
+#
+#   test/msc_pipe_bench.sh [-v]
+#
+# Descriptors and UTRs hold addresses in uint32_t, so the bench is linked
+# without PIE. test/host.h is force-included into every library source.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/msc_pipe_bench.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -I$ROOT/ThirdParty/FatFs/source -I../StorageLib/Include -Iinc -Isrc_msc -Itest"
+
+# the library keeps addresses in uint32_t, the rest is left as is from the
+# core sources on a 64-bit host
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Wno-overflow \
+      -Wno-parentheses -Wno-array-bounds -Wno-maybe-uninitialized -Wno-unused-variable"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host.h $INC -o "$OUT/bench" \
+    test/msc_pipe_bench.c test/ehci_model.c test/host.c \
+    src_core/ehci.c src_core/ehci_iso.c src_core/ohci.c src_core/hub.c \
+    src_core/usb_core.c src_core/mem_alloc.c src_core/support.c \
+    src_msc/msc_xfer.c src_msc/msc_driver.c || exit 1
+
+"$OUT/bench" "$@"
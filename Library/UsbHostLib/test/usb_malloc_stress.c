@@ -0,0 +1,344 @@
+/*
+ * usb_malloc_stress - host stress test of the USB_malloc() pool of support.c.
+ *
+ * First the largest configuration the class drivers build is allocated: a
+ * hub and a USB audio device with their configuration descriptor buffers,
+ * isochronous in and out streams of 392-byte packets and the UTRs, device
+ * and interface records around them. It must fit, and the pool usage is
+ * compared with what the power-of-2 runs of a plain buddy allocator take.
+ *
+ * The host controller descriptors of mem_alloc.c come next: qTDs are taken
+ * until none is left, which must be their own partition plus the shared
+ * one, iTDs must then still get their own partition, and freed qTDs must
+ * give the shared units back to the iTDs.
+ *
+ * Then a random mix of such requests, with 16 to 4096 byte boundaries, is
+ * allocated and freed STRESS_OPS times with up to STRESS_LIVE allocations
+ * held. Every allocation must lie in the pool on its boundary, must not
+ * overlap another one (each is filled with its own tag and checked when
+ * freed), and the pool counters must match the allocations held. With
+ * everything freed the large region must be one run again and the buddy
+ * region whole.
+ *
+ *   usb_malloc_stress.sh [-v]
+ */
+
+#include <time.h>
+
+#include "host.h"
+#include "hub.h"
+
+#define POOL_SIZE       (32 * 1024)
+#define BUDDY_SIZE      (4 * 1024)
+#define STRESS_OPS      200000
+#define STRESS_LIVE     48
+
+#define UAC_MPS         392                                 /* 48 kHz 24-bit stereo, with a spare sample */
+#define UAC_BUFF_SIZE   (UAC_MPS * IF_PER_UTR * 2)          /* uac_core.c: NUM_UTR of IF_PER_UTR packets */
+
+/* record sizes on the 32-bit target, the host ones are inflated by 64-bit pointers */
+#define UDEV_SIZE       60
+#define IFACE_SIZE      1224
+#define UTR_SIZE        140
+
+extern uint8_t  _USBMemoryPool[];
+
+typedef struct alloc_t
+{
+    uint8_t  *p;
+    int      size;
+    uint8_t  tag;
+} ALLOC_T;
+
+static ALLOC_T  live[STRESS_LIVE];
+static int      live_cnt;
+static int      bad;
+
+static uint32_t  host_ns(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* bytes of the power-of-2 run a plain buddy allocator would take */
+static int  buddy_bytes(int size)
+{
+    int  run = 128;
+
+    while (run < size)
+        run <<= 1;
+    return run;
+}
+
+static int  check_alloc(uint8_t *p, int size, int boundary)
+{
+    uint32_t  addr = (uint32_t)(uintptr_t)p;
+    uint32_t  base = (uint32_t)(uintptr_t)_USBMemoryPool;
+    int  i;
+
+    if ((addr < base) || (addr + size > base + POOL_SIZE) || (addr % boundary))
+    {
+        printf("FAIL: USB_malloc(%d, %d) returned 0x%x, pool 0x%x\n", size, boundary, addr, base);
+        return -1;
+    }
+    for (i = 0; i < live_cnt; i++)
+    {
+        if ((p < live[i].p + live[i].size) && (live[i].p < p + size))
+        {
+            printf("FAIL: USB_malloc(%d, %d) at 0x%x overlaps %d bytes at 0x%x\n", size, boundary, addr,
+                   live[i].size, (uint32_t)(uintptr_t)live[i].p);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int  check_counters(void)
+{
+    USB_MEM_STAT_T  stat;
+    uint32_t  requested = 0;
+    int  i;
+
+    for (i = 0; i < live_cnt; i++)
+        requested += live[i].size;
+
+    USB_memory_stat(&stat);
+    if ((stat.requested != requested) || (stat.allocated < requested) ||
+        (USB_allocated_memory() + USB_available_memory() != POOL_SIZE))
+    {
+        printf("FAIL: %d bytes held, pool reports %d requested, %d allocated, %d free\n",
+               requested, stat.requested, USB_allocated_memory(), USB_available_memory());
+        return -1;
+    }
+    return 0;
+}
+
+static void  free_live(int i)
+{
+    int  k;
+
+    for (k = 0; k < live[i].size; k++)
+    {
+        if (live[i].p[k] != live[i].tag)
+        {
+            printf("FAIL: %d bytes at 0x%x overwritten at +%d\n", live[i].size, (uint32_t)(uintptr_t)live[i].p, k);
+            bad++;
+            break;
+        }
+    }
+    USB_free(live[i].p);
+    live[i] = live[--live_cnt];
+}
+
+static int  worst_config(void)
+{
+    static const struct
+    {
+        const char  *name;
+        int         size;
+        int         count;
+    } item[] =
+    {
+        { "config descriptor buffers", MAX_DESC_BUFF_SIZE, 2 },  /* the hub and the audio device */
+        { "audio in/out buffers",      UAC_BUFF_SIZE,      2 },
+        { "device records",            UDEV_SIZE,          2 },
+        { "interface records",         IFACE_SIZE,         4 },  /* hub, audio control, in, out */
+        { "UTRs",                      UTR_SIZE,           6 },  /* audio ping-pong, hub status */
+        { "hub status buffer",         HUB_STATUS_MAX_BYTE, 1 },
+        { "control buffers",           16,                 2 },
+    };
+    USB_MEM_STAT_T  stat;
+    void  *p[32];
+    int   i, k, n = 0, buddy = 0, expect = 0, fail = 0;
+
+    USB_InitializeMemoryPool();
+
+    printf("largest configuration: hub and audio device, %d-byte isochronous packets\n", UAC_MPS);
+    for (i = 0; i < (int)(sizeof(item) / sizeof(item[0])); i++)
+    {
+        for (k = 0; k < item[i].count; k++)
+        {
+            p[n] = USB_malloc(item[i].size, 16);
+            if (p[n] == NULL)
+                fail++;
+            else
+                n++;
+            buddy += buddy_bytes(item[i].size);
+            expect += (item[i].size <= 1024) ? buddy_bytes(item[i].size) : (item[i].size + 127) / 128 * 128;
+        }
+        printf("    %-26s %2d x %5d bytes\n", item[i].name, item[i].count, item[i].size);
+    }
+
+    USB_memory_stat(&stat);
+    printf("    requested %d, allocated %d, largest free %d of %d bytes (power-of-2 runs: %d)\n\n",
+           stat.requested, stat.allocated, stat.largest_free, stat.total, buddy);
+    if (fail)
+        printf("FAIL: %d allocations of the largest configuration failed\n", fail);
+    else if (stat.allocated != expect)
+    {
+        printf("FAIL: %d bytes allocated, large requests should take whole blocks only (%d)\n", stat.allocated, expect);
+        fail++;
+    }
+
+    while (n > 0)
+        USB_free(p[--n]);
+    return fail ? -1 : 0;
+}
+
+/* descriptors of a type until none is left, at most max */
+static int  desc_fill(void **p, int max, void *(*alloc)(void))
+{
+    int  n;
+
+    for (n = 0; n < max; n++)
+    {
+        p[n] = alloc();
+        if (p[n] == NULL)
+            break;
+    }
+    return n;
+}
+
+static void  *alloc_qtd(void)
+{
+    return alloc_ehci_qTD(NULL);
+}
+
+static void  *alloc_itd(void)
+{
+    return alloc_ehci_iTD();
+}
+
+static int  desc_pool(void)
+{
+    static void  *qtd[MEM_POOL_UNIT_NUM], *itd[MEM_POOL_UNIT_NUM];
+    int  nq, ni, ni2, fail = 0;
+
+    usbh_memory_init();
+
+    nq = desc_fill(qtd, MEM_POOL_UNIT_NUM, alloc_qtd);
+    ni = desc_fill(itd, MEM_POOL_UNIT_NUM, alloc_itd);
+    printf("descriptor pool: %d qTDs, then %d iTDs", nq, ni);
+    if ((nq != MEM_POOL_QTD_NUM + MEM_POOL_SHARED_NUM) || (ni != MEM_POOL_ITD_NUM))
+        fail++;
+
+    /* the qTDs give their shared units back */
+    while (nq > 0)
+        free_ehci_qTD(qtd[--nq]);
+    ni2 = desc_fill(itd + ni, MEM_POOL_UNIT_NUM - ni, alloc_itd);
+    printf(", %d more iTDs after the qTDs are freed\n\n", ni2);
+    if (ni2 != MEM_POOL_SHARED_NUM)
+        fail++;
+
+    /* a unit freed as another type stays allocated */
+    free_ehci_qTD((qTD_T *)itd[ni]);
+    if (alloc_ehci_qTD(NULL) == itd[ni])
+        fail++;
+
+    if (fail)
+        printf("FAIL: each type should get %d units beyond its own partition\n", MEM_POOL_SHARED_NUM);
+    return fail ? -1 : 0;
+}
+
+static void  stress(void)
+{
+    static const int  sizes[] =
+    {
+        8, 16, 16, UTR_SIZE, UTR_SIZE, UTR_SIZE, UDEV_SIZE, IFACE_SIZE,
+        64, 512, 1000, 1024, 3072, MAX_DESC_BUFF_SIZE, UAC_BUFF_SIZE
+    };
+    static const int  boundaries[] = { 16, 16, 16, 16, 32, 64, 256, 4096 };
+    USB_MEM_STAT_T  stat;
+    uint32_t  t0, ns = 0, allocs = 0, frees = 0, nomem = 0;
+    int   op, size, boundary;
+    uint8_t  *p;
+
+    USB_InitializeMemoryPool();
+    srand(1);
+
+    for (op = 0; op < STRESS_OPS; op++)
+    {
+        if ((live_cnt == STRESS_LIVE) || ((live_cnt > 0) && (rand() % 2)))
+        {
+            t0 = host_ns();
+            free_live(rand() % live_cnt);
+            ns += host_ns() - t0;
+            frees++;
+        }
+        else
+        {
+            size = sizes[rand() % (sizeof(sizes) / sizeof(sizes[0]))];
+            boundary = boundaries[rand() % (sizeof(boundaries) / sizeof(boundaries[0]))];
+
+            t0 = host_ns();
+            p = USB_malloc(size, boundary);
+            ns += host_ns() - t0;
+            if (p == NULL)
+            {
+                nomem++;
+                continue;
+            }
+            allocs++;
+            if (check_alloc(p, size, boundary) != 0)
+            {
+                bad++;
+                break;
+            }
+            live[live_cnt].p = p;
+            live[live_cnt].size = size;
+            live[live_cnt].tag = (uint8_t)op;
+            memset(p, (uint8_t)op, size);
+            live_cnt++;
+        }
+        if (check_counters() != 0)
+        {
+            bad++;
+            break;
+        }
+    }
+
+    USB_memory_stat(&stat);
+    printf("stress: %d allocs, %d frees, %d out of memory, %d ns per call, high-water %d of %d bytes\n",
+           allocs, frees, nomem, (allocs + frees) ? ns / (allocs + frees) : 0, stat.max_allocated, stat.total);
+
+    while (live_cnt > 0)
+        free_live(live_cnt - 1);
+
+    /* everything merged back */
+    USB_memory_stat(&stat);
+    if ((stat.allocated != 0) || (stat.requested != 0) || (stat.largest_free != POOL_SIZE - BUDDY_SIZE))
+    {
+        printf("FAIL: all freed, %d allocated, %d requested, largest free %d\n",
+               stat.allocated, stat.requested, stat.largest_free);
+        bad++;
+    }
+    p = USB_malloc(POOL_SIZE - BUDDY_SIZE, 4096);
+    if (p == NULL)
+    {
+        printf("FAIL: the large region is not one run after the stress\n");
+        bad++;
+    }
+    else
+    {
+        USB_free(p);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 1) && (strcmp(argv[1], "-v") == 0))
+        host_verbose = 1;
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (worst_config() != 0)
+        bad++;
+    if (desc_pool() != 0)
+        bad++;
+    stress();
+
+    if (!bad)
+        printf("no overlap, misalignment or leak\n");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Build support.c and mem_alloc.c against the host stand-ins and run
+# usb_malloc_stress: the largest class driver configuration, the shared
+# descriptor partition, then random USB_malloc()/USB_free() checked for
+# overlap, alignment and the pool counters.
+#
+#   test/usb_malloc_stress.sh [-v]
+#
+# The pool hands out addresses in uint32_t, so the test is linked without
+# PIE. test/host.h is force-included into every library source.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:-"-O2 -g"}
+OUT=${TMPDIR:-/tmp}/usb_malloc_stress.$$
+ROOT=../..
+INC="-I$ROOT/Driver/Include -Iinc -Itest"
+
+# the library keeps addresses in uint32_t, free_device() negates a size_t
+WARN="-Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Wno-overflow"
+
+mkdir -p "$OUT" || exit 1
+trap 'rm -rf "$OUT"' EXIT
+
+$CC $CFLAGS $WARN -no-pie -include test/host.h $INC -o "$OUT/test" \
+    test/usb_malloc_stress.c test/host.c src_core/support.c src_core/mem_alloc.c || exit 1
+
+"$OUT/test" "$@"
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Decode the UTR trace printed by usbh_trace_dump() of the USB Host library.
+#
+# Build the library with ENABLE_USB_TRACE defined in config.h, start the trace
+# with usbh_trace_start(), and capture the console output of usbh_trace_dump()
+# into a file. Other console lines around the dump are skipped.
+#
+#   usbh_trace.py capture.txt                    per-endpoint statistics
+#   usbh_trace.py --tick-us 1 capture.txt        time stamps from a 1 MHz counter
+#   usbh_trace.py --list --ep 0x81 capture.txt   every transfer of endpoint 0x81
+#
+# Time stamps are get_ticks() (10 ms) unless usbh_trace_start() was given a
+# counter. --tick-us and --mask must match that counter.
+#
+# SPDX-License-Identifier: Apache-2.0
+# Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+#
+
+import argparse
+import sys
+
+HEADER = 'seq,ticks,event,hc,dev,ep,type,len,status,utr'
+EP_TYPES = {0: 'ctrl', 1: 'iso', 2: 'bulk', 3: 'int'}
+
+
+class Record(object):
+    __slots__ = ('seq', 'ticks', 'event', 'hc', 'dev', 'ep', 'type', 'len', 'status', 'utr')
+
+    def __init__(self, fields):
+        self.seq = int(fields[0])
+        self.ticks = int(fields[1])
+        self.event = fields[2]
+        self.hc = fields[3]
+        self.dev = int(fields[4])
+        self.ep = int(fields[5], 16)
+        self.type = int(fields[6])
+        self.len = int(fields[7])
+        self.status = int(fields[8])
+        self.utr = int(fields[9], 16)
+
+
+def parse(lines):
+    """Return the records of all dumps found in lines."""
+    recs = []
+    in_dump = False
+    for line in lines:
+        line = line.strip()
+        if line == HEADER:
+            in_dump = True
+            continue
+        if not in_dump:
+            continue
+        fields = line.split(',')
+        if len(fields) != 10 or fields[2] not in ('S', 'D'):
+            in_dump = False             # end of dump, console output follows
+            continue
+        try:
+            recs.append(Record(fields))
+        except ValueError:
+            in_dump = False
+    return recs
+
+
+def pair(recs, mask):
+    """Pair each done record with the last open submit of the same UTR."""
+    open_sub = {}
+    xfers = []
+    for r in recs:
+        if r.event == 'S':
+            open_sub[r.utr] = r
+        else:
+            s = open_sub.pop(r.utr, None)
+            if s is not None:
+                xfers.append((s, r, (r.ticks - s.ticks) & mask))
+    return xfers
+
+
+def check_seq(recs):
+    lost = 0
+    for a, b in zip(recs, recs[1:]):
+        if b.seq > a.seq + 1:
+            lost += b.seq - a.seq - 1
+    return lost
+
+
+def percentile(sorted_vals, p):
+    if not sorted_vals:
+        return 0
+    i = min(len(sorted_vals) - 1, int(len(sorted_vals) * p / 100.0))
+    return sorted_vals[i]
+
+
+def print_stat(xfers, tick_us, mask):
+    eps = {}
+    for s, d, lat in xfers:
+        eps.setdefault((d.hc, d.dev, d.ep, d.type), []).append((s, d, lat))
+
+    print('%-4s %3s %-4s %-4s %6s %5s %10s %9s %9s %9s %9s %10s' %
+          ('HC', 'dev', 'ep', 'type', 'done', 'err', 'bytes',
+           'lat_min', 'lat_avg', 'lat_p99', 'lat_max', 'KB/s'))
+    for key in sorted(eps):
+        hc, dev, ep, typ = key
+        lst = eps[key]
+        lats = sorted(x[2] for x in lst)
+        err = sum(1 for x in lst if x[1].status < 0)
+        nbytes = sum(x[1].len for x in lst if x[1].status >= 0)
+        span = (lst[-1][1].ticks - lst[0][0].ticks) & mask
+        kbps = (nbytes * 1000000.0 / (span * tick_us) / 1024) if span else 0.0
+        us = lambda t: int(t * tick_us)
+        print('%-4s %3d 0x%02x %-4s %6d %5d %10d %9d %9d %9d %9d %10.1f' %
+              (hc, dev, ep, EP_TYPES.get(typ, '?'), len(lst), err, nbytes,
+               us(lats[0]), us(sum(lats) // len(lats)), us(percentile(lats, 99)),
+               us(lats[-1]), kbps))
+    print('Latencies in us, submit to done.')
+
+
+def print_list(xfers, tick_us, mask):
+    print('%10s %-4s %3s %-4s %8s %7s %10s' % ('submit_us', 'HC', 'dev', 'ep', 'len', 'status', 'lat_us'))
+    t0 = xfers[0][0].ticks if xfers else 0
+    for s, d, lat in xfers:
+        print('%10d %-4s %3d 0x%02x %8d %7d %10d' %
+              (((s.ticks - t0) & mask) * tick_us, d.hc, d.dev, d.ep, d.len, d.status, lat * tick_us))
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Decode usbh_trace_dump() output.')
+    ap.add_argument('file', nargs='?', help='captured console output, stdin if omitted')
+    ap.add_argument('--tick-us', type=float, default=10000,
+                    help='microseconds per time stamp tick (default 10000, get_ticks())')
+    ap.add_argument('--mask', type=lambda x: int(x, 0), default=0xFFFFFFFF,
+                    help='valid time stamp bits, for example 0xFFFFFF (default 0xFFFFFFFF)')
+    ap.add_argument('--ep', type=lambda x: int(x, 0), help='only this endpoint address')
+    ap.add_argument('--dev', type=int, help='only this device number')
+    ap.add_argument('--list', action='store_true', help='list transfers instead of statistics')
+    args = ap.parse_args()
+
+    f = open(args.file) if args.file else sys.stdin
+    recs = parse(f)
+    if not recs:
+        sys.exit('No usbh_trace_dump() output found.')
+
+    lost = check_seq(recs)
+    if lost:
+        sys.stderr.write('%d records lost, the trace ring overflowed. Use a bigger ring or dump more often.\n' % lost)
+
+    xfers = pair(recs, args.mask)
+    if args.ep is not None:
+        xfers = [x for x in xfers if x[1].ep == args.ep]
+    if args.dev is not None:
+        xfers = [x for x in xfers if x[1].dev == args.dev]
+    if not xfers:
+        sys.exit('No completed transfers.')
+
+    if args.list:
+        print_list(xfers, args.tick_us, args.mask)
+    else:
+        print_stat(xfers, args.tick_us, args.mask)
+
+
+if __name__ == '__main__':
+    main()
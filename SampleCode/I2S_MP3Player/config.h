@@ -15,9 +15,12 @@
 #define USE_SDH
 //#define USE_USBH
 
-#define PCM_BUFFER_SIZE        2304
 #define FILE_IO_BUFFER_SIZE    4096
 
+// MP3 player engine, define MP3_PCM_PERIODS and the other MP3Player.h buffer sizes
+// in the project to change its defaults
+#include "MP3Player.h"
+
 struct mp3Header
 {
     unsigned int sync : 11;
@@ -38,18 +41,15 @@ struct mp3Header
 struct AudioInfoObject
 {
     unsigned int playFileSize;
-    unsigned int mp3FileEndFlag;
     unsigned int mp3SampleRate;
     unsigned int mp3BitRate;
     unsigned int mp3Channel;
     unsigned int mp3PlayTime;
-    unsigned int mp3Playing;
 };
 
 
 int mp3CountV1L3Headers(unsigned char *pBytes, size_t size);
 void MP3Player(void);
-void i2sConfigSampleRate(unsigned int u32SampleRate);
 
 #endif
 
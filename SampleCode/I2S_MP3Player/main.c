@@ -21,8 +21,6 @@ FATFS FatFs[FF_VOLUMES];               /* File system object for logical drive *
 
 uint8_t bAudioPlaying = 0;
 extern uint32_t volatile sd_init_ok;
-extern volatile uint8_t aPCMBuffer_Full[2];
-volatile uint8_t u8PCMBuffer_Playing=0;
 
 /***********************************************/
 /* Volume management table defined by user (required when FF_MULTI_PARTITION == 1) */
@@ -72,8 +70,8 @@ void SDH_IRQHandler(void)
 	isr = inpw(REG_SDH_INTSTS);
 	if (isr & SDH_INTSTS_BLKDIF_Msk)		// block down
 	{
-		_sd_SDDataReady = TRUE;
 		outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
+		SD_BlockDoneHandler();	/* advance the SD request queue */
 	}
 
     if (isr & SDH_INTSTS_CDIF0_Msk) { // port 0 card detect
@@ -135,14 +133,6 @@ void Delay(int count)
 	for (i = 0; i < count ; i++);
 }
 
-void play_callback(void)
-{
-    if (aPCMBuffer_Full[u8PCMBuffer_Playing^1] != 1)
-        sysprintf("underflow!!\n");
-    aPCMBuffer_Full[u8PCMBuffer_Playing] = 0;       //set empty flag
-    u8PCMBuffer_Playing ^= 1;
-}
-
 /*---------------------------------------------------------------------------------------------------------*/
 /*  Write 9-bit data to 7-bit address register of NAU8822 with I2C0                                        */
 /*---------------------------------------------------------------------------------------------------------*/
@@ -202,6 +192,62 @@ void SYS_Init(void)
 
 extern void MP3Player(void);
 
+/*---------------------------------------------------------------------------------------------------------*/
+/*  Pick the MP3_SetDecodeMode() flags. Each play prints the decode time per frame of its mode.            */
+/*---------------------------------------------------------------------------------------------------------*/
+static const unsigned int s_au32DecodeModes[] =
+{
+    MP3_DECODE_FULL,
+    MP3_DECODE_MONO,
+    MP3_DECODE_HALF_RATE,
+    MP3_DECODE_MONO | MP3_DECODE_HALF_RATE
+};
+
+static const char *s_apcDecodeModeNames[] =
+{
+    "full",
+    "mono",
+    "half rate",
+    "mono, half rate"
+};
+
+#define DECODE_MODE_CNT     (sizeof(s_au32DecodeModes) / sizeof(s_au32DecodeModes[0]))
+
+void PlayMenu(void)
+{
+    unsigned int u32Dither = 0, i;
+    int ch;
+
+    while (1)
+    {
+        sysprintf("\n[0] full  [1] mono  [2] half rate  [3] mono, half rate\n");
+        sysprintf("[a] all modes in turn  [d] dither %s\n", u32Dither ? "on" : "off");
+        sysprintf("Select decode mode: ");
+        ch = sysGetChar();
+        sysprintf("%c\n", ch);
+
+        if (ch == 'd')
+        {
+            u32Dither ^= MP3_DECODE_DITHER;
+            continue;
+        }
+
+        for (i = 0; i < DECODE_MODE_CNT; i++)
+        {
+            if ((ch != 'a') && (ch != '0' + i))
+                continue;
+            if (SD0.IsCardInsert != TRUE)
+            {
+                sysprintf("No SD card\n");
+                break;
+            }
+            sysprintf("\nDecode mode: %s\n", s_apcDecodeModeNames[i]);
+            MP3_SetDecodeMode(s_au32DecodeModes[i] | u32Dither);
+            MP3Player();
+        }
+    }
+}
+
 int32_t main(void)
 {
     TCHAR sd_path[] = { '0', ':', 0 };    /* SD drive started from 0 */
@@ -246,9 +292,6 @@ int32_t main(void)
     // Select 16-bit data width
     i2sIoctl(I2S_SELECT_BIT, I2S_BIT_WIDTH_16, 0);
     
-    // Set DMA interrupt selection to half of DMA buffer
-    i2sIoctl(I2S_SET_PLAY_DMA_INT_SEL, I2S_DMA_INT_HALF, 0);
-    
     // Set to stereo 
     i2sIoctl(I2S_SET_CHANNEL, I2S_PLAY, I2S_CHANNEL_P_I2S_TWO);
     
@@ -258,8 +301,7 @@ int32_t main(void)
     // Set as master
     i2sIoctl(I2S_SET_MODE, I2S_MODE_MASTER, 0);
 
-    // Set play and record call-back functions
-    i2sIoctl(I2S_SET_I2S_CALLBACKFUN, I2S_PLAY, (uint32_t)&play_callback);
+    // DMA interrupt selection and play call-back are set by the MP3 player engine
 
     // Initialize I2C-0 interface
     i2cInit(0);
@@ -274,12 +316,8 @@ int32_t main(void)
     // Configure NAU8822 audio codec
     NAU8822_Setup();
 
-    //while(1)
-    {
-        /* play mp3 */
-        if (SD0.IsCardInsert == TRUE)
-            MP3Player();
-    }
+    /* play mp3 */
+    PlayMenu();
 }	
 
 /* config play sampling rate */
@@ -71,8 +71,8 @@ void SDH_IRQHandler(void)
 
     if (isr & SDH_INTSTS_BLKDIF_Msk)        // block down
     {
-        _sd_SDDataReady = TRUE;
         outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
+        SD_BlockDoneHandler();    /* advance the SD request queue */
     }
 
     if (isr & SDH_INTSTS_CDIF0_Msk)   // port 0 card detect
@@ -13,6 +13,7 @@
 #include "sdh.h"
 #include "ff.h"
 #include "diskio.h"
+#include "disk_cache.h"
 
 extern int sd0_ok;
 extern int sd1_ok;
@@ -32,6 +33,7 @@ void SD_Open_Disk(unsigned int cardSel)
                 sysprintf("SD0 initial fail!!\n");
                 return;
             }
+            _Path[0] = 0 + '0';
             f_mount(&_FatfsVolSd0, _Path, 1);
             break;
 
@@ -51,11 +53,14 @@ void SD_Close_Disk(unsigned int cardSel)
 {
     if (cardSel == SD_PORT0) {
         sd0_ok = 0;
+        disk_cache_invalidate(0);   /* nothing cached for the removed card may reach the next one */
         memset(&SD0, 0, sizeof(SD_INFO_T));
+        _Path[0] = 0 + '0';
         f_mount(NULL, _Path, 1);
         memset(&_FatfsVolSd0, 0, sizeof(FATFS));
     } else if(cardSel == SD_PORT1) {
         sd1_ok = 0;
+        disk_cache_invalidate(1);
         memset(&SD1, 0, sizeof(SD_INFO_T));
         _Path[0] = 	1 + '0';	
         f_mount(NULL, _Path, 1);
@@ -14,6 +14,8 @@
 #include "sdh.h"
 #include "ff.h"
 #include "diskio.h"
+#include "sd_diskio.h"
+#include "disk_cache.h"
 
 
 #define SD0_DRIVE		0        /* for SD0          */
@@ -26,22 +28,33 @@
 #define USBH_DRIVE_4    7        /* USB Mass Storage */
 
 
-#define DISK_BUFFER_SIZE    (32*1024)
-#ifdef __ICCARM__
-#pragma data_alignment = 32
-static BYTE  fatfs_win_buff_pool[DISK_BUFFER_SIZE];       /* FATFS window buffer is cachable. Must not use it directly. */
-#else
-static BYTE  fatfs_win_buff_pool[DISK_BUFFER_SIZE] __attribute__((aligned(32)));       /* FATFS window buffer is cachable. Must not use it directly. */
-#endif
-
-BYTE  *fatfs_win_buff;
-
 /* Definitions of physical drive number for each media */
 
 #define DRV_SD0     0
 #define DRV_SD1     1
 
 
+static DRESULT sd_media_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    /* sd_disk_read() DMAs straight into buff, cacheable or not. */
+    if (pdrv == DRV_SD0)
+        return sd_disk_read(SD_PORT0, buff, sector, count);
+    else if (pdrv == DRV_SD1)
+        return sd_disk_read(SD_PORT1, buff, sector, count);
+
+    return RES_ERROR;
+}
+
+static DRESULT sd_media_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    if (pdrv == DRV_SD0)
+        return sd_disk_write(SD_PORT0, buff, sector, count);
+    else if (pdrv == DRV_SD1)
+        return sd_disk_write(SD_PORT1, buff, sector, count);
+
+    return RES_ERROR;
+}
+
 /*-----------------------------------------------------------------------*/
 /* Initialize a Drive                                                    */
 /*-----------------------------------------------------------------------*/
@@ -60,6 +73,7 @@ DSTATUS disk_initialize (BYTE pdrv)       /* Physical drive number (0..) */
             return STA_NOINIT;
         break;
     }
+    disk_cache_attach(pdrv, sd_media_read, sd_media_write);
     return RES_OK;
 }
 
@@ -86,7 +100,6 @@ DSTATUS disk_status (BYTE pdrv)       /* Physical drive number (0..) */
 }
 
 
-
 /*-----------------------------------------------------------------------*/
 /* Read Sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
@@ -95,41 +108,13 @@ DRESULT disk_read (
     BYTE pdrv,      /* Physical drive number (0..) */
     BYTE *buff,     /* Data buffer to store read data */
     DWORD sector,   /* Sector address (LBA) */
-    UINT count      /* Number of sectors to read (1..128) */
+    UINT count      /* Number of sectors to read */
 )
 {
-	DRESULT   ret;
-
-    outpw(REG_SDH_GCTL, SDH_GCTL_SDEN_Msk);
 	//sysprintf("disk_read - drv:%d, sec:%d, cnt:%d, buff:0x%x\n", pdrv, sector, count, (UINT32)buff);
-	
-	if (!((UINT32)buff & 0x80000000))
-	{
-		/* Disk read buffer is not non-cachable buffer. Use my non-cachable to do disk read. */
-		if (count * 512 > DISK_BUFFER_SIZE)
-			return RES_ERROR;
-			
-		fatfs_win_buff = (BYTE *)((unsigned int)fatfs_win_buff_pool | 0x80000000);
-        if (pdrv == DRV_SD0)
-            ret = (DRESULT) SD_Read(SD_PORT0, fatfs_win_buff, sector, count);
-        else if (pdrv == DRV_SD1)
-            ret = (DRESULT) SD_Read(SD_PORT1, fatfs_win_buff, sector, count);
-        else
-			return RES_ERROR;
-		memcpy(buff, fatfs_win_buff, count * 512);
-	}
-	else
-	{
-        if (pdrv == DRV_SD0)
-            ret = (DRESULT) SD_Read(SD_PORT0, buff, sector, count);
-        else if (pdrv == DRV_SD1)
-            ret = (DRESULT) SD_Read(SD_PORT1, buff, sector, count);
-        else
-			return RES_ERROR;
-	}
-	return ret;
-}
 
+    return disk_cache_read(pdrv, buff, sector, count);
+}
 
 
 /*-----------------------------------------------------------------------*/
@@ -140,39 +125,12 @@ DRESULT disk_write (
     BYTE pdrv,          /* Physical drive number (0..) */
     const BYTE *buff,   /* Data to be written */
     DWORD sector,       /* Sector address (LBA) */
-    UINT count          /* Number of sectors to write (1..128) */
+    UINT count          /* Number of sectors to write */
 )
 {
-	DRESULT   ret;
-
-    outpw(REG_SDH_GCTL, SDH_GCTL_SDEN_Msk);
 	//sysprintf("disk_write - drv:%d, sec:%d, cnt:%d, buff:0x%x\n", pdrv, sector, count, (UINT32)buff);
-	
-	if (!((UINT32)buff & 0x80000000))
-	{
-		/* Disk write buffer is not non-cachable buffer. Use my non-cachable to do disk write. */
-		if (count * 512 > DISK_BUFFER_SIZE)
-			return RES_ERROR;
-			
-		fatfs_win_buff = (BYTE *)((unsigned int)fatfs_win_buff_pool | 0x80000000);
-		memcpy(fatfs_win_buff, buff, count * 512);
-        if (pdrv == DRV_SD0)
-            ret = (DRESULT) SD_Write(SD_PORT0, fatfs_win_buff, sector, count);
-        else if (pdrv == DRV_SD1)
-            ret = (DRESULT) SD_Write(SD_PORT1, fatfs_win_buff, sector, count);
-        else
-			return RES_ERROR;
-	}
-	else
-	{
-        if (pdrv == DRV_SD0)
-            ret = (DRESULT) SD_Write(SD_PORT0, (UINT8 *)buff, sector, count);
-        else if (pdrv == DRV_SD1)
-            ret = (DRESULT) SD_Write(SD_PORT1, (UINT8 *)buff, sector, count);
-        else
-			return RES_ERROR;
-	}
-	return ret;
+
+    return disk_cache_write(pdrv, buff, sector, count);
 }
 
 
@@ -193,6 +151,10 @@ DRESULT disk_ioctl (
     case DRV_SD0 :
         switch(cmd) {
         case CTRL_SYNC:
+            res = disk_cache_sync(pdrv);
+            break;
+        case CTRL_TRIM:
+            disk_cache_discard(pdrv, ((DWORD *)buff)[0], ((DWORD *)buff)[1] - ((DWORD *)buff)[0] + 1);
             break;
         case GET_SECTOR_COUNT:
             *(DWORD*)buff = SD0.totalSectorN;
@@ -210,6 +172,10 @@ DRESULT disk_ioctl (
     case DRV_SD1 :
         switch(cmd) {
         case CTRL_SYNC:
+            res = disk_cache_sync(pdrv);
+            break;
+        case CTRL_TRIM:
+            disk_cache_discard(pdrv, ((DWORD *)buff)[0], ((DWORD *)buff)[1] - ((DWORD *)buff)[0] + 1);
             break;
         case GET_SECTOR_COUNT:
             *(DWORD*)buff = SD1.totalSectorN;
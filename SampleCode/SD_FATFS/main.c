@@ -12,9 +12,12 @@
 #include "sdh.h"
 #include "ff.h"
 #include "diskio.h"
+#include "sd_recorder.h"
+#include "storage_bench.h"
 
 
 #define BUFF_SIZE		(64*1024)
+#define BENCH_TICKS_PER_SEC	10000			/* TIMER1 rate for benchmark latencies */
 
 static UINT blen = BUFF_SIZE;
 DWORD acc_size;             			/* Work register for fs command */
@@ -51,15 +54,18 @@ PARTITION VolToPart[] = {
 
 /***********************************************/
 
+static uint32_t timer_start;
+
+/* TIMER0 runs at 100 ticks per second */
 void timer_init()
 {
-	sysprintf("timer_init() To do...\n");
+	timer_start = sysGetTicks(TIMER0);
 }
 
+/* elapsed time since timer_init() in 10 ms ticks */
 uint32_t get_timer_value()
 {
-	sysprintf("get_timer_value() To do...\n");
-	return 1;
+	return sysGetTicks(TIMER0) - timer_start;
 }
 BYTE SD_Drv; // select SD0
 
@@ -284,8 +290,8 @@ void SDH_IRQHandler(void)
 	isr = inpw(REG_SDH_INTSTS);
 	if (isr & SDH_INTSTS_BLKDIF_Msk)		// block down
 	{
-		_sd_SDDataReady = TRUE;
 		outpw(REG_SDH_INTSTS, SDH_INTSTS_BLKDIF_Msk);
+		SD_BlockDoneHandler();	/* advance the SD request queue */
 	}
 
     if (isr & SDH_INTSTS_CDIF0_Msk) { // port 0 card detect
@@ -405,6 +411,27 @@ unsigned long get_fattime (void)
 
 
 static FIL file1, file2;        /* File objects */
+static SD_REC_T rec1;           /* Recording file object */
+
+static FRESULT run_bench(DWORD start, DWORD num, UINT req, const TCHAR *path)
+{
+    SBENCH_CFG_T bench;
+
+    if ((req == 0) || (req > BUFF_SIZE / 512))
+        return FR_INVALID_PARAMETER;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.u8Drv = SD_Drv;
+    bench.pPath = path;
+    bench.u32StartSec = start;
+    bench.u32AreaSec = num;
+    bench.u32ReqSec = req;
+    bench.pu8Buff = Buff;
+    bench.i32TimerNo = TIMER1;
+    bench.u32TicksPerSec = BENCH_TICKS_PER_SEC;
+    bench.u32Seed = 1;
+    return sbench_run_all(&bench);
+}
 
 /*----------------------------------------------------------------------------
   MAIN function
@@ -446,6 +473,8 @@ int32_t main(void)
 	/*--- init timer ---*/
 	sysSetTimerReferenceClock (TIMER0, 12000000);
 	sysStartTimer(TIMER0, 100, PERIODIC_MODE);
+	sysSetTimerReferenceClock (TIMER1, 12000000);
+	sysStartTimer(TIMER1, BENCH_TICKS_PER_SEC, PERIODIC_MODE);
 	
     sysprintf("\n\nN9H31 SD FATFS TEST!\n");
     SD_SetReferenceClock(300000);
@@ -545,6 +574,11 @@ int32_t main(void)
                 memset(Buff, (int)p1, BUFF_SIZE);
                 break;
 
+            case 'm' :  /* bm <sect> <num> <req> - Benchmark raw sectors, destroys their data */
+                if (!xatoi(&ptr, &p1) || !xatoi(&ptr, &p2) || !xatoi(&ptr, &p3)) break;
+                put_rc(run_bench(p1, p2, p3, NULL));
+                break;
+
             }
             break;
 
@@ -681,9 +715,9 @@ int32_t main(void)
                     p2 += s2;
                     if (cnt != s2) break;
                 }
-                p1 = get_timer_value()/1000;
+                p1 = get_timer_value();
                 if (p1)
-                    sysprintf("%d bytes read with %d kB/sec.\n", p2, ((p2 * 100) / p1)/1024);
+                    sysprintf("%d bytes read with %d kB/sec.\n", p2, ((p2 / 1024) * 100) / p1);
                 break;
 
             case 'w' :  /* fw <len> <val> - write file */
@@ -707,9 +741,41 @@ int32_t main(void)
                     p2 += s2;
                     if (cnt != s2) break;
                 }
-                p1 = get_timer_value()/1000;
+                p1 = get_timer_value();
                 if (p1)
-                    sysprintf("%d bytes written with %d kB/sec.\n", p2, ((p2 * 100) / p1)/1024);
+                    sysprintf("%d bytes written with %d kB/sec.\n", p2, ((p2 / 1024) * 100) / p1);
+                break;
+
+            case 'b' :  /* fb <num> <req> <name> - Benchmark file read/write */
+                if (!xatoi(&ptr, &p1) || !xatoi(&ptr, &p2)) break;
+                while (*ptr == ' ') ptr++;
+                put_rc(run_bench(0, p1, p2, ptr));
+                break;
+
+            case 'p' :  /* fp <len> <name> - Record to a pre-allocated contiguous file */
+                if (!xatoi(&ptr, &p1)) break;
+                while (*ptr == ' ') ptr++;
+                res = sd_rec_open(&rec1, SD_Drv ? SD_PORT1 : SD_PORT0, ptr, p1);
+                if (res != FR_OK) {
+                    put_rc(res);
+                    break;
+                }
+                sysprintf("extent: sector %d, %d sectors\n", rec1.u32StartSec, rec1.u32SecCount);
+                p2 = 0;
+                timer_init();
+                while ((DWORD)p2 < (DWORD)p1) {
+                    cnt = ((DWORD)(p1 - p2) >= blen) ? blen / 512 : (p1 - p2 + 511) / 512;
+                    if (cnt == 0) cnt = 1;
+                    res = sd_rec_write(&rec1, Buff, cnt);
+                    if (res != FR_OK) break;
+                    p2 += cnt * 512;
+                }
+                s1 = get_timer_value();
+                if (p2 > p1) p2 = p1;
+                res = sd_rec_close(&rec1, p2);
+                put_rc(res);
+                if (s1)
+                    sysprintf("%d bytes recorded with %d kB/sec.\n", p2, ((p2 / 1024) * 100) / s1);
                 break;
 
             case 'n' :  /* fn <old_name> <new_name> - Change file/dir name */
@@ -822,6 +888,7 @@ int32_t main(void)
                 _T("br <pd#> <sect> [<num>] - Read disk into working buffer\n")
                 _T("bw <pd#> <sect> [<num>] - Write working buffer into disk\n")
                 _T("bf <val> - Fill working buffer\n")
+                _T("bm <sect> <num> <req> - Benchmark <num> sectors from <sect> with <req> sectors per request. Destroys data!\n")
                 _T("\n")
                 _T("fs - Show volume status\n")
                 _T("fl [<path>] - Show a directory\n")
@@ -832,6 +899,8 @@ int32_t main(void)
                 _T("fd <len> - Read and dump the file\n")
                 _T("fr <len> - Read the file\n")
                 _T("fw <len> <val> - Write to the file\n")
+                _T("fb <num> <req> <file> - Benchmark a <num> sectors file with <req> sectors per request\n")
+                _T("fp <len> <file> - Record working buffer to a pre-allocated contiguous file\n")
                 _T("fn <object name> <new name> - Rename an object\n")
                 _T("fu <object name> - Unlink an object\n")
                 _T("fv - Truncate the file at current fp\n")
@@ -0,0 +1,214 @@
+/**************************************************************************//**
+ * @file     main.c
+ * @brief    This sample shows how to run the USB Host library under FreeRTOS.
+ *           Hub port changes are handled by the hub task of the library, which
+ *           wakes up on root hub and hub interrupts instead of being polled.
+ *           Newly connected HID devices are set up from the hub task.
+ *
+ * @note
+ * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "N9H31.h"
+#include "sys.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "usbh_lib.h"
+#include "usbh_hid.h"
+
+
+#define HUB_TASK_PRIORITY           (tskIDLE_PRIORITY + 2)
+#define MONITOR_TASK_PRIORITY       (tskIDLE_PRIORITY + 1)
+
+uint32_t   g_buff_pool[1024] __attribute__((aligned(32)));
+
+HID_DEV_T  *g_hid_list[CONFIG_HID_MAX_DEV];
+
+
+void delay_us(int usec)
+{
+    volatile int  loop = 300 * usec;
+    while (loop > 0) loop--;
+}
+
+uint32_t get_ticks(void)
+{
+    return sysGetTicks(TIMER0);
+}
+
+
+void  dump_buff_hex(uint8_t *pucBuff, int nBytes)
+{
+    int     nIdx, i;
+
+    nIdx = 0;
+    while (nBytes > 0)
+    {
+        sysprintf("0x%04X  ", nIdx);
+        for (i = 0; (i < 16) && (nBytes > 0); i++)
+        {
+            sysprintf("%02x ", pucBuff[nIdx + i]);
+            nBytes--;
+        }
+        nIdx += 16;
+        sysprintf("\n");
+    }
+    sysprintf("\n");
+}
+
+int  is_a_new_hid_device(HID_DEV_T *hdev)
+{
+    int    i;
+    for (i = 0; i < CONFIG_HID_MAX_DEV; i++)
+    {
+        if ((g_hid_list[i] != NULL) && (g_hid_list[i] == hdev) &&
+                (g_hid_list[i]->uid == hdev->uid))
+            return 0;
+    }
+    return 1;
+}
+
+void update_hid_device_list(HID_DEV_T *hdev)
+{
+    int  i = 0;
+    memset(g_hid_list, 0, sizeof(g_hid_list));
+    while ((i < CONFIG_HID_MAX_DEV) && (hdev != NULL))
+    {
+        g_hid_list[i++] = hdev;
+        hdev = hdev->next;
+    }
+}
+
+void  int_read_callback(HID_DEV_T *hdev, uint16_t ep_addr, int status, uint8_t *rdata, uint32_t data_len)
+{
+    /*
+     *  Called from the USB host interrupt handler. If <status> is not zero, this interrupt in
+     *  transfer failed and HID driver will stop this pipe. It can be caused by USB transfer error
+     *  or device disconnected.
+     */
+    if (status < 0)
+    {
+        sysprintf("Interrupt in transfer failed! status: %d\n", status);
+        return;
+    }
+    sysprintf("Device [0x%x,0x%x] ep 0x%x, %d bytes received =>\n",
+              hdev->idVendor, hdev->idProduct, ep_addr, data_len);
+    dump_buff_hex(rdata, data_len);
+}
+
+int  init_hid_device(HID_DEV_T *hdev)
+{
+    uint8_t   *data_buff;
+    int       ret;
+
+    data_buff = (uint8_t *)((uint32_t)g_buff_pool | 0x80000000);   // get non-cachable buffer address
+
+    sysprintf("\n\n==================================\n");
+    sysprintf("  Init HID device : 0x%x\n", (int)hdev);
+    sysprintf("  VID: 0x%x, PID: 0x%x\n\n", hdev->idVendor, hdev->idProduct);
+
+    ret = usbh_hid_get_report_descriptor(hdev, data_buff, 1024);
+    if (ret > 0)
+    {
+        sysprintf("\nDump report descriptor =>\n");
+        dump_buff_hex(data_buff, ret);
+    }
+
+    ret = usbh_hid_start_int_read(hdev, 0, int_read_callback);
+    if (ret != HID_RET_OK)
+        sysprintf("usbh_hid_start_int_read failed! %d\n", ret);
+    else
+        sysprintf("Interrupt in transfer started...\n");
+
+    return 0;
+}
+
+/*
+ *  Called in the hub task after devices have been connected or disconnected.
+ */
+void  hub_change_callback(void)
+{
+    HID_DEV_T    *hdev, *hdev_list;
+
+    hdev_list = usbh_hid_get_device_list();
+    hdev = hdev_list;
+    while (hdev != NULL)
+    {
+        if (is_a_new_hid_device(hdev))
+            init_hid_device(hdev);
+        hdev = hdev->next;
+    }
+    update_hid_device_list(hdev_list);
+}
+
+/*
+ *  Any other task keeps running while the hub task enumerates devices.
+ */
+static void  monitor_task(void *pvParameters)
+{
+    for (;;)
+    {
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+
+        if (!sysIsKbHit())
+        {
+            sysGetChar();
+            usbh_memory_used();
+            sysprintf("Free heap: %d bytes\n", (int)xPortGetFreeHeapSize());
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+int32_t main(void)
+{
+    sysDisableCache();
+    sysFlushCache(I_D_CACHE);
+    sysEnableCache(CACHE_WRITE_BACK);
+    sysInitializeUART();
+    sysSetLocalInterrupt(ENABLE_IRQ);
+
+    outpw(REG_CLK_HCLKEN, inpw(REG_CLK_HCLKEN) | 0x40000);
+    outpw(REG_CLK_PCLKEN0, inpw(REG_CLK_PCLKEN0) | 0x10000);
+
+    // set PE.14 & PE.15 for USBH_PPWR0 & USBH_PPWR1
+    outpw(REG_SYS_GPE_MFPH, (inpw(REG_SYS_GPE_MFPH) & ~0xff000000) | 0x77000000);
+
+    sysprintf("\n\n");
+    sysprintf("+--------------------------------------------+\n");
+    sysprintf("|                                            |\n");
+    sysprintf("|  USB Host HID class sample with FreeRTOS   |\n");
+    sysprintf("|                                            |\n");
+    sysprintf("+--------------------------------------------+\n");
+
+    /*--- init timer, FreeRTOS uses TIMER1 for its tick ---*/
+    sysSetTimerReferenceClock (TIMER0, 15000000);
+    sysStartTimer(TIMER0, 100, PERIODIC_MODE);
+
+    usbh_core_init();
+    usbh_hid_init();
+
+    if (usbh_start_hub_task(HUB_TASK_PRIORITY, hub_change_callback) != 0)
+    {
+        sysprintf("Failed to start hub task!\n");
+        while (1);
+    }
+
+    xTaskCreate(monitor_task, "monitor", configMINIMAL_STACK_SIZE * 4, NULL, MONITOR_TASK_PRIORITY, NULL);
+
+    /* usbh_pooling_hubs() is not called from here on, the hub task owns it */
+    vTaskStartScheduler();
+
+    /* Should never reach here! Not enough heap for the idle task. */
+    while (1);
+}
+
+
+/*** (C) COPYRIGHT 2018 Nuvoton Technology Corp. ***/
@@ -14,6 +14,9 @@
 #include "usbh_lib.h"
 #include "usbh_hid.h"
 #include "usbh_uac.h"
+#include "uac_i2s.h"
+#include "i2s.h"
+#include "i2c.h"
 
 
 #define AUDIO_IN_BUFSIZ             8192
@@ -22,6 +25,23 @@ uint8_t   au_in_buff[AUDIO_IN_BUFSIZ] __attribute__((aligned(32)));
 
 uint32_t  g_buff_pool[1024] __attribute__((aligned(32)));
 
+/*
+ *  UAC to I2S bridge, 'b' key. Microphone audio is played on the NAU8822 headphone
+ *  and NAU8822 line-in/microphone audio is sent to the UAC speaker.
+ */
+#define BRIDGE_SRATE                48000
+#define BRIDGE_PERIOD               240     /* I2S half buffer, 5 ms                       */
+#define BRIDGE_DMA_SIZE             (2 * BRIDGE_PERIOD * 4)
+#define BRIDGE_RING_SIZE            (8 * BRIDGE_PERIOD * 4)
+
+uint8_t   bridge_play_dma[BRIDGE_DMA_SIZE] __attribute__((aligned(32)));
+uint8_t   bridge_rec_dma[BRIDGE_DMA_SIZE] __attribute__((aligned(32)));
+uint8_t   bridge_play_ring[BRIDGE_RING_SIZE];
+uint8_t   bridge_rec_ring[BRIDGE_RING_SIZE];
+
+static UAC_I2S_T  bridge;
+static int  bridge_on, codec_ready;         /* codec_ready: 0 not tried, 1 ready, -1 failed */
+
 
 HID_DEV_T   *g_hid_list[CONFIG_HID_MAX_DEV];
 
@@ -478,6 +498,158 @@ void  uac_control_example(UAC_DEV_T *uac_dev)
 }
 
 
+/*
+ *  Write 9-bit data to 7-bit address register of NAU8822 with I2C0.
+ *  Gives up after a few tries, so that the sample keeps running without the codec.
+ */
+static int  I2C_WriteNAU8822(uint8_t u8addr, uint16_t u16data)
+{
+    uint8_t   TxData[2];
+    int       retry;
+
+    TxData[0] = (uint8_t)((u8addr << 1) | (u16data >> 8));
+    TxData[1] = (uint8_t)(u16data & 0x00FF);
+
+    for (retry = 0; retry < 8; retry++)
+    {
+        i2cIoctl(0, I2C_IOC_SET_SUB_ADDRESS, TxData[0], 0);
+        if (i2cWrite(0, &TxData[0], 2) == 2)
+            return 0;
+    }
+    return -1;
+}
+
+static int  NAU8822_Setup(void)
+{
+    int   ret = 0;
+
+    /* I2S master mode, NAU8822 takes its clocks from I2S */
+    ret |= I2C_WriteNAU8822(0,  0x000);   /* Reset all registers */
+    delay_us(1000);
+    ret |= I2C_WriteNAU8822(1,  0x03F);
+    ret |= I2C_WriteNAU8822(2,  0x1BF);   /* Enable L/R Headphone, ADC Mix/Boost, ADC */
+    ret |= I2C_WriteNAU8822(3,  0x07F);   /* Enable L/R main mixer, DAC */
+    ret |= I2C_WriteNAU8822(4,  0x010);   /* 16-bit word length, I2S format, Stereo */
+    ret |= I2C_WriteNAU8822(5,  0x000);   /* Companding control and loop back mode (all disable) */
+    ret |= I2C_WriteNAU8822(10, 0x008);   /* DAC soft mute is disabled, DAC oversampling rate is 128x */
+    ret |= I2C_WriteNAU8822(14, 0x108);   /* ADC HP filter is disabled, ADC oversampling rate is 128x */
+    ret |= I2C_WriteNAU8822(15, 0x1EF);   /* ADC left digital volume control */
+    ret |= I2C_WriteNAU8822(16, 0x1EF);   /* ADC right digital volume control */
+    ret |= I2C_WriteNAU8822(44, 0x033);   /* LMICN/LMICP is connected to PGA */
+    ret |= I2C_WriteNAU8822(50, 0x001);   /* Left DAC connected to LMIX */
+    ret |= I2C_WriteNAU8822(51, 0x001);   /* Right DAC connected to RMIX */
+    return ret;
+}
+
+/*
+ *  Open I2S and set up the codec. Tried on the first bridge start only, as boards
+ *  without the codec can still run the rest of this sample.
+ */
+static int  bridge_codec_init(void)
+{
+    /* Configure multi function pins to I2S and I2C0 */
+    outpw(REG_SYS_GPG_MFPH, (inpw(REG_SYS_GPG_MFPH) & ~0x0FFFFF00) | 0x08888800);
+    outpw(REG_SYS_GPG_MFPL, (inpw(REG_SYS_GPG_MFPL) & ~0xffff) | 0x88);
+
+    i2sInit();
+    if (i2sOpen() != 0)
+    {
+        sysprintf("Failed to open I2S!\n");
+        return -1;
+    }
+    i2sIoctl(I2S_SELECT_BLOCK, I2S_BLOCK_I2S, 0);
+    i2sIoctl(I2S_SELECT_BIT, I2S_BIT_WIDTH_16, 0);
+    i2sIoctl(I2S_SET_I2S_FORMAT, I2S_FORMAT_I2S, 0);
+    i2sIoctl(I2S_SET_MODE, I2S_MODE_MASTER, 0);
+
+    /* APLL is 98.4 MHz, I2S source is APLL / 8 = 12.3 MHz */
+    outpw(REG_CLK_APLLCON, 0xC0008028);
+    outpw(REG_CLK_DIVCTL1, (inpw(REG_CLK_DIVCTL1) & ~0x001f0000) | (0x2 << 19) | (0x7 << 24));
+
+    i2cInit(0);
+    if (i2cOpen(0) != 0)
+    {
+        sysprintf("Failed to open I2C0!\n");
+        return -1;
+    }
+    i2cIoctl(0, I2C_IOC_SET_DEV_ADDRESS, 0x1A, 0);
+    i2cIoctl(0, I2C_IOC_SET_SPEED, 100, 0);
+
+    if (NAU8822_Setup() != 0)
+    {
+        sysprintf("NAU8822 not responding!\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void  bridge_stop(UAC_DEV_T *uac_dev)
+{
+    uac_i2s_stop_record(&bridge);
+    uac_i2s_stop_play(&bridge);
+    bridge_on = 0;
+
+    /* give the streams back to the plain callbacks of this sample */
+    usbh_uac_start_audio_out(uac_dev, audio_out_callback);
+    usbh_uac_start_audio_in(uac_dev, audio_in_callback);
+    sysprintf("Bridge stopped.\n");
+}
+
+static void  bridge_start(UAC_DEV_T *uac_dev)
+{
+    int   channels, ret;
+
+    channels = usbh_uac_get_channel_number(uac_dev, UAC_MICROPHONE);
+    if ((channels < 1) || (channels > 2) ||
+            (usbh_uac_get_channel_number(uac_dev, UAC_SPEAKER) != channels))
+    {
+        sysprintf("Bridge needs the same number of speaker and microphone channels, 1 or 2.\n");
+        return;
+    }
+
+    if (codec_ready == 0)
+        codec_ready = (bridge_codec_init() == 0) ? 1 : -1;
+    if (codec_ready < 0)
+    {
+        sysprintf("No codec, bridge disabled.\n");
+        return;
+    }
+
+    i2sIoctl(I2S_SET_CHANNEL, I2S_PLAY, (channels == 2) ? I2S_CHANNEL_P_I2S_TWO : I2S_CHANNEL_P_I2S_ONE);
+    i2sIoctl(I2S_SET_CHANNEL, I2S_REC, (channels == 2) ? I2S_CHANNEL_R_I2S_TWO : I2S_CHANNEL_R_I2S_LEFT_PCM_SLOT0);
+    i2sSetSampleRate(12300000, BRIDGE_SRATE, 16, channels);
+
+    usbh_uac_stop_audio_in(uac_dev);
+    usbh_uac_stop_audio_out(uac_dev);
+
+    ret = uac_i2s_init(&bridge, uac_dev, BRIDGE_SRATE, channels, BRIDGE_PERIOD);
+    if (ret == 0)
+        ret = uac_i2s_start_play(&bridge, bridge_play_dma, bridge_play_ring, BRIDGE_RING_SIZE);
+    if (ret == 0)
+        ret = uac_i2s_start_record(&bridge, bridge_rec_dma, bridge_rec_ring, BRIDGE_RING_SIZE);
+    if (ret != 0)
+    {
+        sysprintf("Failed to start bridge! (%d)\n", ret);
+        bridge_stop(uac_dev);
+        return;
+    }
+    bridge_on = 1;
+    sysprintf("Bridge started, %d channel(s) at %d Hz.\n", channels, BRIDGE_SRATE);
+}
+
+static void  bridge_report(void)
+{
+    UAC_RING_STAT_T  st;
+
+    uac_ring_get_stat(&bridge.play, &st);
+    sysprintf("MIC->I2S: level %d, underrun %d, overrun %d, drift +%d/-%d\n",
+              st.level, st.underrun, st.overrun, st.drift_fast, st.drift_slow);
+    uac_ring_get_stat(&bridge.rec, &st);
+    sysprintf("I2S->SPK: level %d, underrun %d, overrun %d, drift +%d/-%d\n",
+              st.level, st.underrun, st.overrun, st.drift_fast, st.drift_slow);
+}
+
+
 /*----------------------------------------------------------------------------
   MAIN function
  *----------------------------------------------------------------------------*/
@@ -529,6 +701,7 @@ int32_t main(void)
 
             if (uac_dev != NULL)                  /* should be newly connected UAC device        */
             {
+                bridge_on = 0;
                 usbh_uac_open(uac_dev);
 
                 uac_control_example(uac_dev);
@@ -600,6 +773,18 @@ int32_t main(void)
                 else
                     sysprintf("    Failed to get microphone current volume!\n");
             }
+            else if (ch == 'b')
+            {
+                if (bridge_on)
+                    bridge_stop(uac_dev);
+                else
+                    bridge_start(uac_dev);
+            }
+            else if (bridge_on)
+            {
+                bridge_report();
+                usbh_memory_used();
+            }
             else
             {
                 sysprintf("IN: %d, OUT: %d\n", au_in_cnt, au_out_cnt);
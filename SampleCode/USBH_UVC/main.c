@@ -3,7 +3,7 @@
  * @version  V1.00
  * $Revision: 1 $
  * $Date: 18/03/12 10:47a $
- * @brief    This sample shows how to manage several USB HID class devices.
+ * @brief    This sample shows how to display a USB Video Class camera on LCD.
  *
  * @note
  * Copyright (C) 2018 Nuvoton Technology Corp. All rights reserved.
@@ -16,6 +16,7 @@
 #include "lcd.h"
 #include "usbh_lib.h"
 #include "usbh_uvc.h"
+#include "uvc_display.h"
 
 #include "jpegcodec.h"
 #include "jpeg.h"
@@ -38,30 +39,17 @@ static UVC_DEV_T   *g_vdev = NULL;
 /*----------------------------------------------------------------------
  * Image buffers
  */
-#define IMAGE_BUFF_CNT       2
+#define IMAGE_BUFF_CNT       3            /* UVC frame ring: one receiving, one decoding, one spare */
 
-enum
-{
-    IMAGE_BUFF_FREE,
-    IMAGE_BUFF_USB,
-    IMAGE_BUFF_READY,
-    IMAGE_BUFF_POST
-};
-
-struct ig_buff_t
-{
-    uint8_t   *buff;
-    int       len;
-    int       state;
-};
-struct ig_buff_t  _ig[IMAGE_BUFF_CNT];
+#define DISP_BUFF_CNT        3            /* OSD buffers: one on panel, one waiting vsync, one decoding */
 
 uint8_t  image_buff_pool[IMAGE_BUFF_CNT][IMAGE_MAX_SIZE] __attribute__((aligned(32)));
 
 uint8_t  snapshot_buff_pool[IMAGE_MAX_SIZE] __attribute__((aligned(32)));
 
-int   _idx_usb = 0, _idx_post = 0;
-int   _total_frame_count = 0;
+uint8_t  *_img_buff[IMAGE_BUFF_CNT];
+
+UVC_DISP_T  g_disp;
 
 
 
@@ -70,6 +58,21 @@ int   _total_frame_count = 0;
 uint8_t  * g_OSD_base = 0;
 uint8_t  * g_LCD_base = 0;
 
+static void vpostIntHandler(void)
+{
+    uint32_t uintstatus;
+
+    uintstatus = inpw(REG_LCM_INT_CS);
+    if (uintstatus & VPOSTB_DISP_F_INT)
+    {
+        outpw(REG_LCM_INT_CS,inpw(REG_LCM_INT_CS) | VPOSTB_DISP_F_INT);
+        if (g_disp.vdev != NULL)
+            uvc_disp_vsync(&g_disp);        /* flip the latest decoded image onto OSD     */
+    }
+    else if (uintstatus & VPOSTB_BUS_ERROR_INT)
+        outpw(REG_LCM_INT_CS,inpw(REG_LCM_INT_CS) | VPOSTB_BUS_ERROR_INT);
+}
+
 void delay_us(int usec)
 {
     volatile int  loop = 300 * usec;
@@ -144,9 +147,9 @@ static void init_lcd(void)
 
     vpostSetOSDSrc(OSD_SRC_YCBCR422);
 
-    // Get pointer of OSD frame buffer
+    // Get pointer of OSD frame buffers, the first one is displayed
     // Note: before get pointer of frame buffer, must set display size and display color depth first
-    g_OSD_base = vpostGetOSDBuffer();
+    g_OSD_base = vpostGetMultiOSDBuffer(DISP_BUFF_CNT);
     if (g_OSD_base == NULL)
     {
         sysprintf("Get OSD buffer error !!\n");
@@ -162,12 +165,20 @@ static void init_lcd(void)
     // Enable color key function
     vpostOSDSetColKey(0, 0, 0);
 
+    // Enable LCD interrupt to flip OSD buffers on vsync
+    outpw(REG_LCM_DCCS, inpw(REG_LCM_DCCS) | VPOSTB_DISP_INT_EN);
+    outpw(REG_LCM_INT_CS, inpw(REG_LCM_INT_CS) | VPOSTB_DISP_F_EN);
+
+    sysInstallISR(HIGH_LEVEL_SENSITIVE | IRQ_LEVEL_1, LCD_IRQn, (PVOID)vpostIntHandler);
+    sysSetLocalInterrupt(ENABLE_IRQ);
+    sysEnableInterrupt(LCD_IRQn);
+
     // Start video and OSD
     vpostVAStartTrigger();
     vpostOSDEnable();
 }
 
-void Decode_JPEG_Image(UINT8 *image_buf, int image_len)
+void Decode_JPEG_Image(UINT8 *image_buf, int image_len, UINT8 *dst_buf)
 {
     jpegInit();
 
@@ -175,7 +186,7 @@ void Decode_JPEG_Image(UINT8 *image_buf, int image_len)
 
     jpegIoctl(JPEG_IOCTL_SET_DECODE_MODE, JPEG_DEC_PRIMARY_PACKET_YUV422, 0);
 
-    jpegIoctl(JPEG_IOCTL_SET_YADDR, (UINT32)g_OSD_base, 0);
+    jpegIoctl(JPEG_IOCTL_SET_YADDR, (UINT32)dst_buf, 0);
 
     jpegIoctl(JPEG_IOCTL_DECODE_TRIGGER, 0, 0);
 
@@ -248,47 +259,7 @@ void  init_image_buffers(void)
 {
     int   i;
     for (i = 0; i < IMAGE_BUFF_CNT; i++)
-    {
-        _ig[i].buff   = (uint8_t *)((uint32_t)image_buff_pool[i] | 0x80000000);
-        _ig[i].len    = 0;
-        _ig[i].state  = IMAGE_BUFF_FREE;
-    }
-    _idx_usb = 0;
-    _idx_post = 0;
-}
-
-
-int  uvc_rx_callbak(UVC_DEV_T *vdev, uint8_t *data, int len)
-{
-    int  next_idx;
-
-    //sysprintf("RX: %d\n", len);
-    _total_frame_count++;
-
-    next_idx = (_idx_usb+1) % IMAGE_BUFF_CNT;
-
-    if (_ig[next_idx].state != IMAGE_BUFF_FREE)
-    {
-        /*
-         *  Next image buffer is in used.
-         *  Just drop this newly received image and reuse the same image buffer.
-         */
-        // sysprintf("Drop!\n");
-        usbh_uvc_set_video_buffer(vdev, _ig[_idx_usb].buff, IMAGE_MAX_SIZE);
-    }
-    else
-    {
-        _ig[_idx_usb].state = IMAGE_BUFF_READY;   /* mark the current buffer as ready for decode/display */
-        _ig[_idx_usb].len   = len;                /* length of this newly received image   */
-
-        /* proceed to the next image buffer */
-        _idx_usb = next_idx;
-        _ig[_idx_usb].state = IMAGE_BUFF_USB;     /* mark the next image as used by USB    */
-
-        /* assign the next image buffer to receive next image from USB */
-        usbh_uvc_set_video_buffer(vdev, _ig[_idx_usb].buff, IMAGE_MAX_SIZE);
-    }
-    return 0;
+        _img_buff[i] = (uint8_t *)((uint32_t)image_buff_pool[i] | 0x80000000);
 }
 
 
@@ -315,6 +286,10 @@ void show_menu()
 int32_t main(void)
 {
     UVC_DEV_T       *vdev;
+    UVC_FRAME_T     *frame;
+    UVC_DISP_STAT_T disp_stat;
+    uint8_t         *fb[DISP_BUFF_CNT];
+    uint32_t        rx_cnt, rx_drop, rx_err, shown_last = 0;
     IMAGE_FORMAT_E  format;
     int             i, width, height;
     int             t_last = 0, cnt_last = 0;
@@ -382,9 +357,10 @@ int32_t main(void)
             if (vdev == NULL)
             {
                 g_vdev = NULL;
+                g_disp.vdev = NULL;
                 t_last = 0;
                 cnt_last = 0;
-                _total_frame_count = 0;
+                shown_last = 0;
                 sysprintf("\n[No device connected]\n\n");
                 continue;
             }
@@ -427,11 +403,28 @@ int32_t main(void)
 
             init_image_buffers();
 
-            /* assign the first image buffer to receive the image from USB */
-            usbh_uvc_set_video_buffer(vdev, _ig[_idx_usb].buff, IMAGE_MAX_SIZE);
-            _ig[_idx_usb].state = IMAGE_BUFF_USB;
+            /* images are received into a ring, the application acquires and releases them */
+            ret = usbh_uvc_set_frame_ring(g_vdev, _img_buff, IMAGE_MAX_SIZE, IMAGE_BUFF_CNT);
+            if (ret != 0)
+                sysprintf("usbh_uvc_set_frame_ring failed! - %d\n", ret);
+
+#ifdef SELECT_MJPEG
+            for (i = 0; i < DISP_BUFF_CNT; i++)
+                fb[i] = g_OSD_base + i * SELECT_RES_WIDTH * SELECT_RES_HEIGHT * 2;
+            g_disp.vdev = NULL;
+            vpostSetOSDBuffer(fb[0]);
+
+            /* decode MJPEG images into OSD buffers and flip them on vsync */
+            ret = uvc_disp_init(&g_disp, g_vdev, fb, DISP_BUFF_CNT, SELECT_RES_WIDTH, SELECT_RES_HEIGHT,
+                                SELECT_RES_WIDTH, SELECT_RES_HEIGHT, JPEG_DEC_PRIMARY_PACKET_YUV422, UVC_DISP_LAYER_OSD);
+            if (ret != 0)
+                sysprintf("uvc_disp_init failed! - %d\n", ret);
+#endif
+            t_last = sysGetTicks(TIMER0);
+            cnt_last = 0;
+            shown_last = 0;
 
-            ret = usbh_uvc_start_streaming(g_vdev, uvc_rx_callbak);
+            ret = usbh_uvc_start_streaming(g_vdev, NULL);
             if (ret != 0)
             {
                 sysprintf("usbh_uvc_start_streaming failed! - %d\n", ret);
@@ -441,51 +434,63 @@ int32_t main(void)
                 show_menu();
         }
 
-        if (_ig[_idx_post].state == IMAGE_BUFF_READY)
-        {
-            _ig[_idx_post].state = IMAGE_BUFF_POST;
+        if (g_vdev == NULL)
+            continue;
 
-            if (do_sanpshot)
+        if (do_sanpshot)
+        {
+#ifdef SELECT_MJPEG
+            /* take the next received image away from the display pipeline */
+            uvc_disp_stop(&g_disp);
+#endif
+            frame = usbh_uvc_acquire_frame(g_vdev);
+            if (frame != NULL)
             {
 #ifdef SELECT_MJPEG
-                memcpy(snapshot_buff, _ig[_idx_post].buff, _ig[_idx_post].len);
-                snapshot_len = _ig[_idx_post].len;
+                memcpy(snapshot_buff, frame->buff, frame->len);
+                snapshot_len = frame->len;
 #else
-                ret = Encode_JPEG_Image(_ig[_idx_post].buff, _ig[_idx_post].len, snapshot_buff, &snapshot_len);
+                ret = Encode_JPEG_Image(frame->buff, frame->len, snapshot_buff, &snapshot_len);
                 if (ret == 0)
                     sysprintf("Snapshot image encode done.\n");
 #endif
+                usbh_uvc_release_frame(g_vdev, frame);
                 do_sanpshot = 0;
             }
-
-            if (post_snapshot_time != 0)
-            {
-                if (get_ticks() - post_snapshot_time > SNAPSHOT_POST_TIME)
-                    post_snapshot_time = 0;
-            }
-            else
-            {
+        }
+        else if (post_snapshot_time != 0)
+        {
+            if (get_ticks() - post_snapshot_time > SNAPSHOT_POST_TIME)
+                post_snapshot_time = 0;
+        }
+        else
+        {
 #ifdef SELECT_MJPEG
-                Decode_JPEG_Image(_ig[_idx_post].buff, _ig[_idx_post].len);
+            uvc_disp_poll(&g_disp);         /* never waits for the JPEG engine            */
 #else
-                memcpy(g_OSD_base, _ig[_idx_post].buff, _ig[_idx_post].len);
-#endif
+            frame = usbh_uvc_acquire_frame(g_vdev);
+            if (frame != NULL)
+            {
+                memcpy(g_OSD_base, frame->buff, frame->len);
+                usbh_uvc_release_frame(g_vdev, frame);
             }
-            _ig[_idx_post].state = IMAGE_BUFF_FREE;
-            _idx_post = (_idx_post + 1) % IMAGE_BUFF_CNT;
+#endif
         }
 
-        if (g_vdev == NULL)
-            continue;
-
         if (sysGetTicks(TIMER0) - t_last > 100)
         {
-            cnt_last = _total_frame_count - cnt_last;
+            usbh_uvc_get_frame_stat(g_vdev, &rx_cnt, &rx_drop, &rx_err);
+            uvc_disp_get_stat(&g_disp, &disp_stat);
 
-            sysprintf("Frame rate: %d, Total: %d        \r", (cnt_last*100)/(sysGetTicks(TIMER0) - t_last), _total_frame_count, HSUSBH->UPFLBAR, HSUSBH->UCALAR);
+            sysprintf("Rx: %d fps, Shown: %d fps, Skipped: %d, Dec err: %d, Latency: %d/%d/%d ms        \r",
+                      ((rx_cnt - cnt_last) * 100) / (sysGetTicks(TIMER0) - t_last),
+                      ((disp_stat.shown - shown_last) * 100) / (sysGetTicks(TIMER0) - t_last),
+                      disp_stat.skipped + rx_drop, disp_stat.decode_err,
+                      disp_stat.lat_min * 10, disp_stat.lat_avg * 10, disp_stat.lat_max * 10);
 
             t_last = sysGetTicks(TIMER0);
-            cnt_last = _total_frame_count;
+            cnt_last = rx_cnt;
+            shown_last = disp_stat.shown;
         }
 
         if (!sysIsKbHit())
@@ -508,7 +513,7 @@ int32_t main(void)
         case '2':
             if (g_vdev->is_streaming)
                 break;
-            ret = usbh_uvc_start_streaming(g_vdev, uvc_rx_callbak);
+            ret = usbh_uvc_start_streaming(g_vdev, NULL);
             if (ret != 0)
                 sysprintf("\nusbh_uvc_start_streaming failed! - %d\n", ret);
             break;
@@ -542,7 +547,7 @@ int32_t main(void)
             outpw(REG_SYS_GPF_MFPH, inpw(REG_SYS_GPF_MFPH) | 0x00000700); /* set PF.10 as USBH PPWR           */
 #endif
             usbh_resume();
-            ret = usbh_uvc_start_streaming(g_vdev, uvc_rx_callbak);
+            ret = usbh_uvc_start_streaming(g_vdev, NULL);
             if (ret != 0)
                 sysprintf("\nusbh_uvc_start_streaming failed! - %d\n", ret);
 
@@ -558,7 +563,13 @@ int32_t main(void)
         case '6':
             if (snapshot_len == 0)
                 break;
-            Decode_JPEG_Image(snapshot_buff, snapshot_len);
+            /* post the snapshot on the OSD buffer currently displayed */
+#ifdef SELECT_MJPEG
+            uvc_disp_stop(&g_disp);
+            Decode_JPEG_Image(snapshot_buff, snapshot_len, g_disp.fb[g_disp.front]);
+#else
+            Decode_JPEG_Image(snapshot_buff, snapshot_len, g_OSD_base);
+#endif
             post_snapshot_time = get_ticks();
             break;
 
@@ -4,7 +4,8 @@
  * $Revision: 1 $
  * $Date: 03/03/19 4:02p $
  * @brief    Use USB Host core driver and CDC driver. This sample demonstrates how
- *           to connect a CDC class VCOM device.
+ *           to connect a CDC class VCOM device and stream data through queued
+ *           bulk transfers.
  *
  * @note
  * Copyright (C) 2019 Nuvoton Technology Corp. All rights reserved.
@@ -20,15 +21,27 @@
 
 #define MAX_VCOM_PORT      8
 
+#define VCOM_BAUD_RATE     3000000     /* line rate set to the VCOM devices              */
+#define VCOM_RXQ_DEPTH     4           /* queued bulk-in transfers per port              */
+#define VCOM_TXQ_DEPTH     2           /* queued bulk-out transfers per port             */
+#define VCOM_XFER_SIZE     512         /* buffer size of a bulk transfer                 */
+#define VCOM_RING_SIZE     8192        /* receive ring size per port                     */
+
 uint32_t  g_buff_pool[1024] __attribute__((aligned(32)));
 
 char Line[64];             /* Console input buffer */
 
+uint8_t   g_rx_ring[MAX_VCOM_PORT][VCOM_RING_SIZE];
+uint8_t   g_rx_data[VCOM_RING_SIZE];
+
 typedef struct
 {
     CDC_DEV_T  *cdev;
     LINE_CODING_T  line_code;
     int    checked;
+    volatile int  throttled;      /* receive ring full, RTS should be deasserted   */
+    int    rts_off;               /* RTS deasserted                                */
+    uint32_t  rx_bytes;           /* bytes read in this second                     */
 }  VCOM_PORT_T;
 
 VCOM_PORT_T   vcom_dev[MAX_VCOM_PORT];
@@ -78,19 +91,13 @@ void  vcom_status_callback(CDC_DEV_T *cdev, uint8_t *rdata, int data_len)
     sysprintf("\n");
 }
 
-void  vcom_rx_callback(CDC_DEV_T *cdev, uint8_t *rdata, int data_len)
+/*
+ *  Called in USB interrupt context, so only remember the flow control state here. RTS is
+ *  changed by a control request in main loop.
+ */
+void  vcom_flow_control(CDC_DEV_T *cdev, int throttle)
 {
-    int   i, slot;
-
-    slot = (int)cdev->client;
-    //sysprintf("[%d][RX %d] ", cdev->iface_cdc->if_num, data_len);
-    sysprintf("[RX][VCOM%d]: ", slot);
-    for (i = 0; i < data_len; i++)
-    {
-        //sysprintf("0x%02x ", rdata[i]);
-        sysprintf("%c", rdata[i]);
-    }
-    sysprintf("\n");
+    vcom_dev[(int)cdev->client].throttled = throttle;
 }
 
 void show_line_coding(LINE_CODING_T *lc)
@@ -156,7 +163,7 @@ int  init_cdc_device(CDC_DEV_T *cdev, int slot)
     else
         show_line_coding(line_code);
 
-    line_code->baud = 115200;
+    line_code->baud = VCOM_BAUD_RATE;
     line_code->parity = 0;
     line_code->data_bits = 8;
     line_code->stop_bits = 0;
@@ -183,8 +190,18 @@ int  init_cdc_device(CDC_DEV_T *cdev, int slot)
     sysprintf("usbh_cdc_start_polling_status...\n");
     usbh_cdc_start_polling_status(cdev, vcom_status_callback);
 
-    sysprintf("usbh_cdc_start_to_receive_data...\n");
-    usbh_cdc_start_to_receive_data(cdev, vcom_rx_callback);
+    vcom_dev[slot].throttled = 0;
+    vcom_dev[slot].rts_off = 0;
+    vcom_dev[slot].rx_bytes = 0;
+
+    sysprintf("usbh_cdc_start_rx_queue...\n");
+    ret = usbh_cdc_start_rx_queue(cdev, VCOM_RXQ_DEPTH, VCOM_XFER_SIZE, g_rx_ring[slot], VCOM_RING_SIZE, vcom_flow_control);
+    if (ret < 0)
+        sysprintf("Start bulk-in queue failed: %d\n", ret);
+
+    ret = usbh_cdc_start_tx_queue(cdev, VCOM_TXQ_DEPTH, VCOM_XFER_SIZE);
+    if (ret < 0)
+        sysprintf("Start bulk-out queue failed: %d\n", ret);
 
     return 0;
 }
@@ -250,7 +267,9 @@ next_cdev:
 int32_t main(void)
 {
     CDC_DEV_T   *cdev;
+    CDC_QUEUE_STAT_T  qstat;
     int         i, ret;
+    uint32_t    t0;
     char        *message;
 
     sysDisableCache();
@@ -283,6 +302,7 @@ int32_t main(void)
     usbh_core_init();
     usbh_cdc_init();
     usbh_memory_used();
+    t0 = get_ticks();
 
     while(1)
     {
@@ -306,9 +326,33 @@ int32_t main(void)
             if (cdev == NULL)
                 continue;
 
-            if (!cdev->rx_busy)
+            /* Drain the receive ring. Received data is counted only, since printing it
+               to the console could not keep up with a multi-Mbit stream. */
+            while ((ret = usbh_cdc_read(cdev, g_rx_data, sizeof(g_rx_data))) > 0)
+                vcom_dev[i].rx_bytes += ret;
+
+            /* RTS follows receive ring flow control. */
+            if (vcom_dev[i].throttled != vcom_dev[i].rts_off)
+            {
+                vcom_dev[i].rts_off = vcom_dev[i].throttled;
+                usbh_cdc_set_control_line_state(cdev, !vcom_dev[i].rts_off, 1);
+            }
+        }
+
+        if (get_ticks() - t0 >= 100)         /* report throughput every second            */
+        {
+            t0 = get_ticks();
+            for (i = 0; i < MAX_VCOM_PORT; i++)
             {
-                usbh_cdc_start_to_receive_data(cdev, vcom_rx_callback);
+                cdev = vcom_dev[i].cdev;
+                if ((cdev == NULL) || (vcom_dev[i].rx_bytes == 0))
+                    continue;
+
+                usbh_cdc_get_queue_stat(cdev, &qstat, 1);
+                sysprintf("[VCOM%d] RX %d bytes/s, %d xfers, gaps %d (max %d ticks), throttled %d, errors %d\n",
+                          i, vcom_dev[i].rx_bytes, qstat.rx_xfers, qstat.rx_gaps, qstat.rx_gap_max,
+                          qstat.rx_throttle, qstat.rx_errors);
+                vcom_dev[i].rx_bytes = 0;
             }
         }
 
@@ -328,9 +372,9 @@ int32_t main(void)
                 sprintf(message, "To VCOM%d (VID:0x%x, PID:0x%x, interface %d).\n",
                         i, cdev->udev->descriptor.idVendor, cdev->udev->descriptor.idProduct, cdev->iface_cdc->if_num);
 
-                ret = usbh_cdc_send_data(cdev, (uint8_t *)message, 64);
-                if (ret != 0)
-                    sysprintf("\n!! Send data failed, 0x%x!\n", ret);
+                ret = usbh_cdc_write(cdev, (uint8_t *)message, 64);
+                if (ret != 64)
+                    sysprintf("\n!! Send data failed, %d!\n", ret);
             }
 
         }
@@ -14,6 +14,7 @@
 #include "fmi.h"
 #include "ff.h"
 #include "diskio.h"
+#include "disk_cache.h"
 
 
 #define SD0_DRIVE		0        /* for SD0          */
@@ -36,6 +37,9 @@ static BYTE  fatfs_win_buff_pool[DISK_BUFFER_SIZE] __attribute__((aligned(32)));
 
 BYTE  *fatfs_win_buff;
 
+static DRESULT emmc_media_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+static DRESULT emmc_media_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
 /*-----------------------------------------------------------------------*/
 /* Initialize a Drive                                                    */
 /*-----------------------------------------------------------------------*/
@@ -44,6 +48,7 @@ DSTATUS disk_initialize (BYTE pdrv)       /* Physical drive number (0..) */
 {
     if (FMI_EMMC_GET_CARD_CAPACITY() == 0)
         return STA_NOINIT;
+    disk_cache_attach(pdrv, emmc_media_read, emmc_media_write);
     return RES_OK;
 }
 
@@ -61,10 +66,10 @@ DSTATUS disk_status (BYTE pdrv)       /* Physical drive number (0..) */
 
 
 /*-----------------------------------------------------------------------*/
-/* Read Sector(s)                                                        */
+/* Read Sector(s) from the media                                         */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_read (
+static DRESULT emmc_media_read (
     BYTE pdrv,      /* Physical drive number (0..) */
     BYTE *buff,     /* Data buffer to store read data */
     DWORD sector,   /* Sector address (LBA) */
@@ -96,10 +101,10 @@ DRESULT disk_read (
 
 
 /*-----------------------------------------------------------------------*/
-/* Write Sector(s)                                                       */
+/* Write Sector(s) to the media                                          */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_write (
+static DRESULT emmc_media_write (
     BYTE pdrv,          /* Physical drive number (0..) */
     const BYTE *buff,   /* Data to be written */
     DWORD sector,       /* Sector address (LBA) */
@@ -129,6 +134,36 @@ DRESULT disk_write (
 }
 
 
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s)                                                        */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_read (
+    BYTE pdrv,      /* Physical drive number (0..) */
+    BYTE *buff,     /* Data buffer to store read data */
+    DWORD sector,   /* Sector address (LBA) */
+    UINT count      /* Number of sectors to read */
+)
+{
+    return disk_cache_read(pdrv, buff, sector, count);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s)                                                       */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_write (
+    BYTE pdrv,          /* Physical drive number (0..) */
+    const BYTE *buff,   /* Data to be written */
+    DWORD sector,       /* Sector address (LBA) */
+    UINT count          /* Number of sectors to write */
+)
+{
+    return disk_cache_write(pdrv, buff, sector, count);
+}
+
+
 /*-----------------------------------------------------------------------*/
 /* Miscellaneous Functions                                               */
 /*-----------------------------------------------------------------------*/
@@ -144,6 +179,7 @@ DRESULT disk_ioctl (
 
     switch(cmd) {
         case CTRL_SYNC:
+            res = disk_cache_sync(pdrv);
             break;
         case GET_SECTOR_COUNT:
             *(DWORD*)buff = eMMC.totalSectorN;
@@ -12,6 +12,7 @@
 #include "fmi.h"
 #include "ff.h"
 #include "diskio.h"
+#include "disk_cache.h"
 
 extern int emmc_ok;
 
@@ -28,6 +29,7 @@ void eMMC_Open_Disk(void)
 void eMMC_Close_Disk(void)
 {
     emmc_ok = 0;
+    disk_cache_invalidate(2);   /* drive 2, see _Path */
     memset(&eMMC, 0, sizeof(EMMC_INFO_T));
     f_mount(NULL, _Path, 1);
     memset(&_FatfsVoleMMC, 0, sizeof(FATFS));
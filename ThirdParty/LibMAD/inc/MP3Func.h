@@ -0,0 +1,22 @@
+//------------------------------------------------------------------------------
+// File Name      : MP3Func.h
+// Description    : PCM output stage of the MP3 player
+//------------------------------------------------------------------------------
+#ifndef __MP3FUNC_H__
+#define __MP3FUNC_H__
+
+#include <stdint.h>
+#include "mad.h"
+
+// Noise shaping and dither state of one channel, clear it before the first frame
+typedef struct
+{
+	mad_fixed_t error[3];
+	uint32_t random;
+} MP3_DITHER_T;
+
+signed int MP3FixedToShort(mad_fixed_t sample);
+void MP3PcmToI2S(uint32_t *pu32Dst, struct mad_pcm const *pcm, unsigned int u32Start,
+                 unsigned int u32Count, MP3_DITHER_T *dither);
+
+#endif
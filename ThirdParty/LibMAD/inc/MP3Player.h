@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+// File Name      : MP3Player.h
+// Description    : Streaming MP3 player engine, FatFs file to I2S DMA ring
+//------------------------------------------------------------------------------
+#ifndef __MP3PLAYER_H__
+#define __MP3PLAYER_H__
+
+#include "ff.h"
+
+// Engine buffers, define them in the project to change the defaults
+#ifndef MP3_PCM_PERIODS
+#define MP3_PCM_PERIODS        4           // I2S DMA periods, 2, 4 or 8
+#endif
+#ifndef MP3_PCM_PERIOD_SIZE
+#define MP3_PCM_PERIOD_SIZE    1152        // I2S words (stereo samples) per period
+#endif
+#ifndef MP3_PCM_WATERMARK
+#define MP3_PCM_WATERMARK      3           // periods decoded ahead, at most MP3_PCM_PERIODS - 1
+#endif
+#ifndef MP3_IN_RING_SIZE
+#define MP3_IN_RING_SIZE       (16*1024)   // input ring bytes, multiple of MP3_IN_READ_SIZE
+#endif
+#ifndef MP3_IN_READ_SIZE
+#define MP3_IN_READ_SIZE       4096        // bytes per f_read()
+#endif
+
+// MP3_SetDecodeMode() flags, cheaper decoding for speaker outputs and voice prompts
+#define MP3_DECODE_FULL        0x0         // full sampling rate, both channels
+#define MP3_DECODE_MONO        0x1         // mix stereo to one channel before IMDCT and synthesis
+#define MP3_DECODE_HALF_RATE   0x2         // synthesize half the sampling rate from the lower 16 subbands
+#define MP3_DECODE_DITHER      0x4         // dither and noise shape the 16-bit output instead of rounding
+
+// MP3_Service() states
+#define MP3_STATE_IDLE         0           // no track open
+#define MP3_STATE_PRIME        1           // decoding up to the watermark before I2S starts
+#define MP3_STATE_PLAY         2           // I2S playing, read and decode run ahead
+#define MP3_STATE_DRAIN        3           // input ended or sampling rate changes, I2S plays out the ring
+
+// Player telemetry, see MP3_GetStat()
+typedef struct
+{
+    unsigned int underrun;                 // I2S periods started before they were decoded
+    unsigned int pcmFill;                  // I2S words decoded ahead of the playing period now
+    unsigned int pcmFillMin;               // lowest pcmFill seen by the I2S callback
+    unsigned int inFill;                   // input ring bytes not decoded yet
+    unsigned int inFillMin;                // lowest inFill seen before a frame was decoded
+    unsigned int frames;                   // frames decoded
+    unsigned int decodeErrors;             // frames dropped by decoding errors
+    unsigned int tracks;                   // tracks started, gapless ones included
+    unsigned int decodeTicks;              // TIMER0 ticks spent in the decode stage
+} MP3_STAT_T;
+
+// Settings used by the next MP3_Open()
+void MP3_SetStartTime(unsigned int u32Sec);
+void MP3_SetResumeOffset(unsigned int u32Offset);
+unsigned int MP3_GetResumeOffset(void);
+void MP3_SetDecodeMode(unsigned int u32Mode);
+
+// Playback
+int MP3_Open(const char *pFileName);
+int MP3_QueueNext(const char *pFileName);
+void MP3_Seek(unsigned int u32Sec);
+void MP3_RequestStop(void);
+void MP3_Close(void);
+int MP3_Service(void);
+int MP3_GetState(void);
+int MP3_ReadStage(void);
+int MP3_DecodeStage(void);
+void MP3_GetStat(MP3_STAT_T *stat, int clear);
+FSIZE_t MP3_Id3v2Size(FIL *fp);
+
+// FreeRTOS only, MP3PlayerTask.c
+int MP3_StartTasks(unsigned int u32ReadPriority, unsigned int u32DecodePriority);
+
+// Provided by the application: set the I2S clocks for a new sampling rate
+void i2sConfigSampleRate(unsigned int u32SampleRate);
+
+#endif
@@ -1,5 +1,18 @@
 
-#include "fixed.h"
+#include <stddef.h>
+#include "mad.h"
+#include "MP3Func.h"
+
+// bits dropped from a MAD_F sample to get 16-bit PCM
+#define PCM_SCALEBITS	(MAD_F_FRACBITS + 1 - 16)
+
+// round to 16 bits and saturate, same result as MP3FixedToShort()
+#define PCM_ROUND(v, sample)  \
+    do { \
+        (v) = ((sample) + (1L << (PCM_SCALEBITS - 1))) >> PCM_SCALEBITS;  \
+        if (((v) >> 15) != ((v) >> 31))  \
+            (v) = ((v) >> 31) ^ 0x7fff;  \
+    } while (0)
 
 //------------------------------------------------------------------------------
 // Function Name  : MP3FixedToShort
@@ -22,3 +35,116 @@ signed int MP3FixedToShort(mad_fixed_t sample)
 	/* quantize */
 	return sample >> (MAD_F_FRACBITS + 1 - 16);
 }
+
+//------------------------------------------------------------------------------
+// Function Name  : MP3DitherSample
+// Description    : Quantize a sample to 16 bits with TPDF dither and
+//                  second order noise shaping
+// Input          : sample, dither state of its channel
+// Output         : None
+// Return         : 16-bit sample
+//------------------------------------------------------------------------------
+static signed int MP3DitherSample(mad_fixed_t sample, MP3_DITHER_T *dither)
+{
+	mad_fixed_t output, mask;
+	uint32_t random;
+
+	mask = (1L << PCM_SCALEBITS) - 1;
+
+	/* noise shape */
+	sample += dither->error[0] - dither->error[1] + dither->error[2];
+
+	dither->error[2] = dither->error[1];
+	dither->error[1] = dither->error[0] / 2;
+
+	/* bias */
+	output = sample + (1L << (PCM_SCALEBITS - 1));
+
+	/* dither, difference of two uniform values */
+	random = dither->random * 0x0019660d + 0x3c6ef35f;
+	output += (mad_fixed_t)(random & mask) - (mad_fixed_t)(dither->random & mask);
+	dither->random = random;
+
+	/* clip */
+	if (output >= MAD_F_ONE)
+	{
+		output = MAD_F_ONE - 1;
+		if (sample >= MAD_F_ONE)
+			sample = MAD_F_ONE - 1;
+	}
+	else if (output < -MAD_F_ONE)
+	{
+		output = -MAD_F_ONE;
+		if (sample < -MAD_F_ONE)
+			sample = -MAD_F_ONE;
+	}
+
+	/* quantize */
+	output &= ~mask;
+
+	/* error feedback */
+	dither->error[0] = sample - output;
+
+	return output >> PCM_SCALEBITS;
+}
+
+//------------------------------------------------------------------------------
+// Function Name  : MP3PcmToI2S
+// Description    : Convert synthesized samples to 16-bit stereo I2S words,
+//                  right channel in the low half word. Mono is sent to both
+//                  channels.
+// Input          : pu32Dst   - I2S buffer
+//                  pcm       - synthesized frame
+//                  u32Start  - first sample of the frame to convert
+//                  u32Count  - number of samples to convert
+//                  dither    - dither state of both channels, or NULL to
+//                              round only
+// Output         : None
+// Return         : None
+//------------------------------------------------------------------------------
+void MP3PcmToI2S(uint32_t *pu32Dst, struct mad_pcm const *pcm, unsigned int u32Start,
+                 unsigned int u32Count, MP3_DITHER_T *dither)
+{
+	mad_fixed_t const *left, *right;
+	signed int l0, r0, l1, r1;
+
+	left  = &pcm->samples[0][u32Start];
+	right = &pcm->samples[1][u32Start];
+
+	if (dither != NULL)
+	{
+		while (u32Count--)
+		{
+			l0 = MP3DitherSample(*left++, &dither[0]);
+			r0 = (pcm->channels == 2) ? MP3DitherSample(*right++, &dither[1]) : l0;
+			*pu32Dst++ = (uint16_t)r0 | ((uint32_t)l0 << 16);
+		}
+		return;
+	}
+
+	if (pcm->channels != 2)
+		right = left;
+
+	/* two words per pass, stored as one burst */
+	for (; u32Count >= 2; u32Count -= 2)
+	{
+		PCM_ROUND(l0, left[0]);
+		PCM_ROUND(r0, right[0]);
+		PCM_ROUND(l1, left[1]);
+		PCM_ROUND(r1, right[1]);
+
+		pu32Dst[0] = (uint16_t)r0 | ((uint32_t)l0 << 16);
+		pu32Dst[1] = (uint16_t)r1 | ((uint32_t)l1 << 16);
+
+		left += 2;
+		right += 2;
+		pu32Dst += 2;
+	}
+
+	if (u32Count)
+	{
+		PCM_ROUND(l0, left[0]);
+		PCM_ROUND(r0, right[0]);
+		pu32Dst[0] = (uint16_t)r0 | ((uint32_t)l0 << 16);
+	}
+}
@@ -0,0 +1,873 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id: minimad.c,v 1.4 2004/01/23 09:41:32 rob Exp $
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "N9H31.h"
+#include "sys.h"
+
+#include "ff.h"
+#include "clmt_cache.h"
+#include "mad.h"
+#include "MP3Func.h"
+#include "MP3Player.h"
+#include "i2s.h"
+
+/*
+ * Streaming player engine. Three stages share two rings:
+ *
+ *   MP3_ReadStage()    f_read() to the input ring            moves mp3InWr
+ *   MP3_DecodeStage()  input ring to libmad to the PCM ring  moves mp3InRd, mp3InLap, the ring commit position
+ *   I2S driver         DMA plays the PCM ring                moves the ring DMA position
+ *
+ * Each position has a single writer, so the read and decode stages can be
+ * called from the main loop by MP3_Service() or from two RTOS tasks, the read
+ * task at the higher priority. Seeking, stopping and track switching are done
+ * by the decode stage and reopen or close the file, so the decode stage must
+ * not run while the read stage is inside f_read(). MP3PlayerTask.c runs the
+ * stages as two FreeRTOS tasks that share one lock.
+ *
+ * libmad needs each frame in contiguous memory. When it stops at the ring end
+ * with the rest of the frame wrapped to the ring start, the partial frame is
+ * copied to the guard area just before the ring start and decoding goes on
+ * from there, so at most one frame is copied per ring lap.
+ *
+ * The PCM ring is the I2S driver DMA ring of MP3_PCM_PERIODS periods, see
+ * i2sRingOpen(). The driver silences played periods and reports underruns.
+ */
+
+#define MP3_IN_GUARD        2048        // longest frame, 1728 bytes for Layer II 384 kbps at 32 kHz
+#define MP3_PCM_RING_SIZE   (MP3_PCM_PERIODS * MP3_PCM_PERIOD_SIZE)
+#define MP3_DECODER_DELAY   529         // synthesis delay in samples, removed by the LAME gapless info
+#define MP3_NO_LIMIT        0xFFFFFFFF
+#define MP3_NAME_SIZE       128
+
+#if (MP3_PCM_PERIODS != 2) && (MP3_PCM_PERIODS != 4) && (MP3_PCM_PERIODS != 8)
+    #error "MP3_PCM_PERIODS must be 2, 4 or 8"
+#endif
+
+#if (MP3_PCM_WATERMARK >= MP3_PCM_PERIODS)
+    #error "MP3_PCM_WATERMARK must be less than MP3_PCM_PERIODS"
+#endif
+
+static struct mad_stream   Stream;
+static struct mad_frame    Frame;
+static struct mad_synth    Synth;
+
+static FIL      mp3File;
+// Input ring behind the guard area that takes a frame split by the ring end
+static uint8_t mp3InBuffer[MP3_IN_GUARD + MP3_IN_RING_SIZE] __attribute__((aligned(32)));
+#define mp3InRing       (&mp3InBuffer[MP3_IN_GUARD])
+// I2S DMA ring of MP3_PCM_PERIODS periods
+static uint32_t aPCMBuffer[MP3_PCM_RING_SIZE] __attribute__((aligned(32)));
+
+// Input ring positions in bytes since the track was opened, ring index is position % MP3_IN_RING_SIZE
+static volatile uint32_t mp3InWr;       // end of the data read
+static volatile uint32_t mp3InRd;       // next frame to decode
+static volatile uint32_t mp3InLap;      // position of mp3InRing[0]
+static uint32_t mp3InFed;               // end of the data given to libmad
+static uint32_t mp3InGuard;             // zero bytes still to append after the last track
+static volatile uint8_t mp3InEnd;       // the last track is read up to its guard bytes
+static uint8_t mp3FileOpen;
+static volatile uint8_t mp3Playing;     // I2S DMA is running
+static volatile MP3_STAT_T mp3Stat;
+
+static volatile int mp3State = MP3_STATE_IDLE;
+// I2S sampling rate, 0 until the first frame is decoded
+static unsigned int mp3Rate;
+// The decoded frame waits for I2S to drain before the sampling rate changes
+static uint8_t mp3FramePending;
+
+// Track being decoded
+static char mp3CurName[MP3_NAME_SIZE];
+static uint32_t mp3TrackPos;            // input position of the first byte after the ID3v2 tag
+static FSIZE_t mp3TrackId3v2;
+static uint8_t mp3FirstFrame;           // the next frame may be a Xing/Info frame
+static uint32_t mp3TrackFrames;         // Xing/Info frame count, 0 if unknown
+static uint32_t mp3TrackBytes;          // Xing/Info byte count, 0 if unknown
+static uint8_t mp3Toc[100];             // Xing/Info seek table
+static uint8_t mp3HasToc;
+static uint32_t mp3TrackSamples;        // samples of the LAME gapless info, MP3_NO_LIMIT if unknown
+static uint32_t mp3Skip;                // samples still to drop at the track start
+static uint32_t mp3Keep;                // samples still to play, MP3_NO_LIMIT if not trimmed
+static volatile int mp3SeekSec = -1;
+
+// Track queued by MP3_QueueNext(), opened by the read stage at the end of the current one
+static char mp3NextName[MP3_NAME_SIZE];
+static volatile uint8_t mp3NextRead;    // the read stage switched to the queued track
+static uint32_t mp3NextPos;             // input position where the queued track starts
+static FSIZE_t mp3ReadId3v2;            // ID3v2 size of the track being read
+
+// where the next MP3_Open() starts, in bytes after the ID3v2 tag
+static unsigned int mp3ResumeOffset = 0;
+// start time requested by MP3_SetStartTime(), converted once the bit rate is known
+static unsigned int mp3StartTime = 0;
+static volatile uint8_t mp3StopRequest = 0;
+// MP3_DECODE_xxx flags used by the next MP3_Open()
+static unsigned int mp3DecodeMode = MP3_DECODE_FULL;
+// noise shaping state of MP3_DECODE_DITHER, left and right
+static MP3_DITHER_T mp3Dither[2];
+static MP3_DITHER_T *mp3DitherPtr;
+
+// Start the next MP3_Open() u32Sec seconds into the song
+void MP3_SetStartTime(unsigned int u32Sec)
+{
+    mp3StartTime = u32Sec;
+    mp3ResumeOffset = 0;
+}
+
+// Start the next MP3_Open() at an offset returned by MP3_GetResumeOffset()
+void MP3_SetResumeOffset(unsigned int u32Offset)
+{
+    mp3ResumeOffset = u32Offset;
+    mp3StartTime = 0;
+}
+
+// Offset where MP3_RequestStop() last stopped a track, 0 if it played to the end
+unsigned int MP3_GetResumeOffset(void)
+{
+    return mp3ResumeOffset;
+}
+
+// Ask the decode stage to close the track after the current frame and remember the position
+void MP3_RequestStop(void)
+{
+    mp3StopRequest = 1;
+}
+
+// Select MP3_DECODE_xxx flags for the next MP3_Open()
+void MP3_SetDecodeMode(unsigned int u32Mode)
+{
+    mp3DecodeMode = u32Mode;
+}
+
+/**
+ * MP3 frame can be attached with either ID3v1 or v2, or both
+ * [ID3v2][Frame][Frame]...[Frame][ID3v1]
+ * ID3v2 : ['ID3' + ...], total 10 bytes header + tag frame(M bytes)
+ * ID3v1 : ['TAG' + ...], total 128 bytes
+ * Frame : [4 bytes header + body(N bytes)]
+ */
+FSIZE_t MP3_Id3v2Size(FIL *fp)
+{
+    uint8_t hdr[10];
+    UINT len;
+
+    f_lseek(fp, 0);
+    if ((f_read(fp, hdr, 10, &len) == FR_OK) && (len >= 10) && !memcmp(hdr, "ID3", 3) &&
+        !((hdr[6] | hdr[7] | hdr[8] | hdr[9]) & 0x80))
+    {
+        return (((hdr[6] & 0x7f) << 21) | ((hdr[7] & 0x7f) << 14) | ((hdr[8] & 0x7f) << 7) | (hdr[9] & 0x7f)) + 10;
+    }
+    return 0;
+}
+
+static FSIZE_t MP3_Id3v1Size(FIL *fp)
+{
+    uint8_t tag[3];
+    UINT len;
+
+    if (fp->obj.objsize < 128)
+        return 0;
+    f_lseek(fp, fp->obj.objsize - 128);
+    if ((f_read(fp, tag, 3, &len) == FR_OK) && (len >= 3) && !memcmp(tag, "TAG", 3))
+        return 128;
+    return 0;
+}
+
+// Open a track for the read stage, positioned after its ID3v2 tag and ending before its ID3v1 tag
+static FRESULT MP3_OpenTrack(const char *pFileName)
+{
+    FRESULT res;
+
+    /* The link map keeps later seeks from walking the FAT chain */
+    res = clmt_open(&mp3File, (void *)pFileName, FA_OPEN_EXISTING | FA_READ);
+    if (res != FR_OK)
+        return res;
+    mp3FileOpen = 1;
+
+    mp3ReadId3v2 = MP3_Id3v2Size(&mp3File);
+    mp3File.obj.objsize -= MP3_Id3v1Size(&mp3File);
+    return f_lseek(&mp3File, mp3ReadId3v2);
+}
+
+// I2S words decoded ahead of the playing period, all of the ring after an underrun
+static uint32_t MP3_PcmFill(void)
+{
+    int32_t avail = i2sRingAvail(I2S_PLAY);
+
+    return (avail < 0) ? MP3_PCM_RING_SIZE : MP3_PCM_RING_SIZE - avail / 4;
+}
+
+// I2S period call-back, tracks the lowest PCM fill while playing
+static void MP3_PeriodCallback(uint32_t u32Dir)
+{
+    uint32_t fill;
+
+    if (mp3State != MP3_STATE_PLAY)
+        return;
+
+    /* The period starting now was not decoded in time */
+    if (i2sRingAvail(I2S_PLAY) < 0)
+    {
+        mp3Stat.underrun++;
+        fill = 0;
+    }
+    else
+    {
+        fill = MP3_PcmFill();
+    }
+    if (fill < mp3Stat.pcmFillMin)
+        mp3Stat.pcmFillMin = fill;
+}
+
+// Enable I2S TX with PDMA function
+static void StartPlay(void)
+{
+    sysprintf("Start playing ... \n");
+    // DMA starts at the ring start, one interrupt per period
+    i2sRingStart(I2S_PLAY);
+
+    // enable sound output
+    //PI3 = 0;
+    mp3Playing = 1;
+}
+
+// Disable I2S TX with PDMA function
+static void StopPlay(void)
+{
+    // Rewind the ring to silence
+    i2sRingStop(I2S_PLAY);
+
+    mp3Playing = 0;
+    sysprintf("Stop ...\n");
+}
+
+// Open a track and start streaming it, MP3_Service() does the rest
+int MP3_Open(const char *pFileName)
+{
+    int options = 0;
+
+    MP3_Close();
+
+    if (i2sRingOpen(I2S_PLAY, aPCMBuffer, MP3_PCM_PERIOD_SIZE * 4, MP3_PCM_PERIODS, MP3_PeriodCallback) != 0)
+        return -1;
+    mp3InWr = mp3InRd = mp3InLap = mp3InFed = 0;
+    mp3InGuard = 0;
+    mp3InEnd = 0;
+    mp3Rate = 0;
+    mp3FramePending = 0;
+    mp3NextRead = 0;
+    mp3StopRequest = 0;
+    MP3_GetStat(NULL, 1);
+    mp3Stat.tracks = 1;
+
+    if (MP3_OpenTrack(pFileName) != FR_OK)
+    {
+        //sysprintf("Open file error \r\n");
+        i2sRingClose(I2S_PLAY);
+        return -1;
+    }
+    strncpy(mp3CurName, pFileName, MP3_NAME_SIZE - 1);
+    mp3CurName[MP3_NAME_SIZE - 1] = '\0';
+    mp3TrackId3v2 = mp3ReadId3v2;
+    mp3TrackPos = 0;
+    mp3FirstFrame = 1;
+    mp3Skip = 0;
+    mp3Keep = MP3_NO_LIMIT;
+    mp3SeekSec = -1;
+
+    if (mp3ResumeOffset != 0)
+    {
+        /* In fast seek mode this does not walk the FAT chain, whatever the offset */
+        if (mp3TrackId3v2 + mp3ResumeOffset < mp3File.obj.objsize)
+        {
+            f_lseek(&mp3File, mp3TrackId3v2 + mp3ResumeOffset);
+            mp3TrackPos = 0 - mp3ResumeOffset;
+            mp3FirstFrame = 0;
+        }
+        mp3ResumeOffset = 0;
+    }
+    else if (mp3StartTime != 0)
+    {
+        mp3SeekSec = mp3StartTime;
+        mp3StartTime = 0;
+    }
+
+    /* First the structures used by libmad must be initialized. */
+    mad_stream_init(&Stream);
+    mad_frame_init(&Frame);
+    mad_synth_init(&Synth);
+
+    /* Mono mixes the channels before IMDCT, half rate skips the upper 16 subbands */
+    if (mp3DecodeMode & MP3_DECODE_MONO)
+        options |= MAD_OPTION_SINGLECHANNEL;
+    if (mp3DecodeMode & MP3_DECODE_HALF_RATE)
+        options |= MAD_OPTION_HALFSAMPLERATE;
+    mad_stream_options(&Stream, options);
+
+    mp3DitherPtr = NULL;
+    if (mp3DecodeMode & MP3_DECODE_DITHER)
+    {
+        memset(mp3Dither, 0, sizeof(mp3Dither));
+        mp3DitherPtr = mp3Dither;
+    }
+
+    mp3State = MP3_STATE_PRIME;
+    return 0;
+}
+
+// Play pFileName right after the current track without a gap, before the current track is read to its end
+int MP3_QueueNext(const char *pFileName)
+{
+    if (mp3State == MP3_STATE_IDLE)
+        return MP3_Open(pFileName);
+    if (mp3NextRead || mp3InEnd)
+        return -1;
+
+    strncpy(mp3NextName, pFileName, MP3_NAME_SIZE - 1);
+    mp3NextName[MP3_NAME_SIZE - 1] = '\0';
+    return 0;
+}
+
+// Jump u32Sec seconds into the current track
+void MP3_Seek(unsigned int u32Sec)
+{
+    if (mp3State == MP3_STATE_IDLE)
+        MP3_SetStartTime(u32Sec);
+    else
+        mp3SeekSec = u32Sec;
+}
+
+void MP3_Close(void)
+{
+    if (mp3State == MP3_STATE_IDLE)
+        return;
+
+    if (mp3Playing)
+        StopPlay();
+    i2sRingClose(I2S_PLAY);
+    if (mp3FileOpen)
+    {
+        clmt_close(&mp3File);
+        mp3FileOpen = 0;
+    }
+
+    mad_synth_finish(&Synth);
+    mad_frame_finish(&Frame);
+    mad_stream_finish(&Stream);
+
+    mp3NextName[0] = '\0';
+    mp3State = MP3_STATE_IDLE;
+}
+
+// Copy the telemetry to stat if not NULL, and restart it if clear is set
+void MP3_GetStat(MP3_STAT_T *stat, int clear)
+{
+    if (stat != NULL)
+    {
+        *stat = *(MP3_STAT_T *)&mp3Stat;
+        stat->pcmFill = (i2sRingAvail(I2S_PLAY) < 0) ? 0 : MP3_PcmFill();
+        stat->inFill = mp3InWr - mp3InRd;
+    }
+    if (clear)
+    {
+        memset((void *)&mp3Stat, 0, sizeof(mp3Stat));
+        mp3Stat.pcmFillMin = MP3_PCM_RING_SIZE;
+        mp3Stat.inFillMin = MP3_IN_RING_SIZE;
+    }
+}
+
+// Fill the input ring from the file, returns the bytes added
+int MP3_ReadStage(void)
+{
+    uint32_t wr, rd, len;
+    UINT got;
+    FRESULT res;
+
+    if ((mp3State == MP3_STATE_IDLE) || mp3InEnd)
+        return 0;
+
+    /* Data before the ring start has been copied to the guard area */
+    wr = mp3InWr;
+    rd = mp3InRd;
+    if ((int32_t)(mp3InLap - rd) > 0)
+        rd = mp3InLap;
+    len = MP3_IN_RING_SIZE - (wr - rd);
+    if (len > MP3_IN_RING_SIZE - wr % MP3_IN_RING_SIZE)
+        len = MP3_IN_RING_SIZE - wr % MP3_IN_RING_SIZE;
+    if (len > MP3_IN_READ_SIZE)
+        len = MP3_IN_READ_SIZE;
+
+    if (!mp3FileOpen)
+    {
+        /* The guard bytes after the last track let libmad decode its last frame */
+        if (len > mp3InGuard)
+            len = mp3InGuard;
+        memset(&mp3InRing[wr % MP3_IN_RING_SIZE], 0, len);
+        mp3InGuard -= len;
+        mp3InWr = wr + len;
+        if (mp3InGuard == 0)
+            mp3InEnd = 1;
+        return len;
+    }
+    if (len == 0)
+        return 0;
+
+    res = f_read(&mp3File, &mp3InRing[wr % MP3_IN_RING_SIZE], len, &got);
+    if ((res == FR_OK) && (got != 0))
+    {
+        mp3InWr = wr + got;
+        return got;
+    }
+
+    if (res != FR_OK)
+        sysprintf("Stop !(%x)\n\r", res);
+    clmt_close(&mp3File);
+    mp3FileOpen = 0;
+
+    /* The queued track continues in the same ring, the decoder finds where it starts */
+    if ((res == FR_OK) && (mp3NextName[0] != '\0') && !mp3NextRead)
+    {
+        if (MP3_OpenTrack(mp3NextName) == FR_OK)
+        {
+            mp3NextPos = wr;
+            mp3NextRead = 1;
+            return 0;
+        }
+        mp3NextName[0] = '\0';
+    }
+    mp3InGuard = MAD_BUFFER_GUARD;
+    return 0;
+}
+
+// Hand the input ring from mp3InRd to libmad, 0 if there is nothing new
+static int MP3_FeedStream(void)
+{
+    uint32_t rd = mp3InRd, wr, end, len;
+
+    /* libmad stopped at the ring end, move the partial frame in front of the ring start */
+    end = mp3InLap + MP3_IN_RING_SIZE;
+    if ((mp3InFed == end) && ((int32_t)(mp3InWr - end) >= 0))
+    {
+        len = end - rd;
+        if (len > MP3_IN_GUARD)
+        {
+            /* not a frame, libmad will search for the next sync word */
+            rd = end - MP3_IN_GUARD;
+            len = MP3_IN_GUARD;
+        }
+        memcpy(mp3InRing - len, &mp3InRing[MP3_IN_RING_SIZE - len], len);
+        mp3InLap = end;
+        mp3InRd = rd;
+        end += MP3_IN_RING_SIZE;
+    }
+
+    wr = mp3InWr;
+    if ((int32_t)(wr - end) > 0)
+        wr = end;
+    if (wr == mp3InFed)
+        return 0;
+
+    mad_stream_buffer(&Stream, mp3InRing + (int32_t)(rd - mp3InLap), wr - rd);
+    Stream.error = MAD_ERROR_NONE;
+    mp3InFed = wr;
+    return 1;
+}
+
+// Input position of a libmad stream pointer
+static uint32_t MP3_InPos(unsigned char const *ptr)
+{
+    return mp3InLap + (uint32_t)(ptr - mp3InRing);
+}
+
+// Pad the PCM ring with silence up to the next period start
+static void MP3_PadPeriod(void)
+{
+    uint32_t *pu32Dst, len;
+    int32_t avail = i2sRingAvail(I2S_PLAY);
+
+    if ((avail <= 0) || (i2sRingBegin(I2S_PLAY, (void **)&pu32Dst) <= 0))
+        return;
+
+    /* periods never straddle the ring end */
+    len = (avail / 4) % MP3_PCM_PERIOD_SIZE;
+    memset(pu32Dst, 0, len * 4);
+    i2sRingCommit(I2S_PLAY, len * 4);
+}
+
+// The decoder reached the track queued by MP3_QueueNext()
+static void MP3_NextTrack(void)
+{
+    strcpy(mp3CurName, mp3NextName);
+    mp3NextName[0] = '\0';
+    mp3TrackPos = mp3NextPos;
+    mp3TrackId3v2 = mp3ReadId3v2;
+    mp3NextRead = 0;
+
+    /* No overlap, synthesis history or bit reservoir carries over to the new track */
+    mad_frame_mute(&Frame);
+    mad_synth_mute(&Synth);
+    Stream.md_len = 0;
+
+    mp3FirstFrame = 1;
+    mp3Skip = 0;
+    mp3Keep = MP3_NO_LIMIT;
+    mp3Stat.tracks++;
+}
+
+#define MP3_BE32(p)     (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (p)[3])
+
+/*
+ * The first frame of a VBR or LAME encoded track may be a Xing/Info frame
+ * without audio: [header][side info size of zeros]['Xing' or 'Info'][flags]
+ * [frames][bytes][TOC 100 bytes][quality]['LAME' tag]. The LAME tag holds the
+ * encoder delay and padding, 12 bits each at byte 21 of the tag.
+ * Returns 1 for an Xing/Info frame.
+ */
+static int MP3_ParseInfoFrame(void)
+{
+    unsigned char const *tag, *end = Stream.next_frame;
+    uint32_t flags, spf, delay, padding, total;
+    int single = (Frame.header.mode == MAD_MODE_SINGLE_CHANNEL);
+
+    mp3TrackFrames = mp3TrackBytes = 0;
+    mp3HasToc = 0;
+    mp3TrackSamples = MP3_NO_LIMIT;
+
+    if (Frame.header.layer != MAD_LAYER_III)
+        return 0;
+    tag = Stream.this_frame + 4;
+    if (Frame.header.flags & MAD_FLAG_PROTECTION)
+        tag += 2;
+    if (Frame.header.flags & MAD_FLAG_LSF_EXT)
+        tag += single ? 9 : 17;
+    else
+        tag += single ? 17 : 32;
+    if ((tag + 8 > end) || (memcmp(tag, "Xing", 4) && memcmp(tag, "Info", 4)))
+        return 0;
+
+    flags = MP3_BE32(tag + 4);
+    tag += 8;
+    if ((flags & 0x1) && (tag + 4 <= end))
+    {
+        mp3TrackFrames = MP3_BE32(tag);
+        tag += 4;
+    }
+    if ((flags & 0x2) && (tag + 4 <= end))
+    {
+        mp3TrackBytes = MP3_BE32(tag);
+        tag += 4;
+    }
+    if ((flags & 0x4) && (tag + 100 <= end))
+    {
+        memcpy(mp3Toc, tag, 100);
+        mp3HasToc = 1;
+        tag += 100;
+    }
+    if (flags & 0x8)
+        tag += 4;
+
+    if ((tag + 24 <= end) && !memcmp(tag, "LAME", 4))
+    {
+        delay = (tag[21] << 4) | (tag[22] >> 4);
+        padding = ((tag[22] & 0xf) << 8) | tag[23];
+        spf = 32 * MAD_NSBSAMPLES(&Frame.header);
+        total = mp3TrackFrames * spf;
+        mp3Skip = delay + MP3_DECODER_DELAY;
+        if (total > delay + padding)
+            mp3TrackSamples = total - delay - padding;
+        if (Stream.options & MAD_OPTION_HALFSAMPLERATE)
+        {
+            mp3Skip /= 2;
+            if (mp3TrackSamples != MP3_NO_LIMIT)
+                mp3TrackSamples /= 2;
+        }
+        mp3Keep = mp3TrackSamples;
+    }
+    return 1;
+}
+
+// Restart the current track u32Sec seconds in, from the Xing/Info seek table or the bit rate
+static void MP3_DoSeek(unsigned int u32Sec)
+{
+    uint32_t offset, duration, pct, done;
+
+    if (mp3HasToc && mp3TrackFrames && mp3TrackBytes && Frame.header.samplerate)
+    {
+        duration = (uint32_t)((unsigned long long)mp3TrackFrames * 32 * MAD_NSBSAMPLES(&Frame.header) /
+                              Frame.header.samplerate);
+        pct = duration ? u32Sec * 100 / duration : 0;
+        if (pct > 99)
+            pct = 99;
+        offset = (uint32_t)((unsigned long long)mp3Toc[pct] * mp3TrackBytes / 256);
+    }
+    else
+    {
+        offset = (uint32_t)((unsigned long long)u32Sec * Frame.header.bitrate / 8);
+    }
+
+    /* The read stage may already be in the queued track */
+    if (mp3NextRead || !mp3FileOpen)
+    {
+        if (mp3FileOpen)
+            clmt_close(&mp3File);
+        mp3FileOpen = 0;
+        mp3NextRead = 0;
+        if (MP3_OpenTrack(mp3CurName) != FR_OK)
+        {
+            mp3InGuard = MAD_BUFFER_GUARD;
+            return;
+        }
+    }
+    if (mp3TrackId3v2 + offset >= mp3File.obj.objsize)
+        offset = 0;
+    f_lseek(&mp3File, mp3TrackId3v2 + offset);
+
+    mp3InWr = mp3InRd = mp3InLap = mp3InFed = 0;
+    mp3InGuard = 0;
+    mp3InEnd = 0;
+    mp3TrackPos = 0 - offset;
+    Stream.error = MAD_ERROR_BUFLEN;
+    Stream.md_len = 0;
+    mad_frame_mute(&Frame);
+    mad_synth_mute(&Synth);
+
+    /* From the frame header, no frame may have been synthesized yet when MP3_SetStartTime() was used */
+    mp3Skip = 0;
+    if (mp3TrackSamples != MP3_NO_LIMIT)
+    {
+        done = u32Sec * Frame.header.samplerate;
+        if (Stream.options & MAD_OPTION_HALFSAMPLERATE)
+            done /= 2;
+        mp3Keep = (mp3TrackSamples > done) ? mp3TrackSamples - done : 0;
+    }
+}
+
+// Synthesize the decoded frame to the PCM ring, -1 if I2S must drain for a new sampling rate first
+static int MP3_OutputFrame(void)
+{
+    unsigned int rate = Frame.header.samplerate;
+    uint32_t start, count, len, *pu32Dst;
+    int32_t avail;
+
+    if (Stream.options & MAD_OPTION_HALFSAMPLERATE)
+        rate /= 2;
+    if (rate != mp3Rate)
+    {
+        if ((mp3State == MP3_STATE_PRIME) && (MP3_PcmFill() == 0))
+        {
+            /* Configure to specific sample rate */
+            i2sConfigSampleRate(rate);
+            mp3Rate = rate;
+        }
+        else
+        {
+            mp3FramePending = 1;
+            MP3_PadPeriod();
+            mp3State = MP3_STATE_DRAIN;
+            return -1;
+        }
+    }
+
+    /* Once decoded the frame is synthesized to PCM samples. No errors
+     * are reported by mad_synth_frame();
+     */
+    mad_synth_frame(&Synth, &Frame);
+
+    /* Gapless trimming of the encoder delay and padding */
+    start = 0;
+    count = Synth.pcm.length;
+    if (mp3Skip)
+    {
+        len = (mp3Skip < count) ? mp3Skip : count;
+        mp3Skip -= len;
+        start += len;
+        count -= len;
+    }
+    if (mp3Keep != MP3_NO_LIMIT)
+    {
+        if (count > mp3Keep)
+            count = mp3Keep;
+        mp3Keep -= count;
+    }
+
+    while (count)
+    {
+        /* Round, saturate and interleave as much of the frame as fits before the ring end */
+        avail = i2sRingBegin(I2S_PLAY, (void **)&pu32Dst);
+        if (avail <= 0)
+            break;
+        len = avail / 4;
+        if (len > count)
+            len = count;
+        MP3PcmToI2S(pu32Dst, &Synth.pcm, start, len, mp3DitherPtr);
+        i2sRingCommit(I2S_PLAY, len * 4);
+        start += len;
+        count -= len;
+    }
+    return 0;
+}
+
+// Decode until the PCM ring holds MP3_PCM_WATERMARK periods ahead of I2S, returns the state
+int MP3_DecodeStage(void)
+{
+    uint32_t ahead, t0;
+    int seek;
+
+    if ((mp3State != MP3_STATE_IDLE) && mp3StopRequest)
+    {
+        /* resume from the first frame not decoded yet */
+        mp3StopRequest = 0;
+        mp3ResumeOffset = mp3InRd - mp3TrackPos;
+        MP3_Close();
+        return mp3State;
+    }
+
+    if (mp3State == MP3_STATE_DRAIN)
+    {
+        /* A track shorter than the watermark never started I2S */
+        if (!mp3Playing && (MP3_PcmFill() != 0))
+            StartPlay();
+        /* Drained once I2S runs into the first period not written */
+        if (mp3Playing && (i2sRingAvail(I2S_PLAY) >= 0))
+            return mp3State;
+
+        if (mp3Playing)
+            StopPlay();
+        if (!mp3FramePending)
+        {
+            MP3_Close();
+            return mp3State;
+        }
+        /* Restart I2S at the new sampling rate */
+        mp3State = MP3_STATE_PRIME;
+    }
+    if (mp3State == MP3_STATE_IDLE)
+        return mp3State;
+
+    t0 = sysGetTicks(TIMER0);
+    while (1)
+    {
+        if (i2sRingAvail(I2S_PLAY) < 0)
+        {
+            /* Underrun, continue at the next period I2S has not started */
+            i2sRingRecover(I2S_PLAY);
+        }
+        ahead = MP3_PcmFill();
+        if ((mp3State == MP3_STATE_PRIME) && (ahead >= MP3_PCM_WATERMARK * MP3_PCM_PERIOD_SIZE))
+        {
+            StartPlay();
+            mp3State = MP3_STATE_PLAY;
+        }
+        if ((ahead >= (MP3_PCM_WATERMARK + 1) * MP3_PCM_PERIOD_SIZE) || (ahead + 1152 > MP3_PCM_RING_SIZE))
+            break;
+
+        if (mp3FramePending)
+        {
+            mp3FramePending = 0;
+            if (MP3_OutputFrame() != 0)
+                break;
+            continue;
+        }
+
+        if ((Stream.buffer == NULL) || (Stream.error == MAD_ERROR_BUFLEN))
+        {
+            if (!MP3_FeedStream())
+            {
+                if (mp3InEnd && (mp3InFed == mp3InWr))
+                {
+                    /* the last frame is decoded */
+                    MP3_PadPeriod();
+                    mp3State = MP3_STATE_DRAIN;
+                }
+                break;
+            }
+        }
+
+        if (mp3NextRead && ((int32_t)(mp3InRd - mp3NextPos) >= 0))
+            MP3_NextTrack();
+        if ((mp3State == MP3_STATE_PLAY) && !mp3InEnd && (mp3InWr - mp3InRd < mp3Stat.inFillMin))
+            mp3Stat.inFillMin = mp3InWr - mp3InRd;
+
+        /* decode a frame from the mp3 stream data */
+        if (mad_frame_decode(&Frame, &Stream))
+        {
+            mp3InRd = MP3_InPos(Stream.next_frame);
+            /* the current frame is not full, need to read the remaining part */
+            if (Stream.error == MAD_ERROR_BUFLEN)
+                continue;
+            if (MAD_RECOVERABLE(Stream.error))
+            {
+                if (Stream.error != MAD_ERROR_LOSTSYNC)
+                    mp3Stat.decodeErrors++;
+                continue;
+            }
+
+            sysprintf("Something error!!\n");
+            MP3_PadPeriod();
+            mp3State = MP3_STATE_DRAIN;
+            break;
+        }
+        mp3InRd = MP3_InPos(Stream.next_frame);
+        mp3Stat.frames++;
+
+        if (mp3FirstFrame)
+        {
+            mp3FirstFrame = 0;
+            /* the Xing/Info frame is silent */
+            if (MP3_ParseInfoFrame())
+                continue;
+        }
+
+        seek = mp3SeekSec;
+        if (seek >= 0)
+        {
+            mp3SeekSec = -1;
+            MP3_DoSeek(seek);
+            continue;
+        }
+
+        if (MP3_OutputFrame() != 0)
+            break;
+    }
+    /* 10 ms ticks, the sum over many calls averages out the tick phase */
+    mp3Stat.decodeTicks += sysGetTicks(TIMER0) - t0;
+
+    return mp3State;
+}
+
+// MP3_STATE_xxx state, MP3_STATE_IDLE once the track has been played or stopped
+int MP3_GetState(void)
+{
+    return mp3State;
+}
+
+// Run the read and decode stages once, returns the MP3_STATE_xxx state
+int MP3_Service(void)
+{
+    if (mp3State == MP3_STATE_IDLE)
+        return mp3State;
+
+    MP3_ReadStage();
+    return MP3_DecodeStage();
+}
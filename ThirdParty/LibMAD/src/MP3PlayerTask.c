@@ -0,0 +1,92 @@
+//------------------------------------------------------------------------------
+// File Name      : MP3PlayerTask.c
+// Description    : Runs the MP3 player engine stages as FreeRTOS tasks
+//
+//                  Add this file to FreeRTOS projects only. Bare-metal
+//                  applications call MP3_Service() from their main loop, and
+//                  GCC projects that build LibMAD/src exclude this file.
+//------------------------------------------------------------------------------
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "MP3Player.h"
+
+#define MP3_TASK_STACK_SIZE     1024        // in words, libmad decodes on the decode task stack
+#define MP3_TASK_IDLE_MS        10          // no track open
+#define MP3_TASK_WAIT_MS        5           // input ring or PCM ring full, well below one period
+
+static SemaphoreHandle_t mp3TaskLock;
+
+//------------------------------------------------------------------------------
+// Function Name  : MP3_ReadTask
+// Description    : Keeps the input ring filled, sleeps while it is full
+//------------------------------------------------------------------------------
+static void MP3_ReadTask(void *pvParameters)
+{
+	int got;
+
+	for (;;)
+	{
+		xSemaphoreTake(mp3TaskLock, portMAX_DELAY);
+		got = MP3_ReadStage();
+		xSemaphoreGive(mp3TaskLock);
+
+		if (got == 0)
+			vTaskDelay(MP3_TASK_WAIT_MS / portTICK_PERIOD_MS);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Function Name  : MP3_DecodeTask
+// Description    : Decodes up to the PCM watermark, then sleeps. The ARM9
+//                  port has no yield from the I2S interrupt, so the task
+//                  polls instead of waiting for the period call-back.
+//------------------------------------------------------------------------------
+static void MP3_DecodeTask(void *pvParameters)
+{
+	int state;
+
+	for (;;)
+	{
+		xSemaphoreTake(mp3TaskLock, portMAX_DELAY);
+		state = MP3_DecodeStage();
+		xSemaphoreGive(mp3TaskLock);
+
+		if (state == MP3_STATE_IDLE)
+			vTaskDelay(MP3_TASK_IDLE_MS / portTICK_PERIOD_MS);
+		else
+			vTaskDelay(MP3_TASK_WAIT_MS / portTICK_PERIOD_MS);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Function Name  : MP3_StartTasks
+// Description    : Start a read task and a decode task in place of
+//                  MP3_Service(). The stages take turns under a lock, so
+//                  MP3_Seek(), MP3_QueueNext() and MP3_RequestStop() can be
+//                  called from any task. Call MP3_Open() only while
+//                  MP3_GetState() is MP3_STATE_IDLE, for example after
+//                  MP3_RequestStop() has taken effect.
+// Input          : u32ReadPriority   - FreeRTOS priority of the read task,
+//                                      above the decode task
+//                  u32DecodePriority - FreeRTOS priority of the decode task
+// Output         : None
+// Return         : 0 on success, -1 if out of FreeRTOS heap
+//------------------------------------------------------------------------------
+int MP3_StartTasks(unsigned int u32ReadPriority, unsigned int u32DecodePriority)
+{
+	/* a binary semaphore, configUSE_MUTEXES is not needed */
+	mp3TaskLock = xSemaphoreCreateBinary();
+	if (mp3TaskLock == NULL)
+		return -1;
+	xSemaphoreGive(mp3TaskLock);
+
+	if (xTaskCreate(MP3_ReadTask, "mp3_read", MP3_TASK_STACK_SIZE / 2, NULL, u32ReadPriority, NULL) != pdPASS)
+		return -1;
+	if (xTaskCreate(MP3_DecodeTask, "mp3_decode", MP3_TASK_STACK_SIZE, NULL, u32DecodePriority, NULL) != pdPASS)
+		return -1;
+	return 0;
+}
@@ -433,6 +433,40 @@ int mad_header_decode(struct mad_header *header, struct mad_stream *stream)
   return -1;
 }
 
+/*
+ * NAME:	select_channel()
+ * DESCRIPTION:	apply the channel options to Layer I and II subband samples
+ *		(Layer III applies them before the IMDCT)
+ */
+static
+void select_channel(struct mad_frame *frame)
+{
+  unsigned int ns, s, sb;
+
+  ns = MAD_NSBSAMPLES(&frame->header);
+
+  switch (frame->options & MAD_OPTION_SINGLECHANNEL) {
+  case MAD_OPTION_LEFTCHANNEL:
+    break;
+
+  case MAD_OPTION_RIGHTCHANNEL:
+    for (s = 0; s < ns; ++s) {
+      for (sb = 0; sb < 32; ++sb)
+	frame->sbsample[0][s][sb] = frame->sbsample[1][s][sb];
+    }
+    break;
+
+  default:
+    for (s = 0; s < ns; ++s) {
+      for (sb = 0; sb < 32; ++sb) {
+	frame->sbsample[0][s][sb] =
+	  (frame->sbsample[0][s][sb] >> 1) + (frame->sbsample[1][s][sb] >> 1);
+      }
+    }
+    break;
+  }
+}
+
 /*
  * NAME:	frame->decode()
  * DESCRIPTION:	decode a single frame from a bitstream
@@ -459,6 +493,11 @@ int mad_frame_decode(struct mad_frame *frame, struct mad_stream *stream)
     goto fail;
   }
 
+  if (frame->header.layer != MAD_LAYER_III &&
+      frame->header.mode != MAD_MODE_SINGLE_CHANNEL &&
+      (frame->options & MAD_OPTION_SINGLECHANNEL))
+    select_channel(frame);
+
   /* ancillary_data() */
 
   if (frame->header.layer != MAD_LAYER_III) {
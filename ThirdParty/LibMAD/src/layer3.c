@@ -1574,7 +1574,7 @@ void III_aliasreduce(mad_fixed_t xr[576], int lines)
 }
 
 # if defined(ASO_IMDCT)
-void III_imdct_l2(mad_fixed_t const [18], mad_fixed_t [36], unsigned int);
+void III_imdct_l(mad_fixed_t const [18], mad_fixed_t [36], unsigned int);
 # else
 #  if 1
 static
@@ -2071,9 +2071,6 @@ void imdct36(mad_fixed_t const X[18], mad_fixed_t x[36])
  * NAME:	III_imdct_l()
  * DESCRIPTION:	perform IMDCT and windowing for long blocks
  */
-#  ifndef __WINS__
-void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36], unsigned int block_type);
-#  else
 static
 void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
 		 unsigned int block_type)
@@ -2155,7 +2152,6 @@ void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
     break;
   }
 }
-#  endif
 # endif  /* ASO_IMDCT */
 
 /*
@@ -2362,6 +2358,166 @@ void III_freqinver(mad_fixed_t sample[18][32], unsigned int sb)
 # endif
 }
 
+/*
+ * NAME:	III_reconstruct()
+ * DESCRIPTION:	reorder, alias reduce, IMDCT, overlap-add and frequency invert
+ *		one granule of one channel
+ */
+static
+void III_reconstruct(mad_fixed_t xr[576], struct channel const *channel,
+		     unsigned char const *sfbwidth,
+		     mad_fixed_t overlap[32][18], mad_fixed_t sample[18][32],
+		     int options)
+{
+  unsigned int sb, l, i, sblimit;
+  mad_fixed_t output[36];
+
+  if (channel->block_type == 2) {
+    III_reorder(xr, channel, sfbwidth);
+
+# if !defined(OPT_STRICT)
+    /*
+     * According to ISO/IEC 11172-3, "Alias reduction is not applied for
+     * granules with block_type == 2 (short block)." However, other
+     * sources suggest alias reduction should indeed be performed on the
+     * lower two subbands of mixed blocks. Most other implementations do
+     * this, so by default we will too.
+     */
+    if (channel->flags & mixed_block_flag)
+      III_aliasreduce(xr, 36);
+# endif
+  }
+  else
+    III_aliasreduce(xr, 576);
+
+  l = 0;
+
+  /* subbands 0-1 */
+
+  if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
+    unsigned int block_type;
+
+    block_type = channel->block_type;
+    if (channel->flags & mixed_block_flag)
+      block_type = 0;
+
+    /* long blocks */
+    for (sb = 0; sb < 2; ++sb, l += 18) {
+      III_imdct_l(&xr[l], output, block_type);
+      III_overlap(output, overlap[sb], sample, sb);
+    }
+  }
+  else {
+    /* short blocks */
+    for (sb = 0; sb < 2; ++sb, l += 18) {
+      III_imdct_s(&xr[l], output);
+      III_overlap(output, overlap[sb], sample, sb);
+    }
+  }
+
+  III_freqinver(sample, 1);
+
+  /* (nonzero) subbands 2-31 */
+
+  i = 576;
+  while (i > 36 && xr[i - 1] == 0)
+    --i;
+
+  sblimit = 32 - (576 - i) / 18;
+
+  /* half rate synthesis drops the upper 16 subbands */
+
+  if ((options & MAD_OPTION_HALFSAMPLERATE) && sblimit > 16)
+    sblimit = 16;
+
+  if (channel->block_type != 2) {
+    /* long blocks */
+    for (sb = 2; sb < sblimit; ++sb, l += 18) {
+      III_imdct_l(&xr[l], output, channel->block_type);
+      III_overlap(output, overlap[sb], sample, sb);
+
+      if (sb & 1)
+	III_freqinver(sample, sb);
+    }
+  }
+  else {
+    /* short blocks */
+    for (sb = 2; sb < sblimit; ++sb, l += 18) {
+      III_imdct_s(&xr[l], output);
+      III_overlap(output, overlap[sb], sample, sb);
+
+      if (sb & 1)
+	III_freqinver(sample, sb);
+    }
+  }
+
+  /* remaining (zero) subbands */
+
+  for (sb = sblimit; sb < 32; ++sb) {
+    III_overlap_z(overlap[sb], sample, sb);
+
+    if (sb & 1)
+      III_freqinver(sample, sb);
+  }
+}
+
+/*
+ * NAME:	III_downmix()
+ * DESCRIPTION:	reconstruct one granule of both channels as a single
+ *		(left + right) / 2 channel in sbsample[0]
+ */
+static
+void III_downmix(mad_fixed_t xr[2][576], struct granule const *granule,
+		 unsigned char const *sfbwidth[2], struct mad_frame *frame,
+		 unsigned int gr)
+{
+  struct channel const *left  = &granule->ch[0];
+  struct channel const *right = &granule->ch[1];
+  mad_fixed_t (*sample)[32] = &frame->sbsample[0][18 * gr];
+  unsigned int sb, s, i;
+
+  /*
+   * The rest of the reconstruction is linear and depends on the block type
+   * only, so with equal block types the spectra are mixed and one channel
+   * is reconstructed. The mixed block overlap is kept in overlap[0], and
+   * overlap[1] stays zero.
+   */
+
+  if (left->block_type == right->block_type &&
+      (left->flags & mixed_block_flag) == (right->flags & mixed_block_flag)) {
+    for (i = 0; i < 576; ++i)
+      xr[0][i] = (xr[0][i] >> 1) + (xr[1][i] >> 1);
+
+    III_reconstruct(xr[0], left, sfbwidth[0], (*frame->overlap)[0],
+		    sample, frame->options);
+    return;
+  }
+
+  /* otherwise reconstruct both halves and mix the subband samples */
+
+  for (i = 0; i < 576; ++i) {
+    xr[0][i] >>= 1;
+    xr[1][i] >>= 1;
+  }
+
+  III_reconstruct(xr[0], left, sfbwidth[0], (*frame->overlap)[0],
+		  sample, frame->options);
+  III_reconstruct(xr[1], right, sfbwidth[1], (*frame->overlap)[1],
+		  &frame->sbsample[1][18 * gr], frame->options);
+
+  for (s = 0; s < 18; ++s) {
+    for (sb = 0; sb < 32; ++sb)
+      sample[s][sb] += frame->sbsample[1][18 * gr + s][sb];
+  }
+
+  for (sb = 0; sb < 32; ++sb) {
+    for (s = 0; s < 18; ++s) {
+      (*frame->overlap)[0][sb][s] += (*frame->overlap)[1][sb][s];
+      (*frame->overlap)[1][sb][s]  = 0;
+    }
+  }
+}
+
 /*
  * NAME:	III_decode()
  * DESCRIPTION:	decode frame main_data
@@ -2436,93 +2592,30 @@ enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
 
     /* reordering, alias reduction, IMDCT, overlap-add, frequency inversion */
 
-    for (ch = 0; ch < nch; ++ch) {
-      struct channel const *channel = &granule->ch[ch];
-      mad_fixed_t (*sample)[32] = &frame->sbsample[ch][18 * gr];
-      unsigned int sb, l, i, sblimit;
-      mad_fixed_t output[36];
-
-      if (channel->block_type == 2) {
-	III_reorder(xr[ch], channel, sfbwidth[ch]);
-
-# if !defined(OPT_STRICT)
-	/*
-	 * According to ISO/IEC 11172-3, "Alias reduction is not applied for
-	 * granules with block_type == 2 (short block)." However, other
-	 * sources suggest alias reduction should indeed be performed on the
-	 * lower two subbands of mixed blocks. Most other implementations do
-	 * this, so by default we will too.
-	 */
-	if (channel->flags & mixed_block_flag)
-	  III_aliasreduce(xr[ch], 36);
-# endif
-      }
-      else
-	III_aliasreduce(xr[ch], 576);
-
-      l = 0;
+    if (nch == 2 && (frame->options & MAD_OPTION_SINGLECHANNEL)) {
+      mad_fixed_t (*sample)[32] = &frame->sbsample[0][18 * gr];
 
-      /* subbands 0-1 */
+      switch (frame->options & MAD_OPTION_SINGLECHANNEL) {
+      case MAD_OPTION_LEFTCHANNEL:
+	III_reconstruct(xr[0], &granule->ch[0], sfbwidth[0],
+			(*frame->overlap)[0], sample, frame->options);
+	break;
 
-      if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
-	unsigned int block_type;
+      case MAD_OPTION_RIGHTCHANNEL:
+	III_reconstruct(xr[1], &granule->ch[1], sfbwidth[1],
+			(*frame->overlap)[0], sample, frame->options);
+	break;
 
-	block_type = channel->block_type;
-	if (channel->flags & mixed_block_flag)
-	  block_type = 0;
-
-	/* long blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
-      }
-      else {
-	/* short blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
-      }
-
-      III_freqinver(sample, 1);
-
-      /* (nonzero) subbands 2-31 */
-
-      i = 576;
-      while (i > 36 && xr[ch][i - 1] == 0)
-	--i;
-
-      sblimit = 32 - (576 - i) / 18;
-
-      if (channel->block_type != 2) {
-	/* long blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, channel->block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
-      }
-      else {
-	/* short blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
+      default:
+	III_downmix(xr, granule, sfbwidth, frame, gr);
+	break;
       }
-
-      /* remaining (zero) subbands */
-
-      for (sb = sblimit; sb < 32; ++sb) {
-	III_overlap_z((*frame->overlap)[ch][sb], sample, sb);
-
-	if (sb & 1)
-	  III_freqinver(sample, sb);
+    }
+    else {
+      for (ch = 0; ch < nch; ++ch) {
+	III_reconstruct(xr[ch], &granule->ch[ch], sfbwidth[ch],
+			(*frame->overlap)[ch], &frame->sbsample[ch][18 * gr],
+			frame->options);
       }
     }
   }
@@ -31,30 +31,6 @@
 # include "frame.h"
 # include "synth.h"
 
-/*
- * The following utility routine performs simple rounding, clipping, and
- * scaling of MAD's high-resolution samples down to 16 bits. It does not
- * perform any dithering or noise shaping, which would be recommended to
- * obtain any exceptional audio quality. It is therefore not recommended to
- * use this routine if high-quality output is desired.
- */
- 
-static 
-signed int scale(mad_fixed_t sample)
-{
-  /* round */
-  sample += (1L << (MAD_F_FRACBITS - 16));
-
-  /* clip */
-  if (sample >= MAD_F_ONE)
-    sample = MAD_F_ONE - 1;
-  else if (sample < -MAD_F_ONE)
-    sample = -MAD_F_ONE;
-
-  /* quantize */
-  return sample >> (MAD_F_FRACBITS + 1 - 16);
-}
-
 /*
  * NAME:	synth->init()
  * DESCRIPTION:	initialize synth struct
@@ -585,15 +561,12 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
 		unsigned int nch, unsigned int ns)
 {
   unsigned int phase, ch, s, sb, pe, po;
-//  mad_fixed_t *pcm1, *pcm2, (*filter)[2][2][16][8];
-  short *pcm1, *pcm2;
-  mad_fixed_t (*filter)[2][2][16][8];
+  mad_fixed_t *pcm1, *pcm2, (*filter)[2][2][16][8];
   mad_fixed_t const (*sbsample)[36][32];
   register mad_fixed_t (*fe)[8], (*fx)[8], (*fo)[8];
   register mad_fixed_t const (*Dptr)[32], *ptr;
   register mad_fixed64hi_t hi;
   register mad_fixed64lo_t lo;
-  mad_fixed_t raw_sample;
 
   for (ch = 0; ch < nch; ++ch) {
     sbsample = &frame->sbsample[ch];
@@ -637,10 +610,7 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
       MLA(hi, lo, (*fe)[6], ptr[ 4]);
       MLA(hi, lo, (*fe)[7], ptr[ 2]);
 
-//      *pcm1++ = SHIFT(MLZ(hi, lo));
-      raw_sample = SHIFT(MLZ(hi, lo));
-      raw_sample = scale(raw_sample);
-      *pcm1++ = (short)raw_sample;
+      *pcm1++ = SHIFT(MLZ(hi, lo));
 
       pcm2 = pcm1 + 30;
 
@@ -671,10 +641,7 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
 		MLA(hi, lo, (*fe)[1], ptr[14]);
 		MLA(hi, lo, (*fe)[0], ptr[ 0]);
 	
-//		*pcm1++ = SHIFT(MLZ(hi, lo));
-        raw_sample = SHIFT(MLZ(hi, lo));
-        raw_sample = scale(raw_sample);
-        *pcm1++ = (short)raw_sample;
+		*pcm1++ = SHIFT(MLZ(hi, lo));
 	
 		ptr = *Dptr - pe;
 		ML0(hi, lo, (*fe)[0], ptr[31 - 16]);
@@ -696,10 +663,7 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
 		MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
 		MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
 	
-//		*pcm2-- = SHIFT(MLZ(hi, lo));
-        raw_sample = SHIFT(MLZ(hi, lo));
-        raw_sample = scale(raw_sample);
-        *pcm2-- = (short)raw_sample;
+		*pcm2-- = SHIFT(MLZ(hi, lo));
 	
 		++fo;
       }
@@ -716,12 +680,8 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
       MLA(hi, lo, (*fo)[6], ptr[ 4]);
       MLA(hi, lo, (*fo)[7], ptr[ 2]);
 
-//      *pcm1 = SHIFT(-MLZ(hi, lo));
-//      pcm1 += 16;
-      raw_sample = SHIFT(-MLZ(hi, lo));
-      raw_sample = scale(raw_sample);
-      *pcm1 = (short)raw_sample;
-	  pcm1 += 16;
+      *pcm1 = SHIFT(-MLZ(hi, lo));
+      pcm1 += 16;
 
       phase = (phase + 1) % 16;
     }
@@ -750,7 +710,7 @@ void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
     sbsample = &frame->sbsample[ch];
     filter   = &synth->filter[ch];
     phase    = synth->phase;
-//    pcm1     = synth->pcm.samples[ch];
+    pcm1     = synth->pcm.samples[ch];
 
     for (s = 0; s < ns; ++s) {
       dct32((*sbsample)[s], phase >> 1,
@@ -881,6 +841,10 @@ void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
   nch = MAD_NCHANNELS(&frame->header);
   ns  = MAD_NSBSAMPLES(&frame->header);
 
+  /* the selected or combined channel is in sbsample[0] */
+  if (frame->options & MAD_OPTION_SINGLECHANNEL)
+    nch = 1;
+
   synth->pcm.samplerate = frame->header.samplerate;
   synth->pcm.channels   = nch;
   synth->pcm.length     = 32 * ns;
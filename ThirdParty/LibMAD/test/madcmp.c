@@ -0,0 +1,325 @@
+/*
+ * madcmp - host harness comparing two builds of LibMAD.
+ *
+ * Decodes an MPEG audio stream with the library built in this program and
+ * writes the synthesized PCM, as 32-bit mad_fixed_t, to a file. Built twice
+ * with different settings, for example two FPM_* arithmetic variants, the
+ * two outputs are compared with -c. madcmp.sh does both steps.
+ *
+ *   madcmp [-o opts] [-r repeat] in.mp3 out.pcm   decode and time
+ *   madcmp -g frames out.mp3                      write a test stream
+ *   madcmp -c ref.pcm test.pcm                     compare two outputs
+ *
+ * The test stream has valid Layer III headers and side information with
+ * pseudo-random spectral data. It exercises every window type, and is used
+ * when no MP3 file is given. Real music should be checked as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "mad.h"
+
+static unsigned char *load(char const *path, long *size)
+{
+  FILE *fp;
+  unsigned char *buf;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fseek(fp, 0, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  /* MAD_BUFFER_GUARD zero bytes let the last frame decode */
+  buf = calloc(1, *size + MAD_BUFFER_GUARD);
+  if (buf == NULL || fread(buf, 1, *size, fp) != (size_t) *size) {
+    fprintf(stderr, "%s: read failed\n", path);
+    exit(1);
+  }
+  fclose(fp);
+  return buf;
+}
+
+/* decode */
+
+static int decode(unsigned char const *buf, long size, int options, FILE *out,
+                  unsigned long *frames, unsigned long *errors)
+{
+  struct mad_stream stream;
+  struct mad_frame frame;
+  struct mad_synth synth;
+  unsigned int i, ch;
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+  mad_synth_init(&synth);
+  mad_stream_options(&stream, options);
+  mad_stream_buffer(&stream, buf, size + MAD_BUFFER_GUARD);
+
+  *frames = *errors = 0;
+  for (;;) {
+    if (mad_frame_decode(&frame, &stream) == -1) {
+      if (stream.error == MAD_ERROR_BUFLEN)
+        break;
+      if (!MAD_RECOVERABLE(stream.error)) {
+        fprintf(stderr, "decode error 0x%04x\n", stream.error);
+        return -1;
+      }
+      ++*errors;
+      continue;
+    }
+    mad_synth_frame(&synth, &frame);
+    ++*frames;
+
+    if (out) {
+      for (i = 0; i < synth.pcm.length; ++i) {
+        for (ch = 0; ch < synth.pcm.channels; ++ch)
+          fwrite(&synth.pcm.samples[ch][i], sizeof(mad_fixed_t), 1, out);
+      }
+    }
+  }
+
+  mad_synth_finish(&synth);
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+  return 0;
+}
+
+static int run_decode(char const *in, char const *outpath, int options, int repeat)
+{
+  unsigned char *buf;
+  long size;
+  FILE *out;
+  unsigned long frames, errors;
+  clock_t t0;
+  double sec;
+  int i;
+
+  buf = load(in, &size);
+  out = fopen(outpath, "wb");
+  if (out == NULL) {
+    perror(outpath);
+    return 1;
+  }
+  if (decode(buf, size, options, out, &frames, &errors) < 0)
+    return 1;
+  fclose(out);
+
+  t0 = clock();
+  for (i = 0; i < repeat; ++i)
+    decode(buf, size, options, NULL, &frames, &errors);
+  sec = (double) (clock() - t0) / CLOCKS_PER_SEC;
+
+  printf("%s: %lu frames, %lu skipped", in, frames, errors);
+  if (repeat && frames)
+    printf(", %.2f us/frame", sec * 1e6 / ((double) frames * repeat));
+  printf("\n");
+
+  free(buf);
+  return 0;
+}
+
+/* compare */
+
+/* as the players convert to 16 bits, without rounding */
+static long to16(mad_fixed_t x)
+{
+  if (x >= MAD_F_ONE)
+    x = MAD_F_ONE - 1;
+  else if (x < -MAD_F_ONE)
+    x = -MAD_F_ONE;
+  return x >> (MAD_F_FRACBITS - 15);
+}
+
+static int run_compare(char const *ref, char const *test)
+{
+  mad_fixed_t *a, *b;
+  long na, nb, n, i, diff = 0, diff16 = 0;
+  double sig = 0, err = 0, d, maxerr = 0;
+  long max16 = 0, d16;
+
+  a = (mad_fixed_t *) load(ref, &na);
+  b = (mad_fixed_t *) load(test, &nb);
+  if (na != nb) {
+    printf("length differs: %ld and %ld bytes\n", na, nb);
+    return 1;
+  }
+  n = na / sizeof(mad_fixed_t);
+
+  for (i = 0; i < n; ++i) {
+    if (a[i] == b[i])
+      continue;
+    ++diff;
+    d = (double) a[i] - b[i];
+    err += d * d;
+    if (fabs(d) > maxerr)
+      maxerr = fabs(d);
+
+    d16 = labs(to16(a[i]) - to16(b[i]));
+    if (d16) {
+      ++diff16;
+      if (d16 > max16)
+        max16 = d16;
+    }
+  }
+  for (i = 0; i < n; ++i)
+    sig += (double) a[i] * a[i];
+
+  printf("%ld samples, %ld differ, %ld differ at 16 bits (max %ld LSB)\n",
+         n, diff, diff16, max16);
+  if (diff) {
+    printf("max error %.0f (%.2f 16-bit LSB), SNR %.1f dB\n",
+           maxerr, maxerr / (1L << (MAD_F_FRACBITS - 15)),
+           err ? 10 * log10(sig / err) : 0);
+  }
+  return diff ? 2 : 0;
+}
+
+/* test stream */
+
+static unsigned long seed = 1;
+
+static unsigned int rnd(unsigned int n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (unsigned int) (seed >> 16) % n;
+}
+
+struct bitw {
+  unsigned char *p;
+  unsigned int pos;
+};
+
+static void put(struct bitw *w, unsigned int value, unsigned int len)
+{
+  while (len--) {
+    if ((value >> len) & 1)
+      w->p[w->pos >> 3] |= 0x80 >> (w->pos & 7);
+    ++w->pos;
+  }
+}
+
+/*
+ * MPEG-1 Layer III, 44100 Hz, 128 kbit/s, joint stereo without padding:
+ * 417 bytes, 32 of side information, 381 of main data. main_data_begin is
+ * 0, so each frame decodes on its own.
+ */
+static int run_generate(int count, char const *outpath)
+{
+  static unsigned char const tables[] = { 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12,
+                                          13, 15, 16, 24 };
+  unsigned char frame[417];
+  struct bitw w;
+  unsigned int gr, ch, bits, len;
+  unsigned int block_type = 0, mixed = 0, ms, i;
+  FILE *out;
+  int n;
+
+  out = fopen(outpath, "wb");
+  if (out == NULL) {
+    perror(outpath);
+    return 1;
+  }
+
+  for (n = 0; n < count; ++n) {
+    memset(frame, 0, sizeof(frame));
+    ms = rnd(2);
+    frame[0] = 0xff;
+    frame[1] = 0xfb;
+    frame[2] = 0x90;
+    frame[3] = 0x40 | (ms << 5);        /* joint stereo, MS or not */
+
+    w.p = frame + 4;
+    w.pos = 0;
+    put(&w, 0, 9);                      /* main_data_begin */
+    put(&w, 0, 3);                      /* private_bits */
+    put(&w, 0, 8);                      /* scfsi */
+
+    bits = (sizeof(frame) - 36) * 8;
+    for (gr = 0; gr < 2; ++gr) {
+      for (ch = 0; ch < 2; ++ch) {
+        len = bits / 4 - rnd(200);
+        put(&w, len, 12);               /* part2_3_length */
+        put(&w, 16 + rnd(48), 9);       /* big_values, leaves room for count1 */
+        put(&w, 130 + rnd(40), 8);      /* global_gain, mostly below full scale */
+        put(&w, rnd(16), 4);            /* scalefac_compress */
+
+        /* MS stereo needs the same block type in both channels */
+        if (ch == 0 || !ms) {
+          block_type = rnd(4);
+          mixed = block_type == 2 ? rnd(2) : 0;
+        }
+        if (block_type) {
+          put(&w, 1, 1);                /* window_switching_flag */
+          put(&w, block_type, 2);
+          put(&w, mixed, 1);
+          for (i = 0; i < 2; ++i)
+            put(&w, tables[rnd(sizeof(tables))], 5);
+          for (i = 0; i < 3; ++i)
+            put(&w, rnd(3), 3);         /* subblock_gain */
+        }
+        else {
+          put(&w, 0, 1);
+          for (i = 0; i < 3; ++i)
+            put(&w, tables[rnd(sizeof(tables))], 5);
+          put(&w, rnd(8), 4);           /* region0_count */
+          put(&w, rnd(4), 3);           /* region1_count */
+        }
+        put(&w, rnd(2), 1);             /* preflag */
+        put(&w, rnd(2), 1);             /* scalefac_scale */
+        put(&w, rnd(2), 1);             /* count1table_select */
+      }
+    }
+
+    for (i = 36; i < sizeof(frame); ++i)
+      frame[i] = rnd(256);
+
+    fwrite(frame, 1, sizeof(frame), out);
+  }
+
+  fclose(out);
+  return 0;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: madcmp [-o opts] [-r repeat] in.mp3 out.pcm\n"
+          "       madcmp -g frames out.mp3\n"
+          "       madcmp -c ref.pcm test.pcm\n"
+          "opts: MAD_OPTION_* flags, 0x2 half rate, 0x30 mono\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int options = 0, repeat = 20;
+
+  while (argc > 1 && argv[1][0] == '-') {
+    if (argc < 4)
+      usage();
+    if (strcmp(argv[1], "-c") == 0)
+      return run_compare(argv[2], argv[3]);
+    if (strcmp(argv[1], "-g") == 0)
+      return run_generate(atoi(argv[2]), argv[3]);
+    if (strcmp(argv[1], "-o") == 0)
+      options = (int) strtol(argv[2], NULL, 0);
+    else if (strcmp(argv[1], "-r") == 0)
+      repeat = atoi(argv[2]);
+    else
+      usage();
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc != 3)
+    usage();
+
+  return run_decode(argv[1], argv[2], options, repeat);
+}
@@ -0,0 +1,199 @@
+/*
+ * pcmcmp - host check and benchmark of MP3PcmToI2S().
+ *
+ * Checks that the round-only path of MP3PcmToI2S() gives the same I2S words
+ * as the per-sample loop it replaced: scale() of synth.c, then left and
+ * right packed one sample at a time. Stereo and mono frames are checked
+ * with random samples up to +/-4.0, and with random start and count. The
+ * dither path is checked to stay within a few LSB of the rounded output,
+ * with no DC offset. Then all three are timed.
+ *
+ *   cc -O2 -Iinc -o pcmcmp test/pcmcmp.c src/MP3Func.c && ./pcmcmp
+ *
+ * Samples near +8.0 are left out: their rounding wraps around with the
+ * 32-bit long of the target but not with a 64-bit host long.
+ * Host times only compare the forms with each other; the speed on the
+ * target is printed by the player.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mad.h"
+#include "MP3Func.h"
+
+#define FRAME   1152
+
+/* synth.c before MP3PcmToI2S() */
+static signed int scale(mad_fixed_t sample)
+{
+  /* round */
+  sample += (1L << (MAD_F_FRACBITS - 16));
+
+  /* clip */
+  if (sample >= MAD_F_ONE)
+    sample = MAD_F_ONE - 1;
+  else if (sample < -MAD_F_ONE)
+    sample = -MAD_F_ONE;
+
+  /* quantize */
+  return sample >> (MAD_F_FRACBITS + 1 - 16);
+}
+
+static void reference(uint32_t *dst, struct mad_pcm const *pcm,
+                      unsigned int start, unsigned int count)
+{
+  unsigned int i;
+  uint16_t l, r;
+
+  for (i = start; i < start + count; ++i) {
+    l = (uint16_t) scale(pcm->samples[0][i]);
+    r = (pcm->channels == 2) ? (uint16_t) scale(pcm->samples[1][i]) : l;
+    *dst++ = r | ((uint32_t) l << 16);
+  }
+}
+
+static uint32_t seed = 1;
+
+static uint32_t rnd32(void)
+{
+  seed = seed * 1664525 + 1013904223;
+  return seed;
+}
+
+static mad_fixed_t sample(void)
+{
+  /* mostly the decoder range, sometimes far beyond it */
+  switch (rnd32() >> 30) {
+  case 0:
+    return (mad_fixed_t) (rnd32() >> 1) - (1L << 30);
+  case 1:
+    return (mad_fixed_t) (rnd32() >> 2) - (1L << 29);   /* around full scale */
+  default:
+    return (mad_fixed_t) (rnd32() >> 4) - (1L << 27);
+  }
+}
+
+static void fill(struct mad_pcm *pcm, unsigned int channels)
+{
+  unsigned int i;
+
+  pcm->channels = channels;
+  pcm->length = FRAME;
+  for (i = 0; i < FRAME; ++i) {
+    pcm->samples[0][i] = sample();
+    pcm->samples[1][i] = sample();
+  }
+
+  /* rounding and clipping edges */
+  pcm->samples[0][0] = MAD_F_ONE - 1;
+  pcm->samples[0][1] = -MAD_F_ONE;
+  pcm->samples[0][2] = MAD_F_ONE - (1L << (MAD_F_FRACBITS - 16));
+  pcm->samples[0][3] = (1L << (MAD_F_FRACBITS - 16)) - 1;
+  pcm->samples[0][4] = -(1L << (MAD_F_FRACBITS - 16));
+}
+
+static int check_round(int loops)
+{
+  static struct mad_pcm pcm;
+  uint32_t ref[FRAME + 1], out[FRAME + 1];
+  unsigned int start, count;
+  long bad = 0;
+  int n;
+
+  for (n = 0; n < loops; ++n) {
+    fill(&pcm, 1 + (n & 1));
+    start = (n % 4 < 2) ? 0 : rnd32() % FRAME;
+    count = (n % 4 < 2) ? FRAME : rnd32() % (FRAME - start + 1);
+
+    ref[count] = out[count] = 0xdeadbeef;   /* no write past count */
+    reference(ref, &pcm, start, count);
+    MP3PcmToI2S(out, &pcm, start, count, NULL);
+    if (memcmp(ref, out, (count + 1) * sizeof(uint32_t)) != 0)
+      ++bad;
+  }
+
+  printf("round: %d frames, %ld differ\n", loops, bad);
+  return bad != 0;
+}
+
+static int check_dither(int loops)
+{
+  static struct mad_pcm pcm;
+  static MP3_DITHER_T dither[2];
+  uint32_t ref[FRAME], out[FRAME];
+  long sum = 0, count = 0, d, max = 0;
+  unsigned int i;
+  int n, half;
+
+  memset(dither, 0, sizeof(dither));
+  for (n = 0; n < loops; ++n) {
+    /* quiet signal, clipping would move the noise shaper far off */
+    pcm.channels = 2;
+    pcm.length = FRAME;
+    for (i = 0; i < FRAME; ++i) {
+      pcm.samples[0][i] = (mad_fixed_t) (rnd32() >> 5) - (1L << 26);
+      pcm.samples[1][i] = (mad_fixed_t) (rnd32() >> 5) - (1L << 26);
+    }
+    reference(ref, &pcm, 0, FRAME);
+    MP3PcmToI2S(out, &pcm, 0, FRAME, dither);
+
+    for (i = 0; i < FRAME; ++i) {
+      for (half = 0; half < 32; half += 16) {
+        d = (int16_t) (out[i] >> half) - (int16_t) (ref[i] >> half);
+        sum += d;
+        ++count;
+        if (labs(d) > max)
+          max = labs(d);
+      }
+    }
+  }
+
+  printf("dither: max %ld LSB from rounding, mean %.4f LSB\n",
+         max, (double) sum / count);
+  return (max > 8) || (labs(sum) * 100 > count);
+}
+
+static void bench(int loops)
+{
+  static struct mad_pcm pcm;
+  static MP3_DITHER_T dither[2];
+  static uint32_t out[FRAME];
+  clock_t t0;
+  double t[3];
+  int n;
+
+  fill(&pcm, 2);
+
+  t0 = clock();
+  for (n = 0; n < loops; ++n)
+    reference(out, &pcm, 0, FRAME);
+  t[0] = (double) (clock() - t0) / CLOCKS_PER_SEC;
+
+  t0 = clock();
+  for (n = 0; n < loops; ++n)
+    MP3PcmToI2S(out, &pcm, 0, FRAME, NULL);
+  t[1] = (double) (clock() - t0) / CLOCKS_PER_SEC;
+
+  t0 = clock();
+  for (n = 0; n < loops; ++n)
+    MP3PcmToI2S(out, &pcm, 0, FRAME, dither);
+  t[2] = (double) (clock() - t0) / CLOCKS_PER_SEC;
+
+  printf("us per stereo frame: scale() loop %.2f, MP3PcmToI2S %.2f, dither %.2f\n",
+         t[0] * 1e6 / loops, t[1] * 1e6 / loops, t[2] * 1e6 / loops);
+}
+
+int main(int argc, char *argv[])
+{
+  int loops = (argc > 1) ? atoi(argv[1]) : 20000;
+  int fail;
+
+  fail  = check_round(loops);
+  fail |= check_dither(loops / 10);
+  bench(loops);
+
+  return fail;
+}